@@ -0,0 +1,117 @@
+#ifndef LIO_LIVOX_ASSOCIATION_CACHE_H
+#define LIO_LIVOX_ASSOCIATION_CACHE_H
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+#include <cmath>
+
+/** \brief per point cache of map associations, reused across the outer optimization iterations
+ *  while the pose has not moved far enough to change the nearest neighbours
+ */
+template <typename FeatureT>
+class AssociationCache
+{
+public:
+	/** \brief constructor of AssociationCache
+	 * \param[in] transThres: translation (m) below which the whole cache is reused
+	 * \param[in] rotThres: rotation (deg) below which the whole cache is reused
+	 */
+	AssociationCache(double transThres = 0.1, double rotThres = 1.0)
+		: trans_thres(transThres), rot_thres(rotThres) {}
+
+	/** \brief start a new association pass
+	 * \param[in] pose: pose used to project the points in this pass
+	 * \param[in] numPoints: number of points of the frame
+	 */
+	void Begin(const Eigen::Matrix4d &pose, size_t numPoints)
+	{
+		full_reuse = false;
+		if (entries.size() == numPoints && numPoints > 0)
+		{
+			Eigen::Matrix3d dR = last_pose.topLeftCorner(3, 3).transpose() * pose.topLeftCorner(3, 3);
+			double deltaR = Eigen::AngleAxisd(dR).angle() * 180.0 / M_PI;
+			double deltaT = (pose.topRightCorner(3, 1) - last_pose.topRightCorner(3, 1)).norm();
+			full_reuse = deltaT < trans_thres && deltaR < rot_thres;
+		}
+		else
+			entries.assign(numPoints, Entry());
+		new_entries.assign(numPoints, Entry());
+		// the gate compares against the pose of the last searching pass, so small updates do not add up unnoticed
+		if (!full_reuse)
+			last_pose = pose;
+	}
+
+	/** \brief reuse the cached association of point i if it is still inside its neighbourhood
+	 * \param[in] i: point index
+	 * \param[in] pointSel: point projected with the current pose
+	 * \param[in] maxSqDist: current squared distance threshold of the association
+	 * \param[out] features: cached features are appended here
+	 * \return true on cache hit
+	 */
+	bool Lookup(size_t i, const Eigen::Vector3d &pointSel, double maxSqDist, std::vector<FeatureT> &features)
+	{
+		queries++;
+		const Entry &e = entries[i];
+		if (!e.cached || e.sqDist >= maxSqDist)
+			return false;
+		if (!full_reuse && (pointSel - e.pointSel).norm() > e.gate)
+			return false;
+		Entry &ne = new_entries[i];
+		ne = e;
+		ne.begin = features.size();
+		features.insert(features.end(), cached_features.begin() + e.begin, cached_features.begin() + e.begin + e.count);
+		hits++;
+		return true;
+	}
+
+	/** \brief record the association just computed for point i
+	 * \param[in] i: point index
+	 * \param[in] pointSel: point projected with the current pose
+	 * \param[in] sqDist: squared distance of the farthest neighbour, 0 if nothing was associated
+	 * \param[in] begin: index of the first feature of this point in the feature vector
+	 * \param[in] features: feature vector of the current pass
+	 */
+	void Record(size_t i, const Eigen::Vector3d &pointSel, double sqDist, size_t begin, const std::vector<FeatureT> &features)
+	{
+		Entry &ne = new_entries[i];
+		ne.cached = true;
+		ne.pointSel = pointSel;
+		ne.begin = begin;
+		ne.count = features.size() - begin;
+		// an associated point keeps its neighbours while it stays inside their ball,
+		// a point without association is only searched again once the pose really moved
+		ne.sqDist = ne.count > 0 ? sqDist : 0.0;
+		ne.gate = ne.count > 0 ? std::sqrt(sqDist) : trans_thres;
+	}
+
+	/** \brief finish the pass, the features of this pass become the cache */
+	void End(const std::vector<FeatureT> &features)
+	{
+		cached_features = features;
+		entries.swap(new_entries);
+	}
+
+	size_t hits = 0;
+	size_t queries = 0;
+
+private:
+	struct Entry
+	{
+		bool cached = false;
+		Eigen::Vector3d pointSel = Eigen::Vector3d::Zero();
+		double sqDist = 0;
+		double gate = 0;
+		size_t begin = 0;
+		size_t count = 0;
+	};
+
+	double trans_thres;
+	double rot_thres;
+	bool full_reuse = false;
+	Eigen::Matrix4d last_pose = Eigen::Matrix4d::Identity();
+	std::vector<Entry> entries;
+	std::vector<Entry> new_entries;
+	std::vector<FeatureT> cached_features;
+};
+
+#endif // LIO_LIVOX_ASSOCIATION_CACHE_H
@@ -0,0 +1,101 @@
+#ifndef LIO_LIVOX_CONVERGENCE_MONITOR_H
+#define LIO_LIVOX_CONVERGENCE_MONITOR_H
+#include <vector>
+#include <cstddef>
+
+/** \brief stopping criterion of the outer optimization loop and statistics of the iterations used per frame
+ */
+class ConvergenceMonitor
+{
+public:
+	struct Options
+	{
+		int max_iters = 5;		   // upper bound of outer iterations
+		double trans_thres = 0.05; // pose update (m) below which the loop stops
+		double rot_thres = 0.05;   // pose update (deg) below which the loop stops
+		double cost_thres = 0.01;  // relative cost decrease of a solve below which the loop stops
+	};
+
+	ConvergenceMonitor() : ConvergenceMonitor(Options()) {}
+
+	explicit ConvergenceMonitor(const Options &options)
+		: options(options)
+	{
+		if (this->options.max_iters < 1)
+			this->options.max_iters = 1;
+		histogram.assign(this->options.max_iters + 1, 0);
+	}
+
+	/** \brief check whether the outer loop can stop after this iteration
+	 * \param[in] iter: index of the finished iteration, starting from 0
+	 * \param[in] deltaT: translation update of this iteration (m)
+	 * \param[in] deltaR: rotation update of this iteration (deg)
+	 * \param[in] initialCost: cost before the solve
+	 * \param[in] finalCost: cost after the solve
+	 * \return true if converged or out of iterations
+	 */
+	bool Converged(int iter, double deltaT, double deltaR, double initialCost, double finalCost) const
+	{
+		if (iter + 1 >= options.max_iters)
+			return true;
+		if (deltaT < options.trans_thres && deltaR < options.rot_thres)
+			return true;
+		// the first solve runs on the coarsest associations, only trust its cost from the second one on
+		if (iter > 0 && initialCost > 0 && (initialCost - finalCost) / initialCost < options.cost_thres)
+			return true;
+		return false;
+	}
+
+	/** \brief record the number of outer iterations used by one frame */
+	void AddFrame(int iters)
+	{
+		if (iters < 0)
+			iters = 0;
+		if (iters >= static_cast<int>(histogram.size()))
+			histogram.resize(iters + 1, 0);
+		histogram[iters]++;
+		frames++;
+		total_iters += iters;
+	}
+
+	double MeanIterations() const
+	{
+		return frames > 0 ? static_cast<double>(total_iters) / frames : 0.0;
+	}
+
+	int MedianIterations() const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < histogram.size(); ++i)
+		{
+			count += histogram[i];
+			if (2 * count >= frames && frames > 0)
+				return static_cast<int>(i);
+		}
+		return 0;
+	}
+
+	int MaxIterations() const
+	{
+		return options.max_iters;
+	}
+
+	size_t Frames() const
+	{
+		return frames;
+	}
+
+	/** \brief number of frames that used exactly iters outer iterations */
+	size_t Count(int iters) const
+	{
+		return iters >= 0 && iters < static_cast<int>(histogram.size()) ? histogram[iters] : 0;
+	}
+
+private:
+	Options options;
+	std::vector<size_t> histogram;
+	size_t frames = 0;
+	size_t total_iters = 0;
+};
+
+#endif // LIO_LIVOX_CONVERGENCE_MONITOR_H
@@ -0,0 +1,67 @@
+#ifndef LIO_LIVOX_DESKEW_H
+#define LIO_LIVOX_DESKEW_H
+#include "Estimator/LabelledPoint.h"
+#include <Eigen/Dense>
+#include <vector>
+
+/** \brief moves the points of a scan to the lidar pose at the scan end.
+ *  Instead of a slerp per point the scan time is split into kBuckets buckets, the top bits of
+ *  the 16 bit point time, and one float 4x4 transform is built per bucket by composing a fixed
+ *  step rotation. The points are then transformed in place with eigen's packet math (4 floats
+ *  per instruction) and without allocation. The error is half a bucket of motion, 0.1 mrad for
+ *  a scan turning 0.2 rad.
+ */
+class Deskew
+{
+public:
+	static const int kBucketBits = 10;
+	static const int kBuckets = 1 << kBucketBits;
+
+	Deskew() : table(kBuckets, Eigen::Matrix4f::Identity()) {}
+
+	/** \brief deskew a scan in place
+	 * \param[in] cloud: labelled lidar points, their time is set to the scan end
+	 * \param[in] dRlc: rotation of the lidar over the scan
+	 * \param[in] dtlc: translation of the lidar over the scan
+	 */
+	void Apply(LabelledCloud &cloud, const Eigen::Matrix3d &dRlc, const Eigen::Vector3d &dtlc)
+	{
+		Build(dRlc, dtlc);
+		const Eigen::Matrix4f *T = table.data();
+		const int n = cloud.points.size();
+		LabelledPoint *pts = cloud.points.data();
+		for (int i = 0; i < n; ++i)
+		{
+			LabelledPoint &p = pts[i];
+			const Eigen::Vector4f q = T[p.time >> (16 - kBucketBits)] * Eigen::Vector4f(p.x, p.y, p.z, 1.0f);
+			p.x = q.x();
+			p.y = q.y();
+			p.z = q.z();
+			p.time = 65535;
+		}
+	}
+
+private:
+	/** \brief transform of every bucket: dRlc^T * (R(s) * p + s * dtlc - dtlc) at the bucket centre s */
+	void Build(const Eigen::Matrix3d &dRlc, const Eigen::Vector3d &dtlc)
+	{
+		const Eigen::AngleAxisd aa(Eigen::Quaterniond(dRlc).normalized());
+		const double step = 1.0 / kBuckets;
+		const Eigen::Matrix3d Rstep = Eigen::AngleAxisd(aa.angle() * step, aa.axis()).toRotationMatrix();
+		Eigen::Matrix3d R = Eigen::AngleAxisd(aa.angle() * 0.5 * step, aa.axis()).toRotationMatrix();
+		const Eigen::Matrix3d Rt = dRlc.transpose();
+		const Eigen::Vector3d Rtt = Rt * dtlc;
+		for (int b = 0; b < kBuckets; ++b)
+		{
+			const double s = (b + 0.5) * step;
+			table[b].topLeftCorner<3, 3>() = (Rt * R).cast<float>();
+			table[b].topRightCorner<3, 1>() = ((s - 1.0) * Rtt).cast<float>();
+			// rotations about the same axis, R stays exp(s * log(dRlc))
+			R = R * Rstep;
+		}
+	}
+
+	std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>> table;
+};
+
+#endif // LIO_LIVOX_DESKEW_H
@@ -19,6 +19,15 @@
 #include "Estimator/Map_Manager.h"
 #include "Estimator/ceresfunc.h"
 #include "Estimator/IMUIntegrator.h"
+#include "Estimator/AssociationCache.h"
+#include "Estimator/ConvergenceMonitor.h"
+#include "Estimator/FeatureSelector.h"
+#include "Estimator/FrameWindow.h"
+#include "Estimator/KeyframeGate.h"
+#include "Estimator/LabelledPoint.h"
+#include "Estimator/MortonOrder.h"
+#include "Estimator/VoxelFilter.h"
+#include "utils/Profiler.h"
 #include <chrono>
 
 class Estimator
@@ -29,12 +38,14 @@ public:
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 	/** \brief slide window size */
 	static const int SLIDEWINDOWSIZE = 2;
+	/** \brief frames kept while initializing with IMU, capacity of the frame window */
+	static const int MAXWINDOWSIZE = 20;
 
 	/** \brief lidar frame struct */
 	struct LidarFrame
 	{
 		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-		pcl::PointCloud<PointType>::Ptr laserCloud;
+		LabelledCloud::Ptr laserCloud;
 		IMUIntegrator imuIntegrator;
 		Eigen::Vector3d P;
 		Eigen::Vector3d V;
@@ -51,8 +62,23 @@ public:
 			ba.setZero();
 			timeStamp = 0;
 		}
+		/** \brief back to the default state in place, the IMU message buffer keeps its capacity */
+		void Reset()
+		{
+			laserCloud.reset();
+			imuIntegrator.Clear();
+			P.setZero();
+			V.setZero();
+			Q.setIdentity();
+			bg.setZero();
+			ba.setZero();
+			timeStamp = 0;
+		}
 	};
 
+	/** \brief preallocated sliding window of lidar frames */
+	typedef FrameWindow<LidarFrame, MAXWINDOWSIZE> LidarWindow;
+
 	/** \brief point to line feature */
 	struct FeatureLine
 	{
@@ -150,8 +176,11 @@ public:
 
 public:
 	/** \brief constructor of Estimator
+	 * \param[in] assoc_trans: translation (m) below which the associations of the last iteration are reused
+	 * \param[in] assoc_rot: rotation (deg) below which the associations of the last iteration are reused
 	 */
-	Estimator(const float &filter_corner, const float &filter_surf);
+	Estimator(const float &filter_corner, const float &filter_surf,
+			  const double &assoc_trans = 0.1, const double &assoc_rot = 1.0);
 
 	~Estimator();
 
@@ -161,13 +190,15 @@ public:
 
 	/** \brief construct sharp feature Ceres Costfunctions
 	 * \param[in] edges: store costfunctions
+	 * \param[in] cache: associations of the previous iteration, only points that moved out of their neighbourhood are searched again
 	 * \param[in] m4d: lidar pose, represented by matrix 4X4
 	 */
 	void processPointToLine(std::vector<ceres::CostFunction *> &edges,
 							std::vector<FeatureLine> &vLineFeatures,
 							const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
 							const pcl::PointCloud<PointType>::Ptr &laserCloudCornerMap,
-							const pcl::KdTreeFLANN<PointType>::Ptr &kdtree,
+							const StaticKdTree<PointType>::Ptr &kdtree,
+							AssociationCache<FeatureLine> &cache,
 							const Eigen::Matrix4d &exTlb,
 							const Eigen::Matrix4d &m4d);
 
@@ -179,7 +210,7 @@ public:
 							std::vector<FeaturePlan> &vPlanFeatures,
 							const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
 							const pcl::PointCloud<PointType>::Ptr &laserCloudSurfMap,
-							const pcl::KdTreeFLANN<PointType>::Ptr &kdtree,
+							const StaticKdTree<PointType>::Ptr &kdtree,
 							const Eigen::Matrix4d &exTlb,
 							const Eigen::Matrix4d &m4d);
 
@@ -187,42 +218,93 @@ public:
 							   std::vector<FeaturePlanVec> &vPlanFeatures,
 							   const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
 							   const pcl::PointCloud<PointType>::Ptr &laserCloudSurfMap,
-							   const pcl::KdTreeFLANN<PointType>::Ptr &kdtree,
+							   const StaticKdTree<PointType>::Ptr &kdtree,
+							   AssociationCache<FeaturePlanVec> &cache,
 							   const Eigen::Matrix4d &exTlb,
 							   const Eigen::Matrix4d &m4d);
 
+	/** \brief plane through the 5 nearest map points of a surf point, solved in double, kept in float
+	 * \param[in] neighbours: the 5 map points, one per row
+	 * \param[out] plane: unit normal and offset, n^T p + d = 0
+	 * \return false if a neighbour is farther than 0.2 m from the plane
+	 */
+	static bool PlaneFit5(const Eigen::Matrix<double, 5, 3> &neighbours, Eigen::Vector4f &plane);
+
+	/** \brief square root information of a point to plane residual, the normal direction weighs most
+	 * \param[in] omega: unit plane normal
+	 * \param[in] weightTan: weight of the two tangent directions relative to the normal
+	 */
+	static Eigen::Matrix3d PlaneSqrtInfo(const Eigen::Vector3d &omega, double weightTan);
+
 	void processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
 							  std::vector<FeatureNon> &vNonFeatures,
 							  const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeature,
 							  const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeatureLocal,
-							  const pcl::KdTreeFLANN<PointType>::Ptr &kdtreeLocal,
+							  const StaticKdTree<PointType>::Ptr &kdtreeLocal,
 							  const Eigen::Matrix4d &exTlb,
 							  const Eigen::Matrix4d &m4d);
 
 	/** \brief Transform Lidar Pose in slidewindow to double array
 	 * \param[in] lidarFrameList: Lidar Poses in slidewindow
 	 */
-	void vector2double(const std::list<LidarFrame> &lidarFrameList);
+	void vector2double(const LidarWindow &lidarFrameList);
 
 	/** \brief Transform double array to Lidar Pose in slidewindow
 	 * \param[in] lidarFrameList: Lidar Poses in slidewindow
 	 */
-	void double2vector(std::list<LidarFrame> &lidarFrameList);
+	void double2vector(LidarWindow &lidarFrameList);
 
 	/** \brief estimate lidar pose by matching current lidar cloud with map cloud and tightly coupled IMU message
 	 * \param[in] lidarFrameList: multi-frames of lidar cloud and lidar pose
 	 * \param[in] exTlb: extrinsic matrix between lidar and IMU
 	 * \param[in] gravity: gravity vector
 	 */
-	void EstimateLidarPose(std::list<LidarFrame> &lidarFrameList,
+	void EstimateLidarPose(LidarWindow &lidarFrameList,
 						   const Eigen::Matrix4d &exTlb,
 						   const Eigen::Vector3d &gravity,
 						   nav_msgs::Odometry &debugInfo);
 
-	void Estimate(std::list<LidarFrame> &lidarFrameList,
+	void Estimate(LidarWindow &lidarFrameList,
 				  const Eigen::Matrix4d &exTlb,
 				  const Eigen::Vector3d &gravity);
 
+	/** \brief set the stopping criterion of the outer optimization loop
+	 * \param[in] options: iteration bound, pose update and cost decrease thresholds
+	 */
+	void set_convergence_options(const ConvergenceMonitor::Options &options)
+	{
+		convergence = ConvergenceMonitor(options);
+	}
+
+	/** \brief set which frames and points the map thread inserts into the map, before the first frame
+	 * \param[in] options: motion and novelty thresholds of a keyframe, per voxel caps
+	 */
+	void set_keyframe_options(const KeyframeGate::Options &options)
+	{
+		keyframeGate = KeyframeGate(options);
+	}
+
+	/** \brief set the residual budget of the lidar correspondences of a frame
+	 * \param[in] options: latency target and bounds of the budget
+	 */
+	void set_feature_options(const FeatureSelector::Options &options)
+	{
+		featureSelector = FeatureSelector(options);
+	}
+
+	/** \brief run the next frames degraded or in full
+	 * \param[in] degraded: whether to trade accuracy for latency
+	 * \param[in] max_iters: outer iterations of a degraded frame
+	 * \param[in] leaf_scale: scale of the feature leaf sizes of a degraded frame
+	 */
+	void set_degraded(bool degraded, int max_iters, double leaf_scale)
+	{
+		const float scale = degraded ? float(leaf_scale) : 1.0f;
+		downSizeFilterFrame.setLabelLeafSize(LabelledPoint::Corner, filterCorner * scale);
+		downSizeFilterFrame.setLabelLeafSize(LabelledPoint::Surf, filterSurf * scale);
+		degradedIters = degraded ? std::max(1, max_iters) : 0;
+	}
+
 	pcl::PointCloud<PointType>::Ptr get_corner_map()
 	{
 		return map_manager->get_corner_map();
@@ -248,9 +330,6 @@ private:
 	double para_VBias[SLIDEWINDOWSIZE][9];
 	MarginalizationInfo *last_marginalization_info = nullptr;
 	std::vector<double *> last_marginalization_parameter_blocks;
-	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudCornerLast;
-	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudSurfLast;
-	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudNonFeatureLast;
 
 	pcl::PointCloud<PointType>::Ptr laserCloudCornerFromLocal;
 	pcl::PointCloud<PointType>::Ptr laserCloudSurfFromLocal;
@@ -262,18 +341,20 @@ private:
 	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudCornerStack;
 	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudSurfStack;
 	std::vector<pcl::PointCloud<PointType>::Ptr> laserCloudNonFeatureStack;
-	pcl::KdTreeFLANN<PointType>::Ptr kdtreeCornerFromLocal;
-	pcl::KdTreeFLANN<PointType>::Ptr kdtreeSurfFromLocal;
-	pcl::KdTreeFLANN<PointType>::Ptr kdtreeNonFeatureFromLocal;
-	pcl::VoxelGrid<PointType> downSizeFilterCorner;
-	pcl::VoxelGrid<PointType> downSizeFilterSurf;
-	pcl::VoxelGrid<PointType> downSizeFilterNonFeature;
+	StaticKdTree<PointType>::Ptr kdtreeCornerFromLocal;
+	StaticKdTree<PointType>::Ptr kdtreeSurfFromLocal;
+	StaticKdTree<PointType>::Ptr kdtreeNonFeatureFromLocal;
+	VoxelFilter downSizeFilterFrame; // labelled frames, split and downsampled in one pass
+	MortonOrder<PointType> mortonOrder; // feature stacks in query order
+	VoxelFilter downSizeFilterCorner;
+	VoxelFilter downSizeFilterSurf;
+	VoxelFilter downSizeFilterNonFeature;
 	std::mutex mtx_Map;
 	std::thread threadMap;
 
-	pcl::KdTreeFLANN<PointType> CornerKdMap[10000];
-	pcl::KdTreeFLANN<PointType> SurfKdMap[10000];
-	pcl::KdTreeFLANN<PointType> NonFeatureKdMap[10000];
+	StaticKdTree<PointType> CornerKdMap[10000];
+	StaticKdTree<PointType> SurfKdMap[10000];
+	StaticKdTree<PointType> NonFeatureKdMap[10000];
 
 	pcl::PointCloud<PointType> GlobalSurfMap[10000];
 	pcl::PointCloud<PointType> GlobalCornerMap[10000];
@@ -289,11 +370,16 @@ private:
 	pcl::PointCloud<PointType>::Ptr localSurfMap[localMapWindowSize];
 	pcl::PointCloud<PointType>::Ptr localNonFeatureMap[localMapWindowSize];
 
-	int map_update_ID = 0;
-
-	int map_skip_frame = 2; // every map_skip_frame frame update map
+	KeyframeGate keyframeGate; // frames and points inserted by the map thread
 	double plan_weight_tan = 0.0;
 	double thres_dist = 1.0;
+	double assoc_trans_thres = 0.1;
+	double assoc_rot_thres = 1.0;
+	ConvergenceMonitor convergence;
+	FeatureSelector featureSelector; // budgeted correspondences of each frame, sized by the estimate latency
+	float filterCorner;
+	float filterSurf;
+	int degradedIters = 0; // outer iterations of a degraded frame, 0 runs frames in full
 };
 
 #endif // LIO_LIVOX_ESTIMATOR_H
@@ -0,0 +1,87 @@
+#ifndef LIO_LIVOX_FEATURE_EXTRACTOR_H
+#define LIO_LIVOX_FEATURE_EXTRACTOR_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include "Estimator/LabelledPoint.h"
+#include "Estimator/VoxelFilter.h"
+#include <vector>
+
+/** \brief ros free LOAM style feature extraction of one ring organized scan.
+ *  Input points carry the relative time in normal_x and the ring in normal_y, the extracted
+ *  range image points are LabelledPoint, the corner and surf clouds are labelled in normal_z.
+ */
+class FeatureExtractor
+{
+	typedef pcl::PointXYZINormal PointType;
+
+public:
+	struct Options
+	{
+		int N_SCAN = 16;
+		int Horizon_SCAN = 1800;
+		int downsampleRate = 1;
+		float lidarMinRange = 1.0;
+		float lidarMaxRange = 1000.0;
+		float edgeThreshold = 0.1;
+		float surfThreshold = 0.1;
+		float odometrySurfLeafSize = 0.2;
+		bool sequentialColumns = false; // livox: column is the arrival order inside the ring instead of the azimuth
+	};
+
+	explicit FeatureExtractor(const Options &options);
+
+	/** \brief extract corner and surf features of one scan
+	 * \param[in] inputCloud: scan points, normal_x is the relative time, normal_y the ring
+	 * \param[out] extractedCloud: range image points with their feature label
+	 * \param[out] cornerCloud: corner points
+	 * \param[out] surfaceCloud: downsampled surf points
+	 */
+	void Extract(const pcl::PointCloud<PointType>::Ptr &inputCloud,
+				 LabelledCloud::Ptr &extractedCloud,
+				 pcl::PointCloud<PointType>::Ptr &cornerCloud,
+				 pcl::PointCloud<PointType>::Ptr &surfaceCloud);
+
+	const Options &GetOptions() const
+	{
+		return options;
+	}
+
+	// stages of Extract(), public for the kernel benchmark
+	void projectPointCloud(const pcl::PointCloud<PointType>::Ptr &inputCloud);
+	void cloudExtraction(LabelledCloud &extractedCloud);
+	void calculateSmoothness(int cloudSize);
+	void markOccludedPoints(int cloudSize);
+	void extractFeatures(LabelledCloud &extractedCloud,
+						 pcl::PointCloud<PointType> &cornerCloud,
+						 pcl::PointCloud<PointType> &surfaceCloud);
+
+private:
+	struct smoothness_t
+	{
+		float value;
+		size_t ind;
+	};
+
+	Options options;
+	VoxelFilter downSizeFilter;
+
+	std::vector<float> rangeMat;
+	std::vector<PointType, Eigen::aligned_allocator<PointType>> fullCloud;
+	std::vector<int> columnIdnCountVec;
+
+	std::vector<int> startRingIndex;
+	std::vector<int> endRingIndex;
+	std::vector<int> pointColInd;
+	std::vector<int> pointFullInd; // index in fullCloud of every extracted point
+	std::vector<float> pointRange;
+
+	std::vector<smoothness_t> cloudSmoothness;
+	std::vector<float> cloudCurvature;
+	std::vector<int> cloudNeighborPicked;
+	std::vector<int> cloudLabel;
+
+	pcl::PointCloud<PointType>::Ptr surfaceCloudScan;
+	pcl::PointCloud<PointType>::Ptr surfaceCloudScanDS;
+};
+
+#endif // LIO_LIVOX_FEATURE_EXTRACTOR_H
@@ -0,0 +1,265 @@
+#ifndef LIO_LIVOX_FEATURE_SELECTOR_H
+#define LIO_LIVOX_FEATURE_SELECTOR_H
+#include <ceres/ceres.h>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/** \brief residual budget of the lidar features of one frame.
+ *  Every correspondence contributes one (plane) or two (line) rows of the 6 DoF pose Jacobian.
+ *  When a frame has more correspondences than the budget, the rows are projected onto the
+ *  eigenvectors of the information matrix of all of them and each direction, weakest first, takes
+ *  its turn picking the correspondence that constrains it most. A long corridor keeps the few
+ *  features that still pin the weak axis instead of thousands of redundant wall points. The
+ *  budget follows the measured latency of the estimate towards target_ms. The degeneracy score is
+ *  the smallest over the largest eigenvalue of the kept information, 0 means an unobservable pose
+ *  direction. Unselected cost functions are deleted. Not thread safe.
+ */
+class FeatureSelector
+{
+public:
+	struct Options
+	{
+		bool enable = false;
+		double target_ms = 50.0; // latency of one estimate the budget is sized for (ms)
+		int min_budget = 300;	 // correspondences kept per frame at least
+		int max_budget = 3000;	 // and at most
+	};
+
+	FeatureSelector() : FeatureSelector(Options()) {}
+
+	explicit FeatureSelector(const Options &options) : options(options)
+	{
+		if (this->options.min_budget < 6)
+			this->options.min_budget = 6;
+		if (this->options.max_budget < this->options.min_budget)
+			this->options.max_budget = this->options.min_budget;
+		budget = this->options.max_budget;
+	}
+
+	/** \brief keep at most Budget() of the line and plane correspondences of one frame, in order
+	 * \param[in] pose: lidar pose of the frame in map frame, the correspondences were fitted at
+	 * \param[in,out] edgesLine: point to line cost functions, parallel to lines
+	 * \param[in,out] lines: point to line features
+	 * \param[in,out] edgesPlan: point to plane cost functions, parallel to plans
+	 * \param[in,out] plans: point to plane features
+	 */
+	template <typename LineT, typename PlanT>
+	void Select(const Eigen::Matrix4d &pose,
+				std::vector<ceres::CostFunction *> &edgesLine, std::vector<LineT> &lines,
+				std::vector<ceres::CostFunction *> &edgesPlan, std::vector<PlanT> &plans)
+	{
+		const Eigen::Matrix3d R = pose.topLeftCorner(3, 3);
+		rows.clear();
+		owner.clear();
+		// candidates are the correspondences the solve would add, see the residual loops
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			if (std::fabs(lines[i].error) <= 1e-5)
+				continue;
+			Eigen::Vector3d d = lines[i].lineP2 - lines[i].lineP1;
+			if (d.norm() < 1e-9)
+				continue;
+			d.normalize();
+			Eigen::Vector3d n1 = d.unitOrthogonal();
+			const Eigen::Vector3d arm = R * lines[i].pointOri;
+			AddRow(arm, n1, int(i));
+			AddRow(arm, d.cross(n1), int(i));
+		}
+		const int planOffset = int(lines.size());
+		for (size_t i = 0; i < plans.size(); ++i)
+		{
+			if (std::fabs(plans[i].error) <= 1e-5)
+				continue;
+			// the first row of sqrt_info is the plane normal scaled by its information
+			Eigen::Vector3d n = plans[i].sqrt_info.row(0).transpose();
+			if (n.norm() < 1e-9)
+				continue;
+			AddRow(R * plans[i].pointOri, n.normalized(), planOffset + int(i));
+		}
+
+		const int total = planOffset + int(plans.size());
+		keep.assign(total, 0);
+		int candidates = 0;
+		for (size_t r = 0; r < owner.size(); ++r)
+			if (r == 0 || owner[r] != owner[r - 1])
+				candidates++;
+		candidatesSum += candidates;
+
+		Eigen::Matrix<double, 6, 6> H = Information(std::vector<char>());
+		if (!options.enable)
+		{
+			// no budget, still every correspondence the solve skips is deleted
+			for (size_t i = 0; i < lines.size(); ++i)
+				keep[i] = std::fabs(lines[i].error) > 1e-5;
+			for (size_t i = 0; i < plans.size(); ++i)
+				keep[planOffset + i] = std::fabs(plans[i].error) > 1e-5;
+		}
+		else if (candidates <= budget)
+		{
+			for (int o : owner)
+				keep[o] = 1;
+		}
+		else
+		{
+			Pick(H);
+			H = Information(keep);
+		}
+		Score(H);
+		selectedSum += Compact(edgesLine, lines, 0);
+		selectedSum += Compact(edgesPlan, plans, planOffset);
+	}
+
+	/** \brief steer the budget towards the target latency
+	 * \param[in] ms: latency of the last estimate (ms)
+	 */
+	void AddLatency(double ms)
+	{
+		if (!options.enable || ms <= 0)
+			return;
+		// multiplicative step, damped so a single slow frame does not halve the budget
+		const double ratio = std::max(0.8, std::min(1.25, options.target_ms / ms));
+		budget = std::max(options.min_budget, std::min(options.max_budget, int(budget * ratio + 0.5)));
+	}
+
+	/** \brief clear the statistics of the frames selected since the last call */
+	void ResetStats()
+	{
+		candidatesSum = 0;
+		selectedSum = 0;
+		degeneracy = 1.0;
+	}
+
+	int Budget() const { return budget; }
+	size_t Candidates() const { return candidatesSum; }
+	size_t Selected() const { return selectedSum; }
+	/** \brief smallest degeneracy score of the frames selected since ResetStats */
+	double Degeneracy() const { return degeneracy; }
+
+private:
+	typedef Eigen::Matrix<double, 6, 1> Row;
+
+	void AddRow(const Eigen::Vector3d &arm, const Eigen::Vector3d &n, int o)
+	{
+		Row row;
+		row.head<3>() = arm.cross(n);
+		row.tail<3>() = n;
+		rows.push_back(row);
+		owner.push_back(o);
+	}
+
+	/** \brief information of the kept rows, all rows if mask is empty. The rotation columns are scaled
+	 *  by the mean lever arm so that both blocks are in metres */
+	Eigen::Matrix<double, 6, 6> Information(const std::vector<char> &mask)
+	{
+		double arm = 0;
+		for (const Row &r : rows)
+			arm += r.head<3>().norm();
+		scale = rows.empty() || arm <= 0 ? 1.0 : rows.size() / arm;
+		Eigen::Matrix<double, 6, 6> H = Eigen::Matrix<double, 6, 6>::Zero();
+		for (size_t r = 0; r < rows.size(); ++r)
+		{
+			if (!mask.empty() && !mask[owner[r]])
+				continue;
+			Row s = rows[r];
+			s.head<3>() *= scale;
+			H.selfadjointView<Eigen::Lower>().rankUpdate(s);
+		}
+		return H.selfadjointView<Eigen::Lower>();
+	}
+
+	void Score(const Eigen::Matrix<double, 6, 6> &H)
+	{
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> es(H, Eigen::EigenvaluesOnly);
+		const double maxEig = es.eigenvalues()(5);
+		const double score = maxEig > 0 ? std::max(0.0, es.eigenvalues()(0)) / maxEig : 0.0;
+		degeneracy = std::min(degeneracy, score);
+	}
+
+	/** \brief round robin over the eigen directions of H, weakest first, each taking the
+	 *  correspondence that constrains it most and is not kept yet */
+	void Pick(const Eigen::Matrix<double, 6, 6> &H)
+	{
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 6, 6>> es(H);
+		const size_t total = keep.size();
+		gain.assign(6 * total, 0.0);
+		for (size_t r = 0; r < rows.size(); ++r)
+		{
+			Row s = rows[r];
+			s.head<3>() *= scale;
+			for (int k = 0; k < 6; ++k)
+			{
+				const double g = s.dot(es.eigenvectors().col(k));
+				gain[k * total + owner[r]] += g * g;
+			}
+		}
+		for (int k = 0; k < 6; ++k)
+		{
+			order[k].clear();
+			for (size_t r = 0; r < rows.size(); ++r)
+				if (r == 0 || owner[r] != owner[r - 1])
+					order[k].push_back(owner[r]);
+			const double *g = &gain[k * total];
+			std::sort(order[k].begin(), order[k].end(), [g](int a, int b) { return g[a] > g[b]; });
+		}
+		// the eigenvalues come in increasing order, the weakest direction picks first
+		size_t next[6] = {0, 0, 0, 0, 0, 0};
+		int picked = 0;
+		while (picked < budget)
+		{
+			bool progress = false;
+			for (int k = 0; k < 6 && picked < budget; ++k)
+			{
+				while (next[k] < order[k].size() && keep[order[k][next[k]]])
+					next[k]++;
+				if (next[k] == order[k].size())
+					continue;
+				keep[order[k][next[k]++]] = 1;
+				picked++;
+				progress = true;
+			}
+			if (!progress)
+				break;
+		}
+	}
+
+	/** \brief move the kept entries to the front in order, delete the cost functions of the others
+	 * \return number of kept entries */
+	template <typename FeatureT>
+	size_t Compact(std::vector<ceres::CostFunction *> &edges, std::vector<FeatureT> &features, int offset)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < features.size(); ++i)
+		{
+			if (!keep[offset + i])
+			{
+				delete edges[i];
+				continue;
+			}
+			edges[kept] = edges[i];
+			if (kept != i)
+				features[kept] = features[i];
+			kept++;
+		}
+		edges.resize(kept);
+		features.erase(features.begin() + kept, features.end());
+		return kept;
+	}
+
+	Options options;
+	int budget;
+	double scale = 1.0;
+	std::vector<Row, Eigen::aligned_allocator<Row>> rows; // Jacobian rows of the candidates
+	std::vector<int> owner;								  // correspondence of each row, lines first
+	std::vector<char> keep;
+	std::vector<double> gain;
+	std::vector<int> order[6];
+	size_t candidatesSum = 0;
+	size_t selectedSum = 0;
+	double degeneracy = 1.0;
+};
+
+#endif // LIO_LIVOX_FEATURE_SELECTOR_H
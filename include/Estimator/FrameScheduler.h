@@ -0,0 +1,123 @@
+#ifndef LIO_LIVOX_FRAME_SCHEDULER_H
+#define LIO_LIVOX_FRAME_SCHEDULER_H
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+/** \brief deadline policy of the lidar frame queue.
+ *  The latency of a frame runs from its sensor stamp to the output of its pose. The stamps and the
+ *  current time may come from different clocks, a bag played without /clock for instance, so the
+ *  smallest age of a frame seen so far is taken as their offset. Before the oldest
+ *  queued frame is processed, its age plus the typical processing time of a full frame predicts
+ *  its latency. Within the budget the frame is processed in full. Over the budget and with newer
+ *  frames queued, the frame is skipped, its IMU messages stay queued and are integrated into the
+ *  next processed frame. Only a preintegrated frame bridges the skipped ones, without it the
+ *  constant velocity prediction covers one frame interval, so the frame is degraded instead. At most max_skips frames in a row are skipped, after that, or when the
+ *  frame is the newest one, it is processed degraded, with fewer outer iterations on coarser
+ *  feature clouds. Used by the processing thread only, not thread safe.
+ */
+class FrameScheduler
+{
+public:
+	enum Action
+	{
+		Full = 0,
+		Degraded = 1,
+		Skip = 2
+	};
+
+	struct Options
+	{
+		bool enable = false;
+		double latency_budget = 0.2;	 // sensor stamp to pose output (s)
+		int max_skips = 2;				 // frames skipped in a row at most
+		int degraded_iters = 2;			 // outer iterations of a degraded frame
+		double degraded_leaf_scale = 2.0; // scale of the feature leaf sizes of a degraded frame
+	};
+
+	FrameScheduler() : FrameScheduler(Options()) {}
+
+	explicit FrameScheduler(const Options &options) : options(options) {}
+
+	/** \brief choose the action of the oldest queued frame
+	 * \param[in] stamp: sensor time of the frame (s)
+	 * \param[in] now: current time in the clock of the stamps (s)
+	 * \param[in] queued: number of newer frames waiting behind it
+	 * \param[in] skippable: the next frame is preintegrated over the IMU messages of a skipped one
+	 */
+	Action Decide(double stamp, double now, size_t queued, bool skippable)
+	{
+		clockOffset = std::min(clockOffset, now - stamp);
+		Action action = Full;
+		if (options.enable && Age(stamp, now) + processTime[Full] > options.latency_budget)
+			action = skippable && queued > 0 && skipsInRow < options.max_skips ? Skip : Degraded;
+		skipsInRow = action == Skip ? skipsInRow + 1 : 0;
+		counts[action]++;
+		lastAction = action;
+		return action;
+	}
+
+	/** \brief record the output of a processed frame
+	 * \param[in] stamp: sensor time of the frame (s)
+	 * \param[in] now: time of the pose output in the clock of the stamps (s)
+	 * \param[in] seconds: processing time of the frame (s)
+	 */
+	void Done(double stamp, double now, double seconds)
+	{
+		// a slow frame raises the estimate at once, a fast one lowers it slowly
+		double &t = processTime[lastAction == Degraded ? Degraded : Full];
+		t = seconds > t ? seconds : 0.9 * t + 0.1 * seconds;
+		// forget a stale full frame estimate while degraded, so a full frame is tried again
+		if (lastAction == Degraded)
+			processTime[Full] *= 0.95;
+		lastLatency = Age(stamp, now);
+		maxLatency = std::max(maxLatency, lastLatency);
+	}
+
+	/** \brief cut the motion since the last processed frame down to the motion over the scan of the
+	 *  current frame, the frames skipped in between lie before its scan. Only for a motion that
+	 *  spans the skipped frames, i.e. a preintegrated one
+	 * \param[in] skipped: frames skipped since the last processed frame
+	 * \param[in,out] dR: rotation since the last processed frame
+	 * \param[in,out] dt: translation since the last processed frame
+	 */
+	static void ScanMotion(int skipped, Eigen::Matrix3d &dR, Eigen::Vector3d &dt)
+	{
+		if (skipped <= 0)
+			return;
+		const double share = 1.0 / (skipped + 1);
+		const Eigen::AngleAxisd aa(dR);
+		dR = Eigen::AngleAxisd(aa.angle() * share, aa.axis()).toRotationMatrix();
+		dt *= share;
+	}
+
+	static const char *Name(Action action)
+	{
+		return action == Full ? "full" : action == Degraded ? "degraded" : "skip";
+	}
+
+	const Options &GetOptions() const { return options; }
+	Action LastAction() const { return lastAction; }
+	double LastLatency() const { return lastLatency; }
+	double MaxLatency() const { return maxLatency; }
+	size_t Count(Action action) const { return counts[action]; }
+
+private:
+	double Age(double stamp, double now) const
+	{
+		return now - stamp - clockOffset;
+	}
+
+	Options options;
+	double clockOffset = std::numeric_limits<double>::max();
+	Action lastAction = Full;
+	int skipsInRow = 0;
+	double processTime[2] = {0.0, 0.0}; // typical processing time of a full and a degraded frame (s)
+	double lastLatency = 0.0;
+	double maxLatency = 0.0;
+	size_t counts[3] = {0, 0, 0};
+};
+
+#endif // LIO_LIVOX_FRAME_SCHEDULER_H
@@ -0,0 +1,130 @@
+#ifndef LIO_LIVOX_FRAME_WINDOW_H
+#define LIO_LIVOX_FRAME_WINDOW_H
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include <Eigen/Core>
+
+/** \brief fixed capacity ring buffer of the lidar frames in the sliding window.
+ *  All Capacity frames are constructed once in one aligned block, push_back copy assigns into
+ *  the next free slot so the Eigen states, the IMU message vectors and the cloud pointers reuse
+ *  their storage, pop_front resets the oldest slot in place with Frame::Reset and moves the head.
+ *  A frame keeps its address while it stays in the window. Pushing into a full window drops the
+ *  oldest frame first.
+ */
+template <typename Frame, int Capacity>
+class FrameWindow
+{
+public:
+	/** \brief random access iterator from the oldest to the newest frame */
+	template <typename Window, typename Value>
+	class Iterator
+	{
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef Value value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef Value *pointer;
+		typedef Value &reference;
+
+		Iterator() : window(nullptr), index(0) {}
+		Iterator(Window *window, difference_type index) : window(window), index(index) {}
+		// iterator to const_iterator
+		template <typename W, typename V>
+		Iterator(const Iterator<W, V> &other) : window(other.window), index(other.index) {}
+
+		reference operator*() const { return (*window)[index]; }
+		pointer operator->() const { return &(*window)[index]; }
+		reference operator[](difference_type n) const { return (*window)[index + n]; }
+
+		Iterator &operator++() { ++index; return *this; }
+		Iterator &operator--() { --index; return *this; }
+		Iterator operator++(int) { Iterator tmp(*this); ++index; return tmp; }
+		Iterator operator--(int) { Iterator tmp(*this); --index; return tmp; }
+		Iterator &operator+=(difference_type n) { index += n; return *this; }
+		Iterator &operator-=(difference_type n) { index -= n; return *this; }
+		Iterator operator+(difference_type n) const { return Iterator(window, index + n); }
+		Iterator operator-(difference_type n) const { return Iterator(window, index - n); }
+		difference_type operator-(const Iterator &other) const { return index - other.index; }
+
+		bool operator==(const Iterator &other) const { return index == other.index; }
+		bool operator!=(const Iterator &other) const { return index != other.index; }
+		bool operator<(const Iterator &other) const { return index < other.index; }
+		bool operator>(const Iterator &other) const { return index > other.index; }
+		bool operator<=(const Iterator &other) const { return index <= other.index; }
+		bool operator>=(const Iterator &other) const { return index >= other.index; }
+
+	private:
+		template <typename W, typename V>
+		friend class Iterator;
+
+		Window *window;
+		difference_type index;
+	};
+
+	typedef Iterator<FrameWindow, Frame> iterator;
+	typedef Iterator<const FrameWindow, const Frame> const_iterator;
+
+	FrameWindow() : frames(Capacity), head(0), count(0) {}
+
+	static int capacity() { return Capacity; }
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	/** \brief i-th frame of the window, 0 is the oldest */
+	Frame &operator[](int i)
+	{
+		assert(i >= 0 && i < count);
+		return frames[(head + i) % Capacity];
+	}
+	const Frame &operator[](int i) const
+	{
+		assert(i >= 0 && i < count);
+		return frames[(head + i) % Capacity];
+	}
+
+	Frame &front() { return (*this)[0]; }
+	const Frame &front() const { return (*this)[0]; }
+	Frame &back() { return (*this)[count - 1]; }
+	const Frame &back() const { return (*this)[count - 1]; }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, count); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, count); }
+
+	/** \brief append a copy of frame as the newest frame, a full window drops its oldest frame */
+	void push_back(const Frame &frame)
+	{
+		if (count == Capacity)
+			pop_front();
+		frames[(head + count) % Capacity] = frame;
+		++count;
+	}
+
+	/** \brief drop the oldest frame, its clouds and IMU messages are released at once */
+	void pop_front()
+	{
+		assert(count > 0);
+		// a default constructed frame would be move assigned and take away the capacity of the slot
+		frames[head].Reset();
+		head = (head + 1) % Capacity;
+		--count;
+	}
+
+	void clear()
+	{
+		while (count > 0)
+			pop_front();
+		head = 0;
+	}
+
+private:
+	std::vector<Frame, Eigen::aligned_allocator<Frame>> frames;
+	int head;
+	int count;
+};
+
+#endif // LIO_LIVOX_FRAME_WINDOW_H
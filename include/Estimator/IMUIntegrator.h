@@ -20,6 +20,10 @@ public:
 
   void Reset();
 
+  /** \brief reset and drop the IMU messages, the message buffer keeps its capacity
+     */
+  void Clear();
+
   /** \brief get delta quaternion after IMU integration
      */
   const Eigen::Quaterniond &GetDeltaQ() const;
@@ -77,10 +81,11 @@ public:
   void Integration() {}
 
 public:
-  const double acc_n = 0.08;
-  const double gyr_n = 0.004;
-  const double acc_w = 2.0e-4;
-  const double gyr_w = 2.0e-5;
+  // static so the integrator stays copy assignable into the slots of the frame window
+  constexpr static const double acc_n = 0.08;
+  constexpr static const double gyr_n = 0.004;
+  constexpr static const double acc_w = 2.0e-4;
+  constexpr static const double gyr_w = 2.0e-5;
   constexpr static const double lidar_m = 1.5e-3;
   constexpr static const double gnorm = 1.0; //9.805;
 
@@ -0,0 +1,156 @@
+#ifndef LIO_LIVOX_KEYFRAME_GATE_H
+#define LIO_LIVOX_KEYFRAME_GATE_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "utils/VoxelHash.h"
+
+/** \brief decides which frames are inserted into the map and which of their points.
+ *  A frame becomes a keyframe once the pose moved or rotated far enough since the last keyframe,
+ *  or once enough of its points fall into voxels the map has not seen yet. Every voxel admits at
+ *  most max_points_per_voxel points of each feature class over all keyframes, so revisiting a
+ *  place stops growing its cubes and the cubes only change, and get filtered and rebuilt, for new
+ *  geometry. Voxels farther than forget_radius from the last keyframe are forgotten, the map
+ *  manager drops those cubes sooner or later and a revisit may fill them again.
+ *  Disabled, every frame is inserted with all its points as before.
+ *  Used by the map thread only, not thread safe.
+ */
+class KeyframeGate
+{
+	typedef pcl::PointXYZINormal PointType;
+
+public:
+	struct Options
+	{
+		bool enable = false;		   // off every frame is a keyframe with all its points
+		double trans_thres = 1.0;	   // a frame this far from the last keyframe is a keyframe (m)
+		double rot_thres = 10.0;	   // or rotated this much (deg)
+		double novelty_thres = 0.2;	   // or this fraction of its points falls into unseen voxels
+		double voxel_size = 0.4;	   // occupancy voxel size (m)
+		int max_points_per_voxel = 5;  // points admitted per voxel and feature class
+		double forget_radius = 300.0;  // voxels farther than this from the last keyframe are forgotten (m)
+	};
+
+	KeyframeGate() : KeyframeGate(Options()) {}
+
+	explicit KeyframeGate(const Options &options) : options(options)
+	{
+		inverseVoxel = 1.0 / this->options.voxel_size;
+	}
+
+	/** \brief fraction of points of the map frame clouds in voxels without any admitted point */
+	double Novelty(const pcl::PointCloud<PointType> &corner, const pcl::PointCloud<PointType> &surf) const
+	{
+		size_t unseen = 0;
+		for (const auto &p : corner.points)
+			unseen += occupancy.count(Key(p, 0)) == 0;
+		for (const auto &p : surf.points)
+			unseen += occupancy.count(Key(p, 1)) == 0;
+		const size_t n = corner.size() + surf.size();
+		return n > 0 ? double(unseen) / n : 0.0;
+	}
+
+	/** \brief decide whether the frame at pose is a keyframe, a keyframe becomes the new reference
+	 * \param[in] pose: lidar pose of the frame in map frame
+	 * \param[in] corner: corner points of the frame in map frame
+	 * \param[in] surf: surf points of the frame in map frame
+	 */
+	bool Accept(const Eigen::Matrix4d &pose, const pcl::PointCloud<PointType> &corner, const pcl::PointCloud<PointType> &surf)
+	{
+		frames++;
+		if (!options.enable)
+		{
+			keyframes++;
+			return true;
+		}
+		const Eigen::Vector3d t = pose.topRightCorner(3, 1);
+		const Eigen::Quaterniond q(Eigen::Matrix3d(pose.topLeftCorner(3, 3)));
+		if (keyframes > 0)
+		{
+			const double deltaT = (t - lastT).norm();
+			const double deltaR = q.angularDistance(lastQ) * 180.0 / M_PI;
+			// the novelty is only looked up for a frame that did not move enough
+			if (deltaT < options.trans_thres && deltaR < options.rot_thres &&
+				Novelty(corner, surf) < options.novelty_thres)
+				return false;
+		}
+		keyframes++;
+		lastT = t;
+		lastQ = q;
+		if ((t - pruneT).norm() > 0.25 * options.forget_radius)
+			Forget(t);
+		return true;
+	}
+
+	/** \brief drop the points of cloud whose voxel is full, count the kept ones
+	 * \param[in,out] cloud: map frame points of a keyframe
+	 * \param[in] featureClass: 0 corner, 1 surf, 2 non feature, each class has its own caps
+	 */
+	void Admit(pcl::PointCloud<PointType> &cloud, int featureClass)
+	{
+		if (!options.enable)
+			return;
+		size_t kept = 0;
+		for (size_t i = 0; i < cloud.points.size(); ++i)
+		{
+			uint16_t &count = occupancy[Key(cloud.points[i], featureClass)];
+			if (count >= options.max_points_per_voxel)
+				continue;
+			count++;
+			cloud.points[kept++] = cloud.points[i];
+		}
+		dropped += cloud.points.size() - kept;
+		cloud.points.resize(kept);
+		cloud.width = kept;
+		cloud.height = 1;
+	}
+
+	size_t Frames() const { return frames; }
+	size_t Keyframes() const { return keyframes; }
+	size_t DroppedPoints() const { return dropped; }
+	size_t Voxels() const { return occupancy.size(); }
+
+private:
+	uint64_t Key(const PointType &p, int featureClass) const
+	{
+		return voxel_hash::KeyOf(double(p.x), double(p.y), double(p.z), inverseVoxel, uint64_t(featureClass));
+	}
+
+	/** \brief voxel centre of key in map frame */
+	Eigen::Vector3d Centre(uint64_t key) const
+	{
+		const Eigen::Vector3d index(double(voxel_hash::Index(key, 0)), double(voxel_hash::Index(key, 1)),
+									double(voxel_hash::Index(key, 2)));
+		return (index + Eigen::Vector3d::Constant(0.5)) * options.voxel_size;
+	}
+
+	void Forget(const Eigen::Vector3d &t)
+	{
+		const double r2 = options.forget_radius * options.forget_radius;
+		for (auto it = occupancy.begin(); it != occupancy.end();)
+		{
+			if ((Centre(it->first) - t).squaredNorm() > r2)
+				it = occupancy.erase(it);
+			else
+				++it;
+		}
+		pruneT = t;
+	}
+
+	Options options;
+	double inverseVoxel;
+	std::unordered_map<uint64_t, uint16_t> occupancy; // admitted points per voxel and feature class
+	Eigen::Vector3d lastT = Eigen::Vector3d::Zero();
+	Eigen::Quaterniond lastQ = Eigen::Quaterniond::Identity();
+	Eigen::Vector3d pruneT = Eigen::Vector3d::Zero();
+	size_t frames = 0;
+	size_t keyframes = 0;
+	size_t dropped = 0;
+};
+
+#endif // LIO_LIVOX_KEYFRAME_GATE_H
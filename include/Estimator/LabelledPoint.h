@@ -0,0 +1,109 @@
+#ifndef LIO_LIVOX_LABELLED_POINT_H
+#define LIO_LIVOX_LABELLED_POINT_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/register_point_struct.h>
+#include <cstdint>
+
+/** \brief 16 byte lidar point carried from the feature extraction to the estimators,
+ *  a third of the PointXYZINormal it replaces on that path. The relative time inside the
+ *  scan is quantized to 16 bit, the intensity is not kept.
+ */
+struct LabelledPoint
+{
+	enum Label : uint8_t
+	{
+		None = 0,
+		Corner = 1,
+		Surf = 2,
+		NonFeature = 3
+	};
+
+	float x;
+	float y;
+	float z;
+	uint16_t time; // relative time in the scan, 0..65535 for [0, 1]
+	uint8_t ring;
+	uint8_t label;
+
+	/** \brief relative time in the scan in [0, 1] */
+	float Time() const
+	{
+		return time * (1.0f / 65535.0f);
+	}
+
+	void SetTime(float s)
+	{
+		s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+		time = static_cast<uint16_t>(s * 65535.0f + 0.5f);
+	}
+
+	/** \brief take position, time (normal_x) and ring (normal_y) of a raw scan point */
+	void Set(const pcl::PointXYZINormal &p)
+	{
+		x = p.x;
+		y = p.y;
+		z = p.z;
+		SetTime(p.normal_x);
+		ring = static_cast<uint8_t>(p.normal_y);
+		label = None;
+	}
+
+	/** \brief the PointXYZINormal layout of the map clouds, the label goes to normal_z */
+	pcl::PointXYZINormal ToMapPoint() const
+	{
+		pcl::PointXYZINormal p;
+		p.x = x;
+		p.y = y;
+		p.z = z;
+		p.intensity = 0;
+		p.normal_x = Time();
+		p.normal_y = ring;
+		p.normal_z = label;
+		p.curvature = 0;
+		return p;
+	}
+};
+static_assert(sizeof(LabelledPoint) == 16, "LabelledPoint must stay 16 bytes");
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(LabelledPoint,
+								  (float, x, x)(float, y, y)(float, z, z)(uint16_t, time, time)(uint8_t, ring, ring)(uint8_t, label, label))
+
+typedef pcl::PointCloud<LabelledPoint> LabelledCloud;
+
+/** \brief split a frame by feature label in a single pass
+ * \param[in] cloud: labelled lidar points
+ * \param[out] corner: points labelled Corner
+ * \param[out] surf: points labelled Surf
+ * \param[out] nonFeature: points labelled NonFeature, may be null
+ */
+inline void SplitByLabel(const LabelledCloud &cloud,
+						 pcl::PointCloud<pcl::PointXYZINormal> &corner,
+						 pcl::PointCloud<pcl::PointXYZINormal> &surf,
+						 pcl::PointCloud<pcl::PointXYZINormal> *nonFeature)
+{
+	corner.clear();
+	surf.clear();
+	if (nonFeature)
+		nonFeature->clear();
+	for (const auto &p : cloud.points)
+	{
+		switch (p.label)
+		{
+		case LabelledPoint::Corner:
+			corner.push_back(p.ToMapPoint());
+			break;
+		case LabelledPoint::Surf:
+			surf.push_back(p.ToMapPoint());
+			break;
+		case LabelledPoint::NonFeature:
+			if (nonFeature)
+				nonFeature->push_back(p.ToMapPoint());
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+#endif // LIO_LIVOX_LABELLED_POINT_H
@@ -0,0 +1,156 @@
+#ifndef LIO_LIVOX_LIO_PIPELINE_H
+#define LIO_LIVOX_LIO_PIPELINE_H
+#include "Estimator/Estimator.h"
+#include "Estimator/Deskew.h"
+#include "Estimator/FrameScheduler.h"
+#include "Estimator/StationaryDetector.h"
+#include <mutex>
+#include <queue>
+#include <vector>
+
+/** \brief per frame lidar inertial odometry: IMU prediction, deskew, pose estimation and IMU initialization.
+ *  Holds no ros handle, so it runs both inside the PoseEstimation node and in offline replay.
+ */
+class LioPipeline
+{
+	typedef pcl::PointXYZINormal PointType;
+
+public:
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	struct Options
+	{
+		float filter_parameter_corner = 0.2;
+		float filter_parameter_surf = 0.4;
+		double assoc_trans_thres = 0.1;
+		double assoc_rot_thres = 1.0;
+		ConvergenceMonitor::Options convergence;
+		KeyframeGate::Options keyframe;
+		StationaryDetector::Options stationary;
+		FeatureSelector::Options features;
+		int IMU_Mode = 2;
+		std::vector<double> extrinsic_T = std::vector<double>(3, 0.0); // lidar in IMU frame
+		std::vector<double> extrinsic_R = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+	};
+
+	explicit LioPipeline(const Options &options);
+
+	/** \brief queue one IMU message, thread safe */
+	void PushImu(const sensor_msgs::ImuConstPtr &imu_msg);
+
+	/** \brief get IMU messages in a certain time interval
+	 * \param[in] startTime: left boundary of time interval
+	 * \param[in] endTime: right boundary of time interval
+	 * \param[in] vimuMsg: store IMU messages
+	 */
+	bool fetchImuMsgs(double startTime, double endTime, std::vector<sensor_msgs::ImuConstPtr> &vimuMsg);
+
+	/** \brief time span of the queued IMU messages
+	 * \return false if the queue is empty
+	 */
+	bool ImuQueueSpan(double &front, double &back);
+
+	/** \brief whether the next frame needs the IMU messages since LastLidarTime() */
+	bool NeedImu() const
+	{
+		return options.IMU_Mode > 0 && time_last_lidar > 0;
+	}
+
+	double LastLidarTime() const
+	{
+		return time_last_lidar;
+	}
+
+	/** \brief estimate the pose of one lidar frame
+	 * \param[in] cloud: labelled lidar points in lidar frame, deskewed in place
+	 * \param[in] time: time stamp of the frame
+	 * \param[in] vimuMsg: IMU messages between the last frame and this one
+	 * \return false if IMU is initialized but no IMU message arrived, the frame is dropped
+	 */
+	bool ProcessFrame(const LabelledCloud::Ptr &cloud, double time,
+					  const std::vector<sensor_msgs::ImuConstPtr> &vimuMsg);
+
+	/** \brief drop one lidar frame unprocessed, its IMU messages go to the next processed frame */
+	void SkipFrame()
+	{
+		skippedFrames++;
+	}
+
+	/** \brief lidar pose in world frame of the last processed frame */
+	const Eigen::Matrix4d &GetLidarPose() const
+	{
+		return transformTobeMapped;
+	}
+
+	/** \brief last processed frame, its cloud is deskewed and in lidar frame */
+	const Estimator::LidarFrame &CurrentFrame() const
+	{
+		return lidar_list->front();
+	}
+
+	bool IsLidarIMUInited() const
+	{
+		return LidarIMUInited;
+	}
+
+	/** \brief whether the tightly coupled IMU initialization still needs consecutive full frames */
+	bool IsInitializing() const
+	{
+		return options.IMU_Mode > 1 && !LidarIMUInited;
+	}
+
+	/** \brief whether the last processed frame took the stationary fast path */
+	bool IsStationary() const
+	{
+		return isStationary;
+	}
+
+	/** \brief move every point to the end of the scan
+	 * \param[in] cloud: labelled lidar points
+	 * \param[in] dRlc: rotation of the lidar over the scan
+	 * \param[in] dtlc: translation of the lidar over the scan
+	 */
+	static void RemoveLidarDistortion(LabelledCloud::Ptr &cloud,
+									  const Eigen::Matrix3d &dRlc, const Eigen::Vector3d &dtlc);
+
+	Estimator *estimator;
+
+private:
+
+	bool TryMAPInitialization();
+
+	Options options;
+	int WINDOWSIZE;
+	bool LidarIMUInited = false;
+	StationaryDetector stationary;
+	bool isStationary = false;
+	size_t stationaryFrames = 0;
+	int skippedFrames = 0; // frames dropped since the last processed one
+	// sliding window, holds the initialization window until the IMU is initialized
+	Estimator::LidarWindow lidarFrameList;
+	// the current frame alone, optimized while the IMU is not initialized
+	Estimator::LidarWindow currentFrameList;
+	// window passed to the estimator, either of the two above
+	Estimator::LidarWindow *lidar_list;
+	Estimator::LidarFrame scratchFrame;
+
+	std::mutex _mutexIMUQueue;
+	std::queue<sensor_msgs::ImuConstPtr> _imuMsgQueue;
+
+	Eigen::Matrix4d exTlb;
+	Eigen::Matrix3d exRlb, exRbl;
+	Eigen::Vector3d exPlb, exPbl;
+	Eigen::Vector3d GravityVector;
+
+	Eigen::Matrix4d transformAftMapped = Eigen::Matrix4d::Identity();
+	Eigen::Matrix4d transformTobeMapped = Eigen::Matrix4d::Identity();
+	Eigen::Matrix3d delta_Rl = Eigen::Matrix3d::Identity();
+	Eigen::Vector3d delta_tl = Eigen::Vector3d::Zero();
+	Eigen::Matrix3d delta_Rb = Eigen::Matrix3d::Identity();
+	Eigen::Vector3d delta_tb = Eigen::Vector3d::Zero();
+	double time_last_lidar = -1;
+	int pushCount = 0;
+	double startTime = 0;
+};
+
+#endif // LIO_LIVOX_LIO_PIPELINE_H
@@ -1,9 +1,9 @@
 #ifndef LIO_LIVOX_MAP_MANAGER_H
 #define LIO_LIVOX_MAP_MANAGER_H
-#include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
-#include <pcl/filters/voxel_grid.h>
+#include "Estimator/StaticKdTree.h"
+#include "Estimator/VoxelFilter.h"
 #include <future>
 class MAP_MANAGER
 {
@@ -81,15 +81,15 @@ public:
 
   size_t FindUsedNonFeatureMap(const PointType *p, int a, int b, int c);
 
-  pcl::KdTreeFLANN<PointType> getCornerKdMap(int i)
+  StaticKdTree<PointType> getCornerKdMap(int i)
   {
     return CornerKdMap_last[i];
   }
-  pcl::KdTreeFLANN<PointType> getSurfKdMap(int i)
+  StaticKdTree<PointType> getSurfKdMap(int i)
   {
     return SurfKdMap_last[i];
   }
-  pcl::KdTreeFLANN<PointType> getNonFeatureKdMap(int i)
+  StaticKdTree<PointType> getNonFeatureKdMap(int i)
   {
     return NonFeatureKdMap_last[i];
   }
@@ -145,25 +145,25 @@ private:
   pcl::PointCloud<PointType>::Ptr laserCloudSurfArrayStack[laserCloudNum];
   pcl::PointCloud<PointType>::Ptr laserCloudNonFeatureArrayStack[laserCloudNum];
 
-  pcl::VoxelGrid<PointType> downSizeFilterCorner;
-  pcl::VoxelGrid<PointType> downSizeFilterSurf;
-  pcl::VoxelGrid<PointType> downSizeFilterNonFeature;
+  VoxelFilter downSizeFilterCorner;
+  VoxelFilter downSizeFilterSurf;
+  VoxelFilter downSizeFilterNonFeature;
 
   pcl::PointCloud<PointType>::Ptr laserCloudCornerFromMap;
   pcl::PointCloud<PointType>::Ptr laserCloudSurfFromMap;
   pcl::PointCloud<PointType>::Ptr laserCloudNonFeatureFromMap;
 
-  pcl::KdTreeFLANN<PointType>::Ptr laserCloudCornerKdMap[laserCloudNum];
-  pcl::KdTreeFLANN<PointType>::Ptr laserCloudSurfKdMap[laserCloudNum];
-  pcl::KdTreeFLANN<PointType>::Ptr laserCloudNonFeatureKdMap[laserCloudNum];
+  StaticKdTree<PointType>::Ptr laserCloudCornerKdMap[laserCloudNum];
+  StaticKdTree<PointType>::Ptr laserCloudSurfKdMap[laserCloudNum];
+  StaticKdTree<PointType>::Ptr laserCloudNonFeatureKdMap[laserCloudNum];
 
-  pcl::KdTreeFLANN<PointType> CornerKdMap_copy[laserCloudNum];
-  pcl::KdTreeFLANN<PointType> SurfKdMap_copy[laserCloudNum];
-  pcl::KdTreeFLANN<PointType> NonFeatureKdMap_copy[laserCloudNum];
+  StaticKdTree<PointType> CornerKdMap_copy[laserCloudNum];
+  StaticKdTree<PointType> SurfKdMap_copy[laserCloudNum];
+  StaticKdTree<PointType> NonFeatureKdMap_copy[laserCloudNum];
 
-  pcl::KdTreeFLANN<PointType> CornerKdMap_last[laserCloudNum];
-  pcl::KdTreeFLANN<PointType> SurfKdMap_last[laserCloudNum];
-  pcl::KdTreeFLANN<PointType> NonFeatureKdMap_last[laserCloudNum];
+  StaticKdTree<PointType> CornerKdMap_last[laserCloudNum];
+  StaticKdTree<PointType> SurfKdMap_last[laserCloudNum];
+  StaticKdTree<PointType> NonFeatureKdMap_last[laserCloudNum];
 
   static const int localMapWindowSize = 60;
   pcl::PointCloud<PointType>::Ptr localCornerMap[localMapWindowSize];
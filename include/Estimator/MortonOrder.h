@@ -0,0 +1,85 @@
+#ifndef LIO_LIVOX_MORTON_ORDER_H
+#define LIO_LIVOX_MORTON_ORDER_H
+#include <pcl/point_cloud.h>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/** \brief sorts clouds along a Morton (Z order) curve of cellSize cells.
+ *  The association loops query the map once per feature point in cloud order. With the points
+ *  sorted along the curve, consecutive queries land in the same map cube and walk mostly the same
+ *  kd-tree nodes and leaves, which are still in cache from the previous query. The order is
+ *  preserved by rigid transforms up to the cell size, so sorting the frame once in lidar
+ *  coordinates serves every pose of the optimization.
+ *  The keys and the point buffer are kept between calls. Not thread safe.
+ */
+template <typename PointT>
+class MortonOrder
+{
+public:
+	explicit MortonOrder(float cellSize = 0.5f) : inverseCell(1.0f / cellSize) {}
+
+	/** \brief interleave the low 21 bits of x, y and z */
+	static uint64_t Encode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return Spread(x) | (Spread(y) << 1) | (Spread(z) << 2);
+	}
+
+	/** \brief reorder the points of cloud in place, points in one cell keep their order */
+	void Sort(pcl::PointCloud<PointT> &cloud)
+	{
+		const size_t n = cloud.points.size();
+		if (n < 2)
+			return;
+		float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+		for (const auto &p : cloud.points)
+		{
+			lo[0] = std::min(lo[0], p.x);
+			lo[1] = std::min(lo[1], p.y);
+			lo[2] = std::min(lo[2], p.z);
+		}
+		keys.resize(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const PointT &p = cloud.points[i];
+			keys[i].first = Encode(Cell(p.x - lo[0]), Cell(p.y - lo[1]), Cell(p.z - lo[2]));
+			keys[i].second = uint32_t(i);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		sorted.resize(n);
+		for (size_t i = 0; i < n; ++i)
+			sorted[i] = cloud.points[keys[i].second];
+		// the cloud takes the sorted buffer, its old buffer is reused by the next call
+		cloud.points.swap(sorted);
+	}
+
+private:
+	static const uint32_t kMaxCell = (1u << 21) - 1;
+
+	uint32_t Cell(float offset) const
+	{
+		// nan and far outliers end up in the last cell
+		const float c = offset * inverseCell;
+		return c >= 0.0f && c < float(kMaxCell) ? uint32_t(c) : kMaxCell;
+	}
+
+	static uint64_t Spread(uint32_t v)
+	{
+		uint64_t x = v & kMaxCell;
+		x = (x | x << 32) & 0x1f00000000ffffULL;
+		x = (x | x << 16) & 0x1f0000ff0000ffULL;
+		x = (x | x << 8) & 0x100f00f00f00f00fULL;
+		x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+		x = (x | x << 2) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	float inverseCell;
+	std::vector<std::pair<uint64_t, uint32_t>> keys;
+	decltype(pcl::PointCloud<PointT>::points) sorted;
+};
+
+#endif // LIO_LIVOX_MORTON_ORDER_H
@@ -0,0 +1,443 @@
+#ifndef LIO_LIVOX_STATIC_KDTREE_H
+#define LIO_LIVOX_STATIC_KDTREE_H
+#include <pcl/point_cloud.h>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/** \brief fixed size result buffer of a k nearest neighbour query, sorted by distance */
+template <int K>
+struct KnnResult
+{
+	int indices[K]; // indices into the input cloud of the tree
+	float sqDists[K];
+	float xyz[K][3]; // coordinates as stored in the tree, dequantized
+	int size = 0;
+};
+
+/** \brief drop in replacement of pcl::KdTreeFLANN for the 3D map queries.
+ *  The tree is built once over a cloud and never modified. Nodes are implicit: node i has the
+ *  children 2i+1 and 2i+2 and covers the median halves of the range of its parent, so only the
+ *  split axis and value of every node are stored. The coordinates are copied once in tree order
+ *  as three float arrays, a leaf is a contiguous run of at most about kLeafSize points and is
+ *  scanned by a branch free loop the compiler vectorizes. Clouds of kParallelMin points or more
+ *  are built on up to 4 threads.
+ *  Coordinates are stored relative to the centre of the cloud, so the search keeps its precision
+ *  far from the world origin. With a quantization step set, a leaf stores its points as int16
+ *  offsets from the leaf centre in units of at least that step, 6 instead of 12 bytes a point,
+ *  and the results carry the dequantized coordinates so the input cloud is not needed to fit them.
+ *  Distances are then exact to the dequantized points, the pruning to half a step.
+ *  Queries are const and may run from any number of threads. Copies share the built index, like
+ *  the copies of a KdTreeFLANN share its FLANN index.
+ */
+template <typename PointT>
+class StaticKdTree
+{
+public:
+	typedef boost::shared_ptr<StaticKdTree<PointT>> Ptr;
+	typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+	static const int kLeafSize = 16;
+	static const size_t kParallelMin = 1 << 15; // smaller subtrees are built on the calling thread
+	static const int kMaxDepth = 48;
+
+	/** \brief store the coordinates quantized to step, takes effect on the next setInputCloud
+	 * \param[in] step: quantization step in meters, 0 stores floats
+	 */
+	void setQuantizationStep(float step)
+	{
+		quantizationStep = std::max(step, 0.0f);
+	}
+
+	/** \brief build the tree over cloud, non finite points are skipped */
+	void setInputCloud(const PointCloudConstPtr &cloud)
+	{
+		input = cloud;
+		// a rebuilt tree reuses the buffers unless a copy still shares them
+		if (!index || index.use_count() > 1)
+			index = std::make_shared<Index>();
+		if (cloud)
+			Build(*cloud, *index);
+		else
+			index->Clear();
+	}
+
+	PointCloudConstPtr getInputCloud() const
+	{
+		return input;
+	}
+
+	/** \brief number of points in the tree */
+	int size() const
+	{
+		return index ? int(index->indices.size()) : 0;
+	}
+
+	/** \brief heap bytes held by the built index */
+	size_t memoryBytes() const
+	{
+		return index ? index->MemoryBytes() : 0;
+	}
+
+	/** \brief the K nearest neighbours of point, K is known at compile time
+	 * \param[in] point: query point
+	 * \param[out] result: neighbours sorted by squared distance
+	 * \param[in] maxSqDist: only neighbours closer than this are returned, it also prunes the search
+	 * \return number of neighbours found, less than K for small trees or a tight maxSqDist
+	 */
+	template <int K>
+	int nearestKSearch(const PointT &point, KnnResult<K> &result,
+					   float maxSqDist = std::numeric_limits<float>::max()) const
+	{
+		result.size = Search(point.x, point.y, point.z, K, result.indices, result.sqDists, result.xyz, maxSqDist);
+		return result.size;
+	}
+
+	/** \brief same interface as pcl::KdTreeFLANN::nearestKSearch, the vectors only allocate while they grow */
+	int nearestKSearch(const PointT &point, int k, std::vector<int> &k_indices, std::vector<float> &k_sqr_distances) const
+	{
+		k_indices.resize(k);
+		k_sqr_distances.resize(k);
+		int found = Search(point.x, point.y, point.z, k, k_indices.data(), k_sqr_distances.data(), nullptr,
+						   std::numeric_limits<float>::max());
+		k_indices.resize(found);
+		k_sqr_distances.resize(found);
+		return found;
+	}
+
+private:
+	struct Index
+	{
+		double origin[3] = {0.0, 0.0, 0.0}; // all stored coordinates are relative to this
+		std::vector<float> x, y, z;			 // coordinates in tree order, float storage
+		std::vector<int16_t> qx, qy, qz;	 // coordinates in tree order, quantized storage
+		std::vector<float> leafFrame;		 // centre and quantization step of every leaf, quantized storage
+		std::vector<int> indices;			 // tree order to cloud index
+		std::vector<float> split;			 // split value of every inner node
+		std::vector<uint8_t> axis;			 // split axis of every inner node
+		int depth = 0;						 // levels of inner nodes, the leaves are below
+		bool quantized = false;
+
+		void Clear()
+		{
+			x.clear();
+			y.clear();
+			z.clear();
+			qx.clear();
+			qy.clear();
+			qz.clear();
+			leafFrame.clear();
+			indices.clear();
+			split.clear();
+			axis.clear();
+			depth = 0;
+			quantized = false;
+		}
+
+		size_t MemoryBytes() const
+		{
+			return (x.capacity() + y.capacity() + z.capacity() + leafFrame.capacity() +
+					split.capacity()) * sizeof(float) +
+				   (qx.capacity() + qy.capacity() + qz.capacity()) * sizeof(int16_t) +
+				   indices.capacity() * sizeof(int) + axis.capacity();
+		}
+	};
+
+	struct StackEntry
+	{
+		int node;
+		int begin;
+		int end;
+		int level;
+		float sqDist; // squared distance of the query to the region of the node, a lower bound
+	};
+
+	static float Coord(const PointT &p, int axis)
+	{
+		return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+	}
+
+	void Build(const pcl::PointCloud<PointT> &cloud, Index &index) const
+	{
+		index.Clear();
+		index.indices.reserve(cloud.points.size());
+		double lo[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+		double hi[3] = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+		for (size_t i = 0; i < cloud.points.size(); ++i)
+		{
+			const PointT &p = cloud.points[i];
+			if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+			{
+				index.indices.push_back(int(i));
+				for (int a = 0; a < 3; ++a)
+				{
+					lo[a] = std::min(lo[a], double(Coord(p, a)));
+					hi[a] = std::max(hi[a], double(Coord(p, a)));
+				}
+			}
+		}
+		const int n = int(index.indices.size());
+		for (int a = 0; a < 3; ++a)
+			index.origin[a] = n > 0 ? std::floor(0.5 * (lo[a] + hi[a])) : 0.0;
+		int depth = 0;
+		while ((n >> depth) > kLeafSize && depth < kMaxDepth - 1)
+			++depth;
+		index.depth = depth;
+		index.split.assign((size_t(1) << depth) - 1, 0.0f);
+		index.axis.assign((size_t(1) << depth) - 1, 0);
+
+		BuildNode(cloud, index, 0, 0, n, 0, n >= int(kParallelMin) ? 2 : 0);
+
+		if (quantizationStep > 0.0f && n > 0)
+		{
+			index.quantized = true;
+			index.qx.resize(n);
+			index.qy.resize(n);
+			index.qz.resize(n);
+			index.leafFrame.resize(4 * (size_t(1) << index.depth));
+			QuantizeNode(cloud, index, 0, 0, n, 0);
+			return;
+		}
+		index.x.resize(n);
+		index.y.resize(n);
+		index.z.resize(n);
+		for (int i = 0; i < n; ++i)
+		{
+			const PointT &p = cloud.points[index.indices[i]];
+			index.x[i] = Local(index, p, 0);
+			index.y[i] = Local(index, p, 1);
+			index.z[i] = Local(index, p, 2);
+		}
+	}
+
+	/** \brief coordinate of p along axis relative to the origin of the tree */
+	static float Local(const Index &index, const PointT &p, int axis)
+	{
+		return float(double(Coord(p, axis)) - index.origin[axis]);
+	}
+
+	/** \brief store the points of every leaf below node as int16 offsets from the leaf centre */
+	void QuantizeNode(const pcl::PointCloud<PointT> &cloud, Index &index, int node, int begin, int end, int level) const
+	{
+		if (level < index.depth)
+		{
+			const int mid = begin + (end - begin) / 2;
+			QuantizeNode(cloud, index, 2 * node + 1, begin, mid, level + 1);
+			QuantizeNode(cloud, index, 2 * node + 2, mid, end, level + 1);
+			return;
+		}
+		const int leaf = node - ((1 << index.depth) - 1);
+		float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+		float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+		for (int i = begin; i < end; ++i)
+			for (int a = 0; a < 3; ++a)
+			{
+				const float v = Local(index, cloud.points[index.indices[i]], a);
+				lo[a] = std::min(lo[a], v);
+				hi[a] = std::max(hi[a], v);
+			}
+		// sparse leaves with a wide extent get a coarser step so every offset fits int16
+		float step = quantizationStep;
+		float *centre = &index.leafFrame[4 * leaf];
+		for (int a = 0; a < 3; ++a)
+		{
+			centre[a] = begin < end ? 0.5f * (lo[a] + hi[a]) : 0.0f;
+			if (begin < end)
+				step = std::max(step, (hi[a] - lo[a]) / (2.0f * float(kQuantMax)));
+		}
+		centre[3] = step;
+		std::vector<int16_t> *q[3] = {&index.qx, &index.qy, &index.qz};
+		const float limit = float(kQuantMax);
+		for (int i = begin; i < end; ++i)
+			for (int a = 0; a < 3; ++a)
+			{
+				const float v = std::round((Local(index, cloud.points[index.indices[i]], a) - centre[a]) / step);
+				(*q[a])[i] = int16_t(std::max(-limit, std::min(limit, v)));
+			}
+	}
+
+	/** \brief split [begin, end) at its median along the widest axis, threadLevels levels below spawn a thread per left child */
+	static void BuildNode(const pcl::PointCloud<PointT> &cloud, Index &index,
+						  int node, int begin, int end, int level, int threadLevels)
+	{
+		if (level == index.depth)
+			return;
+		float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+		float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+		for (int i = begin; i < end; ++i)
+		{
+			const PointT &p = cloud.points[index.indices[i]];
+			lo[0] = std::min(lo[0], p.x);
+			lo[1] = std::min(lo[1], p.y);
+			lo[2] = std::min(lo[2], p.z);
+			hi[0] = std::max(hi[0], p.x);
+			hi[1] = std::max(hi[1], p.y);
+			hi[2] = std::max(hi[2], p.z);
+		}
+		int axis = 0;
+		for (int a = 1; a < 3; ++a)
+			if (hi[a] - lo[a] > hi[axis] - lo[axis])
+				axis = a;
+
+		const int mid = begin + (end - begin) / 2;
+		std::nth_element(index.indices.begin() + begin, index.indices.begin() + mid, index.indices.begin() + end,
+						 [&cloud, axis](int a, int b)
+						 { return Coord(cloud.points[a], axis) < Coord(cloud.points[b], axis); });
+		index.axis[node] = uint8_t(axis);
+		index.split[node] = Local(index, cloud.points[index.indices[mid]], axis);
+
+		if (threadLevels > 0)
+		{
+			std::thread left(BuildNode, std::cref(cloud), std::ref(index), 2 * node + 1, begin, mid, level + 1, threadLevels - 1);
+			BuildNode(cloud, index, 2 * node + 2, mid, end, level + 1, threadLevels - 1);
+			left.join();
+		}
+		else
+		{
+			BuildNode(cloud, index, 2 * node + 1, begin, mid, level + 1, 0);
+			BuildNode(cloud, index, 2 * node + 2, mid, end, level + 1, 0);
+		}
+	}
+
+	/** \brief depth first search with an explicit stack, the near child first */
+	int Search(float px, float py, float pz, int k, int *indices, float *sqDists, float (*xyz)[3], float maxSqDist) const
+	{
+		if (!index || index->indices.empty() || k <= 0)
+			return 0;
+		const Index &idx = *index;
+		const float qx = float(double(px) - idx.origin[0]);
+		const float qy = float(double(py) - idx.origin[1]);
+		const float qz = float(double(pz) - idx.origin[2]);
+		const float q[3] = {qx, qy, qz};
+		int found = 0;
+		float worst = maxSqDist; // distance a point has to beat to enter the result
+
+		StackEntry stack[kMaxDepth + 1];
+		int top = 0;
+		stack[top++] = StackEntry{0, 0, int(idx.indices.size()), 0, 0.0f};
+		while (top > 0)
+		{
+			const StackEntry e = stack[--top];
+			if (e.sqDist > worst)
+				continue;
+			if (e.level == idx.depth)
+			{
+				const int n = e.end - e.begin;
+				const int leaf = e.node - ((1 << idx.depth) - 1);
+				float d[2 * kLeafSize + 2];
+				if (idx.quantized)
+					QuantizedDistances(idx, leaf, e.begin, n, q, d);
+				else
+				{
+					const float *lx = idx.x.data() + e.begin;
+					const float *ly = idx.y.data() + e.begin;
+					const float *lz = idx.z.data() + e.begin;
+					for (int j = 0; j < n; ++j)
+					{
+						const float dx = lx[j] - qx;
+						const float dy = ly[j] - qy;
+						const float dz = lz[j] - qz;
+						d[j] = dx * dx + dy * dy + dz * dz;
+					}
+				}
+				for (int j = 0; j < n; ++j)
+				{
+					if (d[j] >= worst)
+						continue;
+					// insertion into the sorted result, the farthest one drops out
+					int pos = found < k ? found++ : k - 1;
+					while (pos > 0 && sqDists[pos - 1] > d[j])
+					{
+						sqDists[pos] = sqDists[pos - 1];
+						indices[pos] = indices[pos - 1];
+						if (xyz)
+							std::copy(xyz[pos - 1], xyz[pos - 1] + 3, xyz[pos]);
+						--pos;
+					}
+					sqDists[pos] = d[j];
+					indices[pos] = idx.indices[e.begin + j];
+					if (xyz)
+						LocalPoint(idx, leaf, e.begin + j, xyz[pos]);
+					if (found == k)
+						worst = sqDists[k - 1];
+				}
+				continue;
+			}
+			const int mid = e.begin + (e.end - e.begin) / 2;
+			const float diff = q[idx.axis[e.node]] - idx.split[e.node];
+			const StackEntry left{2 * e.node + 1, e.begin, mid, e.level + 1, diff < 0 ? e.sqDist : std::max(e.sqDist, diff * diff)};
+			const StackEntry right{2 * e.node + 2, mid, e.end, e.level + 1, diff < 0 ? std::max(e.sqDist, diff * diff) : e.sqDist};
+			if (diff < 0)
+			{
+				stack[top++] = right;
+				stack[top++] = left;
+			}
+			else
+			{
+				stack[top++] = left;
+				stack[top++] = right;
+			}
+		}
+		if (xyz)
+			for (int j = 0; j < found; ++j)
+				for (int a = 0; a < 3; ++a)
+					xyz[j][a] = float(idx.origin[a] + double(xyz[j][a]));
+		return found;
+	}
+
+	/** \brief squared distances of the n points of a quantized leaf to the local query q */
+	static void QuantizedDistances(const Index &idx, int leaf, int begin, int n, const float *q, float *d)
+	{
+		// the query moves into the integer frame of the leaf, the loop only converts and multiplies
+		const float *centre = &idx.leafFrame[4 * leaf];
+		const float step = centre[3];
+		const float inv = 1.0f / step;
+		const float cx = (q[0] - centre[0]) * inv;
+		const float cy = (q[1] - centre[1]) * inv;
+		const float cz = (q[2] - centre[2]) * inv;
+		const int16_t *lx = idx.qx.data() + begin;
+		const int16_t *ly = idx.qy.data() + begin;
+		const int16_t *lz = idx.qz.data() + begin;
+		const float step2 = step * step;
+		for (int j = 0; j < n; ++j)
+		{
+			const float dx = float(lx[j]) - cx;
+			const float dy = float(ly[j]) - cy;
+			const float dz = float(lz[j]) - cz;
+			d[j] = step2 * (dx * dx + dy * dy + dz * dz);
+		}
+	}
+
+	/** \brief coordinates of the point at tree position i of leaf relative to the origin of the tree */
+	static void LocalPoint(const Index &idx, int leaf, int i, float *out)
+	{
+		if (idx.quantized)
+		{
+			const float *centre = &idx.leafFrame[4 * leaf];
+			const float step = centre[3];
+			out[0] = centre[0] + step * idx.qx[i];
+			out[1] = centre[1] + step * idx.qy[i];
+			out[2] = centre[2] + step * idx.qz[i];
+		}
+		else
+		{
+			out[0] = idx.x[i];
+			out[1] = idx.y[i];
+			out[2] = idx.z[i];
+		}
+	}
+
+	static const int kQuantMax = 32767;
+
+	PointCloudConstPtr input;
+	std::shared_ptr<Index> index;
+	float quantizationStep = 0.0f;
+};
+
+#endif // LIO_LIVOX_STATIC_KDTREE_H
@@ -0,0 +1,125 @@
+#ifndef LIO_LIVOX_STATIONARY_DETECTOR_H
+#define LIO_LIVOX_STATIONARY_DETECTOR_H
+#include "Estimator/IMUIntegrator.h"
+#include "Estimator/LabelledPoint.h"
+#include "utils/VoxelHash.h"
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/** \brief zero velocity detector of the lidar frames.
+ *  A frame is still when the bias corrected gyro of its IMU messages stays below gyro_thres, the
+ *  accelerometer barely varies, and the scan occupies nearly the same coarse voxels as the
+ *  previous one, so a parked vehicle with pedestrians walking by stays still. The vehicle is
+ *  stationary after min_frames still frames in a row and until the first frame that is not.
+ *  Not thread safe.
+ */
+class StationaryDetector
+{
+public:
+	struct Options
+	{
+		bool enable = false;
+		double gyro_thres = 0.02;	  // mean bias corrected angular rate of a still frame (rad/s)
+		double acc_std_thres = 0.05;  // standard deviation of the specific force of a still frame (m/s^2)
+		double scan_change = 0.1;	  // fraction of scan voxels not occupied by the previous scan
+		double voxel_size = 1.0;	  // voxels of the scan change (m)
+		int min_frames = 3;			  // still frames in a row before the vehicle counts as stationary
+		double zupt_gain = 0.1;		  // share of the still frame bias estimate blended into the biases
+	};
+
+	StationaryDetector() : StationaryDetector(Options()) {}
+
+	explicit StationaryDetector(const Options &options) : options(options) {}
+
+	/** \brief classify one frame, must see every frame in order
+	 * \param[in] imu: integrator holding the IMU messages of the frame
+	 * \param[in] bg: gyro bias of the frame
+	 * \param[in] scan: raw scan of the frame in lidar frame
+	 * \return true if the vehicle is stationary
+	 */
+	bool Update(const IMUIntegrator &imu, const Eigen::Vector3d &bg, const LabelledCloud &scan)
+	{
+		// the scan voxels are kept up to date even while the IMU says the vehicle moves
+		const double change = ScanChange(scan);
+		const bool still = options.enable && ImuStill(imu, bg) && change < options.scan_change;
+		stillFrames = still ? stillFrames + 1 : 0;
+		return stillFrames >= options.min_frames;
+	}
+
+	/** \brief blend the biases towards the rates and the specific force measured at rest
+	 * \param[in] Qwb: attitude of the IMU in world frame
+	 * \param[in] gravity: gravity in world frame
+	 * \param[in,out] bg: gyro bias
+	 * \param[in,out] ba: accelerometer bias
+	 */
+	void ZeroVelocityUpdate(const Eigen::Quaterniond &Qwb, const Eigen::Vector3d &gravity,
+							Eigen::Vector3d &bg, Eigen::Vector3d &ba) const
+	{
+		// at rest the gyro measures its bias and the accelerometer its bias minus gravity
+		bg += options.zupt_gain * (meanGyr - bg);
+		ba += options.zupt_gain * (meanAcc + Qwb.conjugate() * gravity - ba);
+	}
+
+private:
+	bool ImuStill(const IMUIntegrator &imu, const Eigen::Vector3d &bg)
+	{
+		const std::vector<sensor_msgs::ImuConstPtr> &msgs = imu.GetIMUMsg();
+		if (msgs.size() < 5)
+			return false;
+		Eigen::Vector3d sumGyr = Eigen::Vector3d::Zero();
+		Eigen::Vector3d sumAcc = Eigen::Vector3d::Zero();
+		Eigen::Vector3d sumAcc2 = Eigen::Vector3d::Zero();
+		for (const auto &m : msgs)
+		{
+			const Eigen::Vector3d gyr(m->angular_velocity.x, m->angular_velocity.y, m->angular_velocity.z);
+			const Eigen::Vector3d acc = IMUIntegrator::gnorm * Eigen::Vector3d(m->linear_acceleration.x,
+																			   m->linear_acceleration.y,
+																			   m->linear_acceleration.z);
+			sumGyr += gyr;
+			sumAcc += acc;
+			sumAcc2 += acc.cwiseProduct(acc);
+		}
+		const double n = double(msgs.size());
+		meanGyr = sumGyr / n;
+		meanAcc = sumAcc / n;
+		const double accVar = (sumAcc2 / n - meanAcc.cwiseProduct(meanAcc)).sum();
+		return (meanGyr - bg).norm() < options.gyro_thres &&
+			   accVar < options.acc_std_thres * options.acc_std_thres;
+	}
+
+	/** \brief fraction of the coarse voxels of scan that the previous scan did not occupy */
+	double ScanChange(const LabelledCloud &scan)
+	{
+		const float inv = float(1.0 / options.voxel_size);
+		keys.clear();
+		// every 4th point is plenty to tell the occupied voxels apart
+		for (size_t i = 0; i < scan.points.size(); i += 4)
+		{
+			const LabelledPoint &p = scan.points[i];
+			if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+				continue;
+			keys.push_back(voxel_hash::KeyOf(p.x, p.y, p.z, inv));
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		size_t unseen = 0;
+		for (uint64_t k : keys)
+			unseen += !std::binary_search(previousKeys.begin(), previousKeys.end(), k);
+		const double change = previousKeys.empty() || keys.empty() ? 1.0 : double(unseen) / keys.size();
+		keys.swap(previousKeys);
+		return change;
+	}
+
+	Options options;
+	int stillFrames = 0;
+	Eigen::Vector3d meanGyr = Eigen::Vector3d::Zero();
+	Eigen::Vector3d meanAcc = Eigen::Vector3d::Zero();
+	std::vector<uint64_t> keys;			// sorted voxels of the current scan, reused
+	std::vector<uint64_t> previousKeys; // sorted voxels of the previous scan
+};
+
+#endif // LIO_LIVOX_STATIONARY_DETECTOR_H
@@ -0,0 +1,479 @@
+#ifndef LIO_LIVOX_VOXEL_FILTER_H
+#define LIO_LIVOX_VOXEL_FILTER_H
+#include "Estimator/LabelledPoint.h"
+#include "utils/VoxelHash.h"
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/** \brief drop in replacement of pcl::VoxelGrid<pcl::PointXYZINormal> for the per frame paths.
+ *  Points are binned in an open addressing hash grid and averaged in the same pass. The keys,
+ *  the tables and the voxel sums are kept between calls, so a filter only allocates while its
+ *  clouds grow. Clouds of kParallelMin points or more are split over threads by voxel hash, every
+ *  voxel is still summed in input order by a single thread. The output is in first seen voxel
+ *  order per thread.
+ *  With setCompatible(true), or built with -DLIO_VOXEL_FILTER_COMPAT, the filter reproduces
+ *  pcl::VoxelGrid instead: same voxel bounds, same sorted order, same float sums, so the output
+ *  is bit exact for regression runs.
+ *  Not thread safe, like the pcl filter every thread needs its own instance.
+ */
+class VoxelFilter
+{
+	typedef pcl::PointXYZINormal PointType;
+
+public:
+	static const int kFields = 8;				// x y z intensity normal_x normal_y normal_z curvature
+	static const size_t kParallelMin = 1 << 16; // smaller clouds are filtered on the calling thread
+	static const int kMaxThreads = 4;
+
+	VoxelFilter()
+	{
+#ifdef LIO_VOXEL_FILTER_COMPAT
+		compatible = true;
+#else
+		compatible = false;
+#endif
+		setLeafSize(1.0f, 1.0f, 1.0f);
+		for (int l = 0; l < 3; ++l)
+			setLabelLeafSize(l + 1, 1.0f);
+	}
+
+	/** \brief voxel size of filter() */
+	void setLeafSize(float lx, float ly, float lz)
+	{
+		leafSize = Eigen::Vector3f(lx, ly, lz);
+		inverseLeaf[0] = 1.0f / lx;
+		inverseLeaf[1] = 1.0f / ly;
+		inverseLeaf[2] = 1.0f / lz;
+	}
+
+	Eigen::Vector3f getLeafSize() const
+	{
+		return leafSize;
+	}
+
+	/** \brief voxel size of one label in FilterByLabel()
+	 * \param[in] label: LabelledPoint::Corner, Surf or NonFeature
+	 * \param[in] leaf: voxel size
+	 */
+	void setLabelLeafSize(int label, float leaf)
+	{
+		labelLeaf[label - 1] = leaf;
+		labelInverseLeaf[label - 1][0] = labelInverseLeaf[label - 1][1] = labelInverseLeaf[label - 1][2] = 1.0f / leaf;
+	}
+
+	void setInputCloud(const pcl::PointCloud<PointType>::ConstPtr &cloud)
+	{
+		input = cloud;
+	}
+
+	/** \brief reproduce pcl::VoxelGrid bit for bit instead of the hashed grid */
+	void setCompatible(bool on)
+	{
+		compatible = on;
+	}
+
+	/** \brief downsample the input cloud, output may be the input cloud itself
+	 * \param[out] output: one point per occupied voxel, the mean of all fields of its points
+	 */
+	void filter(pcl::PointCloud<PointType> &output)
+	{
+		const pcl::PointCloud<PointType> &cloud = *input;
+		if (compatible)
+		{
+			FilterCompatible(cloud, output);
+			return;
+		}
+
+		const bool dense = cloud.is_dense;
+		const float *inv = inverseLeaf;
+		Bin(cloud.points.data(), cloud.points.size(), [dense, inv](const PointType &p) -> uint64_t
+			{
+				if (!dense && !(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)))
+					return kInvalid;
+				return Key(p.x, p.y, p.z, inv, 0); });
+
+		output.header = cloud.header;
+		output.points.resize(CountVoxels());
+		Write(-1, output.points.data());
+		SetUnorganized(output);
+	}
+
+	/** \brief split a frame by label and downsample every label with its own leaf size in one pass.
+	 *  Replaces SplitByLabel() followed by one pcl::VoxelGrid per label.
+	 * \param[in] cloud: labelled lidar points
+	 * \param[out] corner: downsampled Corner points
+	 * \param[out] surf: downsampled Surf points
+	 * \param[out] nonFeature: downsampled NonFeature points, may be null
+	 */
+	void FilterByLabel(const LabelledCloud &cloud,
+					   pcl::PointCloud<PointType> &corner,
+					   pcl::PointCloud<PointType> &surf,
+					   pcl::PointCloud<PointType> *nonFeature)
+	{
+		pcl::PointCloud<PointType> *outputs[3] = {&corner, &surf, nonFeature};
+		if (compatible)
+		{
+			pcl::PointCloud<PointType> split[3];
+			SplitByLabel(cloud, split[0], split[1], nonFeature ? &split[2] : nullptr);
+			const Eigen::Vector3f leaf = leafSize;
+			for (int l = 0; l < 3; ++l)
+			{
+				if (!outputs[l])
+					continue;
+				// the leaf as given, like pcl::VoxelGrid::setLeafSize, its inverse is then the same float
+				setLeafSize(labelLeaf[l], labelLeaf[l], labelLeaf[l]);
+				FilterCompatible(split[l], *outputs[l]);
+			}
+			setLeafSize(leaf[0], leaf[1], leaf[2]);
+			return;
+		}
+
+		const bool keepNonFeature = nonFeature != nullptr;
+		const float(*leaf)[3] = labelInverseLeaf;
+		Bin(cloud.points.data(), cloud.points.size(), [keepNonFeature, leaf](const LabelledPoint &p) -> uint64_t
+			{
+				if (p.label == LabelledPoint::None || (p.label == LabelledPoint::NonFeature && !keepNonFeature))
+					return kInvalid;
+				return Key(p.x, p.y, p.z, leaf[p.label - 1], p.label - 1); });
+
+		for (int l = 0; l < 3; ++l)
+		{
+			if (!outputs[l])
+				continue;
+			outputs[l]->header = cloud.header;
+			outputs[l]->points.resize(CountVoxels(l));
+			Write(l, outputs[l]->points.data());
+			SetUnorganized(*outputs[l]);
+		}
+	}
+
+private:
+	static const uint64_t kInvalid = ~uint64_t(0);
+
+	struct Voxel
+	{
+		uint64_t key;
+		int count;
+		float sum[kFields];
+	};
+
+	/** \brief open addressing table of one hash partition, reused between calls */
+	struct Grid
+	{
+		std::vector<int> table; // voxel of every slot, -1 when empty
+		std::vector<Voxel> voxels;
+		int shift = 64;
+
+		void Reset(size_t expected)
+		{
+			size_t capacity = 64;
+			while (capacity < 2 * expected)
+				capacity <<= 1;
+			Resize(capacity);
+			voxels.clear();
+		}
+
+		Voxel &Find(uint64_t key, uint64_t hash)
+		{
+			if (2 * (voxels.size() + 1) > table.size())
+				Grow();
+			const size_t mask = table.size() - 1;
+			for (size_t s = hash >> shift;; s = (s + 1) & mask)
+			{
+				const int v = table[s];
+				if (v < 0)
+				{
+					table[s] = static_cast<int>(voxels.size());
+					voxels.push_back(Voxel());
+					Voxel &voxel = voxels.back();
+					voxel.key = key;
+					voxel.count = 0;
+					std::fill(voxel.sum, voxel.sum + kFields, 0.0f);
+					return voxel;
+				}
+				if (voxels[v].key == key)
+					return voxels[v];
+			}
+		}
+
+		void Resize(size_t capacity)
+		{
+			table.assign(capacity, -1);
+			shift = 64;
+			while ((size_t(1) << (64 - shift)) < capacity)
+				--shift;
+		}
+
+		void Grow()
+		{
+			Resize(table.size() * 2);
+			const size_t mask = table.size() - 1;
+			for (size_t v = 0; v < voxels.size(); ++v)
+			{
+				size_t s = Hash(voxels[v].key) >> shift;
+				while (table[s] >= 0)
+					s = (s + 1) & mask;
+				table[s] = static_cast<int>(v);
+			}
+		}
+	};
+
+	/** \brief entry of the sorted index of FilterCompatible(), ordered like pcl's cloud_point_index_idx */
+	struct IndexIdx
+	{
+		unsigned int idx;
+		unsigned int cloud_point_index;
+
+		bool operator<(const IndexIdx &p) const
+		{
+			return idx < p.idx;
+		}
+	};
+
+	static uint64_t Key(float x, float y, float z, const float *inv, uint64_t label)
+	{
+		return voxel_hash::Key(static_cast<int64_t>(std::floor(x * inv[0])), static_cast<int64_t>(std::floor(y * inv[1])),
+							   static_cast<int64_t>(std::floor(z * inv[2])), label);
+	}
+
+	static uint64_t Hash(uint64_t key)
+	{
+		return key * 0x9E3779B97F4A7C15ull;
+	}
+
+	static void Fields(const PointType &p, float *f)
+	{
+		f[0] = p.x;
+		f[1] = p.y;
+		f[2] = p.z;
+		f[3] = p.intensity;
+		f[4] = p.normal_x;
+		f[5] = p.normal_y;
+		f[6] = p.normal_z;
+		f[7] = p.curvature;
+	}
+
+	static void Fields(const LabelledPoint &p, float *f)
+	{
+		Fields(p.ToMapPoint(), f);
+	}
+
+	static void SetPoint(const float *f, PointType &p)
+	{
+		p.x = f[0];
+		p.y = f[1];
+		p.z = f[2];
+		p.intensity = f[3];
+		p.normal_x = f[4];
+		p.normal_y = f[5];
+		p.normal_z = f[6];
+		p.curvature = f[7];
+	}
+
+	static void SetUnorganized(pcl::PointCloud<PointType> &cloud)
+	{
+		cloud.width = cloud.points.size();
+		cloud.height = 1;
+		cloud.is_dense = true;
+	}
+
+	/** \brief 1, 2 or 4 partitions, a power of two so the partition is a mask of the hash */
+	static int Partitions()
+	{
+		static const int parts = []()
+		{
+			const int hw = std::thread::hardware_concurrency();
+			int p = 1;
+			while (p * 2 <= hw && p * 2 <= kMaxThreads)
+				p *= 2;
+			return p;
+		}();
+		return parts;
+	}
+
+	/** \brief run task(0..parts-1), task 0 on the calling thread */
+	template <typename Task>
+	static void Run(int parts, const Task &task)
+	{
+		std::thread threads[kMaxThreads];
+		for (int t = 1; t < parts; ++t)
+			threads[t] = std::thread([&task, t]()
+									 { task(t); });
+		task(0);
+		for (int t = 1; t < parts; ++t)
+			threads[t].join();
+	}
+
+	/** \brief voxel key of every point in chunks, then the sums of every hash partition */
+	template <typename PointT, typename KeyOf>
+	void Bin(const PointT *pts, size_t n, const KeyOf &keyOf)
+	{
+		parts = n >= kParallelMin ? Partitions() : 1;
+		if (grids.size() < static_cast<size_t>(parts))
+			grids.resize(parts);
+		keys.resize(n);
+
+		const int chunks = parts;
+		Run(chunks, [&](int c)
+			{
+				const size_t end = n * (c + 1) / chunks;
+				for (size_t i = n * c / chunks; i < end; ++i)
+					keys[i] = keyOf(pts[i]); });
+
+		Run(parts, [&](int part)
+			{
+				Grid &grid = grids[part];
+				grid.Reset(n / parts);
+				float f[kFields];
+				for (size_t i = 0; i < n; ++i)
+				{
+					const uint64_t key = keys[i];
+					if (key == kInvalid)
+						continue;
+					const uint64_t hash = Hash(key);
+					if (static_cast<int>((hash >> 24) & (parts - 1)) != part)
+						continue;
+					Voxel &voxel = grid.Find(key, hash);
+					Fields(pts[i], f);
+					for (int j = 0; j < kFields; ++j)
+						voxel.sum[j] += f[j];
+					voxel.count++;
+				} });
+	}
+
+	/** \brief number of voxels of a label, all voxels for label -1 */
+	size_t CountVoxels(int label = -1) const
+	{
+		size_t count = 0;
+		for (int part = 0; part < parts; ++part)
+		{
+			if (label < 0)
+			{
+				count += grids[part].voxels.size();
+				continue;
+			}
+			for (const auto &voxel : grids[part].voxels)
+				count += voxel_hash::Tag(voxel.key) == label;
+		}
+		return count;
+	}
+
+	/** \brief centroids of the voxels of a label, all voxels for label -1 */
+	void Write(int label, PointType *out) const
+	{
+		float f[kFields];
+		for (int part = 0; part < parts; ++part)
+		{
+			for (const auto &voxel : grids[part].voxels)
+			{
+				if (label >= 0 && voxel_hash::Tag(voxel.key) != label)
+					continue;
+				const float count = static_cast<float>(voxel.count);
+				for (int j = 0; j < kFields; ++j)
+					f[j] = voxel.sum[j] / count;
+				SetPoint(f, *out++);
+			}
+		}
+	}
+
+	/** \brief pcl::VoxelGrid::applyFilter with downsample_all_data: voxels indexed inside the
+	 *  bounding box, std::sort of the same index, float sums in the sorted order */
+	void FilterCompatible(const pcl::PointCloud<PointType> &cloud, pcl::PointCloud<PointType> &output)
+	{
+		const bool dense = cloud.is_dense;
+		const size_t n = cloud.points.size();
+		Eigen::Array4f minP = Eigen::Array4f::Constant(FLT_MAX);
+		Eigen::Array4f maxP = Eigen::Array4f::Constant(-FLT_MAX);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const PointType &p = cloud.points[i];
+			if (!dense && !(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)))
+				continue;
+			const Eigen::Array4f pt(p.x, p.y, p.z, 1.0f);
+			minP = minP.min(pt);
+			maxP = maxP.max(pt);
+		}
+
+		int minB[3], divB[3];
+		int64_t volume = 1;
+		for (int a = 0; a < 3; ++a)
+		{
+			minB[a] = static_cast<int>(std::floor(minP[a] * inverseLeaf[a]));
+			divB[a] = static_cast<int>(std::floor(maxP[a] * inverseLeaf[a])) - minB[a] + 1;
+			volume *= divB[a];
+		}
+		if (volume > static_cast<int64_t>(std::numeric_limits<int32_t>::max()))
+		{
+			// leaf too small for the integer index, pcl returns the input unchanged
+			if (&output != &cloud)
+				output = cloud;
+			return;
+		}
+		const unsigned int mulB[3] = {1u, static_cast<unsigned int>(divB[0]), static_cast<unsigned int>(divB[0] * divB[1])};
+
+		indexVector.clear();
+		for (size_t i = 0; i < n; ++i)
+		{
+			const PointType &p = cloud.points[i];
+			if (!dense && !(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z)))
+				continue;
+			const int i0 = static_cast<int>(std::floor(p.x * inverseLeaf[0]) - static_cast<float>(minB[0]));
+			const int i1 = static_cast<int>(std::floor(p.y * inverseLeaf[1]) - static_cast<float>(minB[1]));
+			const int i2 = static_cast<int>(std::floor(p.z * inverseLeaf[2]) - static_cast<float>(minB[2]));
+			IndexIdx entry;
+			entry.idx = i0 * mulB[0] + i1 * mulB[1] + i2 * mulB[2];
+			entry.cloud_point_index = static_cast<unsigned int>(i);
+			indexVector.push_back(entry);
+		}
+		std::sort(indexVector.begin(), indexVector.end(), std::less<IndexIdx>());
+
+		// all voxel means are computed before the output is written, output may alias cloud
+		centroids.clear();
+		float f[kFields], sum[kFields];
+		for (size_t first = 0; first < indexVector.size();)
+		{
+			size_t last = first;
+			std::fill(sum, sum + kFields, 0.0f);
+			for (; last < indexVector.size() && indexVector[last].idx == indexVector[first].idx; ++last)
+			{
+				Fields(cloud.points[indexVector[last].cloud_point_index], f);
+				for (int j = 0; j < kFields; ++j)
+					sum[j] += f[j];
+			}
+			PointType p;
+			for (int j = 0; j < kFields; ++j)
+				f[j] = sum[j] / static_cast<float>(last - first);
+			SetPoint(f, p);
+			centroids.push_back(p);
+			first = last;
+		}
+
+		output.header = cloud.header;
+		output.points.assign(centroids.begin(), centroids.end());
+		SetUnorganized(output);
+	}
+
+	bool compatible;
+	Eigen::Vector3f leafSize;
+	float inverseLeaf[3];
+	float labelLeaf[3];			  // Corner, Surf, NonFeature
+	float labelInverseLeaf[3][3];
+
+	pcl::PointCloud<PointType>::ConstPtr input;
+
+	int parts = 1;
+	std::vector<uint64_t> keys;
+	std::vector<Grid> grids;
+	std::vector<IndexIdx> indexVector;
+	std::vector<PointType, Eigen::aligned_allocator<PointType>> centroids;
+};
+
+#endif // LIO_LIVOX_VOXEL_FILTER_H
@@ -150,7 +150,10 @@ public:
 		}
 	}
 
-	void marginalize()
+	/** \brief place dropped blocks first and kept blocks after them, set m and n
+	 * \return dimension of the whole system
+	 */
+	int assignParameterIdx()
 	{
 		int pos = 0;
 		for (auto &it : parameter_block_idx)
@@ -171,6 +174,12 @@ public:
 		}
 
 		n = pos - m;
+		return pos;
+	}
+
+	void marginalize()
+	{
+		int pos = assignParameterIdx();
 
 		Eigen::MatrixXd A(pos, pos);
 		Eigen::VectorXd b(pos);
@@ -229,6 +238,106 @@ public:
 		linearized_residuals = S_inv_sqrt.asDiagonal() * saes2.eigenvectors().transpose() * b;
 	}
 
+	/** \brief marginalize the oldest frame of a window of WINDOW frames with 6+9 parameters each,
+	 *  using fixed-size matrices and LDLT instead of dynamic matrices and eigen decompositions.
+	 *  Falls back to marginalize() if the factors do not match this layout.
+	 */
+	template <int WINDOW>
+	void marginalizeFixed()
+	{
+		constexpr int FRAME = 6 + 9;
+		constexpr int M = FRAME;
+		constexpr int N = (WINDOW - 1) * FRAME;
+		constexpr int DIM = WINDOW * FRAME;
+
+		int pos = assignParameterIdx();
+		if (m != M || pos != DIM)
+		{
+			marginalize();
+			return;
+		}
+
+		// the window has 2 * WINDOW blocks, look them up linearly instead of hashing every jacobian block
+		const int num_window_blocks = static_cast<int>(parameter_block_idx.size());
+		if (num_window_blocks > 2 * WINDOW)
+		{
+			marginalize();
+			return;
+		}
+		long block_addr[2 * WINDOW];
+		int block_idx[2 * WINDOW];
+		int block_size[2 * WINDOW];
+		int k = 0;
+		for (const auto &it : parameter_block_idx)
+		{
+			block_addr[k] = it.first;
+			block_idx[k] = it.second;
+			block_size[k] = parameter_block_size[it.first];
+			k++;
+		}
+
+		Eigen::Matrix<double, DIM, DIM> A = Eigen::Matrix<double, DIM, DIM>::Zero();
+		Eigen::Matrix<double, DIM, 1> b = Eigen::Matrix<double, DIM, 1>::Zero();
+		int idx[2 * WINDOW];
+		int size[2 * WINDOW];
+		for (auto it : factors)
+		{
+			const int num_blocks = static_cast<int>(it->parameter_blocks.size());
+			for (int i = 0; i < num_blocks; i++)
+			{
+				long addr = reinterpret_cast<long>(it->parameter_blocks[i]);
+				int l = 0;
+				while (block_addr[l] != addr)
+					l++;
+				idx[i] = block_idx[l];
+				size[i] = block_size[l];
+			}
+			for (int i = 0; i < num_blocks; i++)
+			{
+				const auto jacobian_i = it->jacobians[i].leftCols(size[i]);
+				for (int j = 0; j < num_blocks; j++)
+				{
+					const auto jacobian_j = it->jacobians[j].leftCols(size[j]);
+					A.block(idx[i], idx[j], size[i], size[j]).noalias() += jacobian_i.transpose() * jacobian_j;
+				}
+				b.segment(idx[i], size[i]).noalias() += jacobian_i.transpose() * it->residuals;
+			}
+		}
+
+		const Eigen::Matrix<double, M, M> Amm = 0.5 * (A.template topLeftCorner<M, M>() + A.template topLeftCorner<M, M>().transpose());
+		const Eigen::Matrix<double, M, N> Amr = A.template topRightCorner<M, N>();
+		const Eigen::Matrix<double, M, 1> bmm = b.template head<M>();
+
+		// Amm^+ [Amr bmm], pivots below eps are treated as zero like the eigenvalues of the dynamic path
+		Eigen::LDLT<Eigen::Matrix<double, M, M>> ldlt_mm(Amm);
+		const Eigen::Matrix<double, M, 1> d_mm = ldlt_mm.vectorD();
+		const Eigen::Matrix<double, M, 1> d_mm_inv = (d_mm.array() > eps).select(d_mm.array().inverse(), 0);
+		Eigen::Matrix<double, M, N + 1> X;
+		X.template leftCols<N>() = Amr;
+		X.col(N) = bmm;
+		X = ldlt_mm.transpositionsP() * X;
+		ldlt_mm.matrixL().solveInPlace(X);
+		X = d_mm_inv.asDiagonal() * X;
+		ldlt_mm.matrixU().solveInPlace(X);
+		X = ldlt_mm.transpositionsP().transpose() * X;
+
+		Eigen::Matrix<double, N, N> S = A.template bottomRightCorner<N, N>() - Amr.transpose() * X.template leftCols<N>();
+		const Eigen::Matrix<double, N, 1> bs = b.template tail<N>() - Amr.transpose() * X.col(N);
+		S = 0.5 * (S + S.transpose());
+
+		// S = P^T L D L^T P, J = D^(1/2) L^T P and r = D^(-1/2) L^-1 P b so that J^T J = S and J^T r = b
+		Eigen::LDLT<Eigen::Matrix<double, N, N>> ldlt_s(S);
+		const Eigen::Matrix<double, N, 1> d_s = ldlt_s.vectorD();
+		const Eigen::Matrix<double, N, 1> d_s_sqrt = (d_s.array() > eps).select(d_s.array().sqrt(), 0);
+		const Eigen::Matrix<double, N, 1> d_s_inv_sqrt = (d_s.array() > eps).select(d_s.array().sqrt().inverse(), 0);
+		Eigen::Matrix<double, N, N> LtP = Eigen::Matrix<double, N, N>(ldlt_s.matrixU()) * (ldlt_s.transpositionsP() * Eigen::Matrix<double, N, N>::Identity());
+		Eigen::Matrix<double, N, 1> r = ldlt_s.transpositionsP() * bs;
+		ldlt_s.matrixL().solveInPlace(r);
+
+		linearized_jacobians = d_s_sqrt.asDiagonal() * LtP;
+		linearized_residuals = d_s_inv_sqrt.asDiagonal() * r;
+	}
+
 	std::vector<double *> getParameterBlocks(std::unordered_map<long, double *> &addr_shift)
 	{
 		std::vector<double *> keep_block_addr;
@@ -0,0 +1,72 @@
+#ifndef LIO_LOCALIZATION_POSE_ESTIMATION_H
+#define LIO_LOCALIZATION_POSE_ESTIMATION_H
+#include "Estimator/LioPipeline.h"
+#include "utils/Profiler.h"
+#include "utils/CloudPool.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/** \brief ros front end of the LioPipeline: queues the labelled clouds and IMU messages,
+ *  estimates the queued frames in process(), skipping or degrading them when the output falls
+ *  behind, and publishes the odometry and the registered cloud.
+ *  The clouds come from /laser_cloud_filtered or, in the composed node, from PushCloud().
+ */
+class PoseEstimation
+{
+public:
+  /** \brief read the mapping parameters and advertise the topics
+   * \param[in] nh: node handle
+   * \param[in] subscribe_cloud: subscribe /laser_cloud_filtered, false when the clouds are pushed in process
+   */
+  PoseEstimation(ros::NodeHandle &nh, bool subscribe_cloud = true);
+
+  /** \brief queue one labelled cloud, thread safe
+   * \param[in] time: time stamp of the scan end
+   * \param[in] cloud: labelled lidar points, owned by the estimator from now on
+   */
+  void PushCloud(double time, const LabelledCloud::Ptr &cloud)
+  {
+    std::unique_lock<std::mutex> lock(_mutexLidarQueue);
+    _lidarMsgQueue.push_back(std::make_pair(time, cloud));
+  }
+
+  void fullCallBack(const sensor_msgs::PointCloud2ConstPtr &msg);
+
+  void imu_callback(const sensor_msgs::ImuConstPtr &imu_msg)
+  {
+    // push IMU msg to queue
+    pipeline->PushImu(imu_msg);
+  }
+
+  /** \brief publish odometry infomation
+   * \param[in] newPose: pose to be published
+   * \param[in] timefullCloud: time stamp
+   */
+  void pubOdometry(const Eigen::Matrix4d &newPose, double &timefullCloud);
+
+  /** \brief Mapping main thread
+   */
+  void process();
+
+private:
+  LioPipeline *pipeline;
+  FrameScheduler scheduler; // full, degraded or skipped processing of each queued frame
+
+  ros::Subscriber subFullCloud;
+  ros::Subscriber sub_imu;
+  ros::Publisher pubLaserOdometry;
+  ros::Publisher pubLaserOdometryPath;
+  ros::Publisher pubFullLaserCloud;
+  tf::StampedTransform laserOdometryTrans;
+  tf::TransformBroadcaster *tfBroadcaster;
+
+  std::mutex _mutexLidarQueue;
+  std::deque<std::pair<double, LabelledCloud::Ptr>> _lidarMsgQueue;
+  CloudPool<LabelledPoint> cloudPool;     // clouds of fullCallBack, back once the frame left the window
+  LabelledCloud laserCloudAfterEstimate; // registered cloud, reused for every publish
+
+  nav_msgs::Path laserOdoPath;
+};
+
+#endif // LIO_LOCALIZATION_POSE_ESTIMATION_H
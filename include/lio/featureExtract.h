@@ -0,0 +1,125 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <std_msgs/Header.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <deque>
+#include <iostream>
+#include <fstream>
+#include <ctime>
+#include <cfloat>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <limits>
+#include <iomanip>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+#include "LIO_Localization/cloud_info.h"
+#include "my_utility.h"
+#include "Estimator/FeatureExtractor.h"
+#include "utils/ProfilerRos.h"
+#include "utils/CloudPool.h"
+
+enum class SensorType
+{
+    VELODYNE,
+    OUSTER,
+    ROBOSENSE,
+    LIVOX
+};
+
+using PointXYZIRT = VelodynePointXYZIRT;
+
+class FeatureExtract
+{
+public:
+    ros::NodeHandle nh;
+    // Topics
+    std::string pointCloudTopic;
+    // Frames
+    std::string lidarFrameStr;
+
+    // Lidar Sensor Configuration
+    SensorType sensor;
+    int N_SCAN;
+    int Horizon_SCAN;
+    int downsampleRate;
+    float lidarMinRange;
+    float lidarMaxRange;
+
+    // LOAM
+    float edgeThreshold;
+    float surfThreshold;
+    int edgeFeatureMinValidNum;
+    int surfFeatureMinValidNum;
+
+    pcl::PointCloud<PointXYZIRT>::Ptr laserCloudIn;
+    pcl::PointCloud<OusterPointXYZIRT>::Ptr tmpOusterCloudIn;
+    pcl::PointCloud<rsPointXYZIRT>::Ptr tmpRSCloudIn;
+    pcl::PointCloud<PointType>::Ptr inputCloud;
+    LabelledCloud::Ptr extractedCloud;
+    std::shared_ptr<CloudPool<LabelledPoint>> cloudPool; // extracted clouds handed to the estimator come back here
+
+    pcl::PointCloud<PointType>::Ptr cornerCloud;
+    pcl::PointCloud<PointType>::Ptr surfaceCloud;
+
+    std::shared_ptr<FeatureExtractor> extractor;
+    std::shared_ptr<ProfilerPublisher> profilerPublisher;
+
+    // receives the labelled cloud and its end time when an estimator runs in the same process
+    typedef std::function<void(double, const LabelledCloud::Ptr &)> CloudSink;
+    CloudSink cloudSink;
+
+    LIO_Localization::cloud_info cloudInfo;
+    double timeScanCur;
+    double timeScanEnd;
+
+    // voxel filter paprams
+    float odometrySurfLeafSize;
+
+    // CPU Params
+    int numberOfCores;
+
+    ros::Subscriber subLaserCloud;
+
+    ros::Publisher pubLaserCloudInfo;
+    ros::Publisher pubCornerPoints;
+    ros::Publisher pubSurfacePoints;
+    ros::Publisher pubFullPoints;
+
+    std_msgs::Header cloudHeader;
+
+    FeatureExtract();
+
+    void allocateMemory();
+
+    void resetParameters()
+    {
+        laserCloudIn->clear();
+        extractedCloud->clear();
+        inputCloud->clear();
+    }
+
+    void cloudHandler(const sensor_msgs::PointCloud2ConstPtr &laserCloudMsg);
+
+    /** \brief pass the labelled clouds to an estimator in the same process instead of /laser_cloud_filtered */
+    void SetCloudSink(const CloudSink &sink)
+    {
+        cloudSink = sink;
+    }
+    bool cachePointCloud(const sensor_msgs::PointCloud2ConstPtr &laserCloudMsg);
+
+    void publishFeatureCloud();
+};
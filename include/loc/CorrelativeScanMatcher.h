@@ -0,0 +1,94 @@
+#ifndef LIO_LOCALIZATION_CORRELATIVE_SCAN_MATCHER_H
+#define LIO_LOCALIZATION_CORRELATIVE_SCAN_MATCHER_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+
+/** \brief multi-resolution correlative scan matcher, search x/y/yaw by branch-and-bound
+ *  over max-pooled 2D occupancy grids built from the prior map
+ */
+class CorrelativeScanMatcher
+{
+  typedef pcl::PointXYZINormal PointType;
+
+public:
+  struct Options
+  {
+    double resolution = 0.5;         // finest grid cell size (m)
+    int depth = 6;                   // number of max-pooled grid levels
+    double linear_window = 20.0;     // half size of the x/y search window (m)
+    double angular_window = M_PI;    // half size of the yaw search window (rad)
+    double min_score = 0.55;         // candidates below this score are pruned
+    double max_range = 60.0;         // scan points farther than this are ignored (m)
+    double min_z = -1.0;             // height band relative to the sensor used for projection (m)
+    double max_z = 3.0;
+  };
+
+  /** \brief constructor of CorrelativeScanMatcher */
+  explicit CorrelativeScanMatcher(const Options &options);
+
+  /** \brief project map points around center into the grid pyramid
+   * \param[in] mapCloud: prior map points in world frame
+   * \param[in] center: sensor position the search window is centered on, z is used as the height reference
+   */
+  void SetMap(const pcl::PointCloud<PointType>::Ptr &mapCloud, const Eigen::Vector3d &center);
+
+  /** \brief search the globally best x/y/yaw inside the window around initPose
+   * \param[in] scan: lidar points in body frame
+   * \param[in] initPose: initial pose, roll/pitch/z are kept fixed
+   * \param[out] pose: best pose found
+   * \param[out] score: occupancy score of the best pose in [0,1]
+   * \return true if a candidate above min_score was found
+   */
+  bool Match(const pcl::PointCloud<PointType>::Ptr &scan, const Eigen::Matrix4d &initPose,
+             Eigen::Matrix4d &pose, double &score) const;
+
+  bool HasMap() const
+  {
+    return !grids.empty();
+  }
+
+private:
+  struct Grid
+  {
+    int width = 0;
+    std::vector<float> cells;
+    float at(int x, int y) const
+    {
+      if (x < 0 || y < 0 || x >= width || y >= width)
+        return 0.f;
+      return cells[y * width + x];
+    }
+  };
+
+  struct Candidate
+  {
+    int scanIndex;
+    int xOffset;
+    int yOffset;
+    double score;
+    bool operator>(const Candidate &other) const
+    {
+      return score > other.score;
+    }
+  };
+
+  typedef std::vector<Eigen::Array2i> DiscreteScan;
+
+  double ScoreCandidate(const Grid &grid, const DiscreteScan &scan, int xOffset, int yOffset) const;
+
+  void ScoreCandidates(const Grid &grid, const std::vector<DiscreteScan> &scans,
+                       std::vector<Candidate> &candidates) const;
+
+  Candidate BranchAndBound(const std::vector<DiscreteScan> &scans, const std::vector<Candidate> &candidates,
+                           int height, double minScore, int linearBound) const;
+
+  Options options;
+  std::vector<Grid> grids; // grids[h] stores the max over a 2^h x 2^h block
+  Eigen::Vector2d origin;  // world position of cell (0,0)
+  double zRef = 0;
+};
+
+#endif // LIO_LOCALIZATION_CORRELATIVE_SCAN_MATCHER_H
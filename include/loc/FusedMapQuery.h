@@ -0,0 +1,118 @@
+#ifndef LIO_LOCALIZATION_FUSED_MAP_QUERY_H
+#define LIO_LOCALIZATION_FUSED_MAP_QUERY_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "Estimator/StaticKdTree.h"
+#include "loc/IncrementalLocalMap.h"
+
+/** \brief one nearest neighbourhood query over the static prior map and the dynamic local map.
+ *  The prior map is searched first, bounded by the association distance. Its farthest neighbour
+ *  then bounds the local map search, so the local tree only explores the region where it can
+ *  still return a tighter neighbourhood. The tighter of the two complete neighbourhoods is
+ *  returned, every correspondence is fitted once against a single map. Prior map neighbours are
+ *  read from the tree, which may store them quantized, the prior map cloud itself is not touched.
+ *  One instance per association thread, the counters tell how often each map served a query.
+ */
+class FusedMapQuery
+{
+  typedef pcl::PointXYZINormal PointType;
+
+public:
+  static const int K = 5;
+
+  enum Source
+  {
+    None = 0,
+    Global = 1,
+    Local = 2
+  };
+
+  /** \brief K neighbours of one map, sorted by distance. Only the coordinates are set for prior map neighbours */
+  struct Neighbourhood
+  {
+    PointType points[K];
+    float sqDists[K];
+    Source source = None;
+  };
+
+  /** \brief constructor of FusedMapQuery
+   * \param[in] globalTree: tree over the prior map points, may be null
+   * \param[in] localMap: local map of the last scans, may be null
+   * \param[in] minGlobalPoints: the prior map is only searched above this size
+   * \param[in] minLocalPoints: the local map is only searched above this size
+   */
+  FusedMapQuery(const StaticKdTree<PointType>::Ptr &globalTree,
+                IncrementalLocalMap *localMap,
+                int minGlobalPoints, int minLocalPoints = 20)
+      : globalTree(globalTree), localMap(localMap)
+  {
+    useGlobal = globalTree && globalTree->size() > minGlobalPoints;
+    useLocal = localMap && localMap->size() > minLocalPoints;
+  }
+
+  /** \brief the tighter K point neighbourhood of point in either map
+   * \param[in] point: query point in map frame
+   * \param[in] maxSqDist: all neighbours must be closer than this squared distance
+   * \param[out] nb: neighbourhood, left untouched when None is returned
+   * \return map that served the neighbourhood, None if no map has K points in range
+   */
+  Source NearestKSearch(const PointType &point, float maxSqDist, Neighbourhood &nb)
+  {
+    queries++;
+    Source source = None;
+    float bound = maxSqDist;
+    if (useGlobal)
+    {
+      globalTree->nearestKSearch(point, knn, maxSqDist);
+      if (knn.size == K)
+      {
+        for (int j = 0; j < K; j++)
+        {
+          nb.points[j].x = knn.xyz[j][0];
+          nb.points[j].y = knn.xyz[j][1];
+          nb.points[j].z = knn.xyz[j][2];
+          nb.sqDists[j] = knn.sqDists[j];
+        }
+        source = Global;
+        bound = knn.sqDists[K - 1];
+      }
+    }
+    if (useLocal)
+    {
+      localMap->NearestKSearch(point, K, nearLocal, sqDistLocal, std::sqrt(bound));
+      if (static_cast<int>(nearLocal.size()) == K && sqDistLocal[K - 1] < bound)
+      {
+        for (int j = 0; j < K; j++)
+        {
+          nb.points[j] = nearLocal[j];
+          nb.sqDists[j] = sqDistLocal[j];
+        }
+        source = Local;
+      }
+    }
+    nb.source = source;
+    if (source == Global)
+      servedGlobal++;
+    else if (source == Local)
+      servedLocal++;
+    return source;
+  }
+
+  size_t queries = 0;
+  size_t servedGlobal = 0;
+  size_t servedLocal = 0;
+
+private:
+  StaticKdTree<PointType>::Ptr globalTree;
+  IncrementalLocalMap *localMap;
+  bool useGlobal;
+  bool useLocal;
+  KnnResult<K> knn;
+  IncrementalLocalMap::PointVector nearLocal;
+  std::vector<float> sqDistLocal;
+};
+
+#endif // LIO_LOCALIZATION_FUSED_MAP_QUERY_H
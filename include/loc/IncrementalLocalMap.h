@@ -0,0 +1,75 @@
+#ifndef LIO_LOCALIZATION_INCREMENTAL_LOCAL_MAP_H
+#define LIO_LOCALIZATION_INCREMENTAL_LOCAL_MAP_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+template <typename PointType>
+class KD_TREE;
+
+/** \brief sliding window local map of the last windowSize scans, one point per voxel.
+ *  Points are inserted into and evicted from an ikd-Tree in place, so the per-frame cost
+ *  is proportional to one scan instead of the whole window.
+ */
+class IncrementalLocalMap
+{
+  typedef pcl::PointXYZINormal PointType;
+
+public:
+  typedef std::vector<PointType, Eigen::aligned_allocator<PointType>> PointVector;
+
+  /** \brief constructor of IncrementalLocalMap
+   * \param[in] windowSize: number of scans kept in the map
+   * \param[in] leafSize: voxel size, each voxel keeps a single point
+   */
+  IncrementalLocalMap(int windowSize, float leafSize);
+
+  ~IncrementalLocalMap();
+
+  /** \brief insert a scan already transformed to the map frame, evicting the oldest scan once the window is full
+   * \param[in] cloudInMap: scan points in map frame
+   */
+  void Insert(const pcl::PointCloud<PointType> &cloudInMap);
+
+  /** \brief drop all scans */
+  void Clear();
+
+  /** \brief number of points currently in the map */
+  int size() const
+  {
+    return static_cast<int>(voxels.size());
+  }
+
+  /** \brief k nearest neighbour search
+   * \param[in] point: query point in map frame
+   * \param[in] k: number of neighbours
+   * \param[out] points: neighbours sorted by distance
+   * \param[out] sqDist: squared distance of each neighbour
+   * \param[in] maxDist: only neighbours within this distance are returned, it also prunes the search
+   * \return number of neighbours found
+   */
+  int NearestKSearch(const PointType &point, int k, PointVector &points, std::vector<float> &sqDist,
+                     float maxDist = std::numeric_limits<float>::infinity());
+
+private:
+  struct Voxel
+  {
+    PointType point;
+    int64_t frameId; // last scan that observed this voxel
+  };
+
+  int64_t VoxelKey(const PointType &p) const;
+
+  int windowSize;
+  float leafSize;
+  int64_t frameCount = 0;
+  std::unordered_map<int64_t, Voxel> voxels;
+  std::vector<std::vector<int64_t>> slotVoxels; // voxels observed by the scan stored in each slot
+  KD_TREE<PointType> *tree;
+};
+
+#endif // LIO_LOCALIZATION_INCREMENTAL_LOCAL_MAP_H
@@ -0,0 +1,129 @@
+#ifndef LIO_LOCALIZATION_MAP_PYRAMID_H
+#define LIO_LOCALIZATION_MAP_PYRAMID_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Estimator/StaticKdTree.h"
+#include "utils/VoxelHash.h"
+
+/** \brief coarse levels of the prior map for coarse to fine registration.
+ *  Every level holds one point per voxel of the corner and the surf map: the centroid of the map
+ *  points in the voxel, with the line direction of a linear corner voxel or the normal of a planar
+ *  surf voxel precomputed in normal_x/y/z from their covariance. Voxels that are neither are left
+ *  out. A scan point is then associated with its single nearest centroid, no neighbourhood is
+ *  fitted per query. Levels are ordered from coarsest to finest, built once, queries are const.
+ */
+class MapPyramid
+{
+  typedef pcl::PointXYZINormal PointType;
+  typedef pcl::PointCloud<PointType> Cloud;
+
+public:
+  struct Level
+  {
+    float voxel;
+    Cloud::Ptr corner; // centroids of the linear corner voxels, normal_x/y/z line direction
+    Cloud::Ptr surf;   // centroids of the planar surf voxels, normal_x/y/z plane normal
+    StaticKdTree<PointType> cornerTree;
+    StaticKdTree<PointType> surfTree;
+  };
+
+  /** \brief build one level per voxel size
+   * \param[in] corner: corner points of the prior map
+   * \param[in] surf: surf points of the prior map
+   * \param[in] voxels: voxel sizes of the levels, coarsest first (m)
+   */
+  void Build(const Cloud &corner, const Cloud &surf, const std::vector<double> &voxels)
+  {
+    levels.clear();
+    levels.resize(voxels.size());
+    for (size_t l = 0; l < voxels.size(); ++l)
+    {
+      Level &level = levels[l];
+      level.voxel = float(voxels[l]);
+      level.corner.reset(new Cloud);
+      level.surf.reset(new Cloud);
+      Summarize(corner, level.voxel, false, *level.corner);
+      Summarize(surf, level.voxel, true, *level.surf);
+      level.cornerTree.setInputCloud(level.corner);
+      level.surfTree.setInputCloud(level.surf);
+    }
+  }
+
+  int Levels() const
+  {
+    return static_cast<int>(levels.size());
+  }
+
+  const Level &GetLevel(int l) const
+  {
+    return levels[l];
+  }
+
+private:
+  /** \brief centroid and shape of every voxel of cloud
+   * \param[in] planar: keep planar voxels with their normal, else linear voxels with their direction
+   */
+  static void Summarize(const Cloud &cloud, float voxel, bool planar, Cloud &out)
+  {
+    out.clear();
+    if (cloud.points.empty())
+      return;
+    // moments relative to the first point, map coordinates may be far from the origin
+    const Eigen::Vector3d origin(cloud.points[0].x, cloud.points[0].y, cloud.points[0].z);
+    const double inv = 1.0 / voxel;
+    std::unordered_map<uint64_t, voxel_hash::Moments> voxels;
+    voxels.reserve(cloud.size() / 8 + 1);
+    for (const PointType &p : cloud.points)
+    {
+      const Eigen::Vector3d v = Eigen::Vector3d(p.x, p.y, p.z) - origin;
+      voxels[voxel_hash::KeyOf(v.x(), v.y(), v.z(), inv)].Add(v);
+    }
+
+    out.points.reserve(voxels.size());
+    for (const auto &kv : voxels)
+    {
+      const voxel_hash::Moments &m = kv.second;
+      if (m.count < 5)
+        continue;
+      const Eigen::Vector3d mean = m.Mean();
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(m.Covariance());
+      const Eigen::Vector3d &ev = saes.eigenvalues();
+      Eigen::Vector3d dir;
+      if (planar)
+      {
+        // thin compared to its extent, a tenth of it in standard deviation at most
+        if (ev(0) > 0.01 * ev(1))
+          continue;
+        dir = saes.eigenvectors().col(0);
+      }
+      else
+      {
+        // same linearity test as the fine association
+        if (ev(2) <= 3 * ev(1))
+          continue;
+        dir = saes.eigenvectors().col(2);
+      }
+      PointType c;
+      c.x = float(mean.x() + origin.x());
+      c.y = float(mean.y() + origin.y());
+      c.z = float(mean.z() + origin.z());
+      c.normal_x = float(dir.x());
+      c.normal_y = float(dir.y());
+      c.normal_z = float(dir.z());
+      c.intensity = float(m.count);
+      c.curvature = float(std::sqrt(std::max(0.0, planar ? ev(0) : ev(1)))); // spread across the shape (m)
+      out.push_back(c);
+    }
+  }
+
+  std::vector<Level> levels;
+};
+
+#endif // LIO_LOCALIZATION_MAP_PYRAMID_H
@@ -0,0 +1,287 @@
+#ifndef LIO_LOCALIZATION_NDT_MAP_H
+#define LIO_LOCALIZATION_NDT_MAP_H
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils/VoxelHash.h"
+
+/** \brief normal distributions of the prior map, one Gaussian per voxel and feature class.
+ *  Every voxel with enough corner or surf map points keeps the mean of its points and the square
+ *  root of the information of their covariance, so a scan point is matched by hashing its voxel
+ *  instead of a neighbour search and a plane fit. The eigenvalues of a covariance are clamped to
+ *  eigen_ratio of the largest one and to min_sigma squared, the rows of the square root are the
+ *  eigenvectors, smallest first, weighted by the smallest standard deviation over their own: the
+ *  first row of a planar voxel is its normal with weight 1, its tangents weigh sigma_n / sigma_t.
+ *  A cell takes 64 bytes and 2 to 4 hash slots of 12 bytes. Built once, queries are const.
+ */
+class NdtMap
+{
+  typedef pcl::PointXYZINormal PointType;
+  typedef pcl::PointCloud<PointType> Cloud;
+
+public:
+  struct Options
+  {
+    double voxel = 1.0;         // voxel size of the distributions (m)
+    int min_points = 5;         // map points a voxel needs for a distribution
+    double min_sigma = 0.01;    // standard deviations are clamped to this at least (m)
+    double eigen_ratio = 0.001; // and the eigenvalues to this ratio of the largest one
+  };
+
+  /** \brief distribution a point is matched to */
+  struct Match
+  {
+    Eigen::Vector3d mean;     // in map frame
+    Eigen::Matrix3d sqrtInfo; // rows weigh the offset from the mean, the first one by 1
+    double sqDist;            // squared Mahalanobis distance of the point
+  };
+
+  NdtMap() : NdtMap(Options()) {}
+
+  explicit NdtMap(const Options &options) : options(options) {}
+
+  /** \brief distributions of both feature classes of the prior map
+   * \param[in] corner: corner points of the prior map
+   * \param[in] surf: surf points of the prior map
+   */
+  void Build(const Cloud &corner, const Cloud &surf)
+  {
+    cells.clear();
+    const Cloud &first = surf.points.empty() ? corner : surf;
+    // coordinates relative to a map point, map coordinates may be far from the origin
+    origin = first.points.empty() ? Eigen::Vector3d::Zero()
+                                  : Eigen::Vector3d(first.points[0].x, first.points[0].y, first.points[0].z);
+    sources[0] = corner.size();
+    sources[1] = surf.size();
+    Summarize(corner, 0);
+    Summarize(surf, 1);
+    Rehash();
+  }
+
+  /** \brief the closest distribution of the voxel of point and its 6 face neighbours
+   * \param[in] point: query point in map frame
+   * \param[in] featureClass: 0 corner, 1 surf
+   * \param[out] match: the distribution, untouched if none is found
+   * \return true if a distribution is found
+   */
+  bool Lookup(const Eigen::Vector3d &point, int featureClass, Match &match) const
+  {
+    if (cells.empty())
+      return false;
+    static const int offsets[7][3] = {{0, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const Eigen::Vector3d v = point - origin;
+    const int64_t x = int64_t(std::floor(v.x() * inverseVoxel));
+    const int64_t y = int64_t(std::floor(v.y() * inverseVoxel));
+    const int64_t z = int64_t(std::floor(v.z() * inverseVoxel));
+    const Cell *best = nullptr;
+    double bestSqDist = 0;
+    for (const auto &o : offsets)
+    {
+      const Cell *cell = Find(voxel_hash::Key(x + o[0], y + o[1], z + o[2], uint64_t(featureClass)));
+      if (!cell)
+        continue;
+      const Eigen::Vector3d r = cell->sqrtInfo.cast<double>() * (v - cell->mean.cast<double>()) / cell->sigma;
+      const double sqDist = r.squaredNorm();
+      if (!best || sqDist < bestSqDist)
+      {
+        best = cell;
+        bestSqDist = sqDist;
+      }
+    }
+    if (!best)
+      return false;
+    match.mean = best->mean.cast<double>() + origin;
+    match.sqrtInfo = best->sqrtInfo.cast<double>();
+    match.sqDist = bestSqDist;
+    return true;
+  }
+
+  /** \brief write the distributions next to the map they were built from
+   * \return false if the file cannot be written
+   */
+  bool Save(const std::string &path) const
+  {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out)
+      return false;
+    const uint64_t count = cells.size();
+    out.write(Magic(), 8);
+    WriteOptions(out, options);
+    out.write(reinterpret_cast<const char *>(sources), sizeof(sources));
+    out.write(reinterpret_cast<const char *>(origin.data()), 3 * sizeof(double));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(cells.data()), count * sizeof(Cell));
+    return bool(out);
+  }
+
+  /** \brief read distributions written by Save
+   * \param[in] corner: number of corner points of the prior map
+   * \param[in] surf: number of surf points of the prior map
+   * \return false if the file is missing, or was built with other options or from another map
+   */
+  bool Load(const std::string &path, size_t corner, size_t surf)
+  {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    char magic[8];
+    Options fileOptions;
+    uint64_t fileSources[2];
+    uint64_t count = 0;
+    if (!in.read(magic, 8) || std::memcmp(magic, Magic(), 8) != 0 || !ReadOptions(in, fileOptions) ||
+        !in.read(reinterpret_cast<char *>(fileSources), sizeof(fileSources)))
+      return false;
+    if (fileOptions.voxel != options.voxel || fileOptions.min_points != options.min_points ||
+        fileOptions.min_sigma != options.min_sigma || fileOptions.eigen_ratio != options.eigen_ratio ||
+        fileSources[0] != corner || fileSources[1] != surf)
+      return false;
+    Eigen::Vector3d fileOrigin;
+    if (!in.read(reinterpret_cast<char *>(fileOrigin.data()), 3 * sizeof(double)) ||
+        !in.read(reinterpret_cast<char *>(&count), sizeof(count)))
+      return false;
+    std::vector<Cell> fileCells(count);
+    if (!in.read(reinterpret_cast<char *>(fileCells.data()), count * sizeof(Cell)))
+      return false;
+    origin = fileOrigin;
+    sources[0] = corner;
+    sources[1] = surf;
+    cells.swap(fileCells);
+    Rehash();
+    return true;
+  }
+
+  size_t Cells() const { return cells.size(); }
+  const Options &GetOptions() const { return options; }
+
+  size_t memoryBytes() const
+  {
+    return cells.capacity() * sizeof(Cell) + slotKeys.capacity() * sizeof(uint64_t) + slotCells.capacity() * sizeof(uint32_t);
+  }
+
+private:
+  static const uint64_t kEmpty = ~uint64_t(0);
+
+  struct Cell
+  {
+    uint64_t key;
+    Eigen::Vector3f mean;     // relative to origin
+    Eigen::Matrix3f sqrtInfo; // eigenvectors as rows, weighted, smallest eigenvalue first
+    float sigma;              // smallest clamped standard deviation (m)
+  };
+
+  static const char *Magic()
+  {
+    return "LIONDT01";
+  }
+
+  static void WriteOptions(std::ofstream &out, const Options &o)
+  {
+    const int32_t minPoints = o.min_points;
+    out.write(reinterpret_cast<const char *>(&o.voxel), sizeof(double));
+    out.write(reinterpret_cast<const char *>(&minPoints), sizeof(int32_t));
+    out.write(reinterpret_cast<const char *>(&o.min_sigma), sizeof(double));
+    out.write(reinterpret_cast<const char *>(&o.eigen_ratio), sizeof(double));
+  }
+
+  static bool ReadOptions(std::ifstream &in, Options &o)
+  {
+    int32_t minPoints = 0;
+    in.read(reinterpret_cast<char *>(&o.voxel), sizeof(double));
+    in.read(reinterpret_cast<char *>(&minPoints), sizeof(int32_t));
+    in.read(reinterpret_cast<char *>(&o.min_sigma), sizeof(double));
+    in.read(reinterpret_cast<char *>(&o.eigen_ratio), sizeof(double));
+    o.min_points = minPoints;
+    return bool(in);
+  }
+
+  size_t Slot(uint64_t key) const
+  {
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> shift);
+  }
+
+  const Cell *Find(uint64_t key) const
+  {
+    const size_t mask = slotKeys.size() - 1;
+    for (size_t s = Slot(key);; s = (s + 1) & mask)
+    {
+      if (slotKeys[s] == key)
+        return &cells[slotCells[s]];
+      if (slotKeys[s] == kEmpty)
+        return nullptr;
+    }
+  }
+
+  /** \brief open addressing table of the cells, at most half full */
+  void Rehash()
+  {
+    inverseVoxel = 1.0 / options.voxel;
+    size_t size = 2;
+    shift = 63;
+    while (size < 2 * cells.size())
+    {
+      size *= 2;
+      shift--;
+    }
+    slotKeys.assign(size, uint64_t(kEmpty));
+    slotCells.assign(size, 0);
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+      size_t s = Slot(cells[i].key);
+      while (slotKeys[s] != kEmpty)
+        s = (s + 1) & (size - 1);
+      slotKeys[s] = cells[i].key;
+      slotCells[s] = uint32_t(i);
+    }
+  }
+
+  /** \brief distributions of the voxels of cloud */
+  void Summarize(const Cloud &cloud, int featureClass)
+  {
+    const double inv = 1.0 / options.voxel;
+    std::unordered_map<uint64_t, voxel_hash::Moments> voxels;
+    voxels.reserve(cloud.size() / 8 + 1);
+    for (const PointType &p : cloud.points)
+    {
+      const Eigen::Vector3d v = Eigen::Vector3d(p.x, p.y, p.z) - origin;
+      voxels[voxel_hash::KeyOf(v.x(), v.y(), v.z(), inv, uint64_t(featureClass))].Add(v);
+    }
+
+    const double minVar = options.min_sigma * options.min_sigma;
+    cells.reserve(cells.size() + voxels.size());
+    for (const auto &kv : voxels)
+    {
+      const voxel_hash::Moments &m = kv.second;
+      if (m.count < options.min_points)
+        continue;
+      const Eigen::Vector3d mean = m.Mean();
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(m.Covariance());
+      const double minEig = std::max(minVar, options.eigen_ratio * saes.eigenvalues()(2));
+      const Eigen::Vector3d ev = saes.eigenvalues().cwiseMax(minEig);
+      Cell cell;
+      cell.key = kv.first;
+      cell.mean = mean.cast<float>();
+      for (int i = 0; i < 3; ++i)
+        cell.sqrtInfo.row(i) = (std::sqrt(ev(0) / ev(i)) * saes.eigenvectors().col(i).transpose()).cast<float>();
+      cell.sigma = float(std::sqrt(ev(0)));
+      cells.push_back(cell);
+    }
+  }
+
+  Options options;
+  double inverseVoxel = 1.0;
+  Eigen::Vector3d origin = Eigen::Vector3d::Zero();
+  uint64_t sources[2] = {0, 0}; // corner and surf points the cells were built from
+  std::vector<Cell> cells;
+  std::vector<uint64_t> slotKeys;  // cell key per slot, kEmpty if free
+  std::vector<uint32_t> slotCells; // cell index per slot
+  int shift = 63;
+};
+
+#endif // LIO_LOCALIZATION_NDT_MAP_H
@@ -0,0 +1,516 @@
+#ifndef LIO_LOCALIZATION_MAP_LOCATION_H
+#define LIO_LOCALIZATION_MAP_LOCATION_H
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <limits>
+//  ros
+#include <ros/ros.h>
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/Path.h>
+#include <tf/transform_listener.h>
+#include <tf/transform_broadcaster.h>
+#include <tf/transform_datatypes.h>
+
+//  PCL
+#include <pcl/common/common.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/common/transforms.h>
+
+//  Eigen
+#include <Eigen/Dense>
+
+#include "tool_color_printf.hpp"
+#include "mutexDeque.hpp"
+#include "Estimator/Map_Manager.h"
+#include "Estimator/ceresfunc.h"
+#include "Estimator/AssociationCache.h"
+#include "Estimator/ConvergenceMonitor.h"
+#include "Estimator/Deskew.h"
+#include "Estimator/FeatureSelector.h"
+#include "Estimator/FrameScheduler.h"
+#include "Estimator/FrameWindow.h"
+#include "Estimator/LabelledPoint.h"
+#include "Estimator/MortonOrder.h"
+#include "Estimator/VoxelFilter.h"
+#include "loc/CorrelativeScanMatcher.h"
+#include "loc/FusedMapQuery.h"
+#include "loc/IncrementalLocalMap.h"
+#include "loc/MapPyramid.h"
+#include "loc/NdtMap.h"
+#include "utils/ParamFile.h"
+#include "utils/ProfilerRos.h"
+#include "utils/CloudPool.h"
+
+struct PointXYZIRPYT
+{
+  PCL_ADD_POINT4D
+  PCL_ADD_INTENSITY;
+  float roll;
+  float pitch;
+  float yaw;
+  double time;
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+} EIGEN_ALIGN16;
+
+POINT_CLOUD_REGISTER_POINT_STRUCT(PointXYZIRPYT,
+                                  (float, x, x)(float, y, y)(float, z, z)(float, intensity, intensity)(float, roll, roll)(float, pitch, pitch)(float, yaw, yaw)(double, time, time))
+
+// typedef pcl::PointXYZI PointType;
+typedef pcl::PointXYZINormal PointType;
+typedef pcl::PointCloud<PointType> CLOUD;
+typedef CLOUD::Ptr CLOUD_PTR;
+typedef PointXYZIRPYT PointTypePose;
+
+struct pcdmap
+{
+  std::vector<CLOUD_PTR> corner_keyframes_;
+  std::vector<CLOUD_PTR> surf_keyframes_;
+  CLOUD_PTR globalMapCloud_;
+  CLOUD_PTR cloudKeyPoses3D_;
+  CLOUD_PTR globalCornerMapCloud_;
+  CLOUD_PTR globalSurfMapCloud_;
+  pcdmap()
+  {
+    globalMapCloud_.reset(new CLOUD);
+    cloudKeyPoses3D_.reset(new CLOUD);
+    globalCornerMapCloud_.reset(new CLOUD);
+    globalSurfMapCloud_.reset(new CLOUD);
+  }
+};
+
+struct kylidar
+{
+  CLOUD_PTR corner;
+  CLOUD_PTR surf;
+  CLOUD_PTR cloud;
+  double time;
+  kylidar() : time(-1)
+  {
+    corner.reset(new CLOUD);
+    surf.reset(new CLOUD);
+    cloud.reset(new CLOUD());
+  }
+};
+
+enum InitializedFlag
+{
+  NonInitialized,
+  Initializing,
+  Initialized,
+  MayLost
+};
+
+/** \brief point to line feature */
+struct FeatureLine
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  Eigen::Vector3d pointOri;
+  Eigen::Vector3d lineP1;
+  Eigen::Vector3d lineP2;
+  double error;
+  bool valid;
+  FeatureLine(Eigen::Vector3d po, Eigen::Vector3d p1, Eigen::Vector3d p2)
+      : pointOri(std::move(po)), lineP1(std::move(p1)), lineP2(std::move(p2))
+  {
+    valid = false;
+    error = 0;
+  }
+  double ComputeError(const Eigen::Matrix4d &pose)
+  {
+    Eigen::Vector3d P_to_Map = pose.topLeftCorner(3, 3) * pointOri + pose.topRightCorner(3, 1);
+    double l12 = std::sqrt((lineP1(0) - lineP2(0)) * (lineP1(0) - lineP2(0)) + (lineP1(1) - lineP2(1)) * (lineP1(1) - lineP2(1)) + (lineP1(2) - lineP2(2)) * (lineP1(2) - lineP2(2)));
+    double a012 = std::sqrt(
+        ((P_to_Map(0) - lineP1(0)) * (P_to_Map(1) - lineP2(1)) - (P_to_Map(0) - lineP2(0)) * (P_to_Map(1) - lineP1(1))) * ((P_to_Map(0) - lineP1(0)) * (P_to_Map(1) - lineP2(1)) - (P_to_Map(0) - lineP2(0)) * (P_to_Map(1) - lineP1(1))) + ((P_to_Map(0) - lineP1(0)) * (P_to_Map(2) - lineP2(2)) - (P_to_Map(0) - lineP2(0)) * (P_to_Map(2) - lineP1(2))) * ((P_to_Map(0) - lineP1(0)) * (P_to_Map(2) - lineP2(2)) - (P_to_Map(0) - lineP2(0)) * (P_to_Map(2) - lineP1(2))) + ((P_to_Map(1) - lineP1(1)) * (P_to_Map(2) - lineP2(2)) - (P_to_Map(1) - lineP2(1)) * (P_to_Map(2) - lineP1(2))) * ((P_to_Map(1) - lineP1(1)) * (P_to_Map(2) - lineP2(2)) - (P_to_Map(1) - lineP2(1)) * (P_to_Map(2) - lineP1(2))));
+    error = a012 / l12;
+  }
+};
+
+/** \brief point to plan feature */
+struct FeaturePlanVec
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  Eigen::Vector3d pointOri;
+  Eigen::Vector3d pointProj;
+  Eigen::Matrix3d sqrt_info;
+  double error;
+  bool valid;
+  FeaturePlanVec(const Eigen::Vector3d &po, const Eigen::Vector3d &p_proj, Eigen::Matrix3d sqrt_info_)
+      : pointOri(po), pointProj(p_proj), sqrt_info(sqrt_info_)
+  {
+    valid = false;
+    error = 0;
+  }
+  double ComputeError(const Eigen::Matrix4d &pose)
+  {
+    Eigen::Vector3d P_to_Map = pose.topLeftCorner(3, 3) * pointOri + pose.topRightCorner(3, 1);
+    error = (P_to_Map - pointProj).norm();
+  }
+};
+
+class map_location
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  struct LidarFrame
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    LabelledCloud::Ptr laserCloud;
+    CLOUD_PTR corner;
+    CLOUD_PTR surf;
+    IMUIntegrator imuIntegrator;
+    Eigen::Vector3d P;
+    Eigen::Vector3d V;
+    Eigen::Quaterniond Q;
+    Eigen::Vector3d bg;
+    Eigen::Vector3d ba;
+    double timeStamp;
+    // the clouds are taken from the pools of map_location in ProcessFrame
+    LidarFrame()
+    {
+      P.setZero();
+      V.setZero();
+      Q.setIdentity();
+      bg.setZero();
+      ba.setZero();
+      timeStamp = 0;
+    }
+    /** \brief back to the default state in place, the IMU message buffer keeps its capacity */
+    void Reset()
+    {
+      laserCloud.reset();
+      corner.reset();
+      surf.reset();
+      imuIntegrator.Clear();
+      P.setZero();
+      V.setZero();
+      Q.setIdentity();
+      bg.setZero();
+      ba.setZero();
+      timeStamp = 0;
+    }
+  };
+
+private:
+  boost::shared_ptr<ros::NodeHandle> nh_; //  null when running offline
+  const ParamFile *params_ = nullptr;
+  ros::Subscriber sub_cloud_;
+  ros::Subscriber sub_imu_;
+  ros::Subscriber sub_initial_pose_;
+
+  ros::Publisher pub_corner_map;
+  ros::Publisher pub_surf_;
+  ros::Publisher pubMappedPoints_;
+  ros::Publisher pubLaserOdometryPath_;
+
+  tf::StampedTransform transform_;
+  boost::shared_ptr<tf::TransformBroadcaster> broadcaster_; //  publish laser to map tf
+  boost::shared_ptr<ProfilerPublisher> profiler_pub_;       //  periodic latency report, null when running offline
+
+  nav_msgs::Path laserOdoPath;
+
+  pcdmap map;
+  std::string filename;
+  std::string pointCloudTopic;
+  std::string imu_topic;
+  int IMU_Mode = 0;
+  bool use_lio = false;
+  double corner_leaf_;
+  double surf_leaf_;
+  double map_quantization_step = 0.005; // prior map trees store int16 offsets of this step, 0 stores floats
+  std::vector<double> pyramid_levels = {2.0, 1.0}; // voxels of the coarse prior map levels, coarsest first
+  bool use_ndt = false; // match against voxel distributions of the prior map instead of its trees
+  bool use_csm = true;
+  bool map_loaded = false;
+
+  pcl::KdTreeFLANN<PointType>::Ptr kdtree_keyposes_3d_;
+  StaticKdTree<PointType>::Ptr kdtree_corner_map;
+  StaticKdTree<PointType>::Ptr kdtree_surf_map;
+  MapPyramid mapPyramid; // coarse levels of the prior map, associated before the trees above
+  NdtMap ndtMap;         // voxel distributions of the prior map, built instead of the trees and levels
+  size_t ndtQueries = 0;
+  size_t ndtMatched = 0;
+
+  CLOUD_PTR surround_surf;
+  CLOUD_PTR surround_corner;
+
+  LabelledCloud::Ptr laserCloudFullRes;
+
+  VoxelFilter ds_corner_;
+  VoxelFilter ds_surf_;
+  VoxelFilter ds_frame_; // corner and surf of a labelled frame in one pass
+  MortonOrder<PointType> morton_; // corner and surf in query order
+
+  MutexDeque<std::pair<double, LabelledCloud::Ptr>> _lidarMsgQueue; //  scan end time and labelled cloud
+  MutexDeque<sensor_msgs::ImuConstPtr> _imuMsgQueue;
+  InitializedFlag initializedFlag;
+
+  PointTypePose initpose;
+
+  Eigen::Vector3d GravityVector;
+
+  int pushCount = 0;
+  double startTime = 0;
+  int WINDOWSIZE;
+  bool LidarIMUInited = false;
+  std::string root_dir = ROOT_DIR;
+
+  MAP_MANAGER *map_manager = nullptr;
+  CorrelativeScanMatcher *scan_matcher = nullptr;
+  std::mutex mtx_csm;
+  bool csm_fallback_logged = false; // the missing csm grids are reported once
+  static const int SLIDEWINDOWSIZE = 2;
+  static const int MAXWINDOWSIZE = 20;
+  typedef FrameWindow<LidarFrame, MAXWINDOWSIZE> LidarWindow;
+  // sliding window, holds the initialization window until the IMU is initialized
+  LidarWindow lidarFrameList;
+  // the current frame alone while the IMU is not initialized
+  LidarWindow currentFrameList_;
+  LidarFrame scratchFrame_;
+  double para_PR[SLIDEWINDOWSIZE][6];
+  double para_VBias[SLIDEWINDOWSIZE][9];
+  MarginalizationInfo *last_marginalization_info = nullptr;
+  std::vector<double *> last_marginalization_parameter_blocks;
+
+  Eigen::Matrix4d exTlb = Eigen::Matrix4d::Identity();
+  double thres_dist = 1.0;
+  double plan_weight_tan = 0.0;
+  double assoc_trans_thres = 0.1;
+  double assoc_rot_thres = 1.0;
+  ConvergenceMonitor convergence;
+  FeatureSelector featureSelector; // budgeted correspondences of each frame, sized by the estimate latency
+  FrameScheduler scheduler_;       // full, degraded or skipped processing of each queued frame
+  int degradedIters_ = 0;          // outer iterations of a degraded frame, 0 runs frames in full
+  int skippedFrames_ = 0;          // frames dropped since the last processed one
+  Deskew deskew_;
+  CloudPool<LabelledPoint> framePool_; // received scans, back once the frame left the window
+  CloudPool<PointType> cloudPool_;     // corner/surf of the frames and the icp scratch clouds
+  CLOUD cornerInMap_;                  // scan of MapIncrementLocal in map frame, reused
+  CLOUD surfInMap_;
+  Eigen::Matrix3d delta_Rl = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d delta_tl = Eigen::Vector3d::Zero();
+  Eigen::Matrix4d transformLastMapped = Eigen::Matrix4d::Identity();
+  double time_last_lidar = -1;
+
+  static const int localMapWindowSize = 30;
+  IncrementalLocalMap *localCornerMap = nullptr;
+  IncrementalLocalMap *localSurfMap = nullptr;
+
+  template <typename T>
+  void param(const std::string &key, T &value, const T &def)
+  {
+    if (params_)
+      params_->param<T>(key, value, def);
+    else
+      nh_->param<T>(key, value, def);
+  }
+
+public:
+  /** \brief constructor of map_location
+   * \param[in] params: parameters for offline use, no ros handle is created and nothing is published;
+   *  null to read the parameter server and subscribe the topics
+   */
+  explicit map_location(const ParamFile *params = nullptr);
+  ~map_location();
+
+  void cloudHandler(const sensor_msgs::PointCloud2ConstPtr &msg);
+
+  /** \brief queue one labelled cloud, thread safe
+   * \param[in] time: time stamp of the scan end
+   * \param[in] cloud: labelled lidar points, owned by the localization from now on
+   */
+  void PushCloud(double time, const LabelledCloud::Ptr &cloud)
+  {
+    if (!_lidarMsgQueue.empty() && (initializedFlag != Initialized)) //  由于tf关系，导致发布时间存在滞后，tf无法显示
+      _lidarMsgQueue.clear();
+    _lidarMsgQueue.push_back(std::make_pair(time, cloud));
+  }
+
+  /** \brief stop listening on the cloud topic when the clouds are pushed in process */
+  void UnsubscribeCloud()
+  {
+    sub_cloud_.shutdown();
+  }
+
+  void imu_callback(const sensor_msgs::ImuConstPtr &imu_msg)
+  {
+    // push IMU msg to queue
+    _imuMsgQueue.push_back(imu_msg);
+  }
+
+  void ExtractFeature(LidarFrame &kf);
+
+  void initialPoseCB(const geometry_msgs::PoseWithCovarianceStampedConstPtr &msg);
+
+  /** \brief start (re)localization around an initial guess
+   * \param[in] pose: initial pose in map frame, z is taken from the closest keyframe when csm is used
+   */
+  void SetInitialPose(const PointTypePose &pose);
+
+  void pubOdometry(Eigen::Matrix4d pose, double &time);
+
+  void pubOdometry(LidarFrame &frame);
+
+  void vector2double(const LidarWindow &tempFrameList);
+
+  void double2vector(LidarWindow &tempFrameList);
+
+  void Estimate(LidarWindow &frameList, const Eigen::Vector3d &gravity);
+
+  void run();
+
+  /** \brief whether the next frame needs the IMU messages since LastLidarTime() */
+  bool NeedImu() const
+  {
+    return IMU_Mode > 0 && time_last_lidar > 0;
+  }
+
+  /** \brief run the next frames degraded, with fewer outer iterations on coarser features, or in full */
+  void SetDegraded(bool degraded);
+
+  double LastLidarTime() const
+  {
+    return time_last_lidar;
+  }
+
+  bool MapLoaded() const
+  {
+    return map_loaded;
+  }
+
+  InitializedFlag GetInitializedFlag() const
+  {
+    return initializedFlag;
+  }
+
+  /** \brief pose in map frame of the last localized frame */
+  const Eigen::Matrix4d &GetPose() const
+  {
+    return transformLastMapped;
+  }
+
+  /** \brief localize one lidar frame, the initial pose must have been set
+   * \param[in] laserCloudFullRes: labelled lidar points in lidar frame, deskewed in place
+   * \param[in] time: time stamp of the frame
+   * \param[in] vimuMsg: IMU messages between the last frame and this one
+   * \return false if IMU is initialized but no IMU message arrived
+   */
+  bool ProcessFrame(LabelledCloud::Ptr laserCloudFullRes, double time, const std::vector<sensor_msgs::ImuConstPtr> &vimuMsg);
+
+  bool TryMAPInitialization();
+
+  void RemoveLidarDistortion(LabelledCloud::Ptr &laserCloud,
+                             const Eigen::Matrix3d &dRlc, const Eigen::Vector3d &dtlc)
+  {
+    PROFILE_SPAN(Deskew);
+    deskew_.Apply(*laserCloud, dRlc, dtlc);
+  }
+
+  bool fetchImuMsgs(double startTime, double endTime, std::vector<sensor_msgs::ImuConstPtr> &vimuMsg);
+
+  void processPointToLine(std::vector<ceres::CostFunction *> &edges,
+                          std::vector<FeatureLine> &vLineFeatures,
+                          const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                          FusedMapQuery &mapQuery,
+                          AssociationCache<FeatureLine> &cache,
+                          const Eigen::Matrix4d &exTlb,
+                          const Eigen::Matrix4d &m4d);
+
+  void processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
+                             std::vector<FeaturePlanVec> &vPlanFeatures,
+                             const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                             FusedMapQuery &mapQuery,
+                             AssociationCache<FeaturePlanVec> &cache,
+                             const Eigen::Matrix4d &exTlb,
+                             const Eigen::Matrix4d &m4d);
+
+  /** \brief square root information of a point to plane residual, the normal direction weighs most
+   * \param[in] omega: unit plane normal
+   */
+  Eigen::Matrix3d PlaneSqrtInfo(const Eigen::Vector3d &omega) const;
+
+  /** \brief scan subsampling of a pyramid level, about one scan point per level voxel area, 100 points at least
+   * \param[in] points: number of feature points of the scan
+   * \param[in] voxel: voxel size of the level
+   * \param[in] leaf: voxel size the scan features were downsampled with
+   */
+  static int CoarseStride(size_t points, float voxel, double leaf)
+  {
+    const double ratio = leaf > 0 ? voxel / leaf : 1.0;
+    const int stride = std::max(1, int(std::lround(ratio * ratio)));
+    return std::max(1, std::min(stride, int(points / 100)));
+  }
+
+  /** \brief point to line features of every stride-th corner point against the nearest linear voxel of a pyramid level
+   * \param[in] level: pyramid level, its corner centroids carry the line direction
+   * \param[in] stride: subsampling of the scan
+   */
+  void processPointToLineCoarse(std::vector<ceres::CostFunction *> &edges,
+                                std::vector<FeatureLine> &vLineFeatures,
+                                const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                                const MapPyramid::Level &level,
+                                int stride,
+                                const Eigen::Matrix4d &exTlb,
+                                const Eigen::Matrix4d &m4d);
+
+  /** \brief point to plane features of every stride-th surf point against the nearest planar voxel of a pyramid level
+   * \param[in] level: pyramid level, its surf centroids carry the plane normal
+   * \param[in] stride: subsampling of the scan
+   */
+  void processPointToPlanVecCoarse(std::vector<ceres::CostFunction *> &edges,
+                                   std::vector<FeaturePlanVec> &vPlanFeatures,
+                                   const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                                   const MapPyramid::Level &level,
+                                   int stride,
+                                   const Eigen::Matrix4d &exTlb,
+                                   const Eigen::Matrix4d &m4d);
+
+  /** \brief point to distribution features of the corner and surf points, each matched to the closest
+   *  distribution of its voxel and the face neighbours, no tree is searched
+   * \param[in] laserCloudCorner: corner points, matched to the corner distributions
+   * \param[in] laserCloudSurf: surf points, matched to the surf distributions
+   */
+  void processPointToNdt(std::vector<ceres::CostFunction *> &edges,
+                         std::vector<FeaturePlanVec> &vPlanFeatures,
+                         const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                         const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                         const Eigen::Matrix4d &exTlb,
+                         const Eigen::Matrix4d &m4d);
+
+  void MapIncrementLocal(LidarFrame &kframe);
+
+  bool ICPScanMatchGlobal(LidarWindow &kframeList);
+
+  Eigen::Matrix4d toMatrix(PointTypePose &p);
+
+  CLOUD_PTR TransformPointCloud(CLOUD_PTR cloudIn, PointTypePose *transformIn);
+
+  bool extractSurroundKeyFrames(const PointType &p);
+
+  bool loadmap();
+
+  void saveTrajectoryTUMformat(std::fstream &fout, std::string &stamp, Eigen::Vector3d &xyz, Eigen::Quaterniond &xyzw)
+  {
+    fout << stamp << " " << xyz[0] << " " << xyz[1] << " " << xyz[2] << " " << xyzw.x() << " " << xyzw.y() << " " << xyzw.z() << " " << xyzw.w() << std::endl;
+  }
+
+  void saveTrajectoryTUMformat(std::fstream &fout, std::string &stamp, double x, double y, double z, double qx, double qy, double qz, double qw)
+  {
+    fout << stamp << " " << x << " " << y << " " << z << " " << qx << " " << qy << " " << qz << " " << qw << std::endl;
+  }
+};
+
+#endif // LIO_LOCALIZATION_MAP_LOCATION_H
@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+/** \brief heap allocation counters to check that the steady state frame loop does not allocate.
+ *  Build with -DCOUNT_ALLOCATIONS=ON: src/utils/AllocCounter.cpp is linked into the executables
+ *  and interposes malloc, calloc, realloc and the aligned variants, so operator new, the Eigen
+ *  aligned allocator of the pcl clouds and third party code are all counted. Without it the
+ *  counters are always 0.
+ */
+namespace alloc_counter
+{
+#ifdef LIO_COUNT_ALLOCATIONS
+    /** \brief allocations of the calling thread since it started */
+    uint64_t ThreadAllocations();
+
+    /** \brief allocations of all threads since the process started */
+    uint64_t TotalAllocations();
+
+    inline bool Enabled()
+    {
+        return true;
+    }
+#else
+    inline uint64_t ThreadAllocations()
+    {
+        return 0;
+    }
+
+    inline uint64_t TotalAllocations()
+    {
+        return 0;
+    }
+
+    inline bool Enabled()
+    {
+        return false;
+    }
+#endif
+
+    /** \brief allocations of one frame, the calling thread and the whole process */
+    class FrameAllocations
+    {
+    public:
+        FrameAllocations() : thread_start(ThreadAllocations()), total_start(TotalAllocations()) {}
+
+        /** \brief allocations of the calling thread since construction */
+        uint64_t Thread() const
+        {
+            return ThreadAllocations() - thread_start;
+        }
+
+        /** \brief allocations of all threads since construction, worker threads included */
+        uint64_t Total() const
+        {
+            return TotalAllocations() - total_start;
+        }
+
+    private:
+        uint64_t thread_start;
+        uint64_t total_start;
+    };
+} // namespace alloc_counter
+
+#endif // ALLOC_COUNTER_H
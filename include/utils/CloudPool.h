@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef CLOUD_POOL_H
+#define CLOUD_POOL_H
+
+#include <mutex>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+
+/** \brief recycles the per frame point clouds together with their capacity.
+ *  The pool keeps a reference to every cloud it handed out. Once all other references are
+ *  dropped (the frame left the sliding window, the queue, the kd-tree...) the cloud is cleared
+ *  and handed out again, so after the first frames Acquire() and the points filled in
+ *  afterwards no longer touch the heap. Clouds still referenced are never reused; beyond
+ *  maxClouds live clouds Acquire() falls back to plain new. Thread safe.
+ */
+template <typename PointT>
+class CloudPool
+{
+public:
+    typedef pcl::PointCloud<PointT> Cloud;
+    typedef typename Cloud::Ptr Ptr;
+
+    /** \brief constructor of CloudPool
+     * \param[in] maxClouds: clouds kept for reuse
+     * \param[in] reservePoints: capacity of a newly allocated cloud
+     */
+    explicit CloudPool(size_t maxClouds = 16, size_t reservePoints = 0)
+        : maxClouds(maxClouds), reservePoints(reservePoints)
+    {
+        clouds.reserve(maxClouds);
+    }
+
+    /** \brief an empty cloud, reusing the buffer of a pooled cloud nobody else holds any more */
+    Ptr Acquire()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto &cloud : clouds)
+        {
+            // only the pool holds it and only the pool can hand it out again
+            if (cloud.use_count() == 1)
+            {
+                cloud->clear();
+                cloud->header = pcl::PCLHeader();
+                cloud->is_dense = true;
+                return cloud;
+            }
+        }
+        Ptr cloud(new Cloud());
+        cloud->reserve(reservePoints);
+        if (clouds.size() < maxClouds)
+            clouds.push_back(cloud);
+        return cloud;
+    }
+
+    /** \brief clouds currently owned by the pool, in use or free */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return clouds.size();
+    }
+
+private:
+    const size_t maxClouds;
+    const size_t reservePoints;
+    mutable std::mutex mutex;
+    std::vector<Ptr> clouds;
+};
+
+#endif // CLOUD_POOL_H
@@ -0,0 +1,162 @@
+#pragma once
+
+#ifndef PARAM_FILE_H
+#define PARAM_FILE_H
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/** \brief ros free reader of the flat two level config/params.yaml,
+ *  keys are looked up as "section/key" just like on the parameter server.
+ *  Only scalars and single level lists of numbers are understood.
+ */
+class ParamFile
+{
+public:
+    bool load(const std::string &path)
+    {
+        std::ifstream fin(path);
+        if (!fin.is_open())
+            return false;
+
+        std::string line, section, pendingKey, pendingValue;
+        while (std::getline(fin, line))
+        {
+            line = stripComment(line);
+            if (!pendingKey.empty())
+            {
+                // a list continued over several lines
+                pendingValue += " " + trim(line);
+                if (pendingValue.find(']') != std::string::npos)
+                {
+                    values[pendingKey] = pendingValue;
+                    pendingKey.clear();
+                }
+                continue;
+            }
+            if (trim(line).empty())
+                continue;
+
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+                continue;
+            std::string key = trim(line.substr(0, colon));
+            std::string value = trim(line.substr(colon + 1));
+            bool indented = line[0] == ' ' || line[0] == '\t';
+            if (!indented)
+            {
+                section = key;
+                if (value.empty())
+                    continue;
+            }
+            std::string fullKey = indented ? section + "/" + key : key;
+            if (!value.empty() && value[0] == '[' && value.find(']') == std::string::npos)
+            {
+                pendingKey = fullKey;
+                pendingValue = value;
+                continue;
+            }
+            values[fullKey] = value;
+        }
+        return true;
+    }
+
+    bool has(const std::string &key) const
+    {
+        return values.count(key) > 0;
+    }
+
+    /** \brief same contract as ros::NodeHandle::param, value is set to def if the key is missing or malformed */
+    template <typename T>
+    bool param(const std::string &key, T &value, const T &def) const
+    {
+        auto it = values.find(key);
+        if (it == values.end() || !parse(it->second, value))
+        {
+            value = def;
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief override or add one value, e.g. from the command line */
+    void set(const std::string &key, const std::string &value)
+    {
+        values[key] = value;
+    }
+
+private:
+    static std::string trim(const std::string &s)
+    {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos)
+            return "";
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+
+    static std::string stripComment(const std::string &s)
+    {
+        bool quoted = false;
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            if (s[i] == '"')
+                quoted = !quoted;
+            else if (s[i] == '#' && !quoted)
+                return s.substr(0, i);
+        }
+        return s;
+    }
+
+    static bool parse(const std::string &s, std::string &value)
+    {
+        value = s;
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+            value = value.substr(1, value.size() - 2);
+        return true;
+    }
+
+    static bool parse(const std::string &s, bool &value)
+    {
+        if (s == "true" || s == "True")
+            value = true;
+        else if (s == "false" || s == "False")
+            value = false;
+        else
+            return false;
+        return true;
+    }
+
+    template <typename T>
+    static bool parse(const std::string &s, T &value)
+    {
+        std::istringstream iss(s);
+        iss >> value;
+        return !iss.fail();
+    }
+
+    template <typename T>
+    static bool parse(const std::string &s, std::vector<T> &value)
+    {
+        size_t b = s.find('['), e = s.rfind(']');
+        if (b == std::string::npos || e == std::string::npos || e < b)
+            return false;
+        std::string body = s.substr(b + 1, e - b - 1);
+        for (auto &c : body)
+            if (c == ',')
+                c = ' ';
+        value.clear();
+        std::istringstream iss(body);
+        T v;
+        while (iss >> v)
+            value.push_back(v);
+        return true;
+    }
+
+    std::map<std::string, std::string> values;
+};
+
+#endif // PARAM_FILE_H
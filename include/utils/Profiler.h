@@ -0,0 +1,262 @@
+#pragma once
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/Tracer.h"
+
+/** \brief named scoped latency spans of the per frame pipeline.
+ *  Every thread records into its own histograms with relaxed atomics, the registry lock is
+ *  only taken when a thread records its first span. Build with -DLIO_DISABLE_PROFILING
+ *  (cmake -DENABLE_PROFILING=OFF) to compile the spans out. When tracing is enabled the
+ *  spans also show up on the timeline of utils/Tracer.h.
+ */
+namespace profiler
+{
+    enum Stage
+    {
+        Ingest = 0,
+        Deskew,
+        FeatureSplit,
+        Downsample,
+        KdBuild,
+        Association,
+        Solve,
+        Marginalization,
+        MapUpdate,
+        Publish,
+        NumStages
+    };
+
+    inline const char *StageName(int stage)
+    {
+        static const char *names[NumStages] = {"ingest", "deskew", "feature_split", "downsample", "kd_build",
+                                               "association", "solve", "marginalization", "map_update", "publish"};
+        return stage >= 0 && stage < NumStages ? names[stage] : "unknown";
+    }
+
+    // 4 buckets per octave starting at 1us, the last bucket collects everything above ~1.2h
+    static const int kBucketsPerOctave = 4;
+    static const int kNumBuckets = 4 * 32 + 2;
+
+    inline int BucketIndex(int64_t ns)
+    {
+        double us = ns * 1e-3;
+        if (us < 1.0)
+            return 0;
+        int idx = 1 + static_cast<int>(kBucketsPerOctave * std::log2(us));
+        return idx < kNumBuckets ? idx : kNumBuckets - 1;
+    }
+
+    /** \brief upper edge of a bucket in ms */
+    inline double BucketUpperMs(int idx)
+    {
+        return std::pow(2.0, static_cast<double>(idx) / kBucketsPerOctave) * 1e-3;
+    }
+
+    struct ThreadHistograms
+    {
+        std::atomic<uint64_t> counts[NumStages][kNumBuckets];
+        std::atomic<uint64_t> sum_ns[NumStages];
+        std::atomic<bool> in_use;
+
+        ThreadHistograms()
+        {
+            for (int s = 0; s < NumStages; ++s)
+            {
+                for (int b = 0; b < kNumBuckets; ++b)
+                    counts[s][b].store(0, std::memory_order_relaxed);
+                sum_ns[s].store(0, std::memory_order_relaxed);
+            }
+            in_use.store(true, std::memory_order_relaxed);
+        }
+
+        void Record(int stage, int64_t ns)
+        {
+            counts[stage][BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+            sum_ns[stage].fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+        }
+    };
+
+    /** \brief owns the histograms of all threads, slots of finished threads are handed to new ones
+     *  so the short lived association threads do not grow the registry
+     */
+    class Registry
+    {
+    public:
+        ThreadHistograms *Acquire()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto &h : slots)
+            {
+                bool expected = false;
+                if (h->in_use.compare_exchange_strong(expected, true))
+                    return h.get();
+            }
+            slots.emplace_back(new ThreadHistograms());
+            return slots.back().get();
+        }
+
+        /** \brief sum of all threads, counts of released slots are kept */
+        void Merge(std::vector<uint64_t> &counts, std::vector<uint64_t> &sum_ns)
+        {
+            counts.assign(NumStages * kNumBuckets, 0);
+            sum_ns.assign(NumStages, 0);
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto &h : slots)
+            {
+                for (int s = 0; s < NumStages; ++s)
+                {
+                    for (int b = 0; b < kNumBuckets; ++b)
+                        counts[s * kNumBuckets + b] += h->counts[s][b].load(std::memory_order_relaxed);
+                    sum_ns[s] += h->sum_ns[s].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        std::mutex mtx;
+        std::vector<std::unique_ptr<ThreadHistograms>> slots;
+    };
+
+    inline Registry &GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    struct ThreadSlot
+    {
+        ThreadHistograms *hist;
+        ThreadSlot() : hist(GetRegistry().Acquire()) {}
+        ~ThreadSlot() { hist->in_use.store(false, std::memory_order_release); }
+    };
+
+    inline ThreadHistograms &LocalHistograms()
+    {
+        static thread_local ThreadSlot slot;
+        return *slot.hist;
+    }
+
+    class ScopedSpan
+    {
+    public:
+        explicit ScopedSpan(Stage stage) : stage(stage), start(std::chrono::steady_clock::now()), event(StageName(stage), "stage") {}
+
+        ~ScopedSpan()
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            LocalHistograms().Record(stage, ns);
+        }
+
+    private:
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+        tracer::ScopedEvent event;
+    };
+
+    struct StageSummary
+    {
+        std::string name;
+        uint64_t count;
+        double mean_ms, p50_ms, p95_ms, p99_ms;
+    };
+
+    /** \brief latency percentiles per stage over the spans recorded since the previous Collect() */
+    class Reporter
+    {
+    public:
+        std::vector<StageSummary> Collect()
+        {
+            std::vector<uint64_t> counts, sum_ns;
+            GetRegistry().Merge(counts, sum_ns);
+            if (last_counts.empty())
+            {
+                last_counts.assign(counts.size(), 0);
+                last_sum_ns.assign(sum_ns.size(), 0);
+            }
+
+            std::vector<StageSummary> summaries;
+            for (int s = 0; s < NumStages; ++s)
+            {
+                uint64_t total = 0;
+                for (int b = 0; b < kNumBuckets; ++b)
+                    total += counts[s * kNumBuckets + b] - last_counts[s * kNumBuckets + b];
+                if (total == 0)
+                    continue;
+
+                StageSummary summary;
+                summary.name = StageName(s);
+                summary.count = total;
+                summary.mean_ms = (sum_ns[s] - last_sum_ns[s]) * 1e-6 / total;
+                summary.p50_ms = Percentile(counts, s, total, 0.50);
+                summary.p95_ms = Percentile(counts, s, total, 0.95);
+                summary.p99_ms = Percentile(counts, s, total, 0.99);
+                summaries.push_back(summary);
+            }
+            last_counts.swap(counts);
+            last_sum_ns.swap(sum_ns);
+            return summaries;
+        }
+
+    private:
+        double Percentile(const std::vector<uint64_t> &counts, int s, uint64_t total, double q) const
+        {
+            uint64_t rank = static_cast<uint64_t>(std::ceil(q * total)), acc = 0;
+            for (int b = 0; b < kNumBuckets; ++b)
+            {
+                acc += counts[s * kNumBuckets + b] - last_counts[s * kNumBuckets + b];
+                if (acc >= rank)
+                    return BucketUpperMs(b);
+            }
+            return BucketUpperMs(kNumBuckets - 1);
+        }
+
+        std::vector<uint64_t> last_counts, last_sum_ns;
+    };
+
+    /** \brief append one report to a csv file, the header is written when the file is new */
+    inline void AppendCsv(const std::string &path, double stamp, const std::vector<StageSummary> &summaries)
+    {
+        bool exists = std::ifstream(path).good();
+        std::ofstream fout(path, std::ios::app);
+        if (!fout.is_open())
+            return;
+        if (!exists)
+            fout << "stamp,stage,count,mean_ms,p50_ms,p95_ms,p99_ms\n";
+        fout.setf(std::ios::fixed);
+        for (const auto &s : summaries)
+        {
+            fout.precision(6);
+            fout << stamp << "," << s.name << "," << s.count << ",";
+            fout.precision(4);
+            fout << s.mean_ms << "," << s.p50_ms << "," << s.p95_ms << "," << s.p99_ms << "\n";
+        }
+    }
+} // namespace profiler
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#ifdef LIO_DISABLE_PROFILING
+#define PROFILE_SPAN(stage)
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+#else
+#define PROFILE_SPAN(stage) profiler::ScopedSpan PROFILER_CONCAT(profile_span_, __LINE__)(profiler::stage)
+// timeline only, e.g. waiting for a lock
+#define TRACE_SCOPE(name) tracer::ScopedEvent PROFILER_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) tracer::SetThreadName(name)
+#endif
+
+#endif // PROFILER_H
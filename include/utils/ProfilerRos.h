@@ -0,0 +1,116 @@
+#pragma once
+
+#ifndef PROFILER_ROS_H
+#define PROFILER_ROS_H
+
+#include "utils/Profiler.h"
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <ros/ros.h>
+#include <std_srvs/Trigger.h>
+
+/** \brief periodically publishes the profiler percentiles on /diagnostics and appends them to a csv.
+ *  Reads profiling/report_period (s, <= 0 disables the report) and profiling/csv (empty disables the csv).
+ */
+class ProfilerPublisher
+{
+public:
+    ProfilerPublisher(ros::NodeHandle &nh, const std::string &name, const std::string &default_csv)
+        : name(name)
+    {
+        double period;
+        nh.param<double>("profiling/report_period", period, 5.0);
+        nh.param<std::string>("profiling/csv", csv, default_csv);
+#ifdef LIO_DISABLE_PROFILING
+        period = 0;
+#endif
+        if (period <= 0)
+            return;
+        pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+        timer = nh.createWallTimer(ros::WallDuration(period), &ProfilerPublisher::Report, this);
+    }
+
+private:
+    void Report(const ros::WallTimerEvent &)
+    {
+        std::vector<profiler::StageSummary> summaries = reporter.Collect();
+        if (summaries.empty())
+            return;
+
+        diagnostic_msgs::DiagnosticArray msg;
+        msg.header.stamp = ros::Time::now();
+        for (const auto &s : summaries)
+        {
+            diagnostic_msgs::DiagnosticStatus status;
+            status.level = diagnostic_msgs::DiagnosticStatus::OK;
+            status.name = name + ": " + s.name;
+            status.hardware_id = name;
+            status.message = "latency";
+            status.values.resize(5);
+            status.values[0].key = "count";
+            status.values[0].value = std::to_string(s.count);
+            status.values[1].key = "mean_ms";
+            status.values[1].value = std::to_string(s.mean_ms);
+            status.values[2].key = "p50_ms";
+            status.values[2].value = std::to_string(s.p50_ms);
+            status.values[3].key = "p95_ms";
+            status.values[3].value = std::to_string(s.p95_ms);
+            status.values[4].key = "p99_ms";
+            status.values[4].value = std::to_string(s.p99_ms);
+            msg.status.push_back(status);
+        }
+        pub.publish(msg);
+
+        if (!csv.empty())
+            profiler::AppendCsv(csv, ros::WallTime::now().toSec(), summaries);
+    }
+
+    std::string name, csv;
+    profiler::Reporter reporter;
+    ros::Publisher pub;
+    ros::WallTimer timer;
+};
+
+/** \brief enables the timeline tracer when tracing/enable is set, dumps it on the ~dump_trace
+ *  service and once more when destroyed at shutdown. tracing/buffer_events bounds the memory,
+ *  about 48 bytes per event.
+ */
+class TraceDumper
+{
+public:
+    TraceDumper(ros::NodeHandle &nh, const std::string &default_output)
+    {
+        bool enable;
+        int capacity;
+        nh.param<bool>("tracing/enable", enable, false);
+        nh.param<int>("tracing/buffer_events", capacity, 1 << 18);
+        nh.param<std::string>("tracing/output", output, default_output);
+#ifdef LIO_DISABLE_PROFILING
+        enable = false;
+#endif
+        if (!enable || capacity <= 0)
+            return;
+        tracer::GetTracer().Enable(capacity);
+        ros::NodeHandle pnh("~");
+        srv = pnh.advertiseService("dump_trace", &TraceDumper::DumpCB, this);
+        ROS_INFO("tracing %d events, call %s to write %s", capacity, srv.getService().c_str(), output.c_str());
+    }
+
+    ~TraceDumper()
+    {
+        if (tracer::GetTracer().Enabled())
+            tracer::GetTracer().Dump(output);
+    }
+
+private:
+    bool DumpCB(std_srvs::Trigger::Request &, std_srvs::Trigger::Response &res)
+    {
+        res.success = tracer::GetTracer().Dump(output);
+        res.message = output;
+        return true;
+    }
+
+    std::string output;
+    ros::ServiceServer srv;
+};
+
+#endif // PROFILER_ROS_H
@@ -0,0 +1,211 @@
+#pragma once
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** \brief optional timeline of the pipeline threads, dumped as chrome trace json
+ *  (chrome://tracing or ui.perfetto.dev). Disabled until Enable() is called, then every
+ *  span is written as one complete event into a preallocated ring buffer, the oldest events
+ *  are overwritten. Event names must outlive the tracer, i.e. string literals.
+ */
+namespace tracer
+{
+    /** \brief one complete event, a seqlock: seq is 0 while the fields are written and index + 1
+     *  once they are complete, a reader keeps the fields only if seq did not change while it copied them
+     */
+    struct Event
+    {
+        std::atomic<const char *> name;
+        std::atomic<const char *> cat;
+        std::atomic<int64_t> ts_us;
+        std::atomic<int64_t> dur_us;
+        std::atomic<uint32_t> tid;
+        std::atomic<uint64_t> seq;
+    };
+
+    class Tracer
+    {
+    public:
+        Tracer() : epoch(std::chrono::steady_clock::now()) {}
+
+        /** \brief allocate the ring buffer and start recording, not thread safe against Record() */
+        void Enable(size_t capacity)
+        {
+            if (enabled.load(std::memory_order_relaxed) || capacity == 0)
+                return;
+            events.reset(new Event[capacity]);
+            for (size_t i = 0; i < capacity; ++i)
+                events[i].seq.store(0, std::memory_order_relaxed);
+            size = capacity;
+            head.store(0, std::memory_order_relaxed);
+            enabled.store(true, std::memory_order_release);
+        }
+
+        bool Enabled() const
+        {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        int64_t NowUs() const
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        void Record(const char *name, const char *cat, int64_t begin_us, int64_t end_us, uint32_t tid)
+        {
+            uint64_t idx = head.fetch_add(1, std::memory_order_relaxed);
+            Event &e = events[idx % size];
+            e.seq.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            e.name.store(name, std::memory_order_relaxed);
+            e.cat.store(cat, std::memory_order_relaxed);
+            e.ts_us.store(begin_us, std::memory_order_relaxed);
+            e.dur_us.store(end_us - begin_us, std::memory_order_relaxed);
+            e.tid.store(tid, std::memory_order_relaxed);
+            e.seq.store(idx + 1, std::memory_order_release);
+        }
+
+        /** \brief small thread ids, ids of finished threads are handed to new ones so the
+         *  per iteration association threads show up as a few lanes instead of thousands
+         */
+        uint32_t AcquireTid()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!free_tids.empty())
+            {
+                uint32_t tid = free_tids.back();
+                free_tids.pop_back();
+                return tid;
+            }
+            return next_tid++;
+        }
+
+        void ReleaseTid(uint32_t tid)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            free_tids.push_back(tid);
+        }
+
+        void SetThreadName(uint32_t tid, const std::string &name)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            thread_names[tid] = name;
+        }
+
+        /** \brief write the buffered events as chrome trace json, can be called while recording,
+         *  events overwritten while they are read are left out
+         */
+        bool Dump(const std::string &path)
+        {
+            std::ofstream fout(path);
+            if (!fout.is_open() || !Enabled())
+                return false;
+
+            fout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            bool first = true;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (const auto &it : thread_names)
+                {
+                    fout << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << it.first
+                         << ",\"args\":{\"name\":\"" << it.second << "\"}}";
+                    first = false;
+                }
+            }
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = end > size ? end - size : 0;
+            for (uint64_t idx = begin; idx < end; ++idx)
+            {
+                const Event &e = events[idx % size];
+                if (e.seq.load(std::memory_order_acquire) != idx + 1)
+                    continue; // still being written or already overwritten
+                const char *name = e.name.load(std::memory_order_relaxed);
+                const char *cat = e.cat.load(std::memory_order_relaxed);
+                const int64_t ts_us = e.ts_us.load(std::memory_order_relaxed);
+                const int64_t dur_us = e.dur_us.load(std::memory_order_relaxed);
+                const uint32_t tid = e.tid.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (e.seq.load(std::memory_order_relaxed) != idx + 1)
+                    continue; // overwritten while copied
+                fout << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":\"" << name << "\",\"cat\":\"" << cat
+                     << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << ts_us << ",\"dur\":" << dur_us << "}";
+                first = false;
+            }
+            fout << "\n]}\n";
+            return true;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point epoch;
+        std::atomic<bool> enabled{false};
+        std::unique_ptr<Event[]> events;
+        size_t size = 0;
+        std::atomic<uint64_t> head{0};
+
+        std::mutex mtx;
+        uint32_t next_tid = 1;
+        std::vector<uint32_t> free_tids;
+        std::map<uint32_t, std::string> thread_names;
+    };
+
+    inline Tracer &GetTracer()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    struct ThreadId
+    {
+        uint32_t tid;
+        ThreadId() : tid(GetTracer().AcquireTid()) {}
+        ~ThreadId() { GetTracer().ReleaseTid(tid); }
+    };
+
+    inline uint32_t CurrentTid()
+    {
+        static thread_local ThreadId id;
+        return id.tid;
+    }
+
+    /** \brief name the lane of the calling thread in the trace, nothing while tracing is disabled,
+     *  the association threads of every frame call it
+     */
+    inline void SetThreadName(const std::string &name)
+    {
+        if (!GetTracer().Enabled())
+            return;
+        GetTracer().SetThreadName(CurrentTid(), name);
+    }
+
+    class ScopedEvent
+    {
+    public:
+        ScopedEvent(const char *name, const char *cat = "pipeline")
+            : name(name), cat(cat), begin_us(GetTracer().Enabled() ? GetTracer().NowUs() : -1) {}
+
+        ~ScopedEvent()
+        {
+            if (begin_us < 0)
+                return;
+            Tracer &t = GetTracer();
+            t.Record(name, cat, begin_us, t.NowUs(), CurrentTid());
+        }
+
+    private:
+        const char *name;
+        const char *cat;
+        int64_t begin_us;
+    };
+} // namespace tracer
+
+#endif // TRACER_H
@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef VOXEL_HASH_H
+#define VOXEL_HASH_H
+
+#include <Eigen/Core>
+#include <cmath>
+#include <cstdint>
+
+/** \brief voxel hashing shared by the maps and filters: a 64 bit key per voxel and the moments
+ *  of the points falling into it.
+ *  A key holds the three voxel indices in 20 bit each, offset by half their range so that
+ *  indices from -2^19 to 2^19 - 1 map one to one (about 100 km either way at 0.2 m voxels),
+ *  farther indices wrap around. The top 4 bits are free for a tag, e.g. the feature class.
+ *  The layout is stored in NdtMap.bin, changing it invalidates the cached distributions.
+ */
+namespace voxel_hash
+{
+    static const int kKeyBits = 20;
+    static const uint64_t kKeyMask = (uint64_t(1) << kKeyBits) - 1;
+    static const int64_t kKeyHalf = int64_t(1) << (kKeyBits - 1);
+
+    /** \brief key of the voxel with indices (x, y, z)
+     * \param[in] tag: 4 bit tag kept in the top bits
+     */
+    inline uint64_t Key(int64_t x, int64_t y, int64_t z, uint64_t tag = 0)
+    {
+        return (uint64_t(x + kKeyHalf) & kKeyMask) | ((uint64_t(y + kKeyHalf) & kKeyMask) << kKeyBits) |
+               ((uint64_t(z + kKeyHalf) & kKeyMask) << (2 * kKeyBits)) | (tag << (3 * kKeyBits));
+    }
+
+    /** \brief key of the voxel holding (x, y, z), the voxels being 1 / inv wide
+     *  The product is taken in Scalar, float callers keep float voxel bounds.
+     */
+    template <typename Scalar>
+    inline uint64_t KeyOf(Scalar x, Scalar y, Scalar z, Scalar inv, uint64_t tag = 0)
+    {
+        return Key(int64_t(std::floor(x * inv)), int64_t(std::floor(y * inv)), int64_t(std::floor(z * inv)), tag);
+    }
+
+    /** \brief voxel index of key along axis 0, 1 or 2 */
+    inline int64_t Index(uint64_t key, int axis)
+    {
+        return int64_t((key >> (axis * kKeyBits)) & kKeyMask) - kKeyHalf;
+    }
+
+    /** \brief tag of key */
+    inline int Tag(uint64_t key)
+    {
+        return int(key >> (3 * kKeyBits));
+    }
+
+    /** \brief count, sum and sum of outer products of the points of a voxel.
+     *  Accumulate coordinates relative to a nearby origin, far from it the covariance cancels out.
+     */
+    struct Moments
+    {
+        int count = 0;
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        Eigen::Matrix3d sumSq = Eigen::Matrix3d::Zero();
+
+        void Add(const Eigen::Vector3d &v)
+        {
+            count++;
+            sum += v;
+            sumSq += v * v.transpose();
+        }
+
+        Eigen::Vector3d Mean() const
+        {
+            return sum / count;
+        }
+
+        /** \brief covariance around the mean, normalized by count */
+        Eigen::Matrix3d Covariance() const
+        {
+            const Eigen::Vector3d mean = Mean();
+            return sumSq / count - mean * mean.transpose();
+        }
+    };
+} // namespace voxel_hash
+
+#endif // VOXEL_HASH_H
@@ -1,19 +1,12 @@
 #include "Estimator/Estimator.h"
 
-Estimator::Estimator(const float &filter_corner, const float &filter_surf)
+Estimator::Estimator(const float &filter_corner, const float &filter_surf,
+                     const double &assoc_trans, const double &assoc_rot)
+    : assoc_trans_thres(assoc_trans), assoc_rot_thres(assoc_rot), filterCorner(filter_corner), filterSurf(filter_surf)
 {
   laserCloudCornerFromLocal.reset(new pcl::PointCloud<PointType>);
   laserCloudSurfFromLocal.reset(new pcl::PointCloud<PointType>);
   laserCloudNonFeatureFromLocal.reset(new pcl::PointCloud<PointType>);
-  laserCloudCornerLast.resize(SLIDEWINDOWSIZE);
-  for (auto &p : laserCloudCornerLast)
-    p.reset(new pcl::PointCloud<PointType>);
-  laserCloudSurfLast.resize(SLIDEWINDOWSIZE);
-  for (auto &p : laserCloudSurfLast)
-    p.reset(new pcl::PointCloud<PointType>);
-  laserCloudNonFeatureLast.resize(SLIDEWINDOWSIZE);
-  for (auto &p : laserCloudNonFeatureLast)
-    p.reset(new pcl::PointCloud<PointType>);
   laserCloudCornerStack.resize(SLIDEWINDOWSIZE);
   for (auto &p : laserCloudCornerStack)
     p.reset(new pcl::PointCloud<PointType>);
@@ -27,9 +20,9 @@ Estimator::Estimator(const float &filter_corner, const float &filter_surf)
   laserCloudSurfForMap.reset(new pcl::PointCloud<PointType>);
   laserCloudNonFeatureForMap.reset(new pcl::PointCloud<PointType>);
   transformForMap.setIdentity();
-  kdtreeCornerFromLocal.reset(new pcl::KdTreeFLANN<PointType>);
-  kdtreeSurfFromLocal.reset(new pcl::KdTreeFLANN<PointType>);
-  kdtreeNonFeatureFromLocal.reset(new pcl::KdTreeFLANN<PointType>);
+  kdtreeCornerFromLocal.reset(new StaticKdTree<PointType>);
+  kdtreeSurfFromLocal.reset(new StaticKdTree<PointType>);
+  kdtreeNonFeatureFromLocal.reset(new StaticKdTree<PointType>);
 
   for (int i = 0; i < localMapWindowSize; i++)
   {
@@ -41,6 +34,9 @@ Estimator::Estimator(const float &filter_corner, const float &filter_surf)
   downSizeFilterCorner.setLeafSize(filter_corner, filter_corner, filter_corner);
   downSizeFilterSurf.setLeafSize(filter_surf, filter_surf, filter_surf);
   downSizeFilterNonFeature.setLeafSize(0.4, 0.4, 0.4);
+  downSizeFilterFrame.setLabelLeafSize(LabelledPoint::Corner, filter_corner);
+  downSizeFilterFrame.setLabelLeafSize(LabelledPoint::Surf, filter_surf);
+  downSizeFilterFrame.setLabelLeafSize(LabelledPoint::NonFeature, 0.4);
   map_manager = new MAP_MANAGER(filter_corner, filter_surf);
   threadMap = std::thread(&Estimator::threadMapIncrement, this);
 }
@@ -52,20 +48,16 @@ Estimator::~Estimator()
 
 [[noreturn]] void Estimator::threadMapIncrement()
 {
+  TRACE_THREAD_NAME("Estimator::threadMapIncrement");
   pcl::PointCloud<PointType>::Ptr laserCloudCorner(new pcl::PointCloud<PointType>);
   pcl::PointCloud<PointType>::Ptr laserCloudSurf(new pcl::PointCloud<PointType>);
   pcl::PointCloud<PointType>::Ptr laserCloudNonFeature(new pcl::PointCloud<PointType>);
-  pcl::PointCloud<PointType>::Ptr laserCloudCorner_to_map(new pcl::PointCloud<PointType>);
-  pcl::PointCloud<PointType>::Ptr laserCloudSurf_to_map(new pcl::PointCloud<PointType>);
-  pcl::PointCloud<PointType>::Ptr laserCloudNonFeature_to_map(new pcl::PointCloud<PointType>);
   Eigen::Matrix4d transform;
   while (true)
   {
     std::unique_lock<std::mutex> locker(mtx_Map);
     if (!laserCloudCornerForMap->empty())
     {
-
-      map_update_ID++;
       //  cornerForMap数据存入corner
       map_manager->featureAssociateToMap(laserCloudCornerForMap,
                                          laserCloudSurfForMap,
@@ -80,25 +72,24 @@ Estimator::~Estimator()
       transform = transformForMap;
       locker.unlock();
 
-      *laserCloudCorner_to_map += *laserCloudCorner;
-      *laserCloudSurf_to_map += *laserCloudSurf;
-      *laserCloudNonFeature_to_map += *laserCloudNonFeature;
+      // only keyframes reach the map, and only their points in voxels that are not full yet
+      if (keyframeGate.Accept(transform, *laserCloudCorner, *laserCloudSurf))
+      {
+        PROFILE_SPAN(MapUpdate);
+        keyframeGate.Admit(*laserCloudCorner, 0);
+        keyframeGate.Admit(*laserCloudSurf, 1);
+        keyframeGate.Admit(*laserCloudNonFeature, 2);
+        map_manager->MapIncrement(laserCloudCorner,
+                                  laserCloudSurf,
+                                  laserCloudNonFeature,
+                                  transform);
+        ROS_DEBUG("map keyframes: %zu of %zu frames, %zu points dropped by the voxel caps",
+                  keyframeGate.Keyframes(), keyframeGate.Frames(), keyframeGate.DroppedPoints());
+      }
 
       laserCloudCorner->clear();
       laserCloudSurf->clear();
       laserCloudNonFeature->clear();
-
-      if (map_update_ID % map_skip_frame == 0)
-      {
-        map_manager->MapIncrement(laserCloudCorner_to_map,
-                                  laserCloudSurf_to_map,
-                                  laserCloudNonFeature_to_map,
-                                  transform);
-
-        laserCloudCorner_to_map->clear();
-        laserCloudSurf_to_map->clear();
-        laserCloudNonFeature_to_map->clear();
-      }
     }
     else
       locker.unlock();
@@ -112,32 +103,21 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
                                    std::vector<FeatureLine> &vLineFeatures,
                                    const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
                                    const pcl::PointCloud<PointType>::Ptr &laserCloudCornerLocal,
-                                   const pcl::KdTreeFLANN<PointType>::Ptr &kdtreeLocal,
+                                   const StaticKdTree<PointType>::Ptr &kdtreeLocal,
+                                   AssociationCache<FeatureLine> &cache,
                                    const Eigen::Matrix4d &exTlb,
                                    const Eigen::Matrix4d &m4d)
 {
-
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
   Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
   Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
   Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
-  if (!vLineFeatures.empty())
-  {
-    for (const auto &l : vLineFeatures)
-    {
-      auto *e = Cost_NavState_IMU_Line::Create(l.pointOri,
-                                               l.lineP1,
-                                               l.lineP2,
-                                               Tbl,
-                                               Eigen::Matrix<double, 1, 1>(1 / IMUIntegrator::lidar_m));
-      edges.push_back(e);
-    }
-    return;
-  }
+  vLineFeatures.clear();
+  cache.Begin(m4d, laserCloudCorner->points.size());
   PointType _pointOri, _pointSel, _coeff;
-  std::vector<int> _pointSearchInd;
-  std::vector<float> _pointSearchSqDis;
-  std::vector<int> _pointSearchInd2;
-  std::vector<float> _pointSearchSqDis2;
+  KnnResult<5> _knn;
+  KnnResult<5> _knn2;
 
   Eigen::Matrix<double, 3, 3> _matA1;
   _matA1.setZero();
@@ -152,6 +132,18 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
   {
     _pointOri = laserCloudCorner->points[i];
     MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    Eigen::Vector3d _pointSelVec(_pointSel.x, _pointSel.y, _pointSel.z);
+    size_t _featureBegin = vLineFeatures.size();
+    if (cache.Lookup(i, _pointSelVec, thres_dist, vLineFeatures))
+    {
+      for (size_t k = _featureBegin; k < vLineFeatures.size(); k++)
+        edges.push_back(Cost_NavState_IMU_Line::Create(vLineFeatures[k].pointOri,
+                                                       vLineFeatures[k].lineP1,
+                                                       vLineFeatures[k].lineP2,
+                                                       Tbl,
+                                                       Eigen::Matrix<double, 1, 1>(1 / IMUIntegrator::lidar_m)));
+      continue;
+    }
     int id = map_manager->FindUsedCornerMap(&_pointSel, laserCenWidth_last, laserCenHeight_last, laserCenDepth_last);
 
     if (id == 5000)
@@ -162,9 +154,9 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
 
     if (GlobalCornerMap[id].points.size() > 100)
     {
-      CornerKdMap[id].nearestKSearch(_pointSel, 5, _pointSearchInd, _pointSearchSqDis);
+      CornerKdMap[id].nearestKSearch(_pointSel, _knn);
 
-      if (_pointSearchSqDis[4] < thres_dist)
+      if (_knn.size == 5 && _knn.sqDists[4] < thres_dist)
       {
 
         debug_num1++;
@@ -173,9 +165,9 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
         float cz = 0;
         for (int j = 0; j < 5; j++)
         {
-          cx += GlobalCornerMap[id].points[_pointSearchInd[j]].x;
-          cy += GlobalCornerMap[id].points[_pointSearchInd[j]].y;
-          cz += GlobalCornerMap[id].points[_pointSearchInd[j]].z;
+          cx += GlobalCornerMap[id].points[_knn.indices[j]].x;
+          cy += GlobalCornerMap[id].points[_knn.indices[j]].y;
+          cz += GlobalCornerMap[id].points[_knn.indices[j]].z;
         }
         cx /= 5;
         cy /= 5;
@@ -189,9 +181,9 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
         float a33 = 0;
         for (int j = 0; j < 5; j++)
         {
-          float ax = GlobalCornerMap[id].points[_pointSearchInd[j]].x - cx;
-          float ay = GlobalCornerMap[id].points[_pointSearchInd[j]].y - cy;
-          float az = GlobalCornerMap[id].points[_pointSearchInd[j]].z - cz;
+          float ax = GlobalCornerMap[id].points[_knn.indices[j]].x - cx;
+          float ay = GlobalCornerMap[id].points[_knn.indices[j]].y - cy;
+          float az = GlobalCornerMap[id].points[_knn.indices[j]].z - cz;
 
           a11 += ax * ax;
           a12 += ax * ay;
@@ -242,16 +234,19 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
                                      tripod1,
                                      tripod2);
           vLineFeatures.back().ComputeError(m4d);
+          vLineFeatures.back().valid = std::fabs(vLineFeatures.back().error) > 1e-5;
+          cache.Record(i, _pointSelVec, _knn.sqDists[4], _featureBegin, vLineFeatures);
 
           continue;
         }
       }
     }
 
+    double _featureSqDis = 0;
     if (laserCloudCornerLocal->points.size() > 20)
     {
-      kdtreeLocal->nearestKSearch(_pointSel, 5, _pointSearchInd2, _pointSearchSqDis2);
-      if (_pointSearchSqDis2[4] < thres_dist)
+      kdtreeLocal->nearestKSearch(_pointSel, _knn2);
+      if (_knn2.size == 5 && _knn2.sqDists[4] < thres_dist)
       {
 
         debug_num2++;
@@ -260,9 +255,9 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
         float cz = 0;
         for (int j = 0; j < 5; j++)
         {
-          cx += laserCloudCornerLocal->points[_pointSearchInd2[j]].x;
-          cy += laserCloudCornerLocal->points[_pointSearchInd2[j]].y;
-          cz += laserCloudCornerLocal->points[_pointSearchInd2[j]].z;
+          cx += laserCloudCornerLocal->points[_knn2.indices[j]].x;
+          cy += laserCloudCornerLocal->points[_knn2.indices[j]].y;
+          cz += laserCloudCornerLocal->points[_knn2.indices[j]].z;
         }
         cx /= 5;
         cy /= 5;
@@ -276,9 +271,9 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
         float a33 = 0;
         for (int j = 0; j < 5; j++)
         {
-          float ax = laserCloudCornerLocal->points[_pointSearchInd2[j]].x - cx;
-          float ay = laserCloudCornerLocal->points[_pointSearchInd2[j]].y - cy;
-          float az = laserCloudCornerLocal->points[_pointSearchInd2[j]].z - cz;
+          float ax = laserCloudCornerLocal->points[_knn2.indices[j]].x - cx;
+          float ay = laserCloudCornerLocal->points[_knn2.indices[j]].y - cy;
+          float az = laserCloudCornerLocal->points[_knn2.indices[j]].z - cz;
 
           a11 += ax * ax;
           a12 += ax * ay;
@@ -329,17 +324,21 @@ void Estimator::processPointToLine(std::vector<ceres::CostFunction *> &edges,
                                      tripod1,
                                      tripod2);
           vLineFeatures.back().ComputeError(m4d);
+          vLineFeatures.back().valid = std::fabs(vLineFeatures.back().error) > 1e-5;
+          _featureSqDis = _knn2.sqDists[4];
         }
       }
     }
+    cache.Record(i, _pointSelVec, _featureSqDis, _featureBegin, vLineFeatures);
   }
+  cache.End(vLineFeatures);
 }
 
 void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
                                    std::vector<FeaturePlan> &vPlanFeatures,
                                    const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
                                    const pcl::PointCloud<PointType>::Ptr &laserCloudSurfLocal,
-                                   const pcl::KdTreeFLANN<PointType>::Ptr &kdtreeLocal,
+                                   const StaticKdTree<PointType>::Ptr &kdtreeLocal,
                                    const Eigen::Matrix4d &exTlb,
                                    const Eigen::Matrix4d &m4d)
 {
@@ -362,10 +361,8 @@ void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
     return;
   }
   PointType _pointOri, _pointSel, _coeff;
-  std::vector<int> _pointSearchInd;
-  std::vector<float> _pointSearchSqDis;
-  std::vector<int> _pointSearchInd2;
-  std::vector<float> _pointSearchSqDis2;
+  KnnResult<5> _knn;
+  KnnResult<5> _knn2;
 
   Eigen::Matrix<double, 5, 3> _matA0;
   _matA0.setZero();
@@ -395,16 +392,16 @@ void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
 
     if (GlobalSurfMap[id].points.size() > 50)
     {
-      SurfKdMap[id].nearestKSearch(_pointSel, 5, _pointSearchInd, _pointSearchSqDis);
+      SurfKdMap[id].nearestKSearch(_pointSel, _knn);
 
-      if (_pointSearchSqDis[4] < 1.0)
+      if (_knn.size == 5 && _knn.sqDists[4] < 1.0)
       {
         debug_num1++;
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = GlobalSurfMap[id].points[_pointSearchInd[j]].x;
-          _matA0(j, 1) = GlobalSurfMap[id].points[_pointSearchInd[j]].y;
-          _matA0(j, 2) = GlobalSurfMap[id].points[_pointSearchInd[j]].z;
+          _matA0(j, 0) = GlobalSurfMap[id].points[_knn.indices[j]].x;
+          _matA0(j, 1) = GlobalSurfMap[id].points[_knn.indices[j]].y;
+          _matA0(j, 2) = GlobalSurfMap[id].points[_knn.indices[j]].z;
         }
         _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
 
@@ -422,9 +419,9 @@ void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
         bool planeValid = true;
         for (int j = 0; j < 5; j++)
         {
-          if (std::fabs(pa * GlobalSurfMap[id].points[_pointSearchInd[j]].x +
-                        pb * GlobalSurfMap[id].points[_pointSearchInd[j]].y +
-                        pc * GlobalSurfMap[id].points[_pointSearchInd[j]].z + pd) > 0.2)
+          if (std::fabs(pa * GlobalSurfMap[id].points[_knn.indices[j]].x +
+                        pb * GlobalSurfMap[id].points[_knn.indices[j]].y +
+                        pc * GlobalSurfMap[id].points[_knn.indices[j]].z + pd) > 0.2)
           {
             planeValid = false;
             break;
@@ -455,15 +452,15 @@ void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
     }
     if (laserCloudSurfLocal->points.size() > 20)
     {
-      kdtreeLocal->nearestKSearch(_pointSel, 5, _pointSearchInd2, _pointSearchSqDis2);
-      if (_pointSearchSqDis2[4] < 1.0)
+      kdtreeLocal->nearestKSearch(_pointSel, _knn2);
+      if (_knn2.size == 5 && _knn2.sqDists[4] < 1.0)
       {
         debug_num2++;
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = laserCloudSurfLocal->points[_pointSearchInd2[j]].x;
-          _matA0(j, 1) = laserCloudSurfLocal->points[_pointSearchInd2[j]].y;
-          _matA0(j, 2) = laserCloudSurfLocal->points[_pointSearchInd2[j]].z;
+          _matA0(j, 0) = laserCloudSurfLocal->points[_knn2.indices[j]].x;
+          _matA0(j, 1) = laserCloudSurfLocal->points[_knn2.indices[j]].y;
+          _matA0(j, 2) = laserCloudSurfLocal->points[_knn2.indices[j]].z;
         }
         _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
 
@@ -481,9 +478,9 @@ void Estimator::processPointToPlan(std::vector<ceres::CostFunction *> &edges,
         bool planeValid = true;
         for (int j = 0; j < 5; j++)
         {
-          if (std::fabs(pa * laserCloudSurfLocal->points[_pointSearchInd2[j]].x +
-                        pb * laserCloudSurfLocal->points[_pointSearchInd2[j]].y +
-                        pc * laserCloudSurfLocal->points[_pointSearchInd2[j]].z + pd) > 0.2)
+          if (std::fabs(pa * laserCloudSurfLocal->points[_knn2.indices[j]].x +
+                        pb * laserCloudSurfLocal->points[_knn2.indices[j]].y +
+                        pc * laserCloudSurfLocal->points[_knn2.indices[j]].z + pd) > 0.2)
           {
             planeValid = false;
             break;
@@ -517,38 +514,24 @@ void Estimator::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
                                       std::vector<FeaturePlanVec> &vPlanFeatures,
                                       const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
                                       const pcl::PointCloud<PointType>::Ptr &laserCloudSurfLocal,
-                                      const pcl::KdTreeFLANN<PointType>::Ptr &kdtreeLocal,
+                                      const StaticKdTree<PointType>::Ptr &kdtreeLocal,
+                                      AssociationCache<FeaturePlanVec> &cache,
                                       const Eigen::Matrix4d &exTlb,
                                       const Eigen::Matrix4d &m4d)
 {
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
   Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
   Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
   Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
-  if (!vPlanFeatures.empty())
-  {
-    for (const auto &p : vPlanFeatures)
-    {
-      auto *e = Cost_NavState_IMU_Plan_Vec::Create(p.pointOri,
-                                                   p.pointProj,
-                                                   Tbl,
-                                                   p.sqrt_info);
-      edges.push_back(e);
-    }
-    return;
-  }
+  vPlanFeatures.clear();
+  cache.Begin(m4d, laserCloudSurf->points.size());
   PointType _pointOri, _pointSel, _coeff;
-  std::vector<int> _pointSearchInd;
-  std::vector<float> _pointSearchSqDis;
-  std::vector<int> _pointSearchInd2;
-  std::vector<float> _pointSearchSqDis2;
+  KnnResult<5> _knn;
+  KnnResult<5> _knn2;
 
   Eigen::Matrix<double, 5, 3> _matA0;
   _matA0.setZero();
-  Eigen::Matrix<double, 5, 1> _matB0;
-  _matB0.setOnes();
-  _matB0 *= -1;
-  Eigen::Matrix<double, 3, 1> _matX0;
-  _matX0.setZero();
   int laserCloudSurfStackNum = laserCloudSurf->points.size();
 
   int debug_num1 = 0;
@@ -559,6 +542,17 @@ void Estimator::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
   {
     _pointOri = laserCloudSurf->points[i];
     MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    Eigen::Vector3d _pointSelVec(_pointSel.x, _pointSel.y, _pointSel.z);
+    size_t _featureBegin = vPlanFeatures.size();
+    if (cache.Lookup(i, _pointSelVec, thres_dist, vPlanFeatures))
+    {
+      for (size_t k = _featureBegin; k < vPlanFeatures.size(); k++)
+        edges.push_back(Cost_NavState_IMU_Plan_Vec::Create(vPlanFeatures[k].pointOri,
+                                                           vPlanFeatures[k].pointProj,
+                                                           Tbl,
+                                                           vPlanFeatures[k].sqrt_info));
+      continue;
+    }
 
     int id = map_manager->FindUsedSurfMap(&_pointSel, laserCenWidth_last, laserCenHeight_last, laserCenDepth_last);
 
@@ -570,58 +564,27 @@ void Estimator::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
 
     if (GlobalSurfMap[id].points.size() > 50)
     {
-      SurfKdMap[id].nearestKSearch(_pointSel, 5, _pointSearchInd, _pointSearchSqDis);
+      SurfKdMap[id].nearestKSearch(_pointSel, _knn);
 
-      if (_pointSearchSqDis[4] < thres_dist)
+      if (_knn.size == 5 && _knn.sqDists[4] < thres_dist)
       {
         debug_num1++;
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = GlobalSurfMap[id].points[_pointSearchInd[j]].x;
-          _matA0(j, 1) = GlobalSurfMap[id].points[_pointSearchInd[j]].y;
-          _matA0(j, 2) = GlobalSurfMap[id].points[_pointSearchInd[j]].z;
-        }
-        _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
-
-        float pa = _matX0(0, 0);
-        float pb = _matX0(1, 0);
-        float pc = _matX0(2, 0);
-        float pd = 1;
-
-        float ps = std::sqrt(pa * pa + pb * pb + pc * pc);
-        pa /= ps;
-        pb /= ps;
-        pc /= ps;
-        pd /= ps;
-
-        bool planeValid = true;
-        for (int j = 0; j < 5; j++)
-        {
-          if (std::fabs(pa * GlobalSurfMap[id].points[_pointSearchInd[j]].x +
-                        pb * GlobalSurfMap[id].points[_pointSearchInd[j]].y +
-                        pc * GlobalSurfMap[id].points[_pointSearchInd[j]].z + pd) > 0.2)
-          {
-            planeValid = false;
-            break;
-          }
+          _matA0(j, 0) = GlobalSurfMap[id].points[_knn.indices[j]].x;
+          _matA0(j, 1) = GlobalSurfMap[id].points[_knn.indices[j]].y;
+          _matA0(j, 2) = GlobalSurfMap[id].points[_knn.indices[j]].z;
         }
-
-        if (planeValid)
+        Eigen::Vector4f plane;
+        if (PlaneFit5(_matA0, plane))
         {
           debug_num12++;
-          double dist = pa * _pointSel.x +
-                        pb * _pointSel.y +
-                        pc * _pointSel.z + pd;
-          Eigen::Vector3d omega(pa, pb, pc);
+          double dist = plane(0) * _pointSel.x +
+                        plane(1) * _pointSel.y +
+                        plane(2) * _pointSel.z + plane(3);
+          Eigen::Vector3d omega(plane(0), plane(1), plane(2));
           Eigen::Vector3d point_proj = Eigen::Vector3d(_pointSel.x, _pointSel.y, _pointSel.z) - (dist * omega);
-          Eigen::Vector3d e1(1, 0, 0);
-          Eigen::Matrix3d J = e1 * omega.transpose();
-          Eigen::JacobiSVD<Eigen::Matrix3d> svd(J, Eigen::ComputeThinU | Eigen::ComputeThinV);
-          Eigen::Matrix3d R_svd = svd.matrixV() * svd.matrixU().transpose();
-          Eigen::Matrix3d info = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
-          info(1, 1) *= plan_weight_tan;
-          info(2, 2) *= plan_weight_tan;
-          Eigen::Matrix3d sqrt_info = info * R_svd.transpose();
+          Eigen::Matrix3d sqrt_info = PlaneSqrtInfo(omega, plan_weight_tan);
 
           auto *e = Cost_NavState_IMU_Plan_Vec::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
                                                        point_proj,
@@ -632,65 +595,37 @@ void Estimator::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
                                      point_proj,
                                      sqrt_info);
           vPlanFeatures.back().ComputeError(m4d);
+          vPlanFeatures.back().valid = std::fabs(vPlanFeatures.back().error) > 1e-5;
+          cache.Record(i, _pointSelVec, _knn.sqDists[4], _featureBegin, vPlanFeatures);
 
           continue;
         }
       }
     }
 
+    double _featureSqDis = 0;
     if (laserCloudSurfLocal->points.size() > 20)
     {
-      kdtreeLocal->nearestKSearch(_pointSel, 5, _pointSearchInd2, _pointSearchSqDis2);
-      if (_pointSearchSqDis2[4] < thres_dist)
+      kdtreeLocal->nearestKSearch(_pointSel, _knn2);
+      if (_knn2.size == 5 && _knn2.sqDists[4] < thres_dist)
       {
         debug_num2++;
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = laserCloudSurfLocal->points[_pointSearchInd2[j]].x;
-          _matA0(j, 1) = laserCloudSurfLocal->points[_pointSearchInd2[j]].y;
-          _matA0(j, 2) = laserCloudSurfLocal->points[_pointSearchInd2[j]].z;
-        }
-        _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
-
-        float pa = _matX0(0, 0);
-        float pb = _matX0(1, 0);
-        float pc = _matX0(2, 0);
-        float pd = 1;
-
-        float ps = std::sqrt(pa * pa + pb * pb + pc * pc);
-        pa /= ps;
-        pb /= ps;
-        pc /= ps;
-        pd /= ps;
-
-        bool planeValid = true;
-        for (int j = 0; j < 5; j++)
-        {
-          if (std::fabs(pa * laserCloudSurfLocal->points[_pointSearchInd2[j]].x +
-                        pb * laserCloudSurfLocal->points[_pointSearchInd2[j]].y +
-                        pc * laserCloudSurfLocal->points[_pointSearchInd2[j]].z + pd) > 0.2)
-          {
-            planeValid = false;
-            break;
-          }
+          _matA0(j, 0) = laserCloudSurfLocal->points[_knn2.indices[j]].x;
+          _matA0(j, 1) = laserCloudSurfLocal->points[_knn2.indices[j]].y;
+          _matA0(j, 2) = laserCloudSurfLocal->points[_knn2.indices[j]].z;
         }
-
-        if (planeValid)
+        Eigen::Vector4f plane;
+        if (PlaneFit5(_matA0, plane))
         {
           debug_num22++;
-          double dist = pa * _pointSel.x +
-                        pb * _pointSel.y +
-                        pc * _pointSel.z + pd;
-          Eigen::Vector3d omega(pa, pb, pc);
+          double dist = plane(0) * _pointSel.x +
+                        plane(1) * _pointSel.y +
+                        plane(2) * _pointSel.z + plane(3);
+          Eigen::Vector3d omega(plane(0), plane(1), plane(2));
           Eigen::Vector3d point_proj = Eigen::Vector3d(_pointSel.x, _pointSel.y, _pointSel.z) - (dist * omega);
-          Eigen::Vector3d e1(1, 0, 0);
-          Eigen::Matrix3d J = e1 * omega.transpose();
-          Eigen::JacobiSVD<Eigen::Matrix3d> svd(J, Eigen::ComputeThinU | Eigen::ComputeThinV);
-          Eigen::Matrix3d R_svd = svd.matrixV() * svd.matrixU().transpose();
-          Eigen::Matrix3d info = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
-          info(1, 1) *= plan_weight_tan;
-          info(2, 2) *= plan_weight_tan;
-          Eigen::Matrix3d sqrt_info = info * R_svd.transpose();
+          Eigen::Matrix3d sqrt_info = PlaneSqrtInfo(omega, plan_weight_tan);
 
           auto *e = Cost_NavState_IMU_Plan_Vec::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
                                                        point_proj,
@@ -701,17 +636,61 @@ void Estimator::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
                                      point_proj,
                                      sqrt_info);
           vPlanFeatures.back().ComputeError(m4d);
+          vPlanFeatures.back().valid = std::fabs(vPlanFeatures.back().error) > 1e-5;
+          _featureSqDis = _knn2.sqDists[4];
         }
       }
     }
+    cache.Record(i, _pointSelVec, _featureSqDis, _featureBegin, vPlanFeatures);
   }
+  cache.End(vPlanFeatures);
+}
+
+bool Estimator::PlaneFit5(const Eigen::Matrix<double, 5, 3> &neighbours, Eigen::Vector4f &plane)
+{
+  const Eigen::Matrix<double, 5, 1> matB0 = -Eigen::Matrix<double, 5, 1>::Ones();
+  const Eigen::Matrix<double, 3, 1> matX0 = neighbours.colPivHouseholderQr().solve(matB0);
+
+  float pa = matX0(0, 0);
+  float pb = matX0(1, 0);
+  float pc = matX0(2, 0);
+  float pd = 1;
+
+  float ps = std::sqrt(pa * pa + pb * pb + pc * pc);
+  pa /= ps;
+  pb /= ps;
+  pc /= ps;
+  pd /= ps;
+  plane << pa, pb, pc, pd;
+
+  // the map points are floats, their double copies convert back exactly
+  for (int j = 0; j < 5; j++)
+  {
+    if (std::fabs(pa * float(neighbours(j, 0)) +
+                  pb * float(neighbours(j, 1)) +
+                  pc * float(neighbours(j, 2)) + pd) > 0.2)
+      return false;
+  }
+  return true;
+}
+
+Eigen::Matrix3d Estimator::PlaneSqrtInfo(const Eigen::Vector3d &omega, double weightTan)
+{
+  Eigen::Vector3d e1(1, 0, 0);
+  Eigen::Matrix3d J = e1 * omega.transpose();
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(J, Eigen::ComputeThinU | Eigen::ComputeThinV);
+  Eigen::Matrix3d R_svd = svd.matrixV() * svd.matrixU().transpose();
+  Eigen::Matrix3d info = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
+  info(1, 1) *= weightTan;
+  info(2, 2) *= weightTan;
+  return info * R_svd.transpose();
 }
 
 void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
                                      std::vector<FeatureNon> &vNonFeatures,
                                      const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeature,
                                      const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeatureLocal,
-                                     const pcl::KdTreeFLANN<PointType>::Ptr &kdtreeLocal,
+                                     const StaticKdTree<PointType>::Ptr &kdtreeLocal,
                                      const Eigen::Matrix4d &exTlb,
                                      const Eigen::Matrix4d &m4d)
 {
@@ -735,10 +714,8 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
   }
 
   PointType _pointOri, _pointSel, _coeff;
-  std::vector<int> _pointSearchInd;
-  std::vector<float> _pointSearchSqDis;
-  std::vector<int> _pointSearchInd2;
-  std::vector<float> _pointSearchSqDis2;
+  KnnResult<5> _knn;
+  KnnResult<5> _knn2;
 
   Eigen::Matrix<double, 5, 3> _matA0;
   _matA0.setZero();
@@ -763,14 +740,14 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
 
     if (GlobalNonFeatureMap[id].points.size() > 100)
     {
-      NonFeatureKdMap[id].nearestKSearch(_pointSel, 5, _pointSearchInd, _pointSearchSqDis);
-      if (_pointSearchSqDis[4] < 1 * thres_dist)
+      NonFeatureKdMap[id].nearestKSearch(_pointSel, _knn);
+      if (_knn.size == 5 && _knn.sqDists[4] < 1 * thres_dist)
       {
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = GlobalNonFeatureMap[id].points[_pointSearchInd[j]].x;
-          _matA0(j, 1) = GlobalNonFeatureMap[id].points[_pointSearchInd[j]].y;
-          _matA0(j, 2) = GlobalNonFeatureMap[id].points[_pointSearchInd[j]].z;
+          _matA0(j, 0) = GlobalNonFeatureMap[id].points[_knn.indices[j]].x;
+          _matA0(j, 1) = GlobalNonFeatureMap[id].points[_knn.indices[j]].y;
+          _matA0(j, 2) = GlobalNonFeatureMap[id].points[_knn.indices[j]].z;
         }
         _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
 
@@ -788,9 +765,9 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
         bool planeValid = true;
         for (int j = 0; j < 5; j++)
         {
-          if (std::fabs(pa * GlobalNonFeatureMap[id].points[_pointSearchInd[j]].x +
-                        pb * GlobalNonFeatureMap[id].points[_pointSearchInd[j]].y +
-                        pc * GlobalNonFeatureMap[id].points[_pointSearchInd[j]].z + pd) > 0.2)
+          if (std::fabs(pa * GlobalNonFeatureMap[id].points[_knn.indices[j]].x +
+                        pb * GlobalNonFeatureMap[id].points[_knn.indices[j]].y +
+                        pc * GlobalNonFeatureMap[id].points[_knn.indices[j]].z + pd) > 0.2)
           {
             planeValid = false;
             break;
@@ -822,14 +799,14 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
 
     if (laserCloudNonFeatureLocal->points.size() > 20)
     {
-      kdtreeLocal->nearestKSearch(_pointSel, 5, _pointSearchInd2, _pointSearchSqDis2);
-      if (_pointSearchSqDis2[4] < 1 * thres_dist)
+      kdtreeLocal->nearestKSearch(_pointSel, _knn2);
+      if (_knn2.size == 5 && _knn2.sqDists[4] < 1 * thres_dist)
       {
         for (int j = 0; j < 5; j++)
         {
-          _matA0(j, 0) = laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].x;
-          _matA0(j, 1) = laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].y;
-          _matA0(j, 2) = laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].z;
+          _matA0(j, 0) = laserCloudNonFeatureLocal->points[_knn2.indices[j]].x;
+          _matA0(j, 1) = laserCloudNonFeatureLocal->points[_knn2.indices[j]].y;
+          _matA0(j, 2) = laserCloudNonFeatureLocal->points[_knn2.indices[j]].z;
         }
         _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
 
@@ -847,9 +824,9 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
         bool planeValid = true;
         for (int j = 0; j < 5; j++)
         {
-          if (std::fabs(pa * laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].x +
-                        pb * laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].y +
-                        pc * laserCloudNonFeatureLocal->points[_pointSearchInd2[j]].z + pd) > 0.2)
+          if (std::fabs(pa * laserCloudNonFeatureLocal->points[_knn2.indices[j]].x +
+                        pb * laserCloudNonFeatureLocal->points[_knn2.indices[j]].y +
+                        pc * laserCloudNonFeatureLocal->points[_knn2.indices[j]].z + pd) > 0.2)
           {
             planeValid = false;
             break;
@@ -879,11 +856,11 @@ void Estimator::processNonFeatureICP(std::vector<ceres::CostFunction *> &edges,
   }
 }
 
-void Estimator::vector2double(const std::list<LidarFrame> &lidarFrameList)
+void Estimator::vector2double(const LidarWindow &lidarFrameList)
 {
-  int i = 0;
-  for (const auto &l : lidarFrameList)
+  for (int i = 0; i < lidarFrameList.size(); i++)
   {
+    const LidarFrame &l = lidarFrameList[i];
     Eigen::Map<Eigen::Matrix<double, 6, 1>> PR(para_PR[i]);
     PR.segment<3>(0) = l.P;
     PR.segment<3>(3) = Sophus::SO3d(l.Q).log();
@@ -892,15 +869,14 @@ void Estimator::vector2double(const std::list<LidarFrame> &lidarFrameList)
     VBias.segment<3>(0) = l.V;
     VBias.segment<3>(3) = l.bg;
     VBias.segment<3>(6) = l.ba;
-    i++;
   }
 }
 
-void Estimator::double2vector(std::list<LidarFrame> &lidarFrameList)
+void Estimator::double2vector(LidarWindow &lidarFrameList)
 {
-  int i = 0;
-  for (auto &l : lidarFrameList)
+  for (int i = 0; i < lidarFrameList.size(); i++)
   {
+    LidarFrame &l = lidarFrameList[i];
     Eigen::Map<const Eigen::Matrix<double, 6, 1>> PR(para_PR[i]);
     Eigen::Map<const Eigen::Matrix<double, 9, 1>> VBias(para_VBias[i]);
     l.P = PR.segment<3>(0);
@@ -908,15 +884,15 @@ void Estimator::double2vector(std::list<LidarFrame> &lidarFrameList)
     l.V = VBias.segment<3>(0);
     l.bg = VBias.segment<3>(3);
     l.ba = VBias.segment<3>(6);
-    i++;
   }
 }
 
-void Estimator::EstimateLidarPose(std::list<LidarFrame> &lidarFrameList,
+void Estimator::EstimateLidarPose(LidarWindow &lidarFrameList,
                                   const Eigen::Matrix4d &exTlb,
                                   const Eigen::Vector3d &gravity,
                                   nav_msgs::Odometry &debugInfo)
 {
+  TRACE_SCOPE("Estimator::EstimateLidarPose");
 
   Eigen::Matrix3d exRbl = exTlb.topLeftCorner(3, 3).transpose();
   Eigen::Vector3d exPbl = -1.0 * exRbl * exTlb.topRightCorner(3, 1);
@@ -931,37 +907,15 @@ void Estimator::EstimateLidarPose(std::list<LidarFrame> &lidarFrameList,
   int stack_count = 0;
   for (const auto &l : lidarFrameList)
   {
-    laserCloudCornerLast[stack_count]->clear();
-    for (const auto &p : l.laserCloud->points)
     {
-      if (std::fabs(p.normal_z - 1.0) < 1e-5)
-        laserCloudCornerLast[stack_count]->push_back(p);
+      // split by label and downsample every label in one pass
+      PROFILE_SPAN(Downsample);
+      downSizeFilterFrame.FilterByLabel(*l.laserCloud, *laserCloudCornerStack[stack_count], *laserCloudSurfStack[stack_count],
+                                        laserCloudNonFeatureStack[stack_count].get());
+      // consecutive association queries then hit the same cubes and tree nodes
+      mortonOrder.Sort(*laserCloudCornerStack[stack_count]);
+      mortonOrder.Sort(*laserCloudSurfStack[stack_count]);
     }
-    laserCloudSurfLast[stack_count]->clear();
-    for (const auto &p : l.laserCloud->points)
-    {
-      if (std::fabs(p.normal_z - 2.0) < 1e-5)
-        laserCloudSurfLast[stack_count]->push_back(p);
-    }
-
-    laserCloudNonFeatureLast[stack_count]->clear();
-    for (const auto &p : l.laserCloud->points)
-    {
-      if (std::fabs(p.normal_z - 3.0) < 1e-5)
-        laserCloudNonFeatureLast[stack_count]->push_back(p);
-    }
-
-    laserCloudCornerStack[stack_count]->clear();
-    downSizeFilterCorner.setInputCloud(laserCloudCornerLast[stack_count]);
-    downSizeFilterCorner.filter(*laserCloudCornerStack[stack_count]);
-
-    laserCloudSurfStack[stack_count]->clear();
-    downSizeFilterSurf.setInputCloud(laserCloudSurfLast[stack_count]);
-    downSizeFilterSurf.filter(*laserCloudSurfStack[stack_count]);
-
-    laserCloudNonFeatureStack[stack_count]->clear();
-    downSizeFilterNonFeature.setInputCloud(laserCloudNonFeatureLast[stack_count]);
-    downSizeFilterNonFeature.filter(*laserCloudNonFeatureStack[stack_count]);
     stack_count++;
   }
   if (((laserCloudCornerFromMapNum > 0 && laserCloudSurfFromMapNum > 100) ||
@@ -986,11 +940,12 @@ void Estimator::EstimateLidarPose(std::list<LidarFrame> &lidarFrameList,
   locker.unlock();
 }
 
-void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
+void Estimator::Estimate(LidarWindow &lidarFrameList,
                          const Eigen::Matrix4d &exTlb,
                          const Eigen::Vector3d &gravity)
 {
-
+  TRACE_SCOPE("Estimator::Estimate");
+  const auto estimateStart = std::chrono::steady_clock::now();
   int num_corner_map = 0;
   int num_surf_map = 0;
 
@@ -999,11 +954,18 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
   Eigen::Matrix4d transformTobeMapped = Eigen::Matrix4d::Identity();
   Eigen::Matrix3d exRbl = exTlb.topLeftCorner(3, 3).transpose();
   Eigen::Vector3d exPbl = -1.0 * exRbl * exTlb.topRightCorner(3, 1);
-  kdtreeCornerFromLocal->setInputCloud(laserCloudCornerFromLocal);
-  kdtreeSurfFromLocal->setInputCloud(laserCloudSurfFromLocal);
+  {
+    PROFILE_SPAN(KdBuild);
+    kdtreeCornerFromLocal->setInputCloud(laserCloudCornerFromLocal);
+    kdtreeSurfFromLocal->setInputCloud(laserCloudSurfFromLocal);
+  }
   // kdtreeNonFeatureFromLocal->setInputCloud(laserCloudNonFeatureFromLocal);
 
-  std::unique_lock<std::mutex> locker3(map_manager->mtx_MapManager);
+  std::unique_lock<std::mutex> locker3(map_manager->mtx_MapManager, std::defer_lock);
+  {
+    TRACE_SCOPE("wait mtx_MapManager");
+    locker3.lock();
+  }
   for (int i = 0; i < 4851; i++)
   {
     CornerKdMap[i] = map_manager->getCornerKdMap(i);
@@ -1040,6 +1002,10 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
     v.reserve(2000);
   }
 
+  // associations kept across the iterations of this estimate
+  std::vector<AssociationCache<FeatureLine>> lineCaches(windowSize, AssociationCache<FeatureLine>(assoc_trans_thres, assoc_rot_thres));
+  std::vector<AssociationCache<FeaturePlanVec>> planCaches(windowSize, AssociationCache<FeaturePlanVec>(assoc_trans_thres, assoc_rot_thres));
+
   if (windowSize == SLIDEWINDOWSIZE)
   {
     plan_weight_tan = 0.0003;
@@ -1052,7 +1018,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
   }
 
   // excute optimize process
-  const int max_iters = 5;
+  const int max_iters = degradedIters > 0 ? std::min(degradedIters, convergence.MaxIterations()) : convergence.MaxIterations();
   for (int iterOpt = 0; iterOpt < max_iters; ++iterOpt)
   {
 
@@ -1084,8 +1050,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
     // add IMU CostFunction
     for (int f = 1; f < windowSize; ++f)
     {
-      auto frame_curr = lidarFrameList.begin();
-      std::advance(frame_curr, f);
+      auto frame_curr = lidarFrameList.begin() + f;
       problem.AddResidualBlock(Cost_NavState_PRV_Bias::Create(frame_curr->imuIntegrator,
                                                               const_cast<Eigen::Vector3d &>(gravity),
                                                               Eigen::LLT<Eigen::Matrix<double, 15, 15>>(frame_curr->imuIntegrator.GetCovariance().inverse())
@@ -1113,10 +1078,10 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
     std::vector<std::vector<ceres::CostFunction *>> edgesPlan(windowSize);
     std::vector<std::vector<ceres::CostFunction *>> edgesNon(windowSize);
     std::thread threads[3];
+    featureSelector.ResetStats();
     for (int f = 0; f < windowSize; ++f)
     {
-      auto frame_curr = lidarFrameList.begin();
-      std::advance(frame_curr, f);
+      auto frame_curr = lidarFrameList.begin() + f;
       transformTobeMapped = Eigen::Matrix4d::Identity();
       transformTobeMapped.topLeftCorner(3, 3) = frame_curr->Q * exRbl;
       transformTobeMapped.topRightCorner(3, 1) = frame_curr->Q * exPbl + frame_curr->P;
@@ -1127,6 +1092,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
                                std::ref(laserCloudCornerStack[f]),
                                std::ref(laserCloudCornerFromLocal),
                                std::ref(kdtreeCornerFromLocal),
+                               std::ref(lineCaches[f]),
                                std::ref(exTlb),
                                std::ref(transformTobeMapped));
 
@@ -1136,6 +1102,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
                                std::ref(laserCloudSurfStack[f]),
                                std::ref(laserCloudSurfFromLocal),
                                std::ref(kdtreeSurfFromLocal),
+                               std::ref(planCaches[f]),
                                std::ref(exTlb),
                                std::ref(transformTobeMapped));
 
@@ -1151,6 +1118,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
       threads[0].join();
       threads[1].join();
       // threads[2].join();
+      featureSelector.Select(transformTobeMapped, edgesLine[f], vLineFeatures[f], edgesPlan[f], vPlanFeatures[f]);
     }
 
     int cntSurf = 0;
@@ -1318,7 +1286,10 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
     options.minimizer_progress_to_stdout = false;
     options.num_threads = 6;
     ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
+    {
+      PROFILE_SPAN(Solve);
+      ceres::Solve(options, &problem, &summary);
+    }
 
     double2vector(lidarFrameList);
 
@@ -1328,12 +1299,27 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
     double deltaR = (q_before_opti.angularDistance(q_after_opti)) * 180.0 / M_PI;
     double deltaT = (t_before_opti - t_after_opti).norm();
 
-    if (deltaR < 0.05 && deltaT < 0.05 || (iterOpt + 1) == max_iters)
+    if (convergence.Converged(iterOpt, deltaT, deltaR, summary.initial_cost, summary.final_cost) || iterOpt + 1 >= max_iters)
     {
       ROS_INFO("Frame: %d\n", frame_count++);
+      convergence.AddFrame(iterOpt + 1);
+      ROS_DEBUG("outer iterations: %d (mean %.2f, median %d over %zu frames)",
+                iterOpt + 1, convergence.MeanIterations(), convergence.MedianIterations(), convergence.Frames());
+      size_t cacheHits = 0, cacheQueries = 0;
+      for (int f = 0; f < windowSize; ++f)
+      {
+        cacheHits += lineCaches[f].hits + planCaches[f].hits;
+        cacheQueries += lineCaches[f].queries + planCaches[f].queries;
+      }
+      ROS_DEBUG("association cache hit rate: %.1f%% (%zu/%zu)",
+                cacheQueries > 0 ? 100.0 * cacheHits / cacheQueries : 0.0, cacheHits, cacheQueries);
+      ROS_DEBUG("residual budget: %d per frame, kept %zu of %zu correspondences, degeneracy %.4f",
+                featureSelector.Budget(), featureSelector.Selected(), featureSelector.Candidates(),
+                featureSelector.Degeneracy());
       if (windowSize != SLIDEWINDOWSIZE)
         break;
       // apply marginalization
+      PROFILE_SPAN(Marginalization);
       auto *marginalization_info = new MarginalizationInfo();
       if (last_marginalization_info)
       {
@@ -1352,8 +1338,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
         marginalization_info->addResidualBlockInfo(residual_block_info);
       }
 
-      auto frame_curr = lidarFrameList.begin();
-      std::advance(frame_curr, 1);
+      auto frame_curr = lidarFrameList.begin() + 1;
       ceres::CostFunction *IMU_Cost = Cost_NavState_PRV_Bias::Create(frame_curr->imuIntegrator,
                                                                      const_cast<Eigen::Vector3d &>(gravity),
                                                                      Eigen::LLT<Eigen::Matrix<double, 15, 15>>(frame_curr->imuIntegrator.GetCovariance().inverse())
@@ -1364,10 +1349,12 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
                                                         std::vector<int>{0, 1});
       marginalization_info->addResidualBlockInfo(residual_block_info);
 
+      // re-associate the marginalized frame with its own pose, it barely moved so the cache is reused
       int f = 0;
+      auto frame_marg = lidarFrameList.begin();
       transformTobeMapped = Eigen::Matrix4d::Identity();
-      transformTobeMapped.topLeftCorner(3, 3) = frame_curr->Q * exRbl;
-      transformTobeMapped.topRightCorner(3, 1) = frame_curr->Q * exPbl + frame_curr->P;
+      transformTobeMapped.topLeftCorner(3, 3) = frame_marg->Q * exRbl;
+      transformTobeMapped.topRightCorner(3, 1) = frame_marg->Q * exPbl + frame_marg->P;
       edgesLine[f].clear();
       edgesPlan[f].clear();
       edgesNon[f].clear();
@@ -1377,6 +1364,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
                                std::ref(laserCloudCornerStack[f]),
                                std::ref(laserCloudCornerFromLocal),
                                std::ref(kdtreeCornerFromLocal),
+                               std::ref(lineCaches[f]),
                                std::ref(exTlb),
                                std::ref(transformTobeMapped));
 
@@ -1386,6 +1374,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
                                std::ref(laserCloudSurfStack[f]),
                                std::ref(laserCloudSurfFromLocal),
                                std::ref(kdtreeSurfFromLocal),
+                               std::ref(planCaches[f]),
                                std::ref(exTlb),
                                std::ref(transformTobeMapped));
 
@@ -1401,6 +1390,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
       threads[0].join();
       threads[1].join();
       // threads[2].join();
+      featureSelector.Select(transformTobeMapped, edgesLine[f], vLineFeatures[f], edgesPlan[f], vPlanFeatures[f]);
       int cntFtu = 0;
       for (auto &e : edgesLine[f])
       {
@@ -1440,7 +1430,7 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
       }
 
       marginalization_info->preMarginalize();
-      marginalization_info->marginalize();
+      marginalization_info->marginalizeFixed<SLIDEWINDOWSIZE>();
 
       std::unordered_map<long, double *> addr_shift;
       for (int i = 1; i < SLIDEWINDOWSIZE; i++)
@@ -1469,12 +1459,14 @@ void Estimator::Estimate(std::list<LidarFrame> &lidarFrameList,
       }
     }
   }
+  featureSelector.AddLatency(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - estimateStart).count());
 }
 void Estimator::MapIncrementLocal(const pcl::PointCloud<PointType>::Ptr &laserCloudCornerStack,
                                   const pcl::PointCloud<PointType>::Ptr &laserCloudSurfStack,
                                   const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeatureStack,
                                   const Eigen::Matrix4d &transformTobeMapped)
 {
+  PROFILE_SPAN(MapUpdate);
   int laserCloudCornerStackNum = laserCloudCornerStack->points.size();
   int laserCloudSurfStackNum = laserCloudSurfStack->points.size();
   int laserCloudNonFeatureStackNum = laserCloudNonFeatureStack->points.size();
@@ -1506,17 +1498,12 @@ void Estimator::MapIncrementLocal(const pcl::PointCloud<PointType>::Ptr &laserCl
     *laserCloudSurfFromLocal += *localSurfMap[i];
     *laserCloudNonFeatureFromLocal += *localNonFeatureMap[i];
   }
-  pcl::PointCloud<PointType>::Ptr temp(new pcl::PointCloud<PointType>());
+  // in place, the local clouds keep their capacity from frame to frame
   downSizeFilterCorner.setInputCloud(laserCloudCornerFromLocal);
-  downSizeFilterCorner.filter(*temp);
-  laserCloudCornerFromLocal = temp;
-  pcl::PointCloud<PointType>::Ptr temp2(new pcl::PointCloud<PointType>());
+  downSizeFilterCorner.filter(*laserCloudCornerFromLocal);
   downSizeFilterSurf.setInputCloud(laserCloudSurfFromLocal);
-  downSizeFilterSurf.filter(*temp2);
-  laserCloudSurfFromLocal = temp2;
-  pcl::PointCloud<PointType>::Ptr temp3(new pcl::PointCloud<PointType>());
+  downSizeFilterSurf.filter(*laserCloudSurfFromLocal);
   downSizeFilterNonFeature.setInputCloud(laserCloudNonFeatureFromLocal);
-  downSizeFilterNonFeature.filter(*temp3);
-  laserCloudNonFeatureFromLocal = temp3;
+  downSizeFilterNonFeature.filter(*laserCloudNonFeatureFromLocal);
   localMapID++;
 }
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "Estimator/FeatureExtractor.h"
+#include "utils/Profiler.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+FeatureExtractor::FeatureExtractor(const Options &options) : options(options)
+{
+  const int size = options.N_SCAN * options.Horizon_SCAN;
+  downSizeFilter.setLeafSize(options.odometrySurfLeafSize, options.odometrySurfLeafSize, options.odometrySurfLeafSize);
+
+  fullCloud.resize(size);
+  startRingIndex.assign(options.N_SCAN, 0);
+  endRingIndex.assign(options.N_SCAN, 0);
+  pointColInd.assign(size, 0);
+  pointFullInd.assign(size, 0);
+  pointRange.assign(size, 0);
+
+  cloudSmoothness.resize(size);
+  cloudCurvature.assign(size, 0);
+  cloudNeighborPicked.assign(size, 0);
+  cloudLabel.assign(size, 0);
+
+  surfaceCloudScan.reset(new pcl::PointCloud<PointType>());
+  surfaceCloudScanDS.reset(new pcl::PointCloud<PointType>());
+}
+
+/** \brief extract corner and surf features of one scan
+ * \param[in] inputCloud: scan points, normal_x is the relative time, normal_y the ring
+ * \param[out] extractedCloud: range image points with their feature label
+ * \param[out] cornerCloud: corner points
+ * \param[out] surfaceCloud: downsampled surf points
+ */
+void FeatureExtractor::Extract(const pcl::PointCloud<PointType>::Ptr &inputCloud,
+                               LabelledCloud::Ptr &extractedCloud,
+                               pcl::PointCloud<PointType>::Ptr &cornerCloud,
+                               pcl::PointCloud<PointType>::Ptr &surfaceCloud)
+{
+  // reset range matrix for range image projection
+  rangeMat.assign(options.N_SCAN * options.Horizon_SCAN, FLT_MAX);
+  columnIdnCountVec.assign(options.N_SCAN, 0);
+  extractedCloud->clear();
+  cornerCloud->clear();
+  surfaceCloud->clear();
+
+  projectPointCloud(inputCloud);
+  cloudExtraction(*extractedCloud);
+
+  const int cloudSize = extractedCloud->points.size();
+  calculateSmoothness(cloudSize);
+  markOccludedPoints(cloudSize);
+  extractFeatures(*extractedCloud, *cornerCloud, *surfaceCloud);
+}
+
+void FeatureExtractor::projectPointCloud(const pcl::PointCloud<PointType>::Ptr &inputCloud)
+{
+  const float ang_res_x = 360.0 / float(options.Horizon_SCAN);
+  const int cloudSize = inputCloud->points.size();
+  // range image projection
+  for (int i = 0; i < cloudSize; ++i)
+  {
+    const PointType &thisPoint = inputCloud->points[i];
+
+    float range = std::sqrt(thisPoint.x * thisPoint.x + thisPoint.y * thisPoint.y + thisPoint.z * thisPoint.z);
+    if (range < options.lidarMinRange || range > options.lidarMaxRange)
+      continue;
+
+    int rowIdn = thisPoint.normal_y;
+    if (rowIdn < 0 || rowIdn >= options.N_SCAN)
+      continue;
+
+    if (rowIdn % options.downsampleRate != 0)
+      continue;
+
+    int columnIdn = -1;
+    if (options.sequentialColumns)
+    {
+      columnIdn = columnIdnCountVec[rowIdn];
+      columnIdnCountVec[rowIdn] += 1;
+    }
+    else
+    {
+      float horizonAngle = atan2(thisPoint.x, thisPoint.y) * 180 / M_PI;
+      columnIdn = -round((horizonAngle - 90.0) / ang_res_x) + options.Horizon_SCAN / 2;
+      if (columnIdn >= options.Horizon_SCAN)
+        columnIdn -= options.Horizon_SCAN;
+    }
+
+    if (columnIdn < 0 || columnIdn >= options.Horizon_SCAN)
+      continue;
+
+    const int index = columnIdn + rowIdn * options.Horizon_SCAN;
+    if (rangeMat[index] != FLT_MAX)
+      continue;
+
+    rangeMat[index] = range;
+    fullCloud[index] = thisPoint;
+  }
+}
+
+void FeatureExtractor::cloudExtraction(LabelledCloud &extractedCloud)
+{
+  int count = 0;
+  // extract segmented cloud for lidar odometry
+  for (int i = 0; i < options.N_SCAN; ++i)
+  {
+    startRingIndex[i] = count - 1 + 5;
+
+    for (int j = 0; j < options.Horizon_SCAN; ++j)
+    {
+      const int index = j + i * options.Horizon_SCAN;
+      if (rangeMat[index] != FLT_MAX)
+      {
+        // mark the points' column index for marking occlusion later
+        pointColInd[count] = j;
+        // save range info
+        pointRange[count] = rangeMat[index];
+        pointFullInd[count] = index;
+        // save extracted cloud
+        LabelledPoint point;
+        point.Set(fullCloud[index]);
+        extractedCloud.push_back(point);
+        ++count;
+      }
+    }
+    endRingIndex[i] = count - 1 - 5;
+  }
+}
+
+void FeatureExtractor::calculateSmoothness(int cloudSize)
+{
+  std::fill(cloudNeighborPicked.begin(), cloudNeighborPicked.begin() + cloudSize, 0);
+  std::fill(cloudLabel.begin(), cloudLabel.begin() + cloudSize, 0);
+  for (int i = 5; i < cloudSize - 5; i++)
+  {
+    float diffRange = pointRange[i - 5] + pointRange[i - 4] + pointRange[i - 3] + pointRange[i - 2] + pointRange[i - 1] - pointRange[i] * 10 + pointRange[i + 1] + pointRange[i + 2] + pointRange[i + 3] + pointRange[i + 4] + pointRange[i + 5];
+
+    cloudCurvature[i] = diffRange * diffRange;
+    // cloudSmoothness for sorting
+    cloudSmoothness[i].value = cloudCurvature[i];
+    cloudSmoothness[i].ind = i;
+  }
+}
+
+void FeatureExtractor::markOccludedPoints(int cloudSize)
+{
+  // mark occluded points and parallel beam points
+  for (int i = 5; i < cloudSize - 6; ++i)
+  {
+    // occluded points
+    float depth1 = pointRange[i];
+    float depth2 = pointRange[i + 1];
+    int columnDiff = std::abs(int(pointColInd[i + 1] - pointColInd[i]));
+
+    if (columnDiff < 10)
+    {
+      // 10 pixel diff in range image
+      if (depth1 - depth2 > 0.3)
+      {
+        for (int l = 0; l <= 5; l++)
+          cloudNeighborPicked[i - l] = 1;
+      }
+      else if (depth2 - depth1 > 0.3)
+      {
+        for (int l = 1; l <= 6; l++)
+          cloudNeighborPicked[i + l] = 1;
+      }
+    }
+    // parallel beam
+    float diff1 = std::abs(float(pointRange[i - 1] - pointRange[i]));
+    float diff2 = std::abs(float(pointRange[i + 1] - pointRange[i]));
+
+    if (diff1 > 0.02 * pointRange[i] && diff2 > 0.02 * pointRange[i])
+      cloudNeighborPicked[i] = 1;
+  }
+}
+
+void FeatureExtractor::extractFeatures(LabelledCloud &extractedCloud,
+                                       pcl::PointCloud<PointType> &cornerCloud,
+                                       pcl::PointCloud<PointType> &surfaceCloud)
+{
+  // mark the neighbours of a picked feature so that features do not cluster
+  auto pickNeighbors = [this](int ind) {
+    for (int l = 1; l <= 5; l++)
+    {
+      int columnDiff = std::abs(int(pointColInd[ind + l] - pointColInd[ind + l - 1]));
+      if (columnDiff > 10)
+        break;
+      cloudNeighborPicked[ind + l] = 1;
+    }
+    for (int l = -1; l >= -5; l--)
+    {
+      int columnDiff = std::abs(int(pointColInd[ind + l] - pointColInd[ind + l + 1]));
+      if (columnDiff > 10)
+        break;
+      cloudNeighborPicked[ind + l] = 1;
+    }
+  };
+
+  for (int i = 0; i < options.N_SCAN; i++)
+  {
+    surfaceCloudScan->clear();
+
+    for (int j = 0; j < 6; j++)
+    {
+      int sp = (startRingIndex[i] * (6 - j) + endRingIndex[i] * j) / 6;
+      int ep = (startRingIndex[i] * (5 - j) + endRingIndex[i] * (j + 1)) / 6 - 1;
+
+      if (sp >= ep)
+        continue;
+
+      std::sort(cloudSmoothness.begin() + sp, cloudSmoothness.begin() + ep,
+                [](const smoothness_t &left, const smoothness_t &right) { return left.value < right.value; });
+
+      int largestPickedNum = 0;
+      for (int k = ep; k >= sp; k--)
+      {
+        int ind = cloudSmoothness[k].ind;
+        if (cloudNeighborPicked[ind] == 0 && cloudCurvature[ind] > options.edgeThreshold)
+        {
+          largestPickedNum++;
+          if (largestPickedNum > 20)
+            break;
+          cloudLabel[ind] = 1;
+          extractedCloud.points[ind].label = LabelledPoint::Corner;
+          cornerCloud.push_back(fullCloud[pointFullInd[ind]]);
+          cornerCloud.points.back().normal_z = 1.0; //   for corner
+
+          cloudNeighborPicked[ind] = 1;
+          pickNeighbors(ind);
+        }
+      }
+
+      for (int k = sp; k <= ep; k++)
+      {
+        int ind = cloudSmoothness[k].ind;
+        if (cloudNeighborPicked[ind] == 0 && cloudCurvature[ind] < options.surfThreshold)
+        {
+          cloudLabel[ind] = -1;
+          cloudNeighborPicked[ind] = 1;
+          pickNeighbors(ind);
+        }
+      }
+
+      for (int k = sp; k <= ep; k++)
+      {
+        if (cloudLabel[k] <= 0)
+        {
+          extractedCloud.points[k].label = LabelledPoint::Surf;
+          surfaceCloudScan->push_back(fullCloud[pointFullInd[k]]);
+          surfaceCloudScan->points.back().normal_z = 2.0; //   for surf
+        }
+      }
+    }
+
+    PROFILE_SPAN(Downsample);
+    surfaceCloudScanDS->clear();
+    downSizeFilter.setInputCloud(surfaceCloudScan);
+    downSizeFilter.filter(*surfaceCloudScanDS);
+
+    surfaceCloud += *surfaceCloudScanDS;
+  }
+}
@@ -1,5 +1,12 @@
 #include "Estimator/IMUIntegrator.h"
 
+constexpr const double IMUIntegrator::acc_n;
+constexpr const double IMUIntegrator::gyr_n;
+constexpr const double IMUIntegrator::acc_w;
+constexpr const double IMUIntegrator::gyr_w;
+constexpr const double IMUIntegrator::lidar_m;
+constexpr const double IMUIntegrator::gnorm;
+
 IMUIntegrator::IMUIntegrator()
 {
   Reset();
@@ -35,6 +42,12 @@ void IMUIntegrator::Reset()
   linearized_ba.setZero();
 }
 
+void IMUIntegrator::Clear()
+{
+  vimuMsg.clear();
+  Reset();
+}
+
 const Eigen::Quaterniond &IMUIntegrator::GetDeltaQ() const { return dq; }
 
 const Eigen::Vector3d &IMUIntegrator::GetDeltaP() const { return dp; }
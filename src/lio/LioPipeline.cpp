@@ -0,0 +1,503 @@
+#include "Estimator/LioPipeline.h"
+
+LioPipeline::LioPipeline(const Options &options) : options(options), stationary(options.stationary)
+{
+  // set extrinsic matrix between lidar & IMU
+  exRbl << options.extrinsic_R[0], options.extrinsic_R[1], options.extrinsic_R[2],
+      options.extrinsic_R[3], options.extrinsic_R[4], options.extrinsic_R[5],
+      options.extrinsic_R[6], options.extrinsic_R[7], options.extrinsic_R[8];
+  exPbl << options.extrinsic_T[0], options.extrinsic_T[1], options.extrinsic_T[2];
+
+  std::cout << "exRbl: \n"
+            << exRbl << std::endl;
+  std::cout << "exPbl: " << exPbl.transpose() << std::endl;
+
+  Eigen::Quaterniond qr(exRbl); //  归一化处理
+  exRbl = qr.normalized().toRotationMatrix();
+
+  exRlb = exRbl.inverse();
+  exPlb = -1.0 * exRlb * exPbl;
+  exTlb.setIdentity();
+  exTlb.topLeftCorner(3, 3) = exRlb;
+  exTlb.topRightCorner(3, 1) = exPlb;
+  GravityVector.setZero();
+
+  WINDOWSIZE = options.IMU_Mode < 2 ? 1 : Estimator::MAXWINDOWSIZE;
+
+  estimator = new Estimator(options.filter_parameter_corner, options.filter_parameter_surf,
+                            options.assoc_trans_thres, options.assoc_rot_thres);
+  estimator->set_convergence_options(options.convergence);
+  estimator->set_keyframe_options(options.keyframe);
+  estimator->set_feature_options(options.features);
+  lidar_list = &currentFrameList;
+}
+
+/** \brief queue one IMU message, thread safe */
+void LioPipeline::PushImu(const sensor_msgs::ImuConstPtr &imu_msg)
+{
+  // push IMU msg to queue
+  std::unique_lock<std::mutex> lock(_mutexIMUQueue);
+  _imuMsgQueue.push(imu_msg);
+}
+
+bool LioPipeline::fetchImuMsgs(double startTime, double endTime, std::vector<sensor_msgs::ImuConstPtr> &vimuMsg)
+{
+  std::unique_lock<std::mutex> lock(_mutexIMUQueue);
+  double current_time = 0;
+  vimuMsg.clear();
+  while (true)
+  {
+    if (_imuMsgQueue.empty())
+      break;
+    if (_imuMsgQueue.back()->header.stamp.toSec() < endTime ||
+        _imuMsgQueue.front()->header.stamp.toSec() >= endTime)
+      break;
+    sensor_msgs::ImuConstPtr &tmpimumsg = _imuMsgQueue.front();
+    double time = tmpimumsg->header.stamp.toSec();
+    if (time <= endTime && time > startTime)
+    {
+      vimuMsg.push_back(tmpimumsg);
+      current_time = time;
+      _imuMsgQueue.pop();
+      if (time == endTime)
+        break;
+    }
+    else
+    {
+      if (time <= startTime)
+      {
+        _imuMsgQueue.pop();
+      }
+      else
+      {
+        double dt_1 = endTime - current_time;
+        double dt_2 = time - endTime;
+        ROS_ASSERT(dt_1 >= 0);
+        ROS_ASSERT(dt_2 >= 0);
+        ROS_ASSERT(dt_1 + dt_2 > 0);
+        double w1 = dt_2 / (dt_1 + dt_2);
+        double w2 = dt_1 / (dt_1 + dt_2);
+        sensor_msgs::ImuPtr theLastIMU(new sensor_msgs::Imu);
+        theLastIMU->linear_acceleration.x = w1 * vimuMsg.back()->linear_acceleration.x + w2 * tmpimumsg->linear_acceleration.x;
+        theLastIMU->linear_acceleration.y = w1 * vimuMsg.back()->linear_acceleration.y + w2 * tmpimumsg->linear_acceleration.y;
+        theLastIMU->linear_acceleration.z = w1 * vimuMsg.back()->linear_acceleration.z + w2 * tmpimumsg->linear_acceleration.z;
+        theLastIMU->angular_velocity.x = w1 * vimuMsg.back()->angular_velocity.x + w2 * tmpimumsg->angular_velocity.x;
+        theLastIMU->angular_velocity.y = w1 * vimuMsg.back()->angular_velocity.y + w2 * tmpimumsg->angular_velocity.y;
+        theLastIMU->angular_velocity.z = w1 * vimuMsg.back()->angular_velocity.z + w2 * tmpimumsg->angular_velocity.z;
+        theLastIMU->header.stamp.fromSec(endTime);
+        vimuMsg.emplace_back(theLastIMU);
+        break;
+      }
+    }
+  }
+  return !vimuMsg.empty();
+}
+
+/** \brief time span of the queued IMU messages
+ * \return false if the queue is empty
+ */
+bool LioPipeline::ImuQueueSpan(double &front, double &back)
+{
+  std::unique_lock<std::mutex> lock(_mutexIMUQueue);
+  if (_imuMsgQueue.empty())
+    return false;
+  front = _imuMsgQueue.front()->header.stamp.toSec();
+  back = _imuMsgQueue.back()->header.stamp.toSec();
+  return true;
+}
+
+/** \brief Remove Lidar Distortion
+ * \param[in] cloud: lidar cloud need to be undistorted
+ * \param[in] dRlc: delta rotation
+ * \param[in] dtlc: delta displacement
+ */
+void LioPipeline::RemoveLidarDistortion(LabelledCloud::Ptr &cloud,
+                                        const Eigen::Matrix3d &dRlc, const Eigen::Vector3d &dtlc)
+{
+  PROFILE_SPAN(Deskew);
+  // the bucket table is reused between scans
+  static thread_local Deskew deskew;
+  deskew.Apply(*cloud, dRlc, dtlc);
+}
+
+bool LioPipeline::TryMAPInitialization()
+{
+
+  Eigen::Vector3d average_acc = -lidarFrameList.begin()->imuIntegrator.GetAverageAcc();
+  double info_g = std::fabs(9.805 - average_acc.norm());
+  average_acc = average_acc * 9.805 / average_acc.norm();
+
+  // calculate the initial gravity direction
+  double para_quat[4];
+  para_quat[0] = 1;
+  para_quat[1] = 0;
+  para_quat[2] = 0;
+  para_quat[3] = 0;
+
+  ceres::LocalParameterization *quatParam = new ceres::QuaternionParameterization();
+  ceres::Problem problem_quat;
+
+  problem_quat.AddParameterBlock(para_quat, 4, quatParam);
+
+  problem_quat.AddResidualBlock(Cost_Initial_G::Create(average_acc),
+                                nullptr,
+                                para_quat);
+
+  ceres::Solver::Options options_quat;
+  ceres::Solver::Summary summary_quat;
+  ceres::Solve(options_quat, &problem_quat, &summary_quat);
+
+  Eigen::Quaterniond q_wg(para_quat[0], para_quat[1], para_quat[2], para_quat[3]);
+
+  // build prior factor of LIO initialization
+  Eigen::Vector3d prior_r = Eigen::Vector3d::Zero();
+  Eigen::Vector3d prior_ba = Eigen::Vector3d::Zero();
+  Eigen::Vector3d prior_bg = Eigen::Vector3d::Zero();
+  std::vector<Eigen::Vector3d> prior_v;
+  int v_size = lidarFrameList.size();
+  for (int i = 0; i < v_size; i++)
+  {
+    prior_v.push_back(Eigen::Vector3d::Zero());
+  }
+  Sophus::SO3d SO3_R_wg(q_wg.toRotationMatrix());
+  prior_r = SO3_R_wg.log();
+
+  for (int i = 1; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + (i - 1);
+    auto iter_next = lidarFrameList.begin() + i;
+
+    Eigen::Vector3d velo_imu = (iter_next->P - iter->P + iter_next->Q * exPlb - iter->Q * exPlb) / (iter_next->timeStamp - iter->timeStamp);
+    prior_v[i] = velo_imu;
+  }
+  prior_v[0] = prior_v[1];
+
+  double para_v[v_size][3];
+  double para_r[3];
+  double para_ba[3];
+  double para_bg[3];
+
+  for (int i = 0; i < 3; i++)
+  {
+    para_r[i] = 0;
+    para_ba[i] = 0;
+    para_bg[i] = 0;
+  }
+
+  for (int i = 0; i < v_size; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      para_v[i][j] = prior_v[i][j];
+    }
+  }
+
+  Eigen::Matrix<double, 3, 3> sqrt_information_r = 2000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_ba = 1000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_bg = 4000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_v = 4000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+
+  ceres::Problem::Options problem_options;
+  ceres::Problem problem(problem_options);
+  problem.AddParameterBlock(para_r, 3);
+  problem.AddParameterBlock(para_ba, 3);
+  problem.AddParameterBlock(para_bg, 3);
+  for (int i = 0; i < v_size; i++)
+  {
+    problem.AddParameterBlock(para_v[i], 3);
+  }
+
+  // add CostFunction
+  problem.AddResidualBlock(Cost_Initialization_Prior_R::Create(prior_r, sqrt_information_r),
+                           nullptr,
+                           para_r);
+
+  problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_ba, sqrt_information_ba),
+                           nullptr,
+                           para_ba);
+  problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_bg, sqrt_information_bg),
+                           nullptr,
+                           para_bg);
+
+  for (int i = 0; i < v_size; i++)
+  {
+    problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_v[i], sqrt_information_v),
+                             nullptr,
+                             para_v[i]);
+  }
+
+  for (int i = 1; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + (i - 1);
+    auto iter_next = lidarFrameList.begin() + i;
+
+    Eigen::Vector3d pi = iter->P + iter->Q * exPlb;
+    Sophus::SO3d SO3_Ri(iter->Q * exRlb);
+    Eigen::Vector3d ri = SO3_Ri.log();
+    Eigen::Vector3d pj = iter_next->P + iter_next->Q * exPlb;
+    Sophus::SO3d SO3_Rj(iter_next->Q * exRlb);
+    Eigen::Vector3d rj = SO3_Rj.log();
+
+    problem.AddResidualBlock(Cost_Initialization_IMU::Create(iter_next->imuIntegrator,
+                                                             ri,
+                                                             rj,
+                                                             pj - pi,
+                                                             Eigen::LLT<Eigen::Matrix<double, 9, 9>>(iter_next->imuIntegrator.GetCovariance().block<9, 9>(0, 0).inverse())
+                                                                 .matrixL()
+                                                                 .transpose()),
+                             nullptr,
+                             para_r,
+                             para_v[i - 1],
+                             para_v[i],
+                             para_ba,
+                             para_bg);
+  }
+
+  ceres::Solver::Options options;
+  options.minimizer_progress_to_stdout = false;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.num_threads = 6;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+
+  Eigen::Vector3d r_wg(para_r[0], para_r[1], para_r[2]);
+  GravityVector = Sophus::SO3d::exp(r_wg) * Eigen::Vector3d(0, 0, -9.805);
+
+  Eigen::Vector3d ba_vec(para_ba[0], para_ba[1], para_ba[2]);
+  Eigen::Vector3d bg_vec(para_bg[0], para_bg[1], para_bg[2]);
+
+  if (ba_vec.norm() > 0.5 || bg_vec.norm() > 0.5)
+  {
+    ROS_WARN("Too Large Biases! Initialization Failed!");
+    return false;
+  }
+
+  for (int i = 0; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + i;
+    iter->ba = ba_vec;
+    iter->bg = bg_vec;
+    Eigen::Vector3d bv_vec(para_v[i][0], para_v[i][1], para_v[i][2]);
+    if ((bv_vec - prior_v[i]).norm() > 2.0)
+    {
+      ROS_WARN("Too Large Velocity! Initialization Failed!");
+      std::cout << "delta v norm: " << (bv_vec - prior_v[i]).norm() << std::endl;
+      return false;
+    }
+    iter->V = bv_vec;
+  }
+
+  for (size_t i = 0; i < v_size - 1; i++)
+  {
+    auto laser_trans_i = lidarFrameList.begin() + i;
+    auto laser_trans_j = lidarFrameList.begin() + (i + 1);
+    laser_trans_j->imuIntegrator.PreIntegration(laser_trans_i->timeStamp, laser_trans_i->bg, laser_trans_i->ba);
+  }
+
+  // //if IMU success initialized
+  WINDOWSIZE = Estimator::SLIDEWINDOWSIZE;
+  while (lidarFrameList.size() > WINDOWSIZE)
+  {
+    lidarFrameList.pop_front();
+  }
+  Eigen::Vector3d Pwl = lidarFrameList.back().P;
+  Eigen::Quaterniond Qwl = lidarFrameList.back().Q;
+  lidarFrameList.back().P = Pwl + Qwl * exPlb;
+  lidarFrameList.back().Q = Qwl * exRlb;
+
+  // std::cout << "\n=============================\n| Initialization Successful |"<<"\n=============================\n" << std::endl;
+
+  return true;
+}
+
+/** \brief estimate the pose of one lidar frame
+ * \param[in] cloud: labelled lidar points in lidar frame, deskewed in place
+ * \param[in] time: time stamp of the frame
+ * \param[in] vimuMsg: IMU messages between the last frame and this one
+ * \return false if IMU is initialized but no IMU message arrived, the frame is dropped
+ */
+bool LioPipeline::ProcessFrame(const LabelledCloud::Ptr &cloud, double time,
+                               const std::vector<sensor_msgs::ImuConstPtr> &vimuMsg)
+{
+  TRACE_SCOPE("LioPipeline::ProcessFrame");
+  LabelledCloud::Ptr laserCloudFullRes = cloud;
+  nav_msgs::Odometry debugInfo;
+  debugInfo.pose.pose.position.x = 0;
+  debugInfo.pose.pose.position.y = 0;
+  debugInfo.pose.pose.position.z = 0;
+
+  // this lidar frame init, the scratch frame keeps the capacity of its IMU message vector
+  Estimator::LidarFrame &lidarFrame = scratchFrame;
+  lidarFrame.Reset();
+  lidarFrame.laserCloud = laserCloudFullRes;
+  lidarFrame.timeStamp = time;
+
+  if (!vimuMsg.empty())
+  {
+    if (!LidarIMUInited)
+    {
+      // if get IMU msg successfully, use gyro integration to update delta_Rl
+      lidarFrame.imuIntegrator.PushIMUMsg(vimuMsg);
+      lidarFrame.imuIntegrator.GyroIntegration(time_last_lidar);
+      delta_Rb = lidarFrame.imuIntegrator.GetDeltaQ().toRotationMatrix();
+      delta_Rl = exTlb.topLeftCorner(3, 3) * delta_Rb * exTlb.topLeftCorner(3, 3).transpose();
+
+      // predict current lidar pose
+      lidarFrame.P = transformAftMapped.topLeftCorner(3, 3) * delta_tb + transformAftMapped.topRightCorner(3, 1);
+      Eigen::Matrix3d m3d = transformAftMapped.topLeftCorner(3, 3) * delta_Rb;
+      lidarFrame.Q = m3d;
+
+      currentFrameList.clear();
+      currentFrameList.push_back(lidarFrame);
+      lidar_list = &currentFrameList;
+    }
+    else
+    {
+      // if get IMU msg successfully, use pre-integration to update delta lidar pose
+      lidarFrame.imuIntegrator.PushIMUMsg(vimuMsg);
+      lidarFrame.imuIntegrator.PreIntegration(lidarFrameList.back().timeStamp, lidarFrameList.back().bg, lidarFrameList.back().ba);
+
+      const Eigen::Vector3d &Pwbpre = lidarFrameList.back().P;
+      const Eigen::Quaterniond &Qwbpre = lidarFrameList.back().Q;
+      const Eigen::Vector3d &Vwbpre = lidarFrameList.back().V;
+
+      const Eigen::Quaterniond &dQ = lidarFrame.imuIntegrator.GetDeltaQ();
+      const Eigen::Vector3d &dP = lidarFrame.imuIntegrator.GetDeltaP();
+      const Eigen::Vector3d &dV = lidarFrame.imuIntegrator.GetDeltaV();
+      double dt = lidarFrame.imuIntegrator.GetDeltaTime();
+
+      lidarFrame.Q = Qwbpre * dQ;
+      lidarFrame.P = Pwbpre + Vwbpre * dt + 0.5 * GravityVector * dt * dt + Qwbpre * (dP);
+      lidarFrame.V = Vwbpre + GravityVector * dt + Qwbpre * (dV);
+      lidarFrame.bg = lidarFrameList.back().bg;
+      lidarFrame.ba = lidarFrameList.back().ba;
+
+      Eigen::Quaterniond Qwlpre = Qwbpre * Eigen::Quaterniond(exRbl);
+      Eigen::Vector3d Pwlpre = Qwbpre * exPbl + Pwbpre;
+
+      Eigen::Quaterniond Qwl = lidarFrame.Q * Eigen::Quaterniond(exRbl);
+      Eigen::Vector3d Pwl = lidarFrame.Q * exPbl + lidarFrame.P;
+
+      delta_Rl = Qwlpre.conjugate() * Qwl;
+      delta_tl = Qwlpre.conjugate() * (Pwl - Pwlpre);
+      // the preintegrated motion since the last processed frame also spans the skipped ones
+      FrameScheduler::ScanMotion(skippedFrames, delta_Rl, delta_tl);
+      delta_Rb = dQ.toRotationMatrix();
+      delta_tb = dP;
+
+      lidarFrameList.push_back(lidarFrame);
+      lidarFrameList.pop_front();
+      lidar_list = &lidarFrameList;
+
+      // a parked vehicle keeps the pose of the last frame, only the biases follow the IMU
+      isStationary = stationary.Update(lidarFrame.imuIntegrator, lidarFrame.bg, *laserCloudFullRes);
+      if (isStationary)
+      {
+        Estimator::LidarFrame &held = lidarFrameList.back();
+        held.P = lidarFrameList.front().P;
+        held.Q = lidarFrameList.front().Q;
+        held.V.setZero();
+        stationary.ZeroVelocityUpdate(held.Q, GravityVector, held.bg, held.ba);
+        stationaryFrames++;
+        ROS_DEBUG("stationary frame, %zu so far, bg %.5f ba %.4f", stationaryFrames, held.bg.norm(), held.ba.norm());
+      }
+    }
+  }
+  else
+  {
+    if (LidarIMUInited)
+      return false;
+    else
+    {
+      // predict current lidar pose
+      lidarFrame.P = transformAftMapped.topLeftCorner(3, 3) * delta_tb + transformAftMapped.topRightCorner(3, 1);
+      Eigen::Matrix3d m3d = transformAftMapped.topLeftCorner(3, 3) * delta_Rb;
+      lidarFrame.Q = m3d;
+
+      currentFrameList.clear();
+      currentFrameList.push_back(lidarFrame);
+      lidar_list = &currentFrameList;
+    }
+  }
+
+  // a stationary frame needs neither deskewing nor the feature split, association and solve
+  if (!isStationary)
+  {
+    // remove lidar distortion
+    RemoveLidarDistortion(laserCloudFullRes, delta_Rl, delta_tl);
+
+    // optimize current lidar pose with IMU
+    estimator->EstimateLidarPose(*lidar_list, exTlb, GravityVector, debugInfo);
+  }
+  skippedFrames = 0;
+
+  transformTobeMapped = Eigen::Matrix4d::Identity();
+  transformTobeMapped.topLeftCorner(3, 3) = lidar_list->front().Q * exRbl;
+  transformTobeMapped.topRightCorner(3, 1) = lidar_list->front().Q * exPbl + lidar_list->front().P;
+
+  // update delta transformation
+  delta_Rb = transformAftMapped.topLeftCorner(3, 3).transpose() * lidar_list->front().Q.toRotationMatrix();
+  delta_tb = transformAftMapped.topLeftCorner(3, 3).transpose() * (lidar_list->front().P - transformAftMapped.topRightCorner(3, 1));
+
+  Eigen::Matrix3d Rwlpre = transformAftMapped.topLeftCorner(3, 3) * exRbl;
+  Eigen::Vector3d Pwlpre = transformAftMapped.topLeftCorner(3, 3) * exPbl + transformAftMapped.topRightCorner(3, 1);
+  delta_Rl = Rwlpre.transpose() * transformTobeMapped.topLeftCorner(3, 3);
+  delta_tl = Rwlpre.transpose() * (transformTobeMapped.topRightCorner(3, 1) - Pwlpre);
+  transformAftMapped.topLeftCorner(3, 3) = lidar_list->front().Q.toRotationMatrix();
+  transformAftMapped.topRightCorner(3, 1) = lidar_list->front().P;
+
+  // if tightly coupled IMU message, start IMU initialization
+  if (options.IMU_Mode > 1 && !LidarIMUInited)
+  {
+    // update lidar frame pose
+    lidarFrame.P = transformTobeMapped.topRightCorner(3, 1);
+    Eigen::Matrix3d m3d = transformTobeMapped.topLeftCorner(3, 3);
+    lidarFrame.Q = m3d;
+
+    if (pushCount == 0)
+    {
+      lidarFrameList.push_back(lidarFrame);
+      lidarFrameList.back().imuIntegrator.Reset();
+      if (lidarFrameList.size() > WINDOWSIZE)
+        lidarFrameList.pop_front();
+    }
+    else
+    {
+      lidarFrameList.back().laserCloud = lidarFrame.laserCloud;
+      lidarFrameList.back().imuIntegrator.PushIMUMsg(vimuMsg);
+      lidarFrameList.back().timeStamp = lidarFrame.timeStamp;
+      lidarFrameList.back().P = lidarFrame.P;
+      lidarFrameList.back().Q = lidarFrame.Q;
+    }
+    pushCount++;
+    if (pushCount >= 3)
+    {
+      pushCount = 0;
+      if (lidarFrameList.size() > 1)
+      {
+        auto iterRight = lidarFrameList.end() - 1;
+        auto iterLeft = lidarFrameList.end() - 2;
+        iterRight->imuIntegrator.PreIntegration(iterLeft->timeStamp, iterLeft->bg, iterLeft->ba);
+      }
+
+      if (lidarFrameList.size() == int(WINDOWSIZE / 1.5))
+      {
+        startTime = lidarFrameList.back().timeStamp;
+      }
+
+      if (!LidarIMUInited && lidarFrameList.size() == WINDOWSIZE && lidarFrameList.front().timeStamp >= startTime)
+      {
+        std::cout << "**************Start MAP Initialization!!!******************" << std::endl;
+        if (TryMAPInitialization())
+        {
+          LidarIMUInited = true;
+          pushCount = 0;
+          startTime = 0;
+        }
+        std::cout << "**************Finish MAP Initialization!!!******************" << std::endl;
+      }
+    }
+  }
+  time_last_lidar = time;
+  return true;
+}
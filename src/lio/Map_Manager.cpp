@@ -1,4 +1,5 @@
 #include "Estimator/Map_Manager.h"
+#include "utils/Profiler.h"
 #include <fstream>
 
 MAP_MANAGER::MAP_MANAGER(const float &filter_corner, const float &filter_surf)
@@ -12,9 +13,9 @@ MAP_MANAGER::MAP_MANAGER(const float &filter_corner, const float &filter_surf)
     laserCloudSurfArrayStack[i].reset(new pcl::PointCloud<PointType>());
     laserCloudNonFeatureArrayStack[i].reset(new pcl::PointCloud<PointType>());
 
-    laserCloudCornerKdMap[i].reset(new pcl::KdTreeFLANN<PointType>);
-    laserCloudSurfKdMap[i].reset(new pcl::KdTreeFLANN<PointType>);
-    laserCloudNonFeatureKdMap[i].reset(new pcl::KdTreeFLANN<PointType>);
+    laserCloudCornerKdMap[i].reset(new StaticKdTree<PointType>);
+    laserCloudSurfKdMap[i].reset(new StaticKdTree<PointType>);
+    laserCloudNonFeatureKdMap[i].reset(new StaticKdTree<PointType>);
   }
   for (int i = 0; i < localMapWindowSize; i++)
   {
@@ -94,10 +95,11 @@ void MAP_MANAGER::MapIncrement(const pcl::PointCloud<PointType>::Ptr &laserCloud
                                const pcl::PointCloud<PointType>::Ptr &laserCloudNonFeatureStack,
                                const Eigen::Matrix4d &transformTobeMapped)
 {
-
-  clock_t t0, t1, t2, t3, t4, t5;
-  t0 = clock();
-  std::unique_lock<std::mutex> locker2(mtx_MapManager);
+  std::unique_lock<std::mutex> locker2(mtx_MapManager, std::defer_lock);
+  {
+    TRACE_SCOPE("wait mtx_MapManager");
+    locker2.lock();
+  }
   for (int i = 0; i < laserCloudNum; i++)
   {
     CornerKdMap_last[i] = *laserCloudCornerKdMap[i];
@@ -114,10 +116,8 @@ void MAP_MANAGER::MapIncrement(const pcl::PointCloud<PointType>::Ptr &laserCloud
 
   locker2.unlock();
 
-  t1 = clock();
   MapMove(transformTobeMapped);
 
-  t2 = clock();
   int laserCloudCornerStackNum = laserCloudCornerStack->points.size();
   int laserCloudSurfStackNum = laserCloudSurfStack->points.size();
   int laserCloudNonFeatureStackNum = laserCloudNonFeatureStack->points.size();
@@ -200,64 +200,69 @@ void MAP_MANAGER::MapIncrement(const pcl::PointCloud<PointType>::Ptr &laserCloud
     }
   }
 
-  t3 = clock();
-
-  laserCloudCornerFromMap->clear();
-  laserCloudSurfFromMap->clear();
-  laserCloudNonFeatureFromMap->clear();
-  for (int i = 0; i < laserCloudNum; i++)
+  // rebuild the kd-trees of the changed cubes
   {
-    if (CornerChangeFlag[i])
+    PROFILE_SPAN(KdBuild);
+    laserCloudCornerFromMap->clear();
+    laserCloudSurfFromMap->clear();
+    laserCloudNonFeatureFromMap->clear();
+    for (int i = 0; i < laserCloudNum; i++)
     {
-      if (laserCloudCornerArray[i]->points.size() > 300)
+      if (CornerChangeFlag[i])
       {
-        downSizeFilterCorner.setInputCloud(laserCloudCornerArray[i]);
-        laserCloudCornerArrayStack[i]->clear();
-        downSizeFilterCorner.filter(*laserCloudCornerArrayStack[i]);
-        pcl::PointCloud<PointType>::Ptr tmp = laserCloudCornerArrayStack[i];
-        laserCloudCornerArrayStack[i] = laserCloudCornerArray[i];
-        laserCloudCornerArray[i] = tmp;
-      }
+        if (laserCloudCornerArray[i]->points.size() > 300)
+        {
+          downSizeFilterCorner.setInputCloud(laserCloudCornerArray[i]);
+          laserCloudCornerArrayStack[i]->clear();
+          downSizeFilterCorner.filter(*laserCloudCornerArrayStack[i]);
+          pcl::PointCloud<PointType>::Ptr tmp = laserCloudCornerArrayStack[i];
+          laserCloudCornerArrayStack[i] = laserCloudCornerArray[i];
+          laserCloudCornerArray[i] = tmp;
+        }
 
-      laserCloudCornerKdMap[i]->setInputCloud(laserCloudCornerArray[i]);
-      *laserCloudCornerFromMap += *laserCloudCornerKdMap[i]->getInputCloud();
-    }
+        laserCloudCornerKdMap[i]->setInputCloud(laserCloudCornerArray[i]);
+        *laserCloudCornerFromMap += *laserCloudCornerKdMap[i]->getInputCloud();
+      }
 
-    if (SurfChangeFlag[i])
-    {
-      if (laserCloudSurfArray[i]->points.size() > 300)
+      if (SurfChangeFlag[i])
       {
-        downSizeFilterSurf.setInputCloud(laserCloudSurfArray[i]);
-        laserCloudSurfArrayStack[i]->clear();
-        downSizeFilterSurf.filter(*laserCloudSurfArrayStack[i]);
-        pcl::PointCloud<PointType>::Ptr tmp = laserCloudSurfArrayStack[i];
-        laserCloudSurfArrayStack[i] = laserCloudSurfArray[i];
-        laserCloudSurfArray[i] = tmp;
-      }
+        if (laserCloudSurfArray[i]->points.size() > 300)
+        {
+          downSizeFilterSurf.setInputCloud(laserCloudSurfArray[i]);
+          laserCloudSurfArrayStack[i]->clear();
+          downSizeFilterSurf.filter(*laserCloudSurfArrayStack[i]);
+          pcl::PointCloud<PointType>::Ptr tmp = laserCloudSurfArrayStack[i];
+          laserCloudSurfArrayStack[i] = laserCloudSurfArray[i];
+          laserCloudSurfArray[i] = tmp;
+        }
 
-      laserCloudSurfKdMap[i]->setInputCloud(laserCloudSurfArray[i]);
-      *laserCloudSurfFromMap += *laserCloudSurfKdMap[i]->getInputCloud();
-    }
+        laserCloudSurfKdMap[i]->setInputCloud(laserCloudSurfArray[i]);
+        *laserCloudSurfFromMap += *laserCloudSurfKdMap[i]->getInputCloud();
+      }
 
-    if (NonFeatureChangeFlag[i])
-    {
-      if (laserCloudNonFeatureArray[i]->points.size() > 300)
+      if (NonFeatureChangeFlag[i])
       {
-        downSizeFilterNonFeature.setInputCloud(laserCloudNonFeatureArray[i]);
-        laserCloudNonFeatureArrayStack[i]->clear();
-        downSizeFilterNonFeature.filter(*laserCloudNonFeatureArrayStack[i]);
-        pcl::PointCloud<PointType>::Ptr tmp = laserCloudNonFeatureArrayStack[i];
-        laserCloudNonFeatureArrayStack[i] = laserCloudNonFeatureArray[i];
-        laserCloudNonFeatureArray[i] = tmp;
-      }
+        if (laserCloudNonFeatureArray[i]->points.size() > 300)
+        {
+          downSizeFilterNonFeature.setInputCloud(laserCloudNonFeatureArray[i]);
+          laserCloudNonFeatureArrayStack[i]->clear();
+          downSizeFilterNonFeature.filter(*laserCloudNonFeatureArrayStack[i]);
+          pcl::PointCloud<PointType>::Ptr tmp = laserCloudNonFeatureArrayStack[i];
+          laserCloudNonFeatureArrayStack[i] = laserCloudNonFeatureArray[i];
+          laserCloudNonFeatureArray[i] = tmp;
+        }
 
-      laserCloudNonFeatureKdMap[i]->setInputCloud(laserCloudNonFeatureArray[i]);
-      *laserCloudNonFeatureFromMap += *laserCloudNonFeatureKdMap[i]->getInputCloud();
+        laserCloudNonFeatureKdMap[i]->setInputCloud(laserCloudNonFeatureArray[i]);
+        *laserCloudNonFeatureFromMap += *laserCloudNonFeatureKdMap[i]->getInputCloud();
+      }
     }
   }
 
-  t4 = clock();
-  std::unique_lock<std::mutex> locker(mtx_MapManager);
+  std::unique_lock<std::mutex> locker(mtx_MapManager, std::defer_lock);
+  {
+    TRACE_SCOPE("wait mtx_MapManager");
+    locker.lock();
+  }
   for (int i = 0; i < laserCloudNum; i++)
   {
     CornerKdMap_copy[i] = *laserCloudCornerKdMap[i];
@@ -266,7 +271,6 @@ void MAP_MANAGER::MapIncrement(const pcl::PointCloud<PointType>::Ptr &laserCloud
   }
 
   locker.unlock();
-  t5 = clock();
 
   currentUpdatePos++;
 }
@@ -304,12 +308,12 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int k = 0; k < laserCloudHeight; k++)
       {
         int i = laserCloudDepth - 1;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
 
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
@@ -356,11 +360,11 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int k = 0; k < laserCloudHeight; k++)
       {
         int i = 0;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
@@ -406,11 +410,11 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int k = 0; k < laserCloudHeight; k++)
       {
         int j = laserCloudWidth - 1;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
@@ -455,11 +459,11 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int k = 0; k < laserCloudHeight; k++)
       {
         int j = 0;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
@@ -504,11 +508,11 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int j = 0; j < laserCloudWidth; j++)
       {
         int k = laserCloudHeight - 1;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
@@ -553,11 +557,11 @@ void MAP_MANAGER::MapMove(const Eigen::Matrix4d &transformTobeMapped)
       for (int j = 0; j < laserCloudWidth; j++)
       {
         int k = 0;
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeCornerPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeCornerPointerKd =
             laserCloudCornerKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeSurfPointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeSurfPointerKd =
             laserCloudSurfKdMap[ToIndex(i, j, k)];
-        pcl::KdTreeFLANN<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
+        StaticKdTree<PointType>::Ptr laserCloudCubeNonFeaturePointerKd =
             laserCloudNonFeatureKdMap[ToIndex(i, j, k)];
 
         pcl::PointCloud<PointType>::Ptr laserCloudCubeCornerPointer =
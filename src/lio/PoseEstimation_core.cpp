@@ -0,0 +1,200 @@
+#include "lio/PoseEstimation.h"
+
+PoseEstimation::PoseEstimation(ros::NodeHandle &nh, bool subscribe_cloud)
+{
+  LioPipeline::Options options;
+  std::string imu_topic;
+
+  nh.param<std::string>("common/imuTopic", imu_topic, "/livox/imu");
+  nh.param<float>("mapping/filter_parameter_corner", options.filter_parameter_corner, 0.3);
+  nh.param<float>("mapping/filter_parameter_surf", options.filter_parameter_surf, 0.3);
+  nh.param<int>("mapping/IMU_Mode", options.IMU_Mode, 0);
+  nh.param<double>("mapping/assoc_trans_thres", options.assoc_trans_thres, 0.1);
+  nh.param<double>("mapping/assoc_rot_thres", options.assoc_rot_thres, 1.0);
+  nh.param<int>("mapping/max_iters", options.convergence.max_iters, 5);
+  nh.param<double>("mapping/converge_trans", options.convergence.trans_thres, 0.05);
+  nh.param<double>("mapping/converge_rot", options.convergence.rot_thres, 0.05);
+  nh.param<double>("mapping/converge_cost", options.convergence.cost_thres, 0.01);
+  nh.param<bool>("mapping/keyframe_enable", options.keyframe.enable, false);
+  nh.param<double>("mapping/keyframe_trans", options.keyframe.trans_thres, 1.0);
+  nh.param<double>("mapping/keyframe_rot", options.keyframe.rot_thres, 10.0);
+  nh.param<double>("mapping/keyframe_novelty", options.keyframe.novelty_thres, 0.2);
+  nh.param<double>("mapping/map_voxel_size", options.keyframe.voxel_size, 0.4);
+  nh.param<int>("mapping/map_voxel_max_points", options.keyframe.max_points_per_voxel, 5);
+  nh.param<bool>("mapping/stationary_enable", options.stationary.enable, false);
+  nh.param<double>("mapping/stationary_gyro", options.stationary.gyro_thres, 0.02);
+  nh.param<double>("mapping/stationary_acc_std", options.stationary.acc_std_thres, 0.05);
+  nh.param<double>("mapping/stationary_scan_change", options.stationary.scan_change, 0.1);
+  nh.param<int>("mapping/stationary_frames", options.stationary.min_frames, 3);
+  nh.param<bool>("mapping/feature_budget_enable", options.features.enable, false);
+  nh.param<double>("mapping/feature_budget_target_ms", options.features.target_ms, 50.0);
+  nh.param<int>("mapping/feature_budget_min", options.features.min_budget, 300);
+  nh.param<int>("mapping/feature_budget_max", options.features.max_budget, 3000);
+  FrameScheduler::Options schedule_options;
+  nh.param<bool>("mapping/schedule_enable", schedule_options.enable, false);
+  nh.param<double>("mapping/schedule_latency", schedule_options.latency_budget, 0.2);
+  nh.param<int>("mapping/schedule_max_skips", schedule_options.max_skips, 2);
+  nh.param<int>("mapping/schedule_degraded_iters", schedule_options.degraded_iters, 2);
+  nh.param<double>("mapping/schedule_degraded_leaf_scale", schedule_options.degraded_leaf_scale, 2.0);
+  scheduler = FrameScheduler(schedule_options);
+  nh.param<std::vector<double>>("mapping/extrinsic_T", options.extrinsic_T, std::vector<double>());
+  nh.param<std::vector<double>>("mapping/extrinsic_R", options.extrinsic_R, std::vector<double>());
+
+  pipeline = new LioPipeline(options);
+
+  if (subscribe_cloud)
+    subFullCloud = nh.subscribe<sensor_msgs::PointCloud2>("/laser_cloud_filtered", 10, &PoseEstimation::fullCallBack, this);
+  if (options.IMU_Mode > 0)
+    sub_imu = nh.subscribe(imu_topic, 2000, &PoseEstimation::imu_callback, this /*, ros::TransportHints().unreliable()*/);
+
+  pubFullLaserCloud = nh.advertise<sensor_msgs::PointCloud2>("/full_cloud_mapped", 10);
+  pubLaserOdometry = nh.advertise<nav_msgs::Odometry>("/odometry_mapped", 5);
+  pubLaserOdometryPath = nh.advertise<nav_msgs::Path>("/odometry_path_mapped", 5);
+
+  tfBroadcaster = new tf::TransformBroadcaster();
+}
+
+void PoseEstimation::fullCallBack(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+  PROFILE_SPAN(Ingest);
+  LabelledCloud::Ptr cloud = cloudPool.Acquire();
+  pcl::fromROSMsg(*msg, *cloud);
+  PushCloud(msg->header.stamp.toSec(), cloud);
+}
+
+void PoseEstimation::pubOdometry(const Eigen::Matrix4d &newPose, double &timefullCloud)
+{
+  nav_msgs::Odometry laserOdometry;
+
+  Eigen::Matrix3d Rcurr = newPose.topLeftCorner(3, 3);
+  Eigen::Quaterniond newQuat(Rcurr);
+  Eigen::Vector3d newPosition = newPose.topRightCorner(3, 1);
+  laserOdometry.header.frame_id = "/world";
+  laserOdometry.child_frame_id = "/livox_frame";
+  laserOdometry.header.stamp = ros::Time().fromSec(timefullCloud);
+  laserOdometry.pose.pose.orientation.x = newQuat.x();
+  laserOdometry.pose.pose.orientation.y = newQuat.y();
+  laserOdometry.pose.pose.orientation.z = newQuat.z();
+  laserOdometry.pose.pose.orientation.w = newQuat.w();
+  laserOdometry.pose.pose.position.x = newPosition.x();
+  laserOdometry.pose.pose.position.y = newPosition.y();
+  laserOdometry.pose.pose.position.z = newPosition.z();
+  pubLaserOdometry.publish(laserOdometry);
+
+  geometry_msgs::PoseStamped laserPose;
+  laserPose.header = laserOdometry.header;
+  laserPose.pose = laserOdometry.pose.pose;
+  laserOdoPath.header.stamp = laserOdometry.header.stamp;
+  laserOdoPath.poses.push_back(laserPose);
+  laserOdoPath.header.frame_id = "/world";
+  pubLaserOdometryPath.publish(laserOdoPath);
+
+  laserOdometryTrans.frame_id_ = "/world";
+  laserOdometryTrans.child_frame_id_ = "/livox_frame";
+  laserOdometryTrans.stamp_ = ros::Time().fromSec(timefullCloud);
+  laserOdometryTrans.setRotation(tf::Quaternion(newQuat.x(), newQuat.y(), newQuat.z(), newQuat.w()));
+  laserOdometryTrans.setOrigin(tf::Vector3(newPosition.x(), newPosition.y(), newPosition.z()));
+  tfBroadcaster->sendTransform(laserOdometryTrans);
+}
+
+void PoseEstimation::process()
+{
+  TRACE_THREAD_NAME("PoseEstimation::process");
+  std::vector<sensor_msgs::ImuConstPtr> vimuMsg;
+  while (ros::ok())
+  {
+    bool newfullCloud = false;
+    double time_curr_lidar = -1;
+    size_t queued = 0;
+    LabelledCloud::Ptr laserCloudFullRes;
+    std::unique_lock<std::mutex> lock_lidar(_mutexLidarQueue);
+    if (!_lidarMsgQueue.empty())
+    {
+      // get new lidar msg
+      time_curr_lidar = _lidarMsgQueue.front().first;
+      laserCloudFullRes = _lidarMsgQueue.front().second;
+      _lidarMsgQueue.pop_front();
+      queued = _lidarMsgQueue.size();
+      newfullCloud = true;
+    }
+    lock_lidar.unlock();
+
+    if (newfullCloud)
+    {
+      // the initialization window needs every frame in full
+      FrameScheduler::Action action = FrameScheduler::Full;
+      if (!pipeline->IsInitializing())
+        action = scheduler.Decide(time_curr_lidar, ros::Time::now().toSec(), queued, pipeline->IsLidarIMUInited());
+      if (action == FrameScheduler::Skip)
+      {
+        // the IMU messages stay queued for the next frame
+        pipeline->SkipFrame();
+        ROS_DEBUG("frame %.3f: skip, %zu frames queued", time_curr_lidar, queued);
+        continue;
+      }
+      const FrameScheduler::Options &schedule = scheduler.GetOptions();
+      pipeline->estimator->set_degraded(action == FrameScheduler::Degraded, schedule.degraded_iters, schedule.degraded_leaf_scale);
+      const auto processStart = std::chrono::steady_clock::now();
+
+      if (pipeline->NeedImu())
+      {
+        // get IMU msg int the Specified time interval
+        vimuMsg.clear();
+        int countFail = 0;
+        while (!pipeline->fetchImuMsgs(pipeline->LastLidarTime(), time_curr_lidar, vimuMsg))
+        {
+          countFail++;
+          if (countFail > 100)
+          {
+            double front, back;
+            if (!pipeline->ImuQueueSpan(front, back))
+              std::cout << "imu queue is empty." << std::endl;
+            else
+              std::cout << "imu time: " << front << "-->" << back << std::endl;
+            break;
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+      }
+
+      if (!pipeline->ProcessFrame(laserCloudFullRes, time_curr_lidar, vimuMsg))
+        break;
+
+      const Estimator::LidarFrame &frame = pipeline->CurrentFrame();
+      Eigen::Matrix4d transformTobeMapped = pipeline->GetLidarPose();
+      double timeStamp = frame.timeStamp;
+
+      PROFILE_SPAN(Publish);
+      // publish odometry rostopic
+      pubOdometry(transformTobeMapped, timeStamp);
+      scheduler.Done(time_curr_lidar, ros::Time::now().toSec(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - processStart).count());
+      ROS_DEBUG("frame %.3f: %s, latency %.3f s", time_curr_lidar, FrameScheduler::Name(action), scheduler.LastLatency());
+      if (action != FrameScheduler::Full)
+        ROS_WARN_THROTTLE(5.0, "behind the lidar: %zu frames skipped, %zu degraded, latency %.3f s (max %.3f s)",
+                          scheduler.Count(FrameScheduler::Skip), scheduler.Count(FrameScheduler::Degraded),
+                          scheduler.LastLatency(), scheduler.MaxLatency());
+
+      // publish lidar points
+      if (pubFullLaserCloud.getNumSubscribers() == 0)
+        continue;
+      int laserCloudFullResNum = frame.laserCloud->points.size();
+      laserCloudAfterEstimate = *frame.laserCloud;
+      const Eigen::Matrix3f R = transformTobeMapped.topLeftCorner(3, 3).cast<float>();
+      const Eigen::Vector3f t = transformTobeMapped.topRightCorner(3, 1).cast<float>();
+      for (int i = 0; i < laserCloudFullResNum; i++)
+      {
+        LabelledPoint &p = laserCloudAfterEstimate.points[i];
+        Eigen::Vector3f pw = R * Eigen::Vector3f(p.x, p.y, p.z) + t;
+        p.x = pw.x();
+        p.y = pw.y();
+        p.z = pw.z();
+      }
+      sensor_msgs::PointCloud2 laserCloudMsg;
+      pcl::toROSMsg(laserCloudAfterEstimate, laserCloudMsg);
+      laserCloudMsg.header.frame_id = "/world";
+      laserCloudMsg.header.stamp.fromSec(timeStamp);
+      pubFullLaserCloud.publish(laserCloudMsg);
+    }
+  }
+}
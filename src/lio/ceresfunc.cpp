@@ -1,7 +1,10 @@
 #include "Estimator/ceresfunc.h"
+#include "utils/Profiler.h"
 
 void *ThreadsConstructA(void *threadsstruct)
 {
+  TRACE_THREAD_NAME("marginalization worker");
+  TRACE_SCOPE("ThreadsConstructA");
   ThreadsStruct *p = ((ThreadsStruct *)threadsstruct);
   for (auto it : p->sub_factors)
   {
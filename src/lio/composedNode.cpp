@@ -0,0 +1,62 @@
+/*
+ * Feature extraction and one estimator in a single process. The labelled cloud of every scan is
+ * handed from the extractor to the estimator queue as a pointer, instead of being serialized to
+ * /laser_cloud_filtered, sent over the loopback and deserialized again.
+ *
+ * ~estimator: "lio" runs the PoseEstimation odometry, "loc" the map localization.
+ * The separate featureExtract / poseEstimate / maplocalization nodes stay available for debugging.
+ */
+#include "lio/featureExtract.h"
+#include "lio/PoseEstimation.h"
+#include "loc/map_location.h"
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "LIO_Composed");
+  ros::NodeHandle nh;
+  ros::NodeHandle pnh("~");
+
+  std::string estimator;
+  pnh.param<std::string>("estimator", estimator, "lio");
+  ROS_INFO("\033[1;32m----> Feature Extraction + %s Started.\033[0m", estimator.c_str());
+
+  std::string root_dir = ROOT_DIR;
+  std::cout << "ROOT_DIR: " << root_dir << std::endl;
+  std::string command = "mkdir -p " + root_dir + "Log";
+  system(command.c_str());
+
+  std::thread thread_process;
+  // before the pipeline threads start so their lanes are named, declared after the thread so the
+  // trace is written before the thread is destroyed
+  TraceDumper traceDumper(nh, root_dir + "Log/composed_trace.json");
+
+  FeatureExtract FE;
+  if (estimator == "loc")
+  {
+    map_location *lol = new map_location();
+    lol->UnsubscribeCloud();
+    FE.SetCloudSink([lol](double time, const LabelledCloud::Ptr &cloud)
+                    { lol->PushCloud(time, cloud); });
+    // the profiler is process wide, map_location already reports it
+    FE.profilerPublisher.reset();
+    thread_process = std::thread(&map_location::run, lol);
+  }
+  else if (estimator == "lio")
+  {
+    PoseEstimation *estimation = new PoseEstimation(nh, false);
+    FE.SetCloudSink([estimation](double time, const LabelledCloud::Ptr &cloud)
+                    { estimation->PushCloud(time, cloud); });
+    FE.profilerPublisher.reset(new ProfilerPublisher(nh, "LIO_Composed", root_dir + "Log/composed_latency.csv"));
+    thread_process = std::thread(&PoseEstimation::process, estimation);
+  }
+  else
+  {
+    ROS_ERROR_STREAM("Invalid estimator (must be either 'lio' or 'loc'): " << estimator);
+    return 1;
+  }
+
+  TRACE_THREAD_NAME("ros spinner");
+  ros::spin();
+
+  return 0;
+}
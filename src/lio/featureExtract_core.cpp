@@ -0,0 +1,289 @@
+#include "lio/featureExtract.h"
+
+FeatureExtract::FeatureExtract()
+{
+    nh.param<std::string>("common/pointCloudTopic", pointCloudTopic, "points_raw");
+    nh.param<std::string>("feature_extract/lidarFrame", lidarFrameStr, "base_link");
+
+    std::string sensorStr;
+    nh.param<std::string>("feature_extract/sensor", sensorStr, "");
+    if (sensorStr == "velodyne")
+    {
+        sensor = SensorType::VELODYNE;
+    }
+    else if (sensorStr == "livox")
+    {
+        sensor = SensorType::LIVOX;
+    }
+    else if (sensorStr == "ouster")
+    {
+        sensor = SensorType::OUSTER;
+    }
+    else if (sensorStr == "robosense")
+    {
+        sensor = SensorType::ROBOSENSE;
+    }
+    else
+    {
+        ROS_ERROR_STREAM(
+            "Invalid sensor type (must be either 'velodyne' 'ouster' 'robosense' or 'livox'): " << sensorStr);
+        ros::shutdown();
+    }
+    std::cout << "-- " << sensorStr << ": " << int(sensor) << std::endl;
+
+    nh.param<int>("feature_extract/N_SCAN", N_SCAN, 16);
+    nh.param<int>("feature_extract/Horizon_SCAN", Horizon_SCAN, 1800);
+    nh.param<int>("feature_extract/downsampleRate", downsampleRate, 1);
+    nh.param<float>("feature_extract/lidarMinRange", lidarMinRange, 1.0);
+    nh.param<float>("feature_extract/lidarMaxRange", lidarMaxRange, 1000.0);
+
+    nh.param<float>("feature_extract/edgeThreshold", edgeThreshold, 0.1);
+    nh.param<float>("feature_extract/surfThreshold", surfThreshold, 0.1);
+    nh.param<int>("feature_extract/edgeFeatureMinValidNum", edgeFeatureMinValidNum, 10);
+    nh.param<int>("feature_extract/surfFeatureMinValidNum", surfFeatureMinValidNum, 100);
+
+    nh.param<float>("feature_extract/odometrySurfLeafSize", odometrySurfLeafSize, 0.2);
+
+    subLaserCloud = nh.subscribe<sensor_msgs::PointCloud2>(pointCloudTopic, 50, &FeatureExtract::cloudHandler, this);
+
+    pubCornerPoints = nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_edge", 1);
+    pubSurfacePoints = nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_surf", 1);
+    pubFullPoints = nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_filtered", 10);
+    pubLaserCloudInfo = nh.advertise<LIO_Localization::cloud_info>("/feature/cloud_info", 1);
+    profilerPublisher.reset(new ProfilerPublisher(nh, "FeatureExtract", std::string(ROOT_DIR) + "Log/featureExtract_latency.csv"));
+
+    allocateMemory();
+    resetParameters();
+}
+
+void FeatureExtract::allocateMemory()
+{
+    laserCloudIn.reset(new pcl::PointCloud<PointXYZIRT>());
+    tmpOusterCloudIn.reset(new pcl::PointCloud<OusterPointXYZIRT>());
+    tmpRSCloudIn.reset(new pcl::PointCloud<rsPointXYZIRT>());
+    inputCloud.reset(new pcl::PointCloud<PointType>());
+    cloudPool.reset(new CloudPool<LabelledPoint>(16, N_SCAN * Horizon_SCAN));
+    extractedCloud = cloudPool->Acquire();
+    cornerCloud.reset(new pcl::PointCloud<PointType>());
+    surfaceCloud.reset(new pcl::PointCloud<PointType>());
+
+    FeatureExtractor::Options options;
+    options.N_SCAN = N_SCAN;
+    options.Horizon_SCAN = Horizon_SCAN;
+    options.downsampleRate = downsampleRate;
+    options.lidarMinRange = lidarMinRange;
+    options.lidarMaxRange = lidarMaxRange;
+    options.edgeThreshold = edgeThreshold;
+    options.surfThreshold = surfThreshold;
+    options.odometrySurfLeafSize = odometrySurfLeafSize;
+    options.sequentialColumns = sensor == SensorType::LIVOX;
+    extractor.reset(new FeatureExtractor(options));
+
+    resetParameters();
+}
+
+void FeatureExtract::cloudHandler(const sensor_msgs::PointCloud2ConstPtr &laserCloudMsg)
+{
+    //     判断使用帧首帧尾时间
+    // std::cout << std::setprecision(10) << laserCloudMsg->header.stamp.toSec() - ros::Time::now().toSec() << std::endl;
+
+    {
+        PROFILE_SPAN(Ingest);
+        if (!cachePointCloud(laserCloudMsg))
+            return;
+    }
+
+    {
+        PROFILE_SPAN(FeatureSplit);
+        extractor->Extract(inputCloud, extractedCloud, cornerCloud, surfaceCloud);
+    }
+
+    PROFILE_SPAN(Publish);
+    publishFeatureCloud();
+
+    if (cloudSink)
+    {
+        // hand the cloud over without copy, the next scan takes a buffer the estimator has released
+        cloudSink(timeScanEnd, extractedCloud);
+        extractedCloud = cloudPool->Acquire();
+    }
+
+    resetParameters();
+}
+
+#define TEST_LIO_SAM_6AXIS_DATA
+bool FeatureExtract::cachePointCloud(const sensor_msgs::PointCloud2ConstPtr &laserCloudMsg)
+{
+    sensor_msgs::PointCloud2 currentCloudMsg = *laserCloudMsg;
+    double timespan;
+    if (sensor == SensorType::VELODYNE)
+    {
+        pcl::moveFromROSMsg(currentCloudMsg, *laserCloudIn);
+        inputCloud->points.resize(laserCloudIn->size());
+        inputCloud->is_dense = laserCloudIn->is_dense;
+// FIXME:NCLT数据集需要乘以1e-6,其他数据集不需要
+#ifdef TEST_LIO_SAM_6AXIS_DATA
+        timespan = laserCloudIn->points.back().time /* * 1e-6*/;
+#else
+        timespan = laserCloudIn->points.back().time - laserCloudIn->points[0].time;
+#endif
+        for (size_t i = 0; i < laserCloudIn->size(); i++)
+        {
+            auto &src = laserCloudIn->points[i];
+            auto &dst = inputCloud->points[i];
+            dst.x = src.x;
+            dst.y = src.y;
+            dst.z = src.z;
+            dst.intensity = src.intensity;
+            dst.normal_y = src.ring; //  ring
+            dst.normal_z = 0;
+#ifdef TEST_LIO_SAM_6AXIS_DATA
+            dst.normal_x = src.time /* * 1e-6*/ / timespan;
+#else
+            dst.normal_x = (src.time + timespan) / timespan;
+#endif
+        }
+#ifndef TEST_LIO_SAM_6AXIS_DATA
+        timespan = 0.0;
+#endif
+        // std::cout << "header-0:" << cloudHeader.stamp.toSec() - laserCloudIn->points[0].time << ",0: " << laserCloudIn->points[0].time
+        //           << ",100:" << laserCloudIn->points[100].time << ",end " << laserCloudIn->points.back().time << std::endl;
+    }
+    else if (sensor == SensorType::LIVOX)
+    {
+        pcl::moveFromROSMsg(currentCloudMsg, *laserCloudIn);
+        inputCloud->points.resize(laserCloudIn->size());
+        inputCloud->is_dense = laserCloudIn->is_dense;
+        timespan = laserCloudIn->points.back().time;
+        for (size_t i = 0; i < laserCloudIn->size(); i++)
+        {
+            auto &src = laserCloudIn->points[i];
+            auto &dst = inputCloud->points[i];
+            dst.x = src.x;
+            dst.y = src.y;
+            dst.z = src.z;
+            dst.intensity = src.intensity;
+            dst.normal_y = src.ring; //  ring
+            dst.normal_z = 0;
+            dst.normal_x = src.time / timespan;
+        }
+        // std::cout << "stamp: " << laserCloudIn->points[0].time << ", " << laserCloudIn->points.back().time << std::endl;
+    }
+    else if (sensor == SensorType::OUSTER)
+    {
+        // Convert to Velodyne format
+        pcl::fromROSMsg(currentCloudMsg, *tmpOusterCloudIn);
+        // pcl::moveFromROSMsg(currentCloudMsg, *tmpOusterCloudIn);
+        inputCloud->points.resize(tmpOusterCloudIn->size());
+        inputCloud->is_dense = tmpOusterCloudIn->is_dense;
+        //  FIXME:偶现,最后一个点时间戳异常
+        // timespan = tmpOusterCloudIn->points.back().t;
+        timespan = tmpOusterCloudIn->points[tmpOusterCloudIn->size() - 2].t;
+        for (size_t i = 0; i < tmpOusterCloudIn->size(); i++)
+        {
+            auto &src = tmpOusterCloudIn->points[i];
+            auto &dst = inputCloud->points[i];
+            dst.x = src.x;
+            dst.y = src.y;
+            dst.z = src.z;
+            dst.intensity = src.intensity;
+            dst.normal_y = src.ring;
+            dst.normal_z = 0;
+            dst.normal_x = src.t / timespan; //        *1e-9f;
+        }
+        timespan = timespan * 1e-9f;
+    }
+    else if (sensor == SensorType::ROBOSENSE)
+    {
+        //  FIXME: robosense时间戳为最后一个点的数据
+        pcl::fromROSMsg(currentCloudMsg, *tmpRSCloudIn);
+        // inputCloud->points.resize(tmpRSCloudIn->size());
+        // inputCloud->is_dense = tmpRSCloudIn->is_dense;
+        timespan = tmpRSCloudIn->points[tmpRSCloudIn->size() - 1].timestamp - tmpRSCloudIn->points[0].timestamp;
+        std::cout << "fist: " << tmpRSCloudIn->points[1].timestamp
+                  << ", 100: " << tmpRSCloudIn->points[100].timestamp
+                  << ",intervel: " << tmpRSCloudIn->points[tmpRSCloudIn->size() - 1].timestamp - tmpRSCloudIn->points[0].timestamp
+                  << ",t: " << tmpRSCloudIn->points[0].timestamp - currentCloudMsg.header.stamp.toSec()
+                  << "timespan: " << timespan << std::endl;
+        for (size_t i = 0; i < tmpRSCloudIn->size(); i++)
+        {
+            auto &src = tmpRSCloudIn->points[i];
+            if (!pcl_isfinite(src.x) || !pcl_isfinite(src.y) || !pcl_isfinite(src.z))
+                continue;
+
+            PointType dst;
+            dst.x = src.x;
+            dst.y = src.y;
+            dst.z = src.z;
+            dst.intensity = src.intensity;
+            dst.normal_y = src.ring;
+            dst.normal_z = 0;
+            dst.normal_x = (src.timestamp - tmpRSCloudIn->points[0].timestamp) / timespan;
+            inputCloud->push_back(dst);
+        }
+        timespan = 0.0;
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Unknown sensor type: " << int(sensor));
+        ros::shutdown();
+    }
+
+    // get timestamp
+    cloudHeader = currentCloudMsg.header;
+    timeScanCur = cloudHeader.stamp.toSec();
+    timeScanEnd = timeScanCur + timespan; // inputCloud->points.back().normal_x;
+    // std::cout << "timeC:" << timeScanCur << "," << timespan << std::endl;
+
+    // check dense flag
+    if (inputCloud->is_dense == false)
+    {
+        ROS_ERROR("Point cloud is not in dense format, please remove NaN points first!");
+        ros::shutdown();
+    }
+
+    // check ring channel
+    static int ringFlag = 0;
+    if (ringFlag == 0)
+    {
+        ringFlag = -1;
+        for (int i = 0; i < (int)currentCloudMsg.fields.size(); ++i)
+        {
+            if (currentCloudMsg.fields[i].name == "ring")
+            {
+                ringFlag = 1;
+                break;
+            }
+        }
+        if (ringFlag == -1)
+        {
+            ROS_ERROR("Point cloud ring channel not available, please configure your point cloud data!");
+            ros::shutdown();
+        }
+    }
+
+    return true;
+}
+
+void FeatureExtract::publishFeatureCloud()
+{
+    // only serialize the clouds somebody listens to, in process the estimator gets the cloud from cloudSink
+    bool infoSubscribed = pubLaserCloudInfo.getNumSubscribers() != 0;
+    // save newly extracted features
+    if (infoSubscribed || pubCornerPoints.getNumSubscribers() != 0)
+        cloudInfo.cloud_corner = publishCloud(&pubCornerPoints, cornerCloud, cloudHeader.stamp, lidarFrameStr);
+    if (infoSubscribed || pubSurfacePoints.getNumSubscribers() != 0)
+        cloudInfo.cloud_surface = publishCloud(&pubSurfacePoints, surfaceCloud, cloudHeader.stamp, lidarFrameStr);
+    cloudHeader.stamp = ros::Time().fromSec(timeScanEnd); // lio used
+    if (pubFullPoints.getNumSubscribers() != 0)
+    {
+        sensor_msgs::PointCloud2 fullMsg;
+        pcl::toROSMsg(*extractedCloud, fullMsg);
+        fullMsg.header.stamp = cloudHeader.stamp;
+        fullMsg.header.frame_id = lidarFrameStr;
+        pubFullPoints.publish(fullMsg);
+    }
+    // publish to mapOptimization
+    if (infoSubscribed)
+        pubLaserCloudInfo.publish(cloudInfo);
+}
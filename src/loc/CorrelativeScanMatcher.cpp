@@ -0,0 +1,199 @@
+#include "loc/CorrelativeScanMatcher.h"
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+CorrelativeScanMatcher::CorrelativeScanMatcher(const Options &options) : options(options)
+{
+  origin.setZero();
+}
+
+/** \brief project map points around center into the grid pyramid
+ * \param[in] mapCloud: prior map points in world frame
+ * \param[in] center: sensor position the search window is centered on, z is used as the height reference
+ */
+void CorrelativeScanMatcher::SetMap(const pcl::PointCloud<PointType>::Ptr &mapCloud, const Eigen::Vector3d &center)
+{
+  const double res = options.resolution;
+  const double halfSize = options.linear_window + options.max_range;
+  const int width = static_cast<int>(std::ceil(2.0 * halfSize / res)) + 1;
+  origin = center.head<2>() - Eigen::Vector2d(halfSize, halfSize);
+  zRef = center.z();
+
+  grids.assign(std::max(options.depth, 1), Grid());
+  Grid &base = grids[0];
+  base.width = width;
+  base.cells.assign(width * width, 0.f);
+  for (const auto &p : mapCloud->points)
+  {
+    double dz = p.z - zRef;
+    if (dz < options.min_z || dz > options.max_z)
+      continue;
+    int x = static_cast<int>(std::floor((p.x - origin.x()) / res));
+    int y = static_cast<int>(std::floor((p.y - origin.y()) / res));
+    if (x < 0 || y < 0 || x >= width || y >= width)
+      continue;
+    // occupied cell and a softer halo so that slightly misaligned points still score
+    for (int dy = -1; dy <= 1; ++dy)
+      for (int dx = -1; dx <= 1; ++dx)
+      {
+        int xx = x + dx, yy = y + dy;
+        if (xx < 0 || yy < 0 || xx >= width || yy >= width)
+          continue;
+        float v = (dx == 0 && dy == 0) ? 1.f : 0.5f;
+        float &cell = base.cells[yy * width + xx];
+        cell = std::max(cell, v);
+      }
+  }
+
+  // level h keeps the max of a 2^h block starting at (x,y), built from level h-1
+  for (size_t h = 1; h < grids.size(); ++h)
+  {
+    const Grid &prev = grids[h - 1];
+    Grid &curr = grids[h];
+    const int stride = 1 << (h - 1);
+    curr.width = width;
+    curr.cells.resize(width * width);
+    for (int y = 0; y < width; ++y)
+      for (int x = 0; x < width; ++x)
+        curr.cells[y * width + x] = std::max(std::max(prev.at(x, y), prev.at(x + stride, y)),
+                                             std::max(prev.at(x, y + stride), prev.at(x + stride, y + stride)));
+  }
+}
+
+double CorrelativeScanMatcher::ScoreCandidate(const Grid &grid, const DiscreteScan &scan, int xOffset, int yOffset) const
+{
+  double sum = 0;
+  for (const auto &c : scan)
+    sum += grid.at(c.x() + xOffset, c.y() + yOffset);
+  return scan.empty() ? 0 : sum / scan.size();
+}
+
+void CorrelativeScanMatcher::ScoreCandidates(const Grid &grid, const std::vector<DiscreteScan> &scans,
+                                             std::vector<Candidate> &candidates) const
+{
+  for (auto &c : candidates)
+    c.score = ScoreCandidate(grid, scans[c.scanIndex], c.xOffset, c.yOffset);
+  std::sort(candidates.begin(), candidates.end(), std::greater<Candidate>());
+}
+
+CorrelativeScanMatcher::Candidate CorrelativeScanMatcher::BranchAndBound(const std::vector<DiscreteScan> &scans,
+                                                                         const std::vector<Candidate> &candidates,
+                                                                         int height, double minScore, int linearBound) const
+{
+  if (height == 0)
+    return candidates.front();
+
+  Candidate best{0, 0, 0, minScore};
+  const int half = 1 << (height - 1);
+  for (const auto &c : candidates)
+  {
+    // candidates are sorted, the rest can not beat the current best
+    if (c.score <= best.score)
+      break;
+    std::vector<Candidate> children;
+    children.reserve(4);
+    for (int dx = 0; dx <= half; dx += half)
+    {
+      if (c.xOffset + dx > linearBound)
+        break;
+      for (int dy = 0; dy <= half; dy += half)
+      {
+        if (c.yOffset + dy > linearBound)
+          break;
+        children.push_back(Candidate{c.scanIndex, c.xOffset + dx, c.yOffset + dy, 0});
+      }
+    }
+    ScoreCandidates(grids[height - 1], scans, children);
+    Candidate child = BranchAndBound(scans, children, height - 1, best.score, linearBound);
+    if (child.score > best.score)
+      best = child;
+  }
+  return best;
+}
+
+/** \brief search the globally best x/y/yaw inside the window around initPose
+ * \param[in] scan: lidar points in body frame
+ * \param[in] initPose: initial pose, roll/pitch/z are kept fixed
+ * \param[out] pose: best pose found
+ * \param[out] score: occupancy score of the best pose in [0,1]
+ * \return true if a candidate above min_score was found
+ */
+bool CorrelativeScanMatcher::Match(const pcl::PointCloud<PointType>::Ptr &scan, const Eigen::Matrix4d &initPose,
+                                   Eigen::Matrix4d &pose, double &score) const
+{
+  score = 0;
+  if (grids.empty())
+    return false;
+
+  const double res = options.resolution;
+  const Eigen::Matrix3d R = initPose.topLeftCorner(3, 3);
+  const double yaw0 = std::atan2(R(1, 0), R(0, 0));
+  const Eigen::Matrix3d Rrp = Eigen::AngleAxisd(-yaw0, Eigen::Vector3d::UnitZ()).toRotationMatrix() * R;
+  const Eigen::Vector2d center = initPose.block<2, 1>(0, 3);
+
+  // gravity aligned points inside the height band
+  std::vector<Eigen::Vector2d> points;
+  points.reserve(scan->points.size());
+  double maxRange = 0;
+  for (const auto &p : scan->points)
+  {
+    Eigen::Vector3d q = Rrp * Eigen::Vector3d(p.x, p.y, p.z);
+    double range = q.head<2>().norm();
+    if (range < 1e-3 || range > options.max_range || q.z() < options.min_z || q.z() > options.max_z)
+      continue;
+    maxRange = std::max(maxRange, range);
+    points.emplace_back(q.head<2>());
+  }
+  if (points.size() < 10)
+    return false;
+
+  // the farthest point moves by about one cell per angular step
+  double angularStep = std::acos(1.0 - res * res / (2.0 * maxRange * maxRange));
+  int numAngular = static_cast<int>(std::ceil(options.angular_window / angularStep));
+  std::vector<double> angles;
+  std::vector<DiscreteScan> scans;
+  for (int k = -numAngular; k <= numAngular; ++k)
+  {
+    double theta = yaw0 + k * angularStep;
+    Eigen::Rotation2Dd rot(theta);
+    DiscreteScan ds;
+    ds.reserve(points.size());
+    for (const auto &q : points)
+    {
+      Eigen::Vector2d w = rot * q + center - origin;
+      ds.emplace_back(static_cast<int>(std::floor(w.x() / res)), static_cast<int>(std::floor(w.y() / res)));
+    }
+    // several points falling into one cell only count once
+    std::sort(ds.begin(), ds.end(), [](const Eigen::Array2i &a, const Eigen::Array2i &b) {
+      return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+    });
+    ds.erase(std::unique(ds.begin(), ds.end(), [](const Eigen::Array2i &a, const Eigen::Array2i &b) {
+               return a.x() == b.x() && a.y() == b.y();
+             }),
+             ds.end());
+    angles.push_back(theta);
+    scans.push_back(std::move(ds));
+  }
+
+  const int linearBound = static_cast<int>(std::ceil(options.linear_window / res));
+  const int topHeight = static_cast<int>(grids.size()) - 1;
+  const int topStride = 1 << topHeight;
+  std::vector<Candidate> candidates;
+  for (size_t k = 0; k < scans.size(); ++k)
+    for (int x = -linearBound; x <= linearBound; x += topStride)
+      for (int y = -linearBound; y <= linearBound; y += topStride)
+        candidates.push_back(Candidate{static_cast<int>(k), x, y, 0});
+  ScoreCandidates(grids[topHeight], scans, candidates);
+
+  Candidate best = BranchAndBound(scans, candidates, topHeight, options.min_score, linearBound);
+  if (best.score <= options.min_score)
+    return false;
+
+  score = best.score;
+  pose = initPose;
+  pose.topLeftCorner(3, 3) = Eigen::AngleAxisd(angles[best.scanIndex], Eigen::Vector3d::UnitZ()).toRotationMatrix() * Rrp;
+  pose(0, 3) = center.x() + best.xOffset * res;
+  pose(1, 3) = center.y() + best.yOffset * res;
+  return true;
+}
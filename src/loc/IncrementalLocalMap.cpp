@@ -0,0 +1,90 @@
+#include "loc/IncrementalLocalMap.h"
+#include "ikd-Tree/ikd_Tree.h"
+#include <cmath>
+#include "utils/VoxelHash.h"
+
+IncrementalLocalMap::IncrementalLocalMap(int windowSize, float leafSize)
+    : windowSize(windowSize), leafSize(leafSize), slotVoxels(windowSize)
+{
+  tree = new KD_TREE<PointType>();
+}
+
+IncrementalLocalMap::~IncrementalLocalMap()
+{
+  delete tree;
+}
+
+int64_t IncrementalLocalMap::VoxelKey(const PointType &p) const
+{
+  return static_cast<int64_t>(voxel_hash::Key(static_cast<int64_t>(std::floor(p.x / leafSize)),
+                                              static_cast<int64_t>(std::floor(p.y / leafSize)),
+                                              static_cast<int64_t>(std::floor(p.z / leafSize))));
+}
+
+/** \brief insert a scan already transformed to the map frame, evicting the oldest scan once the window is full
+ * \param[in] cloudInMap: scan points in map frame
+ */
+void IncrementalLocalMap::Insert(const pcl::PointCloud<PointType> &cloudInMap)
+{
+  const size_t slot = frameCount % windowSize;
+  const int64_t evictId = frameCount - windowSize;
+
+  // evict voxels that no newer scan has observed since the oldest scan
+  PointVector pointsToDel;
+  for (const auto &key : slotVoxels[slot])
+  {
+    auto it = voxels.find(key);
+    if (it != voxels.end() && it->second.frameId == evictId)
+    {
+      pointsToDel.push_back(it->second.point);
+      voxels.erase(it);
+    }
+  }
+  slotVoxels[slot].clear();
+
+  PointVector pointsToAdd;
+  for (const auto &p : cloudInMap.points)
+  {
+    int64_t key = VoxelKey(p);
+    auto it = voxels.find(key);
+    if (it == voxels.end())
+    {
+      voxels.emplace(key, Voxel{p, frameCount});
+      pointsToAdd.push_back(p);
+    }
+    else if (it->second.frameId == frameCount)
+      continue;
+    else
+      it->second.frameId = frameCount;
+    slotVoxels[slot].push_back(key);
+  }
+
+  if (!pointsToDel.empty())
+    tree->Delete_Points(pointsToDel);
+  if (!pointsToAdd.empty())
+  {
+    if (tree->Root_Node == nullptr)
+      tree->Build(pointsToAdd);
+    else
+      tree->Add_Points(pointsToAdd, false);
+  }
+  frameCount++;
+}
+
+/** \brief drop all scans */
+void IncrementalLocalMap::Clear()
+{
+  delete tree;
+  tree = new KD_TREE<PointType>();
+  voxels.clear();
+  for (auto &s : slotVoxels)
+    s.clear();
+  frameCount = 0;
+}
+
+int IncrementalLocalMap::NearestKSearch(const PointType &point, int k, PointVector &points, std::vector<float> &sqDist,
+                                        float maxDist)
+{
+  tree->Nearest_Search(point, k, points, sqDist, maxDist);
+  return static_cast<int>(points.size());
+}
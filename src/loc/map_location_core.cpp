@@ -0,0 +1,1969 @@
+#include "loc/map_location.h"
+
+#include <fstream>
+#include <pcl/io/pcd_io.h>
+#include <pcl/registration/icp.h>
+#include "tictoc.hpp"
+
+map_location::map_location(const ParamFile *params) : params_(params)
+{
+  if (!params_)
+  {
+    nh_.reset(new ros::NodeHandle());
+    broadcaster_.reset(new tf::TransformBroadcaster());
+  }
+  param<std::string>("location/filedir", filename, "");
+  param<std::string>("location/pointCloudTopic", pointCloudTopic, "points_raw");
+  param<std::string>("location/imuTopic", imu_topic, "/livox/imu");
+  param<int>("location/IMU_Mode", IMU_Mode, 0);
+  param<bool>("location/use_lio", use_lio, false);
+  param<double>("location/corner_leaf_", corner_leaf_, 0.2);
+  param<double>("location/surf_leaf_", surf_leaf_, 0.5);
+  param<double>("location/map_quantization_step", map_quantization_step, 0.005);
+  param<std::vector<double>>("location/pyramid_levels", pyramid_levels, pyramid_levels);
+  NdtMap::Options ndt_options;
+  param<bool>("location/use_ndt", use_ndt, false);
+  param<double>("location/ndt_voxel", ndt_options.voxel, 1.0);
+  param<int>("location/ndt_min_points", ndt_options.min_points, 5);
+  param<double>("location/ndt_min_sigma", ndt_options.min_sigma, 0.01);
+  param<double>("location/ndt_eigen_ratio", ndt_options.eigen_ratio, 0.001);
+  ndtMap = NdtMap(ndt_options);
+  param<double>("location/assoc_trans_thres", assoc_trans_thres, 0.1);
+  param<double>("location/assoc_rot_thres", assoc_rot_thres, 1.0);
+  ConvergenceMonitor::Options convergence_options;
+  param<int>("location/max_iters", convergence_options.max_iters, 5);
+  param<double>("location/converge_trans", convergence_options.trans_thres, 0.05);
+  param<double>("location/converge_rot", convergence_options.rot_thres, 0.05);
+  param<double>("location/converge_cost", convergence_options.cost_thres, 0.01);
+  convergence = ConvergenceMonitor(convergence_options);
+  FeatureSelector::Options feature_options;
+  param<bool>("location/feature_budget_enable", feature_options.enable, false);
+  param<double>("location/feature_budget_target_ms", feature_options.target_ms, 50.0);
+  param<int>("location/feature_budget_min", feature_options.min_budget, 300);
+  param<int>("location/feature_budget_max", feature_options.max_budget, 3000);
+  featureSelector = FeatureSelector(feature_options);
+  FrameScheduler::Options schedule_options;
+  param<bool>("location/schedule_enable", schedule_options.enable, false);
+  param<double>("location/schedule_latency", schedule_options.latency_budget, 0.2);
+  param<int>("location/schedule_max_skips", schedule_options.max_skips, 2);
+  param<int>("location/schedule_degraded_iters", schedule_options.degraded_iters, 2);
+  param<double>("location/schedule_degraded_leaf_scale", schedule_options.degraded_leaf_scale, 2.0);
+  scheduler_ = FrameScheduler(schedule_options);
+  CorrelativeScanMatcher::Options csm_options;
+  double csm_angular_window = 180.0;
+  param<bool>("location/use_csm", use_csm, true);
+  param<double>("location/csm_resolution", csm_options.resolution, 0.5);
+  param<int>("location/csm_depth", csm_options.depth, 6);
+  param<double>("location/csm_linear_window", csm_options.linear_window, 20.0);
+  param<double>("location/csm_angular_window", csm_angular_window, 180.0);
+  param<double>("location/csm_min_score", csm_options.min_score, 0.55);
+  csm_options.angular_window = csm_angular_window * M_PI / 180.0;
+  scan_matcher = new CorrelativeScanMatcher(csm_options);
+
+  if (IMU_Mode < 2)
+    WINDOWSIZE = 1;
+  else
+    WINDOWSIZE = MAXWINDOWSIZE;
+  if (nh_)
+  {
+    sub_cloud_ = nh_->subscribe<sensor_msgs::PointCloud2>(pointCloudTopic, 50, &map_location::cloudHandler, this);
+    if (IMU_Mode > 0)
+      sub_imu_ = nh_->subscribe(imu_topic, 2000, &map_location::imu_callback, this);
+    sub_initial_pose_ = nh_->subscribe<geometry_msgs::PoseWithCovarianceStamped>("/initialpose", 1, &map_location::initialPoseCB, this);
+
+    pub_corner_map = nh_->advertise<sensor_msgs::PointCloud2>("/global_corner_map", 1);
+    pub_surf_ = nh_->advertise<sensor_msgs::PointCloud2>("/surf_registed", 1);
+
+    pubMappedPoints_ = nh_->advertise<sensor_msgs::PointCloud2>("/laser_cloud_mapped", 10);
+    pubLaserOdometryPath_ = nh_->advertise<nav_msgs::Path>("/path_mapped", 5);
+  }
+
+  ds_corner_.setLeafSize(corner_leaf_, corner_leaf_, corner_leaf_);
+  ds_surf_.setLeafSize(surf_leaf_, surf_leaf_, surf_leaf_);
+  ds_frame_.setLabelLeafSize(LabelledPoint::Corner, corner_leaf_);
+  ds_frame_.setLabelLeafSize(LabelledPoint::Surf, surf_leaf_);
+
+  if (loadmap())
+    std::cout << ANSI_COLOR_GREEN << "load map successful..." << ANSI_COLOR_RESET << std::endl;
+  else
+  {
+    std::cout << ANSI_COLOR_RED_BOLD << "WARN: load map failed." << ANSI_COLOR_RESET << std::endl;
+    return;
+  }
+
+  std::cout << "ROOT_DIR: " << root_dir << std::endl;
+  //  create folder
+  std::string command = "mkdir -p " + root_dir + "Log";
+  system(command.c_str());
+  if (nh_)
+    profiler_pub_.reset(new ProfilerPublisher(*nh_, "map_location", root_dir + "Log/maplocalization_latency.csv"));
+
+  surround_surf.reset(new CLOUD);
+  surround_corner.reset(new CLOUD);
+  kdtree_keyposes_3d_.reset(new pcl::KdTreeFLANN<PointType>());
+  kdtree_keyposes_3d_->setInputCloud(map.cloudKeyPoses3D_); // init 3d-pose kdtree
+
+  if (use_ndt)
+  {
+    // the distributions were built by loadmap, from the full resolution maps
+    std::cout << "prior map distributions: " << ndtMap.Cells() << " voxels of " << ndtMap.GetOptions().voxel
+              << " m, " << ndtMap.memoryBytes() / 1024 << " KiB" << std::endl;
+  }
+  else
+  {
+    {
+      PROFILE_SPAN(KdBuild);
+      kdtree_corner_map.reset(new StaticKdTree<PointType>());
+      kdtree_corner_map->setQuantizationStep(map_quantization_step);
+      kdtree_corner_map->setInputCloud(map.globalCornerMapCloud_);
+      kdtree_surf_map.reset(new StaticKdTree<PointType>());
+      kdtree_surf_map->setQuantizationStep(map_quantization_step);
+      kdtree_surf_map->setInputCloud(map.globalSurfMapCloud_);
+      mapPyramid.Build(*map.globalCornerMapCloud_, *map.globalSurfMapCloud_, pyramid_levels);
+    }
+    std::cout << "prior map trees: " << kdtree_corner_map->size() << " corner, " << kdtree_surf_map->size()
+              << " surf points, " << (kdtree_corner_map->memoryBytes() + kdtree_surf_map->memoryBytes()) / 1024 << " KiB" << std::endl;
+    for (int l = 0; l < mapPyramid.Levels(); l++)
+      std::cout << "prior map level " << mapPyramid.GetLevel(l).voxel << " m: " << mapPyramid.GetLevel(l).corner->size()
+                << " linear, " << mapPyramid.GetLevel(l).surf->size() << " planar voxels" << std::endl;
+  }
+
+  if (pub_corner_map.getNumSubscribers() > 0)
+  {
+    sensor_msgs::PointCloud2 msg_corner_target;
+    pcl::toROSMsg(*map.globalCornerMapCloud_, msg_corner_target);
+    msg_corner_target.header.stamp = ros::Time::now();
+    msg_corner_target.header.frame_id = "world";
+    pub_corner_map.publish(msg_corner_target);
+    std::cout << "publish corner map,size: " << map.globalCornerMapCloud_->size() << std::endl;
+  }
+  initializedFlag = NonInitialized;
+
+  localCornerMap = new IncrementalLocalMap(localMapWindowSize, corner_leaf_);
+  localSurfMap = new IncrementalLocalMap(localMapWindowSize, surf_leaf_);
+
+  map_manager = new MAP_MANAGER(0.2, 0.3);
+  map_loaded = true;
+}
+
+map_location::~map_location()
+{
+  delete map_manager;
+  delete scan_matcher;
+  delete localCornerMap;
+  delete localSurfMap;
+  delete last_marginalization_info;
+}
+
+void map_location::cloudHandler(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+  PROFILE_SPAN(Ingest);
+  LabelledCloud::Ptr cloud = framePool_.Acquire();
+  pcl::fromROSMsg(*msg, *cloud);
+  PushCloud(msg->header.stamp.toSec(), cloud);
+}
+
+void map_location::ExtractFeature(LidarFrame &kf)
+{
+  PROFILE_SPAN(Downsample);
+  ds_frame_.FilterByLabel(*kf.laserCloud, *kf.corner, *kf.surf, nullptr);
+  // consecutive association queries then walk the same tree nodes
+  morton_.Sort(*kf.corner);
+  morton_.Sort(*kf.surf);
+}
+
+void map_location::initialPoseCB(const geometry_msgs::PoseWithCovarianceStampedConstPtr &msg)
+{
+  PointTypePose pose;
+  pose.x = msg->pose.pose.position.x;
+  pose.y = msg->pose.pose.position.y;
+  pose.z = msg->pose.pose.position.z;
+  double roll, pitch, yaw;
+  tf::Quaternion q;
+  tf::quaternionMsgToTF(msg->pose.pose.orientation, q);
+  tf::Matrix3x3(q).getRPY(roll, pitch, yaw);
+  pose.roll = roll;
+  pose.pitch = pitch;
+  pose.yaw = yaw;
+  SetInitialPose(pose);
+}
+
+void map_location::SetInitialPose(const PointTypePose &pose)
+{
+  //  低频，不加锁
+  PointType p;
+  initpose = pose;
+
+  if (use_csm && !map.cloudKeyPoses3D_->empty())
+  {
+    //  the pose from rviz has no height, take it from the closest keyframe
+    double min_dist = std::numeric_limits<double>::max();
+    for (const auto &kp : map.cloudKeyPoses3D_->points)
+    {
+      double dist = (kp.x - initpose.x) * (kp.x - initpose.x) + (kp.y - initpose.y) * (kp.y - initpose.y);
+      if (dist < min_dist)
+      {
+        min_dist = dist;
+        initpose.z = kp.z;
+      }
+    }
+    TicToc tc;
+    std::lock_guard<std::mutex> lock(mtx_csm);
+    scan_matcher->SetMap(map.globalSurfMapCloud_, Eigen::Vector3d(initpose.x, initpose.y, initpose.z));
+    std::cout << "build csm grids takes: " << tc.toc() << "ms" << std::endl;
+  }
+
+  p.x = initpose.x;
+  p.y = initpose.y;
+  p.z = initpose.z;
+  std::cout << ANSI_COLOR_RED << "Get initial pose: " << initpose.x << " " << initpose.y << " "
+            << initpose.z << " " << initpose.roll << " " << initpose.pitch << " " << initpose.yaw << ANSI_COLOR_RESET << std::endl;
+  extractSurroundKeyFrames(p);
+  std::cout << ANSI_COLOR_YELLOW << "Change flat from " << initializedFlag
+            << " to " << Initializing << ", start do localizating ..."
+            << ANSI_COLOR_RESET << std::endl;
+  if (initializedFlag != NonInitialized)
+  { // TODO: 非第一次执行，需要重置部分参数
+    delta_Rl = Eigen::Matrix3d::Identity();
+    delta_tl = Eigen::Vector3d::Zero();
+    localCornerMap->Clear();
+    localSurfMap->Clear();
+  }
+  initializedFlag = Initializing;
+}
+
+void map_location::pubOdometry(Eigen::Matrix4d pose, double &time)
+{
+  if (!nh_)
+    return;
+  PROFILE_SPAN(Publish);
+  Eigen::Quaterniond Q(pose.block<3, 3>(0, 0));
+  ros::Time ros_time = ros::Time().fromSec(time);
+  transform_.stamp_ = ros_time;
+  transform_.setRotation(tf::Quaternion(Q.x(), Q.y(), Q.z(), Q.w()));
+  transform_.setOrigin(tf::Vector3(pose(0, 3), pose(1, 3), pose(2, 3)));
+  transform_.frame_id_ = "world";
+  transform_.child_frame_id_ = "base_link";
+  broadcaster_->sendTransform(transform_);
+
+  geometry_msgs::PoseStamped laserPose;
+  laserPose.header.frame_id = "world";
+  laserPose.header.stamp = ros_time;
+
+  laserPose.pose.orientation.x = Q.x();
+  laserPose.pose.orientation.y = Q.y();
+  laserPose.pose.orientation.z = Q.z();
+  laserPose.pose.orientation.w = Q.w();
+  laserPose.pose.position.x = pose(0, 3);
+  laserPose.pose.position.y = pose(1, 3);
+  laserPose.pose.position.z = pose(2, 3);
+
+  laserOdoPath.header.stamp = ros_time;
+  laserOdoPath.poses.push_back(laserPose);
+  laserOdoPath.header.frame_id = "/world";
+  pubLaserOdometryPath_.publish(laserOdoPath);
+}
+
+void map_location::pubOdometry(LidarFrame &frame)
+{
+  if (!nh_)
+    return;
+  PROFILE_SPAN(Publish);
+  ros::Time ros_time = ros::Time().fromSec(frame.timeStamp);
+  transform_.stamp_ = ros_time;
+  transform_.setRotation(tf::Quaternion(frame.Q.x(), frame.Q.y(), frame.Q.z(), frame.Q.w()));
+  transform_.setOrigin(tf::Vector3(frame.P(0), frame.P(1), frame.P(2)));
+  transform_.frame_id_ = "world";
+  transform_.child_frame_id_ = "base_link";
+  broadcaster_->sendTransform(transform_);
+
+  geometry_msgs::PoseStamped laserPose;
+  laserPose.header.frame_id = "world";
+  laserPose.header.stamp = ros_time;
+
+  laserPose.pose.orientation.x = frame.Q.x();
+  laserPose.pose.orientation.y = frame.Q.y();
+  laserPose.pose.orientation.z = frame.Q.z();
+  laserPose.pose.orientation.w = frame.Q.w();
+  laserPose.pose.position.x = frame.P(0);
+  laserPose.pose.position.y = frame.P(1);
+  laserPose.pose.position.z = frame.P(2);
+
+  laserOdoPath.header.stamp = ros_time;
+  laserOdoPath.poses.push_back(laserPose);
+  laserOdoPath.header.frame_id = "/world";
+  pubLaserOdometryPath_.publish(laserOdoPath);
+}
+
+void map_location::vector2double(const LidarWindow &tempFrameList)
+{
+  for (int i = 0; i < tempFrameList.size(); i++)
+  {
+    const LidarFrame &l = tempFrameList[i];
+    Eigen::Map<Eigen::Matrix<double, 6, 1>> PR(para_PR[i]);
+    PR.segment<3>(0) = l.P;
+    PR.segment<3>(3) = Sophus::SO3d(l.Q).log();
+
+    Eigen::Map<Eigen::Matrix<double, 9, 1>> VBias(para_VBias[i]);
+    VBias.segment<3>(0) = l.V;
+    VBias.segment<3>(3) = l.bg;
+    VBias.segment<3>(6) = l.ba;
+  }
+}
+
+void map_location::double2vector(LidarWindow &tempFrameList)
+{
+  for (int i = 0; i < tempFrameList.size(); i++)
+  {
+    LidarFrame &l = tempFrameList[i];
+    Eigen::Map<const Eigen::Matrix<double, 6, 1>> PR(para_PR[i]);
+    Eigen::Map<const Eigen::Matrix<double, 9, 1>> VBias(para_VBias[i]);
+    l.P = PR.segment<3>(0);
+    l.Q = Sophus::SO3d::exp(PR.segment<3>(3)).unit_quaternion();
+    l.V = VBias.segment<3>(0);
+    l.bg = VBias.segment<3>(3);
+    l.ba = VBias.segment<3>(6);
+  }
+}
+
+void map_location::Estimate(LidarWindow &frameList, const Eigen::Vector3d &gravity)
+{
+  TRACE_SCOPE("map_location::Estimate");
+  const auto estimateStart = std::chrono::steady_clock::now();
+  int num_corner_map = 0;
+  int num_surf_map = 0;
+  int windowSize = frameList.size();
+  ndtQueries = 0;
+  ndtMatched = 0;
+  for (auto &frame : frameList)
+    ExtractFeature(frame);
+
+  // store point to line features
+  std::vector<std::vector<FeatureLine>> vLineFeatures(windowSize);
+  for (auto &v : vLineFeatures)
+    v.reserve(2000);
+
+  // store point to plan features
+  std::vector<std::vector<FeaturePlanVec>> vPlanFeatures(windowSize);
+  for (auto &v : vPlanFeatures)
+    v.reserve(2000);
+
+  // associations kept across the iterations of this estimate
+  std::vector<AssociationCache<FeatureLine>> lineCaches(windowSize, AssociationCache<FeatureLine>(assoc_trans_thres, assoc_rot_thres));
+  std::vector<AssociationCache<FeaturePlanVec>> planCaches(windowSize, AssociationCache<FeaturePlanVec>(assoc_trans_thres, assoc_rot_thres));
+  // prior map and local map queried together, one per association thread
+  FusedMapQuery cornerQuery(kdtree_corner_map, localCornerMap, 100);
+  FusedMapQuery surfQuery(kdtree_surf_map, localSurfMap, 200);
+
+  if (windowSize == SLIDEWINDOWSIZE)
+  {
+    plan_weight_tan = 0.0003;
+    thres_dist = 1.0;
+  }
+  else
+  {
+    plan_weight_tan = 0.0;
+    thres_dist = 25.0;
+  }
+
+  // excute optimize process
+  // a single frame is first registered coarse to fine, subsampled against the pyramid levels
+  const int coarseIters = windowSize != SLIDEWINDOWSIZE && kdtree_surf_map ? mapPyramid.Levels() : 0;
+  const int max_iters = coarseIters + (degradedIters_ > 0 ? std::min(degradedIters_, convergence.MaxIterations()) : convergence.MaxIterations());
+  int iterOpt = 0;
+  for (; iterOpt < max_iters; ++iterOpt)
+  {
+    vector2double(frameList);
+
+    // create huber loss function
+    ceres::LossFunction *loss_function = NULL;
+    loss_function = new ceres::HuberLoss(0.1 / IMUIntegrator::lidar_m);
+    if (windowSize == SLIDEWINDOWSIZE)
+    {
+      loss_function = NULL;
+    }
+    else
+    {
+      loss_function = new ceres::HuberLoss(0.1 / IMUIntegrator::lidar_m);
+    }
+
+    ceres::Problem::Options problem_options;
+    ceres::Problem problem(problem_options);
+
+    for (int i = 0; i < windowSize; ++i)
+    {
+      problem.AddParameterBlock(para_PR[i], 6);
+    }
+
+    for (int i = 0; i < windowSize; ++i)
+      problem.AddParameterBlock(para_VBias[i], 9);
+
+    //  TODO: add imu here
+    for (int f = 1; f < windowSize; ++f)
+    {
+      auto frame_curr = frameList.begin() + f;
+      problem.AddResidualBlock(Cost_NavState_PRV_Bias::Create(frame_curr->imuIntegrator,
+                                                              const_cast<Eigen::Vector3d &>(gravity),
+                                                              Eigen::LLT<Eigen::Matrix<double, 15, 15>>(frame_curr->imuIntegrator.GetCovariance().inverse())
+                                                                  .matrixL()
+                                                                  .transpose()),
+                               nullptr,
+                               para_PR[f - 1],
+                               para_VBias[f - 1],
+                               para_PR[f],
+                               para_VBias[f]);
+    }
+
+    if (last_marginalization_info)
+    {
+      // construct new marginlization_factor
+      auto *marginalization_factor = new MarginalizationFactor(last_marginalization_info);
+      problem.AddResidualBlock(marginalization_factor, nullptr,
+                               last_marginalization_parameter_blocks);
+    }
+
+    Eigen::Quaterniond q_before_opti = frameList.back().Q;
+    Eigen::Vector3d t_before_opti = frameList.back().P;
+
+    std::vector<std::vector<ceres::CostFunction *>> edgesLine(windowSize);
+    std::vector<std::vector<ceres::CostFunction *>> edgesPlan(windowSize);
+    std::thread threads[2];
+    featureSelector.ResetStats();
+
+    for (int f = 0; f < windowSize; ++f)
+    {
+      auto frame_curr = frameList.begin() + f;
+      Eigen::Matrix4d transformTobeMapped = Eigen::Matrix4d::Identity();
+      transformTobeMapped.topLeftCorner(3, 3) = frame_curr->Q.toRotationMatrix();
+      transformTobeMapped.topRightCorner(3, 1) = frame_curr->P;
+
+      if (use_ndt)
+      {
+        vLineFeatures[f].clear();
+        processPointToNdt(edgesPlan[f],
+                          vPlanFeatures[f],
+                          frame_curr->corner,
+                          frame_curr->surf,
+                          exTlb,
+                          transformTobeMapped);
+      }
+      else if (iterOpt < coarseIters)
+      {
+        const MapPyramid::Level &level = mapPyramid.GetLevel(iterOpt);
+        threads[0] = std::thread(&map_location::processPointToLineCoarse, this,
+                                 std::ref(edgesLine[f]),
+                                 std::ref(vLineFeatures[f]),
+                                 std::ref(frame_curr->corner),
+                                 std::cref(level),
+                                 CoarseStride(frame_curr->corner->size(), level.voxel, corner_leaf_),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+
+        threads[1] = std::thread(&map_location::processPointToPlanVecCoarse, this,
+                                 std::ref(edgesPlan[f]),
+                                 std::ref(vPlanFeatures[f]),
+                                 std::ref(frame_curr->surf),
+                                 std::cref(level),
+                                 CoarseStride(frame_curr->surf->size(), level.voxel, surf_leaf_),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+      }
+      else
+      {
+        threads[0] = std::thread(&map_location::processPointToLine, this,
+                                 std::ref(edgesLine[f]),
+                                 std::ref(vLineFeatures[f]),
+                                 std::ref(frame_curr->corner),
+                                 std::ref(cornerQuery),
+                                 std::ref(lineCaches[f]),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+
+        threads[1] = std::thread(&map_location::processPointToPlanVec, this,
+                                 std::ref(edgesPlan[f]),
+                                 std::ref(vPlanFeatures[f]),
+                                 std::ref(frame_curr->surf),
+                                 std::ref(surfQuery),
+                                 std::ref(planCaches[f]),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+      }
+
+      for (auto &t : threads)
+        if (t.joinable())
+          t.join();
+      featureSelector.Select(transformTobeMapped, edgesLine[f], vLineFeatures[f], edgesPlan[f], vPlanFeatures[f]);
+    }
+
+    if (windowSize == SLIDEWINDOWSIZE)
+    {
+      thres_dist = 1.0;
+      if (iterOpt == 0)
+      {
+        for (int f = 0; f < windowSize; ++f)
+        {
+          int cntFtu = 0;
+          for (auto &e : edgesLine[f])
+          {
+            if (std::fabs(vLineFeatures[f][cntFtu].error) > 1e-5)
+            {
+              problem.AddResidualBlock(e, loss_function, para_PR[f]);
+              vLineFeatures[f][cntFtu].valid = true;
+            }
+            else
+            {
+              vLineFeatures[f][cntFtu].valid = false;
+            }
+            cntFtu++;
+          }
+
+          cntFtu = 0;
+          for (auto &e : edgesPlan[f])
+          {
+            if (std::fabs(vPlanFeatures[f][cntFtu].error) > 1e-5)
+            {
+              problem.AddResidualBlock(e, loss_function, para_PR[f]);
+              vPlanFeatures[f][cntFtu].valid = true;
+            }
+            else
+            {
+              vPlanFeatures[f][cntFtu].valid = false;
+            }
+            cntFtu++;
+          }
+        }
+      }
+      else
+      {
+        for (int f = 0; f < windowSize; ++f)
+        {
+          int cntFtu = 0;
+          for (auto &e : edgesLine[f])
+          {
+            if (vLineFeatures[f][cntFtu].valid)
+            {
+              problem.AddResidualBlock(e, loss_function, para_PR[f]);
+            }
+            cntFtu++;
+          }
+          cntFtu = 0;
+          for (auto &e : edgesPlan[f])
+          {
+            if (vPlanFeatures[f][cntFtu].valid)
+            {
+              problem.AddResidualBlock(e, loss_function, para_PR[f]);
+            }
+            cntFtu++;
+          }
+        }
+      }
+    }
+    else
+    {
+      // the first fine iteration, after the pyramid levels if any, still searches wider
+      if (iterOpt == std::max(0, coarseIters - 1))
+      {
+        thres_dist = 10.0;
+      }
+      else
+      {
+        thres_dist = 1.0;
+      }
+      for (int f = 0; f < windowSize; ++f)
+      {
+        int cntFtu = 0;
+        for (auto &e : edgesLine[f])
+        {
+          if (std::fabs(vLineFeatures[f][cntFtu].error) > 1e-5)
+          {
+            problem.AddResidualBlock(e, loss_function, para_PR[f]);
+            vLineFeatures[f][cntFtu].valid = true;
+          }
+          else
+          {
+            vLineFeatures[f][cntFtu].valid = false;
+          }
+          cntFtu++;
+        }
+        cntFtu = 0;
+        for (auto &e : edgesPlan[f])
+        {
+          if (std::fabs(vPlanFeatures[f][cntFtu].error) > 1e-5)
+          {
+            problem.AddResidualBlock(e, loss_function, para_PR[f]);
+            vPlanFeatures[f][cntFtu].valid = true;
+          }
+          else
+          {
+            vPlanFeatures[f][cntFtu].valid = false;
+          }
+          cntFtu++;
+        }
+      }
+    }
+
+    ceres::Solver::Options options;
+    options.linear_solver_type = ceres::DENSE_SCHUR;
+    options.trust_region_strategy_type = ceres::DOGLEG;
+    options.max_num_iterations = 5;
+    options.minimizer_progress_to_stdout = false;
+    options.num_threads = 6;
+    ceres::Solver::Summary summary;
+    {
+      PROFILE_SPAN(Solve);
+      ceres::Solve(options, &problem, &summary);
+    }
+
+    double2vector(frameList);
+
+    Eigen::Quaterniond q_after_opti = frameList.back().Q;
+    Eigen::Vector3d t_after_opti = frameList.back().P;
+
+    double deltaR = (q_before_opti.angularDistance(q_after_opti)) * 180.0 / M_PI;
+    double deltaT = (t_before_opti - t_after_opti).norm();
+    if (iterOpt >= coarseIters &&
+        (convergence.Converged(iterOpt - coarseIters, deltaT, deltaR, summary.initial_cost, summary.final_cost) || iterOpt + 1 >= max_iters))
+    {
+      size_t cacheHits = 0, cacheQueries = 0;
+      for (int f = 0; f < windowSize; ++f)
+      {
+        cacheHits += lineCaches[f].hits + planCaches[f].hits;
+        cacheQueries += lineCaches[f].queries + planCaches[f].queries;
+      }
+      ROS_DEBUG("association cache hit rate: %.1f%% (%zu/%zu)",
+                cacheQueries > 0 ? 100.0 * cacheHits / cacheQueries : 0.0, cacheHits, cacheQueries);
+      size_t mapQueries = cornerQuery.queries + surfQuery.queries;
+      size_t servedGlobal = cornerQuery.servedGlobal + surfQuery.servedGlobal;
+      size_t servedLocal = cornerQuery.servedLocal + surfQuery.servedLocal;
+      if (use_ndt)
+        ROS_DEBUG("distribution lookups: %zu, matched %zu", ndtQueries, ndtMatched);
+      else
+        ROS_DEBUG("map queries: %zu, served by prior map %zu, by local map %zu, unmatched %zu",
+                  mapQueries, servedGlobal, servedLocal, mapQueries - servedGlobal - servedLocal);
+      ROS_DEBUG("residual budget: %d per frame, kept %zu of %zu correspondences, degeneracy %.4f",
+                featureSelector.Budget(), featureSelector.Selected(), featureSelector.Candidates(),
+                featureSelector.Degeneracy());
+      if (windowSize != SLIDEWINDOWSIZE)
+        break;
+      PROFILE_SPAN(Marginalization);
+      auto *marginalization_info = new MarginalizationInfo();
+      if (last_marginalization_info)
+      {
+        std::vector<int> drop_set;
+        for (int i = 0; i < static_cast<int>(last_marginalization_parameter_blocks.size()); i++)
+        {
+          if (last_marginalization_parameter_blocks[i] == para_PR[0] ||
+              last_marginalization_parameter_blocks[i] == para_VBias[0])
+            drop_set.push_back(i);
+        }
+
+        auto *marginalization_factor = new MarginalizationFactor(last_marginalization_info);
+        auto *residual_block_info = new ResidualBlockInfo(marginalization_factor, nullptr,
+                                                          last_marginalization_parameter_blocks,
+                                                          drop_set);
+        marginalization_info->addResidualBlockInfo(residual_block_info);
+      }
+
+      auto frame_curr = frameList.begin() + 1;
+      ceres::CostFunction *IMU_Cost = Cost_NavState_PRV_Bias::Create(frame_curr->imuIntegrator,
+                                                                     const_cast<Eigen::Vector3d &>(gravity),
+                                                                     Eigen::LLT<Eigen::Matrix<double, 15, 15>>(frame_curr->imuIntegrator.GetCovariance().inverse())
+                                                                         .matrixL()
+                                                                         .transpose());
+      auto *residual_block_info = new ResidualBlockInfo(IMU_Cost, nullptr,
+                                                        std::vector<double *>{para_PR[0], para_VBias[0], para_PR[1], para_VBias[1]},
+                                                        std::vector<int>{0, 1});
+      marginalization_info->addResidualBlockInfo(residual_block_info);
+
+      // re-associate the marginalized frame with its own pose, it barely moved so the cache is reused
+      int f = 0;
+      auto frame_marg = frameList.begin();
+      Eigen::Matrix4d transformTobeMapped = Eigen::Matrix4d::Identity();
+      transformTobeMapped.topLeftCorner(3, 3) = frame_marg->Q.toRotationMatrix();
+      transformTobeMapped.topRightCorner(3, 1) = frame_marg->P;
+      edgesLine[f].clear();
+      edgesPlan[f].clear();
+      if (use_ndt)
+      {
+        vLineFeatures[f].clear();
+        processPointToNdt(edgesPlan[f],
+                          vPlanFeatures[f],
+                          frame_marg->corner,
+                          frame_marg->surf,
+                          exTlb,
+                          transformTobeMapped);
+      }
+      else
+      {
+        threads[0] = std::thread(&map_location::processPointToLine, this,
+                                 std::ref(edgesLine[f]),
+                                 std::ref(vLineFeatures[f]),
+                                 std::ref(frame_marg->corner),
+                                 std::ref(cornerQuery),
+                                 std::ref(lineCaches[f]),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+
+        threads[1] = std::thread(&map_location::processPointToPlanVec, this,
+                                 std::ref(edgesPlan[f]),
+                                 std::ref(vPlanFeatures[f]),
+                                 std::ref(frame_marg->surf),
+                                 std::ref(surfQuery),
+                                 std::ref(planCaches[f]),
+                                 std::ref(exTlb),
+                                 std::ref(transformTobeMapped));
+
+        threads[0].join();
+        threads[1].join();
+      }
+      featureSelector.Select(transformTobeMapped, edgesLine[f], vLineFeatures[f], edgesPlan[f], vPlanFeatures[f]);
+
+      int cntFtu = 0;
+      for (auto &e : edgesLine[f])
+      {
+        if (vLineFeatures[f][cntFtu].valid)
+        {
+          auto *residual_block_info = new ResidualBlockInfo(e, nullptr,
+                                                            std::vector<double *>{para_PR[0]},
+                                                            std::vector<int>{0});
+          marginalization_info->addResidualBlockInfo(residual_block_info);
+        }
+        cntFtu++;
+      }
+      cntFtu = 0;
+      for (auto &e : edgesPlan[f])
+      {
+        if (vPlanFeatures[f][cntFtu].valid)
+        {
+          auto *residual_block_info = new ResidualBlockInfo(e, nullptr,
+                                                            std::vector<double *>{para_PR[0]},
+                                                            std::vector<int>{0});
+          marginalization_info->addResidualBlockInfo(residual_block_info);
+        }
+        cntFtu++;
+      }
+
+      marginalization_info->preMarginalize();
+      marginalization_info->marginalizeFixed<SLIDEWINDOWSIZE>();
+
+      std::unordered_map<long, double *> addr_shift;
+      for (int i = 1; i < SLIDEWINDOWSIZE; i++)
+      {
+        addr_shift[reinterpret_cast<long>(para_PR[i])] = para_PR[i - 1];
+        addr_shift[reinterpret_cast<long>(para_VBias[i])] = para_VBias[i - 1];
+      }
+      std::vector<double *> parameter_blocks = marginalization_info->getParameterBlocks(addr_shift);
+
+      delete last_marginalization_info;
+      last_marginalization_info = marginalization_info;
+      last_marginalization_parameter_blocks = parameter_blocks;
+      break;
+    }
+    if (windowSize != SLIDEWINDOWSIZE)
+    {
+      for (int f = 0; f < windowSize; ++f)
+      {
+        edgesLine[f].clear();
+        edgesPlan[f].clear();
+        vLineFeatures[f].clear();
+        vPlanFeatures[f].clear();
+      }
+    }
+  }
+  convergence.AddFrame(iterOpt + 1);
+  ROS_DEBUG("outer iterations: %d (mean %.2f, median %d over %zu frames)",
+            iterOpt + 1, convergence.MeanIterations(), convergence.MedianIterations(), convergence.Frames());
+  featureSelector.AddLatency(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - estimateStart).count());
+}
+
+void map_location::run()
+{
+  TRACE_THREAD_NAME("map_location::run");
+  double time_curr_lidar = -1;
+  std::vector<sensor_msgs::ImuConstPtr> vimuMsg;
+  while (true)
+  {
+
+    if (initializedFlag == NonInitialized)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+    if (_lidarMsgQueue.empty())
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+
+    //  update frame
+    {
+      std::pair<double, LabelledCloud::Ptr> scan = _lidarMsgQueue.pop_front();
+      time_curr_lidar = scan.first;
+      laserCloudFullRes = scan.second;
+    }
+
+    // relocalization and the IMU initialization window need every frame in full
+    const size_t queued = _lidarMsgQueue.size();
+    FrameScheduler::Action action = FrameScheduler::Full;
+    if (initializedFlag == Initialized && !(IMU_Mode > 1 && !LidarIMUInited))
+      action = scheduler_.Decide(time_curr_lidar, ros::Time::now().toSec(), queued, LidarIMUInited);
+    if (action == FrameScheduler::Skip)
+    {
+      // the IMU messages stay queued for the next frame
+      skippedFrames_++;
+      ROS_DEBUG("frame %.3f: skip, %zu frames queued", time_curr_lidar, queued);
+      continue;
+    }
+    SetDegraded(action == FrameScheduler::Degraded);
+    const auto processStart = std::chrono::steady_clock::now();
+
+    if (NeedImu())
+    {
+      // get IMU msg int the Specified time interval
+      vimuMsg.clear();
+      int countFail = 0;
+      while (!fetchImuMsgs(time_last_lidar, time_curr_lidar, vimuMsg))
+      {
+        countFail++;
+        if (countFail > 100)
+        {
+          if (_imuMsgQueue.empty())
+            std::cout << "imu queue is empty." << std::endl;
+          else
+            std::cout << "imu time: " << _imuMsgQueue.front()->header.stamp.toSec() << "-->" << _imuMsgQueue.back()->header.stamp.toSec() << std::endl;
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+
+    if (!ProcessFrame(laserCloudFullRes, time_curr_lidar, vimuMsg))
+      break;
+    scheduler_.Done(time_curr_lidar, ros::Time::now().toSec(),
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - processStart).count());
+    ROS_DEBUG("frame %.3f: %s, latency %.3f s", time_curr_lidar, FrameScheduler::Name(action), scheduler_.LastLatency());
+    if (action != FrameScheduler::Full)
+      ROS_WARN_THROTTLE(5.0, "behind the lidar: %zu frames skipped, %zu degraded, latency %.3f s (max %.3f s)",
+                        scheduler_.Count(FrameScheduler::Skip), scheduler_.Count(FrameScheduler::Degraded),
+                        scheduler_.LastLatency(), scheduler_.MaxLatency());
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void map_location::SetDegraded(bool degraded)
+{
+  const FrameScheduler::Options &schedule = scheduler_.GetOptions();
+  const double scale = degraded ? schedule.degraded_leaf_scale : 1.0;
+  ds_frame_.setLabelLeafSize(LabelledPoint::Corner, corner_leaf_ * scale);
+  ds_frame_.setLabelLeafSize(LabelledPoint::Surf, surf_leaf_ * scale);
+  degradedIters_ = degraded ? std::max(1, schedule.degraded_iters) : 0;
+}
+
+bool map_location::ProcessFrame(LabelledCloud::Ptr laserCloudFullRes, double time, const std::vector<sensor_msgs::ImuConstPtr> &vimuMsg)
+{
+  TRACE_SCOPE("map_location::ProcessFrame");
+  // the scratch frame keeps the capacity of its IMU message vector
+  LidarFrame &lidarFrame = scratchFrame_;
+  lidarFrame.Reset();
+  lidarFrame.timeStamp = time;
+  lidarFrame.laserCloud = laserCloudFullRes;
+  lidarFrame.corner = cloudPool_.Acquire();
+  lidarFrame.surf = cloudPool_.Acquire();
+
+  LidarWindow *lidar_list = nullptr;
+
+  if (!vimuMsg.empty())
+  {
+    if (!LidarIMUInited)
+    {
+      lidarFrame.imuIntegrator.PushIMUMsg(vimuMsg);
+      lidarFrame.imuIntegrator.GyroIntegration(time_last_lidar);
+      delta_Rl = lidarFrame.imuIntegrator.GetDeltaQ().toRotationMatrix();
+
+      //  predict current lidar pose
+      lidarFrame.P = transformLastMapped.topLeftCorner(3, 3) * delta_tl + transformLastMapped.topRightCorner(3, 1);
+      Eigen::Matrix3d m3d = transformLastMapped.topLeftCorner(3, 3) * delta_Rl;
+      lidarFrame.Q = m3d;
+
+      currentFrameList_.clear();
+      currentFrameList_.push_back(lidarFrame);
+      lidar_list = &currentFrameList_;
+    }
+    else
+    {
+      // if get IMU msg successfully, use pre-integration to update delta lidar pose
+      lidarFrame.imuIntegrator.PushIMUMsg(vimuMsg);
+      lidarFrame.imuIntegrator.PreIntegration(lidarFrameList.back().timeStamp, lidarFrameList.back().bg, lidarFrameList.back().ba);
+
+      const Eigen::Vector3d &Pwbpre = lidarFrameList.back().P;
+      const Eigen::Quaterniond &Qwbpre = lidarFrameList.back().Q;
+      const Eigen::Vector3d &Vwbpre = lidarFrameList.back().V;
+
+      const Eigen::Quaterniond &dQ = lidarFrame.imuIntegrator.GetDeltaQ();
+      const Eigen::Vector3d &dP = lidarFrame.imuIntegrator.GetDeltaP();
+      const Eigen::Vector3d &dV = lidarFrame.imuIntegrator.GetDeltaV();
+      double dt = lidarFrame.imuIntegrator.GetDeltaTime();
+
+      lidarFrame.Q = Qwbpre * dQ;
+      lidarFrame.P = Pwbpre + Vwbpre * dt + 0.5 * GravityVector * dt * dt + Qwbpre * (dP);
+      lidarFrame.V = Vwbpre + GravityVector * dt + Qwbpre * (dV);
+      lidarFrame.bg = lidarFrameList.back().bg;
+      lidarFrame.ba = lidarFrameList.back().ba;
+
+      Eigen::Quaterniond Qwlpre = Qwbpre;
+      Eigen::Vector3d Pwlpre = Pwbpre;
+
+      Eigen::Quaterniond Qwl = lidarFrame.Q;
+      Eigen::Vector3d Pwl = lidarFrame.P;
+
+      delta_Rl = Qwlpre.conjugate() * Qwl;
+      delta_tl = Qwlpre.conjugate() * (Pwl - Pwlpre);
+      // the preintegrated motion since the last processed frame also spans the skipped ones
+      FrameScheduler::ScanMotion(skippedFrames_, delta_Rl, delta_tl);
+      // delta_Rb = dQ.toRotationMatrix();
+      // delta_tb = dP;
+
+      lidarFrameList.push_back(lidarFrame);
+      lidarFrameList.pop_front();
+      lidar_list = &lidarFrameList;
+    }
+  }
+  else
+  {
+    if (LidarIMUInited)
+      return false;
+    else
+    {
+      //  predict pose use constant velocity
+      lidarFrame.P = transformLastMapped.topLeftCorner(3, 3) * delta_tl + transformLastMapped.topRightCorner(3, 1);
+      Eigen::Matrix3d m3d = transformLastMapped.topLeftCorner(3, 3) * delta_Rl;
+      lidarFrame.Q = m3d;
+
+      currentFrameList_.clear();
+      currentFrameList_.push_back(lidarFrame);
+      lidar_list = &currentFrameList_;
+    }
+  }
+
+  skippedFrames_ = 0;
+  RemoveLidarDistortion(laserCloudFullRes, delta_Rl, delta_tl);
+  //  publish cloud after remove distort
+  if (nh_)
+  {
+    PROFILE_SPAN(Publish);
+    sensor_msgs::PointCloud2 laserCloudMsg;
+    pcl::toROSMsg(*lidarFrame.laserCloud, laserCloudMsg);
+    laserCloudMsg.header.frame_id = "/base_link";
+    laserCloudMsg.header.stamp.fromSec(lidarFrame.timeStamp);
+    pubMappedPoints_.publish(laserCloudMsg);
+  }
+
+  if (initializedFlag == Initializing)
+  {
+    if (ICPScanMatchGlobal(*lidar_list))
+    {
+      initializedFlag = Initialized;
+      std::cout << ANSI_COLOR_GREEN << "icp scan match successful ..." << ANSI_COLOR_RESET << std::endl;
+    }
+
+    transformLastMapped.topLeftCorner(3, 3) = lidar_list->front().Q.toRotationMatrix();
+    transformLastMapped.topRightCorner(3, 1) = lidar_list->front().P;
+
+    pubOdometry(transformLastMapped, lidar_list->front().timeStamp);
+  }
+  else if (initializedFlag == Initialized)
+  {
+    Eigen::Matrix4d transformAftMapped = Eigen::Matrix4d::Identity();
+    //  TODO: 增加局部地图
+    int laserCloudCornerFromLocalNum = localCornerMap->size();
+    int laserCloudSurfFromLocalNum = localSurfMap->size();
+    if ((kdtree_surf_map && kdtree_corner_map) || ndtMap.Cells() > 0 ||
+        (laserCloudCornerFromLocalNum > 0 && laserCloudSurfFromLocalNum > 100))
+    {
+      Estimate(*lidar_list, GravityVector);
+
+      transformAftMapped = Eigen::Matrix4d::Identity();
+      transformAftMapped.topLeftCorner(3, 3) = lidar_list->front().Q.toRotationMatrix();
+      transformAftMapped.topRightCorner(3, 1) = lidar_list->front().P;
+      pubOdometry(transformAftMapped, lidar_list->front().timeStamp);
+
+      Eigen::Matrix3d Rwlpre = transformLastMapped.topLeftCorner(3, 3);
+      Eigen::Vector3d Pwlpre = transformLastMapped.topRightCorner(3, 1);
+      delta_Rl = Rwlpre.transpose() * transformAftMapped.topLeftCorner(3, 3);
+      delta_tl = Rwlpre.transpose() * (transformAftMapped.topRightCorner(3, 1) - Pwlpre);
+      transformLastMapped = transformAftMapped;
+    }
+    if (use_lio)
+      MapIncrementLocal(lidar_list->front());
+#define SAVE_TRAJ
+
+#ifdef SAVE_TRAJ
+    if (1)
+    {
+      static std::fstream fout(root_dir + "Log/odom_trajectory_TUM.txt", std::ios::out);
+      static std::ostringstream stamp;
+      stamp.str("");
+      if (fout.is_open())
+      {
+        // std::string tstamp = to_string(ros::Time().fromSec(laser_odometry->time));
+        std::string tstamp = std::to_string(lidar_list->front().timeStamp);
+        saveTrajectoryTUMformat(fout, tstamp, lidar_list->front().P(0), lidar_list->front().P(1), lidar_list->front().P(2),
+                                lidar_list->front().Q.x(), lidar_list->front().Q.y(), lidar_list->front().Q.z(), lidar_list->front().Q.w());
+      }
+    }
+#endif
+
+    // if tightly coupled IMU message, start IMU initialization
+    if (IMU_Mode > 1 && !LidarIMUInited)
+    {
+      // update lidar frame pose
+      lidarFrame.P = transformAftMapped.topRightCorner(3, 1);
+      Eigen::Matrix3d m3d = transformAftMapped.topLeftCorner(3, 3);
+      lidarFrame.Q = m3d;
+
+      // static int pushCount = 0;
+      std::cout << "lidarframelist: " << lidarFrameList.size() << std::endl;
+      if (pushCount == 0)
+      {
+        lidarFrameList.push_back(lidarFrame);
+        lidarFrameList.back().imuIntegrator.Reset();
+        if (lidarFrameList.size() > WINDOWSIZE)
+          lidarFrameList.pop_front();
+      }
+      else
+      {
+        lidarFrameList.back().laserCloud = lidarFrame.laserCloud;
+        lidarFrameList.back().imuIntegrator.PushIMUMsg(vimuMsg);
+        lidarFrameList.back().timeStamp = lidarFrame.timeStamp;
+        lidarFrameList.back().P = lidarFrame.P;
+        lidarFrameList.back().Q = lidarFrame.Q;
+      }
+      std::cout << "lidarframelist: " << lidarFrameList.size() << std::endl;
+
+      pushCount++;
+      if (pushCount >= 3)
+      {
+        pushCount = 0;
+        if (lidarFrameList.size() > 1)
+        {
+          auto iterRight = lidarFrameList.end() - 1;
+          auto iterLeft = lidarFrameList.end() - 2;
+          iterRight->imuIntegrator.PreIntegration(iterLeft->timeStamp, iterLeft->bg, iterLeft->ba);
+        }
+
+        if (lidarFrameList.size() == int(WINDOWSIZE / 1.5))
+        {
+          startTime = lidarFrameList.back().timeStamp;
+        }
+
+        if (!LidarIMUInited && lidarFrameList.size() == WINDOWSIZE && lidarFrameList.front().timeStamp >= startTime)
+        {
+          std::cout << "**************Start MAP Initialization!!!******************" << std::endl;
+          if (TryMAPInitialization())
+          {
+            LidarIMUInited = true;
+            pushCount = 0;
+            startTime = 0;
+          }
+          std::cout << "**************Finish MAP Initialization!!!******************" << std::endl;
+        }
+      }
+    }
+  }
+
+
+  time_last_lidar = time; //  update time
+  return true;
+}
+
+bool map_location::TryMAPInitialization()
+{
+
+  Eigen::Vector3d average_acc = -lidarFrameList.begin()->imuIntegrator.GetAverageAcc();
+  double info_g = std::fabs(9.805 - average_acc.norm());
+  average_acc = average_acc * 9.805 / average_acc.norm();
+
+  // calculate the initial gravity direction
+  double para_quat[4];
+  para_quat[0] = 1;
+  para_quat[1] = 0;
+  para_quat[2] = 0;
+  para_quat[3] = 0;
+
+  ceres::LocalParameterization *quatParam = new ceres::QuaternionParameterization();
+  ceres::Problem problem_quat;
+
+  problem_quat.AddParameterBlock(para_quat, 4, quatParam);
+
+  problem_quat.AddResidualBlock(Cost_Initial_G::Create(average_acc),
+                                nullptr,
+                                para_quat);
+
+  ceres::Solver::Options options_quat;
+  ceres::Solver::Summary summary_quat;
+  ceres::Solve(options_quat, &problem_quat, &summary_quat);
+
+  Eigen::Quaterniond q_wg(para_quat[0], para_quat[1], para_quat[2], para_quat[3]);
+
+  // build prior factor of LIO initialization
+  Eigen::Vector3d prior_r = Eigen::Vector3d::Zero();
+  Eigen::Vector3d prior_ba = Eigen::Vector3d::Zero();
+  Eigen::Vector3d prior_bg = Eigen::Vector3d::Zero();
+  std::vector<Eigen::Vector3d> prior_v;
+  int v_size = lidarFrameList.size();
+  for (int i = 0; i < v_size; i++)
+  {
+    prior_v.push_back(Eigen::Vector3d::Zero());
+  }
+  Sophus::SO3d SO3_R_wg(q_wg.toRotationMatrix());
+  prior_r = SO3_R_wg.log();
+
+  for (int i = 1; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + (i - 1);
+    auto iter_next = lidarFrameList.begin() + i;
+
+    Eigen::Vector3d velo_imu = (iter_next->P - iter->P) / (iter_next->timeStamp - iter->timeStamp);
+    prior_v[i] = velo_imu;
+  }
+  prior_v[0] = prior_v[1];
+
+  double para_v[v_size][3];
+  double para_r[3];
+  double para_ba[3];
+  double para_bg[3];
+
+  for (int i = 0; i < 3; i++)
+  {
+    para_r[i] = 0;
+    para_ba[i] = 0;
+    para_bg[i] = 0;
+  }
+
+  for (int i = 0; i < v_size; i++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      para_v[i][j] = prior_v[i][j];
+    }
+  }
+
+  Eigen::Matrix<double, 3, 3> sqrt_information_r = 2000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_ba = 1000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_bg = 4000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+  Eigen::Matrix<double, 3, 3> sqrt_information_v = 4000.0 * Eigen::Matrix<double, 3, 3>::Identity();
+
+  ceres::Problem::Options problem_options;
+  ceres::Problem problem(problem_options);
+  problem.AddParameterBlock(para_r, 3);
+  problem.AddParameterBlock(para_ba, 3);
+  problem.AddParameterBlock(para_bg, 3);
+  for (int i = 0; i < v_size; i++)
+  {
+    problem.AddParameterBlock(para_v[i], 3);
+  }
+
+  // add CostFunction
+  problem.AddResidualBlock(Cost_Initialization_Prior_R::Create(prior_r, sqrt_information_r),
+                           nullptr,
+                           para_r);
+
+  problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_ba, sqrt_information_ba),
+                           nullptr,
+                           para_ba);
+  problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_bg, sqrt_information_bg),
+                           nullptr,
+                           para_bg);
+
+  for (int i = 0; i < v_size; i++)
+  {
+    problem.AddResidualBlock(Cost_Initialization_Prior_bv::Create(prior_v[i], sqrt_information_v),
+                             nullptr,
+                             para_v[i]);
+  }
+
+  for (int i = 1; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + (i - 1);
+    auto iter_next = lidarFrameList.begin() + i;
+
+    Eigen::Vector3d pi = iter->P;
+    Sophus::SO3d SO3_Ri(iter->Q);
+    Eigen::Vector3d ri = SO3_Ri.log();
+    Eigen::Vector3d pj = iter_next->P;
+    Sophus::SO3d SO3_Rj(iter_next->Q);
+    Eigen::Vector3d rj = SO3_Rj.log();
+
+    problem.AddResidualBlock(Cost_Initialization_IMU::Create(iter_next->imuIntegrator,
+                                                             ri,
+                                                             rj,
+                                                             pj - pi,
+                                                             Eigen::LLT<Eigen::Matrix<double, 9, 9>>(iter_next->imuIntegrator.GetCovariance().block<9, 9>(0, 0).inverse())
+                                                                 .matrixL()
+                                                                 .transpose()),
+                             nullptr,
+                             para_r,
+                             para_v[i - 1],
+                             para_v[i],
+                             para_ba,
+                             para_bg);
+  }
+
+  ceres::Solver::Options options;
+  options.minimizer_progress_to_stdout = false;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.num_threads = 6;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+
+  Eigen::Vector3d r_wg(para_r[0], para_r[1], para_r[2]);
+  GravityVector = Sophus::SO3d::exp(r_wg) * Eigen::Vector3d(0, 0, -9.805);
+
+  Eigen::Vector3d ba_vec(para_ba[0], para_ba[1], para_ba[2]);
+  Eigen::Vector3d bg_vec(para_bg[0], para_bg[1], para_bg[2]);
+
+  std::cout << "after opt,ba:" << ba_vec.transpose() << ",bg: " << bg_vec.transpose()
+            << ",g: " << GravityVector.transpose() << std::endl;
+
+  if (ba_vec.norm() > 0.5 || bg_vec.norm() > 0.5)
+  {
+    ROS_WARN("Too Large Biases! Initialization Failed!");
+    return false;
+  }
+
+  for (int i = 0; i < v_size; i++)
+  {
+    auto iter = lidarFrameList.begin() + i;
+    iter->ba = ba_vec;
+    iter->bg = bg_vec;
+    Eigen::Vector3d bv_vec(para_v[i][0], para_v[i][1], para_v[i][2]);
+    if ((bv_vec - prior_v[i]).norm() > 2.0)
+    {
+      ROS_WARN("Too Large Velocity! Initialization Failed!");
+      std::cout << "delta v norm: " << (bv_vec - prior_v[i]).norm() << std::endl;
+      return false;
+    }
+    iter->V = bv_vec;
+  }
+
+  for (size_t i = 0; i < v_size - 1; i++)
+  {
+    auto laser_trans_i = lidarFrameList.begin() + i;
+    auto laser_trans_j = lidarFrameList.begin() + (i + 1);
+    laser_trans_j->imuIntegrator.PreIntegration(laser_trans_i->timeStamp, laser_trans_i->bg, laser_trans_i->ba);
+  }
+
+  // //if IMU success initialized
+  WINDOWSIZE = SLIDEWINDOWSIZE;
+  while (lidarFrameList.size() > WINDOWSIZE)
+  {
+    lidarFrameList.pop_front();
+  }
+  Eigen::Vector3d Pwl = lidarFrameList.back().P;
+  Eigen::Quaterniond Qwl = lidarFrameList.back().Q;
+  lidarFrameList.back().P = Pwl;
+  lidarFrameList.back().Q = Qwl;
+
+  std::cout << "\n=============================================\n|         Initialization Successful         |"
+            << "\n=============================================\n"
+            << std::endl;
+  return true;
+}
+
+bool map_location::fetchImuMsgs(double startTime, double endTime, std::vector<sensor_msgs::ImuConstPtr> &vimuMsg)
+{
+  double current_time = 0;
+  vimuMsg.clear();
+  while (true)
+  {
+    if (_imuMsgQueue.empty())
+      break;
+    if (_imuMsgQueue.back()->header.stamp.toSec() < endTime ||
+        _imuMsgQueue.front()->header.stamp.toSec() >= endTime)
+      break;
+    sensor_msgs::ImuConstPtr tmpimumsg = _imuMsgQueue.front();
+    double time = tmpimumsg->header.stamp.toSec();
+    if (time <= endTime && time > startTime)
+    {
+      vimuMsg.push_back(tmpimumsg);
+      current_time = time;
+      _imuMsgQueue.pop_front();
+      if (time == endTime)
+        break;
+    }
+    else
+    {
+      if (time <= startTime)
+      {
+        _imuMsgQueue.pop_front();
+      }
+      else
+      {
+        double dt_1 = endTime - current_time;
+        double dt_2 = time - endTime;
+        ROS_ASSERT(dt_1 >= 0);
+        ROS_ASSERT(dt_2 >= 0);
+        ROS_ASSERT(dt_1 + dt_2 > 0);
+        double w1 = dt_2 / (dt_1 + dt_2);
+        double w2 = dt_1 / (dt_1 + dt_2);
+        sensor_msgs::ImuPtr theLastIMU(new sensor_msgs::Imu);
+        theLastIMU->linear_acceleration.x = w1 * vimuMsg.back()->linear_acceleration.x + w2 * tmpimumsg->linear_acceleration.x;
+        theLastIMU->linear_acceleration.y = w1 * vimuMsg.back()->linear_acceleration.y + w2 * tmpimumsg->linear_acceleration.y;
+        theLastIMU->linear_acceleration.z = w1 * vimuMsg.back()->linear_acceleration.z + w2 * tmpimumsg->linear_acceleration.z;
+        theLastIMU->angular_velocity.x = w1 * vimuMsg.back()->angular_velocity.x + w2 * tmpimumsg->angular_velocity.x;
+        theLastIMU->angular_velocity.y = w1 * vimuMsg.back()->angular_velocity.y + w2 * tmpimumsg->angular_velocity.y;
+        theLastIMU->angular_velocity.z = w1 * vimuMsg.back()->angular_velocity.z + w2 * tmpimumsg->angular_velocity.z;
+        theLastIMU->header.stamp.fromSec(endTime);
+        vimuMsg.emplace_back(theLastIMU);
+        break;
+      }
+    }
+  }
+  return !vimuMsg.empty();
+}
+
+void map_location::processPointToLine(std::vector<ceres::CostFunction *> &edges,
+                                      std::vector<FeatureLine> &vLineFeatures,
+                                      const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                                      FusedMapQuery &mapQuery,
+                                      AssociationCache<FeatureLine> &cache,
+                                      const Eigen::Matrix4d &exTlb,
+                                      const Eigen::Matrix4d &m4d)
+{
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
+  Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
+  vLineFeatures.clear();
+  cache.Begin(m4d, laserCloudCorner->points.size());
+  PointType _pointOri, _pointSel, _coeff;
+  FusedMapQuery::Neighbourhood _near;
+
+  Eigen::Matrix<double, 3, 3> _matA1;
+  _matA1.setZero();
+
+  int laserCloudCornerStackNum = laserCloudCorner->points.size();
+  for (int i = 0; i < laserCloudCornerStackNum; i++)
+  {
+    _pointOri = laserCloudCorner->points[i];
+    MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    Eigen::Vector3d _pointSelVec(_pointSel.x, _pointSel.y, _pointSel.z);
+    size_t _featureBegin = vLineFeatures.size();
+    if (cache.Lookup(i, _pointSelVec, thres_dist, vLineFeatures))
+    {
+      for (size_t k = _featureBegin; k < vLineFeatures.size(); k++)
+        edges.push_back(Cost_NavState_IMU_Line::Create(vLineFeatures[k].pointOri,
+                                                       vLineFeatures[k].lineP1,
+                                                       vLineFeatures[k].lineP2,
+                                                       Tbl,
+                                                       Eigen::Matrix<double, 1, 1>(1 / IMUIntegrator::lidar_m)));
+      continue;
+    }
+    double _featureSqDis = 0;
+
+    //  the tighter neighbourhood of the prior map and the local map
+    if (mapQuery.NearestKSearch(_pointSel, thres_dist, _near) != FusedMapQuery::None)
+    {
+      float cx = 0;
+      float cy = 0;
+      float cz = 0;
+      for (int j = 0; j < 5; j++)
+      {
+        cx += _near.points[j].x;
+        cy += _near.points[j].y;
+        cz += _near.points[j].z;
+      }
+      cx /= 5;
+      cy /= 5;
+      cz /= 5;
+
+      float a11 = 0;
+      float a12 = 0;
+      float a13 = 0;
+      float a22 = 0;
+      float a23 = 0;
+      float a33 = 0;
+      for (int j = 0; j < 5; j++)
+      {
+        float ax = _near.points[j].x - cx;
+        float ay = _near.points[j].y - cy;
+        float az = _near.points[j].z - cz;
+
+        a11 += ax * ax;
+        a12 += ax * ay;
+        a13 += ax * az;
+        a22 += ay * ay;
+        a23 += ay * az;
+        a33 += az * az;
+      }
+      a11 /= 5;
+      a12 /= 5;
+      a13 /= 5;
+      a22 /= 5;
+      a23 /= 5;
+      a33 /= 5;
+
+      _matA1(0, 0) = a11;
+      _matA1(0, 1) = a12;
+      _matA1(0, 2) = a13;
+      _matA1(1, 0) = a12;
+      _matA1(1, 1) = a22;
+      _matA1(1, 2) = a23;
+      _matA1(2, 0) = a13;
+      _matA1(2, 1) = a23;
+      _matA1(2, 2) = a33;
+
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(_matA1);
+      Eigen::Vector3d unit_direction = saes.eigenvectors().col(2);
+
+      if (saes.eigenvalues()[2] > 3 * saes.eigenvalues()[1])
+      {
+        float x1 = cx + 0.1 * unit_direction[0];
+        float y1 = cy + 0.1 * unit_direction[1];
+        float z1 = cz + 0.1 * unit_direction[2];
+        float x2 = cx - 0.1 * unit_direction[0];
+        float y2 = cy - 0.1 * unit_direction[1];
+        float z2 = cz - 0.1 * unit_direction[2];
+
+        Eigen::Vector3d tripod1(x1, y1, z1);
+        Eigen::Vector3d tripod2(x2, y2, z2);
+        auto *e = Cost_NavState_IMU_Line::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                                 tripod1,
+                                                 tripod2,
+                                                 Tbl,
+                                                 Eigen::Matrix<double, 1, 1>(1 / IMUIntegrator::lidar_m));
+        edges.push_back(e);
+        vLineFeatures.emplace_back(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                   tripod1,
+                                   tripod2);
+        vLineFeatures.back().ComputeError(m4d);
+        vLineFeatures.back().valid = std::fabs(vLineFeatures.back().error) > 1e-5;
+        _featureSqDis = _near.sqDists[4];
+      }
+    }
+    cache.Record(i, _pointSelVec, _featureSqDis, _featureBegin, vLineFeatures);
+  }
+  cache.End(vLineFeatures);
+}
+
+void map_location::processPointToPlanVec(std::vector<ceres::CostFunction *> &edges,
+                                         std::vector<FeaturePlanVec> &vPlanFeatures,
+                                         const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                                         FusedMapQuery &mapQuery,
+                                         AssociationCache<FeaturePlanVec> &cache,
+                                         const Eigen::Matrix4d &exTlb,
+                                         const Eigen::Matrix4d &m4d)
+{
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
+  Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
+  vPlanFeatures.clear();
+  cache.Begin(m4d, laserCloudSurf->points.size());
+  PointType _pointOri, _pointSel, _coeff;
+  FusedMapQuery::Neighbourhood _near;
+
+  Eigen::Matrix<double, 5, 3> _matA0;
+  _matA0.setZero();
+  Eigen::Matrix<double, 5, 1> _matB0;
+  _matB0.setOnes();
+  _matB0 *= -1;
+  Eigen::Matrix<double, 3, 1> _matX0;
+  _matX0.setZero();
+  int laserCloudSurfStackNum = laserCloudSurf->points.size();
+
+  for (int i = 0; i < laserCloudSurfStackNum; i++)
+  {
+    _pointOri = laserCloudSurf->points[i];
+    MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    Eigen::Vector3d _pointSelVec(_pointSel.x, _pointSel.y, _pointSel.z);
+    size_t _featureBegin = vPlanFeatures.size();
+    if (cache.Lookup(i, _pointSelVec, thres_dist, vPlanFeatures))
+    {
+      for (size_t k = _featureBegin; k < vPlanFeatures.size(); k++)
+        edges.push_back(Cost_NavState_IMU_Plan_Vec::Create(vPlanFeatures[k].pointOri,
+                                                           vPlanFeatures[k].pointProj,
+                                                           Tbl,
+                                                           vPlanFeatures[k].sqrt_info));
+      continue;
+    }
+    double _featureSqDis = 0;
+    //  the tighter neighbourhood of the prior map and the local map
+    if (mapQuery.NearestKSearch(_pointSel, thres_dist, _near) != FusedMapQuery::None)
+    {
+      for (int j = 0; j < 5; j++)
+      {
+        _matA0(j, 0) = _near.points[j].x;
+        _matA0(j, 1) = _near.points[j].y;
+        _matA0(j, 2) = _near.points[j].z;
+      }
+      _matX0 = _matA0.colPivHouseholderQr().solve(_matB0);
+
+      float pa = _matX0(0, 0);
+      float pb = _matX0(1, 0);
+      float pc = _matX0(2, 0);
+      float pd = 1;
+
+      float ps = std::sqrt(pa * pa + pb * pb + pc * pc);
+      pa /= ps;
+      pb /= ps;
+      pc /= ps;
+      pd /= ps;
+
+      bool planeValid = true;
+      for (int j = 0; j < 5; j++)
+      {
+        if (std::fabs(pa * _near.points[j].x +
+                      pb * _near.points[j].y +
+                      pc * _near.points[j].z + pd) > 0.2)
+        {
+          planeValid = false;
+          break;
+        }
+      }
+
+      if (planeValid)
+      {
+        double dist = pa * _pointSel.x +
+                      pb * _pointSel.y +
+                      pc * _pointSel.z + pd;
+        Eigen::Vector3d omega(pa, pb, pc);
+        Eigen::Vector3d point_proj = Eigen::Vector3d(_pointSel.x, _pointSel.y, _pointSel.z) - (dist * omega);
+        Eigen::Matrix3d sqrt_info = PlaneSqrtInfo(omega);
+
+        auto *e = Cost_NavState_IMU_Plan_Vec::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                                     point_proj,
+                                                     Tbl,
+                                                     sqrt_info);
+        edges.push_back(e);
+        vPlanFeatures.emplace_back(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                   point_proj,
+                                   sqrt_info);
+        vPlanFeatures.back().ComputeError(m4d);
+        vPlanFeatures.back().valid = std::fabs(vPlanFeatures.back().error) > 1e-5;
+        _featureSqDis = _near.sqDists[4];
+      }
+    }
+    cache.Record(i, _pointSelVec, _featureSqDis, _featureBegin, vPlanFeatures);
+  }
+  cache.End(vPlanFeatures);
+}
+
+Eigen::Matrix3d map_location::PlaneSqrtInfo(const Eigen::Vector3d &omega) const
+{
+  Eigen::Vector3d e1(1, 0, 0);
+  Eigen::Matrix3d J = e1 * omega.transpose();
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(J, Eigen::ComputeThinU | Eigen::ComputeThinV);
+  Eigen::Matrix3d R_svd = svd.matrixV() * svd.matrixU().transpose();
+  Eigen::Matrix3d info = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
+  info(1, 1) *= plan_weight_tan;
+  info(2, 2) *= plan_weight_tan;
+  return info * R_svd.transpose();
+}
+
+void map_location::processPointToLineCoarse(std::vector<ceres::CostFunction *> &edges,
+                                            std::vector<FeatureLine> &vLineFeatures,
+                                            const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                                            const MapPyramid::Level &level,
+                                            int stride,
+                                            const Eigen::Matrix4d &exTlb,
+                                            const Eigen::Matrix4d &m4d)
+{
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
+  Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
+  vLineFeatures.clear();
+  PointType _pointSel;
+  KnnResult<1> _knn;
+  // the nearest centroid lies within two voxels, the point within one voxel of its line
+  const float maxSqDist = 4 * level.voxel * level.voxel;
+
+  int laserCloudCornerStackNum = laserCloudCorner->points.size();
+  for (int i = 0; i < laserCloudCornerStackNum; i += stride)
+  {
+    const PointType &_pointOri = laserCloudCorner->points[i];
+    MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    if (level.cornerTree.nearestKSearch(_pointSel, _knn, maxSqDist) < 1)
+      continue;
+    const PointType &c = level.corner->points[_knn.indices[0]];
+    Eigen::Vector3d centre(c.x, c.y, c.z);
+    Eigen::Vector3d unit_direction(c.normal_x, c.normal_y, c.normal_z);
+    Eigen::Vector3d d = Eigen::Vector3d(_pointSel.x, _pointSel.y, _pointSel.z) - centre;
+    if ((d - d.dot(unit_direction) * unit_direction).norm() > level.voxel)
+      continue;
+
+    Eigen::Vector3d tripod1 = centre + 0.1 * unit_direction;
+    Eigen::Vector3d tripod2 = centre - 0.1 * unit_direction;
+    auto *e = Cost_NavState_IMU_Line::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                             tripod1,
+                                             tripod2,
+                                             Tbl,
+                                             Eigen::Matrix<double, 1, 1>(1 / IMUIntegrator::lidar_m));
+    edges.push_back(e);
+    vLineFeatures.emplace_back(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                               tripod1,
+                               tripod2);
+    vLineFeatures.back().ComputeError(m4d);
+    vLineFeatures.back().valid = std::fabs(vLineFeatures.back().error) > 1e-5;
+  }
+}
+
+void map_location::processPointToPlanVecCoarse(std::vector<ceres::CostFunction *> &edges,
+                                               std::vector<FeaturePlanVec> &vPlanFeatures,
+                                               const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                                               const MapPyramid::Level &level,
+                                               int stride,
+                                               const Eigen::Matrix4d &exTlb,
+                                               const Eigen::Matrix4d &m4d)
+{
+  TRACE_THREAD_NAME("association");
+  PROFILE_SPAN(Association);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
+  Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
+  vPlanFeatures.clear();
+  PointType _pointSel;
+  KnnResult<1> _knn;
+  // the nearest centroid lies within two voxels, the point within one voxel of its plane
+  const float maxSqDist = 4 * level.voxel * level.voxel;
+
+  int laserCloudSurfStackNum = laserCloudSurf->points.size();
+  for (int i = 0; i < laserCloudSurfStackNum; i += stride)
+  {
+    const PointType &_pointOri = laserCloudSurf->points[i];
+    MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+    if (level.surfTree.nearestKSearch(_pointSel, _knn, maxSqDist) < 1)
+      continue;
+    const PointType &c = level.surf->points[_knn.indices[0]];
+    Eigen::Vector3d omega(c.normal_x, c.normal_y, c.normal_z);
+    Eigen::Vector3d pointSel(_pointSel.x, _pointSel.y, _pointSel.z);
+    double dist = omega.dot(pointSel - Eigen::Vector3d(c.x, c.y, c.z));
+    if (std::fabs(dist) > level.voxel)
+      continue;
+
+    Eigen::Vector3d point_proj = pointSel - dist * omega;
+    Eigen::Matrix3d sqrt_info = PlaneSqrtInfo(omega);
+    auto *e = Cost_NavState_IMU_Plan_Vec::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                                 point_proj,
+                                                 Tbl,
+                                                 sqrt_info);
+    edges.push_back(e);
+    vPlanFeatures.emplace_back(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                               point_proj,
+                               sqrt_info);
+    vPlanFeatures.back().ComputeError(m4d);
+    vPlanFeatures.back().valid = std::fabs(vPlanFeatures.back().error) > 1e-5;
+  }
+}
+
+void map_location::processPointToNdt(std::vector<ceres::CostFunction *> &edges,
+                                     std::vector<FeaturePlanVec> &vPlanFeatures,
+                                     const pcl::PointCloud<PointType>::Ptr &laserCloudCorner,
+                                     const pcl::PointCloud<PointType>::Ptr &laserCloudSurf,
+                                     const Eigen::Matrix4d &exTlb,
+                                     const Eigen::Matrix4d &m4d)
+{
+  PROFILE_SPAN(Association);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Tbl.topLeftCorner(3, 3) = exTlb.topLeftCorner(3, 3).transpose();
+  Tbl.topRightCorner(3, 1) = -1.0 * Tbl.topLeftCorner(3, 3) * exTlb.topRightCorner(3, 1);
+  vPlanFeatures.clear();
+  PointType _pointSel;
+  NdtMap::Match _match;
+  const pcl::PointCloud<PointType>::Ptr clouds[2] = {laserCloudCorner, laserCloudSurf};
+
+  for (int c = 0; c < 2; c++)
+  {
+    int laserCloudStackNum = clouds[c]->points.size();
+    ndtQueries += laserCloudStackNum;
+    for (int i = 0; i < laserCloudStackNum; i++)
+    {
+      const PointType &_pointOri = clouds[c]->points[i];
+      MAP_MANAGER::pointAssociateToMap(&_pointOri, &_pointSel, m4d);
+      Eigen::Vector3d pointSel(_pointSel.x, _pointSel.y, _pointSel.z);
+      if (!ndtMap.Lookup(pointSel, c, _match))
+        continue;
+      // the weighted offset is the point to plane or point to line distance, gated like the neighbourhoods
+      if ((_match.sqrtInfo * (pointSel - _match.mean)).squaredNorm() > thres_dist)
+        continue;
+
+      Eigen::Matrix3d sqrt_info = (1.0 / IMUIntegrator::lidar_m) * _match.sqrtInfo;
+      auto *e = Cost_NavState_IMU_Plan_Vec::Create(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                                   _match.mean,
+                                                   Tbl,
+                                                   sqrt_info);
+      edges.push_back(e);
+      vPlanFeatures.emplace_back(Eigen::Vector3d(_pointOri.x, _pointOri.y, _pointOri.z),
+                                 _match.mean,
+                                 sqrt_info);
+      vPlanFeatures.back().ComputeError(m4d);
+      vPlanFeatures.back().valid = std::fabs(vPlanFeatures.back().error) > 1e-5;
+      ndtMatched++;
+    }
+  }
+}
+
+void map_location::MapIncrementLocal(LidarFrame &kframe)
+{
+  PROFILE_SPAN(MapUpdate);
+  int laserCloudCornerStackNum = kframe.corner->points.size();
+  int laserCloudSurfStackNum = kframe.surf->points.size();
+  Eigen::Matrix4d pose_in_map = Eigen::Matrix4d::Identity();
+  pose_in_map.topLeftCorner(3, 3) = kframe.Q.toRotationMatrix();
+  pose_in_map.topRightCorner(3, 1) = kframe.P;
+  cornerInMap_.resize(laserCloudCornerStackNum);
+  surfInMap_.resize(laserCloudSurfStackNum);
+  for (int i = 0; i < laserCloudCornerStackNum; i++)
+    MAP_MANAGER::pointAssociateToMap(&kframe.corner->points[i], &cornerInMap_.points[i], pose_in_map);
+  for (int i = 0; i < laserCloudSurfStackNum; i++)
+    MAP_MANAGER::pointAssociateToMap(&kframe.surf->points[i], &surfInMap_.points[i], pose_in_map);
+
+  //  only the new scan is inserted, the oldest one is evicted in place
+  localCornerMap->Insert(cornerInMap_);
+  localSurfMap->Insert(surfInMap_);
+}
+
+bool map_location::ICPScanMatchGlobal(LidarWindow &kframeList)
+{
+  if (kframeList.size() != 1)
+    std::cout << "may error,only process one lidar frame" << std::endl;
+
+  auto &kframe = kframeList.front();
+  CLOUD_PTR surf = cloudPool_.Acquire();
+  for (const auto &p : kframe.laserCloud->points)
+  {
+    if (p.label == LabelledPoint::Surf)
+      surf->push_back(p.ToMapPoint());
+  }
+  ds_surf_.setInputCloud(surf);
+  ds_surf_.filter(*surf);
+
+  TicToc tc;
+  //  the csm result is only a guess for icp, initpose keeps the user's guess until icp accepts it
+  PointTypePose guess = initpose;
+  bool guessMoved = false;
+  if (use_csm)
+  {
+    //  global search over x/y/yaw first, icp only refines the result
+    Eigen::Matrix4d csm_pose;
+    double csm_score = 0;
+    bool hasMap = false;
+    bool matched = false;
+    tc.tic();
+    {
+      std::lock_guard<std::mutex> lock(mtx_csm);
+      hasMap = scan_matcher->HasMap();
+      if (hasMap)
+        matched = scan_matcher->Match(surf, toMatrix(initpose), csm_pose, csm_score);
+    }
+    if (!hasMap)
+    {
+      //  the grids are only built around a keyframe, a map without keyframes has none
+      if (!csm_fallback_logged)
+        std::cout << ANSI_COLOR_YELLOW << "csm has no map, icp starts from the initial pose" << ANSI_COLOR_RESET << std::endl;
+      csm_fallback_logged = true;
+    }
+    else if (!matched)
+    {
+      std::cout << ANSI_COLOR_YELLOW << "csm failed, score: " << csm_score << ", icp starts from the initial pose" << ANSI_COLOR_RESET << std::endl;
+    }
+    else
+    {
+      std::cout << "csm takes: " << tc.toc() << "ms, score: " << csm_score << std::endl;
+      guess.x = csm_pose(0, 3);
+      guess.y = csm_pose(1, 3);
+      guess.yaw = std::atan2(csm_pose(1, 0), csm_pose(0, 0));
+      PointType p;
+      p.x = guess.x;
+      p.y = guess.y;
+      p.z = guess.z;
+      extractSurroundKeyFrames(p);
+      guessMoved = true;
+    }
+  }
+
+  tc.tic();
+  CLOUD_PTR cloud_icp = TransformPointCloud(surf, &guess);
+
+  pcl::IterativeClosestPoint<PointType, PointType> icp;
+  icp.setMaxCorrespondenceDistance(50);
+  icp.setMaximumIterations(30);
+  icp.setTransformationEpsilon(1e-4);
+  icp.setEuclideanFitnessEpsilon(1e-4);
+  icp.setRANSACIterations(0);
+
+  icp.setInputSource(cloud_icp);
+  icp.setInputTarget(surround_surf);
+  CLOUD_PTR unused_result = cloudPool_.Acquire();
+  icp.align(*unused_result);
+
+  if (icp.hasConverged() == false || icp.getFitnessScore() > 0.4)
+  {
+    std::cout << ANSI_COLOR_RED << "initial loc failed...,score: " << icp.getFitnessScore() << ANSI_COLOR_RESET << std::endl;
+    if (guessMoved)
+    {
+      //  the next attempt starts from the user's guess again
+      PointType p;
+      p.x = initpose.x;
+      p.y = initpose.y;
+      p.z = initpose.z;
+      extractSurroundKeyFrames(p);
+    }
+    return false;
+  }
+  initpose = guess;
+  Eigen::Affine3f correct_transform;
+  correct_transform = icp.getFinalTransformation();
+  Eigen::Matrix4d curr_pose = toMatrix(initpose);
+
+  Eigen::Matrix4d pose = correct_transform.matrix().cast<double>() * curr_pose;
+
+  kframe.Q = pose.block<3, 3>(0, 0);
+  kframe.P = pose.topRightCorner(3, 1); //  update pose here
+
+  double tt = tc.toc();
+  std::cout << "icp takes: " << tt << "ms" << std::endl;
+  if (!nh_)
+    return true;
+  CLOUD_PTR output = cloudPool_.Acquire();
+
+  pcl::transformPointCloud(*surf, *output, pose);
+  sensor_msgs::PointCloud2 msg_target;
+  // pcl::toROSMsg(*cloud_icp, msg_target);
+  pcl::toROSMsg(*output, msg_target);
+  msg_target.header.stamp = ros::Time::now();
+  msg_target.header.frame_id = "world";
+  pub_surf_.publish(msg_target);
+
+  return true;
+}
+
+Eigen::Matrix4d map_location::toMatrix(PointTypePose &p)
+{
+  Eigen::Matrix4d odom = Eigen::Matrix4d::Identity();
+  Eigen::AngleAxisd rollAngle(Eigen::AngleAxisd(p.roll, Eigen::Vector3d::UnitX()));
+  Eigen::AngleAxisd pitchAngle(Eigen::AngleAxisd(p.pitch, Eigen::Vector3d::UnitY()));
+  Eigen::AngleAxisd yawAngle(Eigen::AngleAxisd(p.yaw, Eigen::Vector3d::UnitZ()));
+  Eigen::Quaterniond rotation = yawAngle * pitchAngle * rollAngle;
+  odom.block(0, 0, 3, 3) = rotation.toRotationMatrix();
+  odom(0, 3) = p.x, odom(1, 3) = p.y, odom(2, 3) = p.z;
+  return odom;
+}
+
+CLOUD_PTR map_location::TransformPointCloud(CLOUD_PTR cloudIn, PointTypePose *transformIn)
+{
+  CLOUD_PTR cloudOut = cloudPool_.Acquire();
+  PointType *pointfrom;
+  PointType pointTo;
+
+  int cloudSize = cloudIn->points.size();
+  cloudOut->resize(cloudSize);
+  for (int i = 0; i < cloudSize; i++)
+  {
+    pointfrom = &cloudIn->points[i];
+    float x1 = pointfrom->x;
+    float y1 = cos(transformIn->roll) * pointfrom->y - sin(transformIn->roll) * pointfrom->z;
+    float z1 = sin(transformIn->roll) * pointfrom->y + cos(transformIn->roll) * pointfrom->z;
+
+    float x2 = cos(transformIn->pitch) * x1 + sin(transformIn->pitch) * z1;
+    float y2 = y1;
+    float z2 = -sin(transformIn->pitch) * x1 + cos(transformIn->pitch) * z1;
+
+    pointTo.x = cos(transformIn->yaw) * x2 - sin(transformIn->yaw) * y2 + transformIn->x;
+    pointTo.y = sin(transformIn->yaw) * x2 + cos(transformIn->yaw) * y2 + transformIn->y;
+    pointTo.z = z2 + transformIn->z;
+    pointTo.intensity = pointfrom->intensity;
+
+    cloudOut->points[i] = pointTo;
+  }
+  return cloudOut;
+}
+
+bool map_location::extractSurroundKeyFrames(const PointType &p)
+{
+  TicToc tc;
+  tc.tic();
+  std::cout << "-----extract surround keyframes ------ " << std::endl;
+  std::vector<int> point_search_idx_;
+  std::vector<float> point_search_dist_;
+  double surround_search_radius_ = 5.0;
+  kdtree_keyposes_3d_->radiusSearch(p, surround_search_radius_, point_search_idx_, point_search_dist_, 0);
+  surround_surf->clear();
+  surround_corner->clear();
+  for (int i = 0; i < point_search_idx_.size(); ++i)
+  {
+    *surround_surf += *map.surf_keyframes_[i];
+    *surround_corner += *map.corner_keyframes_[i];
+  }
+  ds_corner_.setInputCloud(surround_corner);
+  ds_corner_.filter(*surround_corner);
+  ds_surf_.setInputCloud(surround_surf);
+  ds_surf_.filter(*surround_surf);
+  double tt = tc.toc();
+  std::cout << __FUNCTION__ << ",takes: " << tt << "ms" << std::endl;
+}
+
+bool map_location::loadmap()
+{
+  std::cout << ANSI_COLOR_YELLOW << "file dir: " << filename << ANSI_COLOR_RESET << std::endl;
+  CLOUD_PTR globalCornerCloud(new CLOUD);
+  CLOUD_PTR globalSurfCloud(new CLOUD);
+
+  std::string fn_poses_ = filename + "/trajectory.pcd";
+  std::string fn_corner_ = filename + "/CornerMap.pcd";
+  std::string fn_surf_ = filename + "/SurfMap.pcd";
+  std::string fn_global_ = filename + "/GlobalMap.pcd";
+
+  if (pcl::io::loadPCDFile(fn_poses_, *map.cloudKeyPoses3D_) == -1 ||
+      pcl::io::loadPCDFile(fn_corner_, *globalCornerCloud) == -1 ||
+      pcl::io::loadPCDFile(fn_surf_, *globalSurfCloud) == -1 ||
+      pcl::io::loadPCDFile(fn_global_, *map.globalMapCloud_))
+  {
+    std::cout << ANSI_COLOR_RED << "couldn't load pcd file" << ANSI_COLOR_RESET << std::endl;
+    return false;
+  }
+
+  map.corner_keyframes_.resize(map.cloudKeyPoses3D_->points.size());
+  map.surf_keyframes_.resize(map.cloudKeyPoses3D_->points.size());
+  for (int i = 0; i < map.cloudKeyPoses3D_->points.size(); ++i)
+  {
+    map.corner_keyframes_[i] = CLOUD_PTR(new CLOUD);
+    map.surf_keyframes_[i] = CLOUD_PTR(new CLOUD);
+  }
+
+  for (int i = 0; i < globalCornerCloud->points.size(); ++i)
+  {
+    const auto &p = globalCornerCloud->points[i];
+    map.corner_keyframes_[int(p.intensity)]->points.push_back(p);
+  }
+  for (int i = 0; i < globalSurfCloud->points.size(); ++i)
+  {
+    const auto &p = globalSurfCloud->points[i];
+    map.surf_keyframes_[int(p.intensity)]->points.push_back(p);
+  }
+  ds_corner_.setInputCloud(globalCornerCloud);
+  ds_corner_.filter(*map.globalCornerMapCloud_);
+  std::cout << globalCornerCloud->size() << ", " << map.globalCornerMapCloud_->size() << std::endl;
+  ds_surf_.setInputCloud(globalSurfCloud);
+  ds_surf_.filter(*map.globalSurfMapCloud_);
+
+  if (use_ndt)
+  {
+    // built once from the full resolution maps and cached next to them
+    PROFILE_SPAN(KdBuild);
+    std::string fn_ndt_ = filename + "/NdtMap.bin";
+    if (ndtMap.Load(fn_ndt_, globalCornerCloud->size(), globalSurfCloud->size()))
+      std::cout << "loaded " << fn_ndt_ << std::endl;
+    else
+    {
+      ndtMap.Build(*globalCornerCloud, *globalSurfCloud);
+      if (!ndtMap.Save(fn_ndt_))
+        std::cout << ANSI_COLOR_RED << "couldn't save " << fn_ndt_ << ANSI_COLOR_RESET << std::endl;
+    }
+  }
+  return true;
+}
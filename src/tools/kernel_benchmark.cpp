@@ -0,0 +1,470 @@
+/*
+ * Microbenchmarks of the estimator hot kernels.
+ *
+ * usage:
+ *   kernel_benchmark [--scan <pcd>] [--benchmark_filter=<regex>] [--benchmark_format=json] [--benchmark_out=<file>]
+ *
+ * Without --scan the kernels run on a synthetic 32 ring scan of a box shaped room. A recorded scan is a
+ * PointXYZINormal pcd as fed to the feature extraction: normal_x is the relative time, normal_y the ring.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <pcl/io/pcd_io.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include "Estimator/FeatureExtractor.h"
+#include "Estimator/IMUIntegrator.h"
+#include "Estimator/LioPipeline.h"
+#include "Estimator/Map_Manager.h"
+#include "Estimator/MortonOrder.h"
+#include "Estimator/Estimator.h"
+#include "Estimator/StaticKdTree.h"
+#include "Estimator/VoxelFilter.h"
+
+typedef pcl::PointXYZINormal PointType;
+typedef pcl::PointCloud<PointType> CLOUD;
+
+static const int kNScan = 32;
+static const int kHorizonScan = 1800;
+static CLOUD::Ptr recorded_scan;
+
+/** \brief one revolution of a lidar in the middle of a 40 x 30 x 8 m box */
+static CLOUD::Ptr SyntheticScan()
+{
+  CLOUD::Ptr scan(new CLOUD);
+  scan->reserve(kNScan * kHorizonScan);
+  for (int ring = 0; ring < kNScan; ++ring)
+  {
+    double pitch = (-25.0 + 40.0 * ring / (kNScan - 1)) * M_PI / 180.0;
+    for (int col = 0; col < kHorizonScan; ++col)
+    {
+      double yaw = 2 * M_PI * col / kHorizonScan;
+      Eigen::Vector3d dir(std::cos(pitch) * std::cos(yaw), std::cos(pitch) * std::sin(yaw), std::sin(pitch));
+      // distance to the nearest wall, floor or ceiling
+      double range = 1e9;
+      const double half[3] = {20.0, 15.0, 4.0};
+      for (int a = 0; a < 3; ++a)
+        if (std::fabs(dir(a)) > 1e-6)
+          range = std::min(range, half[a] / std::fabs(dir(a)));
+      PointType p;
+      p.x = range * dir(0);
+      p.y = range * dir(1);
+      p.z = range * dir(2);
+      p.intensity = 10;
+      p.normal_x = static_cast<float>(col) / kHorizonScan;
+      p.normal_y = ring;
+      p.normal_z = 0;
+      scan->push_back(p);
+    }
+  }
+  return scan;
+}
+
+static CLOUD::Ptr Scan()
+{
+  static CLOUD::Ptr scan = recorded_scan ? recorded_scan : SyntheticScan();
+  return scan;
+}
+
+static CLOUD::Ptr RandomCloud(size_t n, double extent, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uni(-extent, extent);
+  std::uniform_real_distribution<float> time(0, 1);
+  CLOUD::Ptr cloud(new CLOUD);
+  cloud->resize(n);
+  for (auto &p : cloud->points)
+  {
+    p.x = uni(rng);
+    p.y = uni(rng);
+    p.z = 0.1 * uni(rng);
+    p.intensity = 1;
+    p.normal_x = time(rng);
+    p.normal_y = 0;
+    p.normal_z = 2;
+  }
+  return cloud;
+}
+
+static std::vector<sensor_msgs::ImuConstPtr> SyntheticImu(int n, double t0, double rate)
+{
+  std::vector<sensor_msgs::ImuConstPtr> vimu;
+  for (int i = 0; i < n; ++i)
+  {
+    sensor_msgs::ImuPtr imu(new sensor_msgs::Imu);
+    imu->header.stamp.fromSec(t0 + (i + 1) / rate);
+    imu->linear_acceleration.x = 0.1 * std::sin(0.1 * i);
+    imu->linear_acceleration.y = 0.05;
+    imu->linear_acceleration.z = 9.805;
+    imu->angular_velocity.x = 0.01;
+    imu->angular_velocity.y = 0.0;
+    imu->angular_velocity.z = 0.2;
+    vimu.push_back(imu);
+  }
+  return vimu;
+}
+
+static void BM_MapIncrement(benchmark::State &state)
+{
+  std::unique_ptr<MAP_MANAGER> map(new MAP_MANAGER(0.2, 0.4));
+  CLOUD::Ptr corner = RandomCloud(state.range(0) / 4, 30.0, 1);
+  CLOUD::Ptr surf = RandomCloud(state.range(0), 30.0, 2);
+  CLOUD::Ptr nonfeature(new CLOUD);
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  // fill the cubes until the voxel filters keep their size
+  for (int i = 0; i < 10; ++i)
+    map->MapIncrement(corner, surf, nonfeature, pose);
+  int frame = 0;
+  for (auto _ : state)
+  {
+    pose(0, 3) = 0.5 * (frame++ % 20);
+    map->MapIncrement(corner, surf, nonfeature, pose);
+  }
+  state.SetItemsProcessed(state.iterations() * (corner->size() + surf->size()));
+}
+BENCHMARK(BM_MapIncrement)->Arg(2000)->Arg(8000)->Unit(benchmark::kMillisecond);
+
+static void BM_PclVoxelGrid(benchmark::State &state)
+{
+  CLOUD::Ptr cloud = RandomCloud(state.range(0), 30.0, 3);
+  CLOUD filtered;
+  pcl::VoxelGrid<PointType> filter;
+  filter.setLeafSize(0.4, 0.4, 0.4);
+  filter.setInputCloud(cloud);
+  for (auto _ : state)
+    filter.filter(filtered);
+  state.SetItemsProcessed(state.iterations() * cloud->size());
+}
+BENCHMARK(BM_PclVoxelGrid)->Arg(1000)->Arg(20000)->Arg(300000)->Unit(benchmark::kMicrosecond);
+
+template <bool COMPATIBLE>
+static void BM_VoxelFilter(benchmark::State &state)
+{
+  CLOUD::Ptr cloud = RandomCloud(state.range(0), 30.0, 3);
+  CLOUD filtered;
+  VoxelFilter filter;
+  filter.setCompatible(COMPATIBLE);
+  filter.setLeafSize(0.4, 0.4, 0.4);
+  filter.setInputCloud(cloud);
+  for (auto _ : state)
+    filter.filter(filtered);
+  state.SetItemsProcessed(state.iterations() * cloud->size());
+}
+BENCHMARK_TEMPLATE(BM_VoxelFilter, false)->Arg(1000)->Arg(20000)->Arg(300000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_VoxelFilter, true)->Arg(1000)->Arg(20000)->Arg(300000)->Unit(benchmark::kMicrosecond);
+
+static void BM_MapMove(benchmark::State &state)
+{
+  std::unique_ptr<MAP_MANAGER> map(new MAP_MANAGER(0.2, 0.4));
+  CLOUD::Ptr surf = RandomCloud(8000, 30.0, 2);
+  CLOUD::Ptr corner = RandomCloud(2000, 30.0, 1);
+  CLOUD::Ptr nonfeature(new CLOUD);
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  map->MapIncrement(corner, surf, nonfeature, pose);
+  int frame = 0;
+  for (auto _ : state)
+  {
+    // jump back and forth across the shift boundary so every call moves the cube array
+    pose(0, 3) = (frame++ % 2) ? 150.0 : -150.0;
+    map->MapMove(pose);
+  }
+}
+BENCHMARK(BM_MapMove)->Unit(benchmark::kMicrosecond);
+
+static void BM_CubeKnn5(benchmark::State &state)
+{
+  // one 50 m cube of the map after downsampling
+  CLOUD::Ptr cube = RandomCloud(state.range(0), 25.0, 3);
+  pcl::KdTreeFLANN<PointType> kdtree;
+  kdtree.setInputCloud(cube);
+  CLOUD::Ptr queries = RandomCloud(1024, 25.0, 4);
+  std::vector<int> indices;
+  std::vector<float> sqdist;
+  size_t q = 0;
+  for (auto _ : state)
+  {
+    kdtree.nearestKSearch(queries->points[q++ & 1023], 5, indices, sqdist);
+    benchmark::DoNotOptimize(sqdist.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CubeKnn5)->Arg(1000)->Arg(10000)->Arg(50000);
+
+static void BM_CubeKnn5Static(benchmark::State &state)
+{
+  // same queries as BM_CubeKnn5 through the tree of the map
+  CLOUD::Ptr cube = RandomCloud(state.range(0), 25.0, 3);
+  StaticKdTree<PointType> kdtree;
+  kdtree.setInputCloud(cube);
+  CLOUD::Ptr queries = RandomCloud(1024, 25.0, 4);
+  KnnResult<5> knn;
+  size_t q = 0;
+  for (auto _ : state)
+  {
+    kdtree.nearestKSearch(queries->points[q++ & 1023], knn);
+    benchmark::DoNotOptimize(knn.sqDists);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CubeKnn5Static)->Arg(1000)->Arg(10000)->Arg(50000);
+
+template <bool Morton>
+static void BM_FrameKnn5(benchmark::State &state)
+{
+  // the surf features of one frame against a dense map, in voxel filter order or along the curve
+  CLOUD::Ptr map = RandomCloud(state.range(0), 60.0, 3);
+  StaticKdTree<PointType> kdtree;
+  kdtree.setInputCloud(map);
+  CLOUD::Ptr frame = RandomCloud(4000, 60.0, 4);
+  MortonOrder<PointType> order;
+  KnnResult<5> knn;
+  for (auto _ : state)
+  {
+    if (Morton)
+      order.Sort(*frame);
+    for (const auto &p : frame->points)
+    {
+      kdtree.nearestKSearch(p, knn);
+      benchmark::DoNotOptimize(knn.sqDists);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * frame->size());
+}
+BENCHMARK_TEMPLATE(BM_FrameKnn5, false)->Arg(100000)->Arg(2000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FrameKnn5, true)->Arg(100000)->Arg(2000000)->Unit(benchmark::kMicrosecond);
+
+template <bool Quantized>
+static void BM_PriorMapKnn5(benchmark::State &state)
+{
+  // the frame queries of BM_FrameKnn5 against a prior map 5 km from the world origin
+  CLOUD::Ptr map = RandomCloud(state.range(0), 60.0, 3);
+  CLOUD::Ptr frame = RandomCloud(4000, 60.0, 4);
+  for (auto &p : map->points)
+    p.x += 5000.0f;
+  for (auto &p : frame->points)
+    p.x += 5000.0f;
+  StaticKdTree<PointType> kdtree;
+  kdtree.setQuantizationStep(Quantized ? 0.005f : 0.0f);
+  kdtree.setInputCloud(map);
+  KnnResult<5> knn;
+  for (auto _ : state)
+  {
+    for (const auto &p : frame->points)
+    {
+      kdtree.nearestKSearch(p, knn);
+      benchmark::DoNotOptimize(knn.xyz);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * frame->size());
+  state.counters["index_bytes"] = double(kdtree.memoryBytes());
+}
+BENCHMARK_TEMPLATE(BM_PriorMapKnn5, false)->Arg(100000)->Arg(2000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_PriorMapKnn5, true)->Arg(100000)->Arg(2000000)->Unit(benchmark::kMicrosecond);
+
+template <bool Static>
+static void BM_KdTreeBuild(benchmark::State &state)
+{
+  // per cube rebuild of MapIncrement and the prior map of map_location at the largest size
+  CLOUD::Ptr cloud = RandomCloud(state.range(0), 25.0, 3);
+  pcl::KdTreeFLANN<PointType> flann;
+  StaticKdTree<PointType> tree;
+  for (auto _ : state)
+  {
+    if (Static)
+      tree.setInputCloud(cloud);
+    else
+      flann.setInputCloud(cloud);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_KdTreeBuild, false)->Arg(1000)->Arg(50000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_KdTreeBuild, true)->Arg(1000)->Arg(50000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+static void BM_PlaneFit5(benchmark::State &state)
+{
+  // the fit of Estimator::processPointToPlanVec, on noisy neighbourhoods of a plane
+  std::mt19937 rng(5);
+  std::normal_distribution<double> noise(0, 0.02);
+  std::vector<Eigen::Matrix<double, 5, 3>> neighbours(256);
+  for (auto &A : neighbours)
+    for (int j = 0; j < 5; ++j)
+      A.row(j) << float(0.3 * j + noise(rng)), float(0.2 * (j % 3) + noise(rng)), float(2.0 + noise(rng));
+  PointType pointSel;
+  pointSel.x = 0.5f;
+  pointSel.y = 0.3f;
+  pointSel.z = 2.05f;
+  size_t k = 0;
+  for (auto _ : state)
+  {
+    Eigen::Vector4f plane;
+    const bool planeValid = Estimator::PlaneFit5(neighbours[k++ & 255], plane);
+    double dist = plane(0) * pointSel.x + plane(1) * pointSel.y + plane(2) * pointSel.z + plane(3);
+    Eigen::Vector3d omega(plane(0), plane(1), plane(2));
+    Eigen::Vector3d point_proj = Eigen::Vector3d(pointSel.x, pointSel.y, pointSel.z) - dist * omega;
+    Eigen::Matrix3d sqrt_info = Estimator::PlaneSqrtInfo(omega, 1.0);
+    benchmark::DoNotOptimize(planeValid);
+    benchmark::DoNotOptimize(point_proj);
+    benchmark::DoNotOptimize(sqrt_info);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlaneFit5);
+
+static void BM_PreIntegration(benchmark::State &state)
+{
+  std::vector<sensor_msgs::ImuConstPtr> vimu = SyntheticImu(state.range(0), 0.0, 200.0);
+  Eigen::Vector3d bg(0.001, -0.002, 0.001), ba(0.01, 0.02, -0.01);
+  for (auto _ : state)
+  {
+    IMUIntegrator integrator;
+    integrator.PushIMUMsg(vimu);
+    integrator.PreIntegration(0.0, bg, ba);
+    benchmark::DoNotOptimize(integrator.GetDeltaP());
+  }
+  state.SetItemsProcessed(state.iterations() * vimu.size());
+}
+BENCHMARK(BM_PreIntegration)->Arg(100)->Unit(benchmark::kMicrosecond);
+
+static void BM_RemoveLidarDistortion(benchmark::State &state)
+{
+  CLOUD::Ptr random = RandomCloud(state.range(0), 50.0, 6);
+  LabelledCloud::Ptr source(new LabelledCloud), cloud(new LabelledCloud);
+  source->resize(random->size());
+  for (size_t i = 0; i < random->size(); ++i)
+    source->points[i].Set(random->points[i]);
+  Eigen::Matrix3d dR = Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+  Eigen::Vector3d dt(0.8, 0.05, 0.01);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    *cloud = *source;
+    state.ResumeTiming();
+    LioPipeline::RemoveLidarDistortion(cloud, dR, dt);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * source->size());
+}
+BENCHMARK(BM_RemoveLidarDistortion)->Arg(100000)->Arg(200000)->Unit(benchmark::kMillisecond);
+
+/** \brief marginalization of a 2 frame window with one IMU factor and num_planes point to plane factors on the oldest frame */
+static MarginalizationInfo *BuildMarginalization(int num_planes, double para_PR[2][6], double para_VBias[2][9],
+                                                 IMUIntegrator &integrator, Eigen::Vector3d &gravity)
+{
+  auto *info = new MarginalizationInfo();
+  Eigen::Matrix<double, 15, 15> sqrt_info = Eigen::LLT<Eigen::Matrix<double, 15, 15>>(integrator.GetCovariance().inverse())
+                                                .matrixL()
+                                                .transpose();
+  info->addResidualBlockInfo(new ResidualBlockInfo(Cost_NavState_PRV_Bias::Create(integrator, gravity, sqrt_info), nullptr,
+                                                   std::vector<double *>{para_PR[0], para_VBias[0], para_PR[1], para_VBias[1]},
+                                                   std::vector<int>{0, 1}));
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> uni(-20, 20);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Eigen::Matrix3d sqrt_plane = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
+  for (int i = 0; i < num_planes; ++i)
+  {
+    Eigen::Vector3d p(uni(rng), uni(rng), uni(rng));
+    Eigen::Vector3d proj = p + Eigen::Vector3d(0.01, 0, 0);
+    info->addResidualBlockInfo(new ResidualBlockInfo(Cost_NavState_IMU_Plan_Vec::Create(p, proj, Tbl, sqrt_plane), nullptr,
+                                                     std::vector<double *>{para_PR[0]}, std::vector<int>{0}));
+  }
+  return info;
+}
+
+template <bool FIXED>
+static void BM_Marginalize(benchmark::State &state)
+{
+  double para_PR[2][6] = {{0, 0, 0, 0, 0, 0}, {0.5, 0, 0, 0, 0, 0.01}};
+  double para_VBias[2][9] = {{1, 0, 0, 0, 0, 0, 0, 0, 0}, {1, 0, 0, 0, 0, 0, 0, 0, 0}};
+  IMUIntegrator integrator;
+  integrator.PushIMUMsg(SyntheticImu(20, 0.0, 200.0));
+  integrator.PreIntegration(0.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  Eigen::Vector3d gravity(0, 0, -9.805);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    MarginalizationInfo *info = BuildMarginalization(state.range(0), para_PR, para_VBias, integrator, gravity);
+    info->preMarginalize();
+    state.ResumeTiming();
+    if (FIXED)
+      info->marginalizeFixed<Estimator::SLIDEWINDOWSIZE>();
+    else
+      info->marginalize();
+    state.PauseTiming();
+    delete info;
+    state.ResumeTiming();
+  }
+}
+BENCHMARK_TEMPLATE(BM_Marginalize, false)->Arg(500)->Arg(3000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Marginalize, true)->Arg(500)->Arg(3000)->Unit(benchmark::kMicrosecond);
+
+static FeatureExtractor::Options ExtractorOptions()
+{
+  FeatureExtractor::Options options;
+  options.N_SCAN = kNScan;
+  options.Horizon_SCAN = kHorizonScan;
+  options.edgeThreshold = 1.0;
+  options.surfThreshold = 0.1;
+  options.odometrySurfLeafSize = 0.5;
+  return options;
+}
+
+static void BM_CalculateSmoothness(benchmark::State &state)
+{
+  FeatureExtractor extractor(ExtractorOptions());
+  LabelledCloud::Ptr extracted(new LabelledCloud);
+  CLOUD::Ptr corner(new CLOUD), surf(new CLOUD);
+  // run once to fill the range image of the scan
+  extractor.Extract(Scan(), extracted, corner, surf);
+  const int cloudSize = extracted->size();
+  for (auto _ : state)
+  {
+    extractor.calculateSmoothness(cloudSize);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * cloudSize);
+}
+BENCHMARK(BM_CalculateSmoothness)->Unit(benchmark::kMicrosecond);
+
+static void BM_FeatureExtract(benchmark::State &state)
+{
+  FeatureExtractor extractor(ExtractorOptions());
+  LabelledCloud::Ptr extracted(new LabelledCloud);
+  CLOUD::Ptr corner(new CLOUD), surf(new CLOUD);
+  for (auto _ : state)
+    extractor.Extract(Scan(), extracted, corner, surf);
+  state.SetItemsProcessed(state.iterations() * Scan()->size());
+}
+BENCHMARK(BM_FeatureExtract)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv)
+{
+  // take our own arguments out before google benchmark parses the rest
+  int out = 1;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--scan") == 0 && i + 1 < argc)
+    {
+      recorded_scan.reset(new CLOUD);
+      if (pcl::io::loadPCDFile(argv[++i], *recorded_scan) == -1)
+      {
+        std::cerr << "couldn't load " << argv[i] << std::endl;
+        return 1;
+      }
+      continue;
+    }
+    argv[out++] = argv[i];
+  }
+  argc = out;
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
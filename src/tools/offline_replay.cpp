@@ -0,0 +1,415 @@
+/*
+ * Offline replay of a recorded sequence through feature extraction, LIO and map localization,
+ * back-to-back in a single thread without a ros master, as fast as the CPU allows.
+ *
+ * usage:
+ *   offline_replay <sequence_dir> [--config <params.yaml>] [--mode lio|loc|both] [--map <map_dir>]
+ *                  [--init x y z roll pitch yaw] [--max_frames N] [--out <prefix>] [--trace]
+ *
+ * sequence layout:
+ *   scans.txt  one scan per line: "<end time [s]> <pcd file relative to sequence_dir>"
+ *   imu.txt    one sample per line: "<time [s]> <acc x y z [m/s^2]> <gyro x y z [rad/s]>"
+ *   *.pcd      PointXYZINormal scans as produced by the feature_extract node before projection:
+ *              normal_x is the relative time inside the scan in [0,1], normal_y the ring
+ *
+ * outputs:
+ *   <prefix>_lio.txt / <prefix>_loc.txt  trajectories in TUM format
+ *   frames/s and per stage latency percentiles on stdout
+ *   <prefix>_latency.csv                 percentiles of the profiler spans inside the pipelines
+ *   <prefix>_trace.json                  with --trace, chrome trace timeline of all threads
+ *   heap allocations per frame on stdout when built with -DCOUNT_ALLOCATIONS=ON
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sys/stat.h>
+
+#include "Estimator/FeatureExtractor.h"
+#include "Estimator/LioPipeline.h"
+#include "loc/map_location.h"
+#include "utils/ParamFile.h"
+#include "utils/Profiler.h"
+#include "utils/AllocCounter.h"
+#include "utils/CloudPool.h"
+#include "tictoc.hpp"
+
+/** \brief latency samples of one pipeline stage */
+struct StageStats
+{
+  std::vector<double> samples; // ms
+
+  void add(double ms)
+  {
+    samples.push_back(ms);
+  }
+
+  double percentile(double q) const
+  {
+    if (samples.empty())
+      return 0;
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(q * (sorted.size() - 1) + 0.5));
+    return sorted[idx];
+  }
+
+  double mean() const
+  {
+    double sum = 0;
+    for (double s : samples)
+      sum += s;
+    return samples.empty() ? 0 : sum / samples.size();
+  }
+};
+
+struct ScanEntry
+{
+  double time;
+  std::string file;
+};
+
+bool loadScanList(const std::string &dir, std::vector<ScanEntry> &scans)
+{
+  std::ifstream fin(dir + "/scans.txt");
+  if (!fin.is_open())
+    return false;
+  ScanEntry e;
+  while (fin >> e.time >> e.file)
+    scans.push_back(e);
+  return !scans.empty();
+}
+
+bool loadImu(const std::string &dir, std::vector<sensor_msgs::ImuConstPtr> &imus)
+{
+  std::ifstream fin(dir + "/imu.txt");
+  if (!fin.is_open())
+    return false;
+  double t, ax, ay, az, gx, gy, gz;
+  while (fin >> t >> ax >> ay >> az >> gx >> gy >> gz)
+  {
+    sensor_msgs::ImuPtr imu(new sensor_msgs::Imu);
+    imu->header.stamp.fromSec(t);
+    imu->linear_acceleration.x = ax;
+    imu->linear_acceleration.y = ay;
+    imu->linear_acceleration.z = az;
+    imu->angular_velocity.x = gx;
+    imu->angular_velocity.y = gy;
+    imu->angular_velocity.z = gz;
+    imus.push_back(imu);
+  }
+  return true;
+}
+
+/** \brief create dir and its missing parents, like mkdir -p */
+bool makeDirs(const std::string &dir)
+{
+  for (size_t pos = dir.find('/', 1);; pos = dir.find('/', pos + 1))
+  {
+    const std::string sub = dir.substr(0, pos);
+    if (!sub.empty() && ::mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+    if (pos == std::string::npos)
+      return true;
+  }
+}
+
+void saveTrajectoryTUMformat(std::ofstream &fout, double time, const Eigen::Matrix4d &pose)
+{
+  Eigen::Quaterniond q(pose.topLeftCorner<3, 3>());
+  fout << std::fixed << std::setprecision(6) << time << " " << pose(0, 3) << " " << pose(1, 3) << " " << pose(2, 3) << " "
+       << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    std::cout << "usage: " << argv[0] << " <sequence_dir> [--config <params.yaml>] [--mode lio|loc|both] [--map <map_dir>]"
+              << " [--init x y z roll pitch yaw] [--max_frames N] [--out <prefix>] [--trace]" << std::endl;
+    return 1;
+  }
+  std::string seq_dir = argv[1];
+  std::string config = std::string(ROOT_DIR) + "config/params.yaml";
+  std::string mode = "both";
+  std::string map_dir;
+  std::string out_prefix = std::string(ROOT_DIR) + "Log/replay";
+  int max_frames = -1;
+  bool trace = false;
+  PointXYZIRPYT init_pose;
+  init_pose.x = init_pose.y = init_pose.z = 0;
+  init_pose.roll = init_pose.pitch = init_pose.yaw = 0;
+  for (int i = 2; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--config" && i + 1 < argc)
+      config = argv[++i];
+    else if (arg == "--mode" && i + 1 < argc)
+      mode = argv[++i];
+    else if (arg == "--map" && i + 1 < argc)
+      map_dir = argv[++i];
+    else if (arg == "--out" && i + 1 < argc)
+      out_prefix = argv[++i];
+    else if (arg == "--trace")
+      trace = true;
+    else if (arg == "--max_frames" && i + 1 < argc)
+      max_frames = std::atoi(argv[++i]);
+    else if (arg == "--init" && i + 6 < argc)
+    {
+      init_pose.x = std::atof(argv[++i]);
+      init_pose.y = std::atof(argv[++i]);
+      init_pose.z = std::atof(argv[++i]);
+      init_pose.roll = std::atof(argv[++i]);
+      init_pose.pitch = std::atof(argv[++i]);
+      init_pose.yaw = std::atof(argv[++i]);
+    }
+    else
+    {
+      std::cout << ANSI_COLOR_RED << "unknown argument: " << arg << ANSI_COLOR_RESET << std::endl;
+      return 1;
+    }
+  }
+  const bool run_lio = mode == "lio" || mode == "both";
+  const bool run_loc = mode == "loc" || mode == "both";
+
+  ParamFile params;
+  if (!params.load(config))
+  {
+    std::cout << ANSI_COLOR_RED << "couldn't load config: " << config << ANSI_COLOR_RESET << std::endl;
+    return 1;
+  }
+  if (!map_dir.empty())
+    params.set("location/filedir", map_dir);
+
+#ifndef LIO_DISABLE_PROFILING
+  if (trace)
+  {
+    int capacity;
+    params.param<int>("tracing/buffer_events", capacity, 1 << 18);
+    tracer::GetTracer().Enable(capacity);
+    TRACE_THREAD_NAME("offline_replay");
+  }
+#endif
+
+  std::vector<ScanEntry> scans;
+  std::vector<sensor_msgs::ImuConstPtr> imus;
+  if (!loadScanList(seq_dir, scans) || !loadImu(seq_dir, imus))
+  {
+    std::cout << ANSI_COLOR_RED << "couldn't load scans.txt/imu.txt from " << seq_dir << ANSI_COLOR_RESET << std::endl;
+    return 1;
+  }
+  if (max_frames > 0 && static_cast<int>(scans.size()) > max_frames)
+    scans.resize(max_frames);
+  std::cout << "replay " << scans.size() << " scans, " << imus.size() << " imu samples" << std::endl;
+
+  // feature extraction
+  FeatureExtractor::Options fe_options;
+  std::string sensor;
+  params.param<std::string>("feature_extract/sensor", sensor, "");
+  params.param<int>("feature_extract/N_SCAN", fe_options.N_SCAN, 16);
+  params.param<int>("feature_extract/Horizon_SCAN", fe_options.Horizon_SCAN, 1800);
+  params.param<int>("feature_extract/downsampleRate", fe_options.downsampleRate, 1);
+  params.param<float>("feature_extract/lidarMinRange", fe_options.lidarMinRange, 1.0);
+  params.param<float>("feature_extract/lidarMaxRange", fe_options.lidarMaxRange, 1000.0);
+  params.param<float>("feature_extract/edgeThreshold", fe_options.edgeThreshold, 0.1);
+  params.param<float>("feature_extract/surfThreshold", fe_options.surfThreshold, 0.1);
+  params.param<float>("feature_extract/odometrySurfLeafSize", fe_options.odometrySurfLeafSize, 0.2);
+  fe_options.sequentialColumns = sensor == "livox";
+  FeatureExtractor extractor(fe_options);
+
+  // lidar inertial odometry
+  LioPipeline *lio = nullptr;
+  if (run_lio)
+  {
+    LioPipeline::Options options;
+    params.param<float>("mapping/filter_parameter_corner", options.filter_parameter_corner, 0.3);
+    params.param<float>("mapping/filter_parameter_surf", options.filter_parameter_surf, 0.3);
+    params.param<int>("mapping/IMU_Mode", options.IMU_Mode, 0);
+    params.param<double>("mapping/assoc_trans_thres", options.assoc_trans_thres, 0.1);
+    params.param<double>("mapping/assoc_rot_thres", options.assoc_rot_thres, 1.0);
+    params.param<int>("mapping/max_iters", options.convergence.max_iters, 5);
+    params.param<double>("mapping/converge_trans", options.convergence.trans_thres, 0.05);
+    params.param<double>("mapping/converge_rot", options.convergence.rot_thres, 0.05);
+    params.param<double>("mapping/converge_cost", options.convergence.cost_thres, 0.01);
+    params.param<bool>("mapping/keyframe_enable", options.keyframe.enable, false);
+    params.param<double>("mapping/keyframe_trans", options.keyframe.trans_thres, 1.0);
+    params.param<double>("mapping/keyframe_rot", options.keyframe.rot_thres, 10.0);
+    params.param<double>("mapping/keyframe_novelty", options.keyframe.novelty_thres, 0.2);
+    params.param<double>("mapping/map_voxel_size", options.keyframe.voxel_size, 0.4);
+    params.param<int>("mapping/map_voxel_max_points", options.keyframe.max_points_per_voxel, 5);
+    params.param<bool>("mapping/stationary_enable", options.stationary.enable, false);
+    params.param<double>("mapping/stationary_gyro", options.stationary.gyro_thres, 0.02);
+    params.param<double>("mapping/stationary_acc_std", options.stationary.acc_std_thres, 0.05);
+    params.param<double>("mapping/stationary_scan_change", options.stationary.scan_change, 0.1);
+    params.param<int>("mapping/stationary_frames", options.stationary.min_frames, 3);
+    params.param<bool>("mapping/feature_budget_enable", options.features.enable, false);
+    params.param<double>("mapping/feature_budget_target_ms", options.features.target_ms, 50.0);
+    params.param<int>("mapping/feature_budget_min", options.features.min_budget, 300);
+    params.param<int>("mapping/feature_budget_max", options.features.max_budget, 3000);
+    params.param<std::vector<double>>("mapping/extrinsic_T", options.extrinsic_T, options.extrinsic_T);
+    params.param<std::vector<double>>("mapping/extrinsic_R", options.extrinsic_R, options.extrinsic_R);
+    lio = new LioPipeline(options);
+    if (options.IMU_Mode > 0)
+      for (const auto &imu : imus)
+        lio->PushImu(imu);
+  }
+
+  // map localization
+  std::unique_ptr<map_location> loc;
+  if (run_loc)
+  {
+    loc.reset(new map_location(&params));
+    if (!loc->MapLoaded())
+    {
+      std::cout << ANSI_COLOR_RED << "localization disabled, no prior map" << ANSI_COLOR_RESET << std::endl;
+      loc.reset();
+    }
+    else
+    {
+      for (const auto &imu : imus)
+        loc->imu_callback(imu);
+      loc->SetInitialPose(init_pose);
+    }
+  }
+
+  //  create the output folder
+  const size_t slash = out_prefix.rfind('/');
+  if (slash != std::string::npos && !makeDirs(out_prefix.substr(0, slash)))
+    std::cout << ANSI_COLOR_RED << "couldn't create " << out_prefix.substr(0, slash) << ANSI_COLOR_RESET << std::endl;
+  std::ofstream lio_fout, loc_fout;
+  if (lio)
+    lio_fout.open(out_prefix + "_lio.txt");
+  if (loc)
+    loc_fout.open(out_prefix + "_loc.txt");
+
+  std::map<std::string, StageStats> stats;
+  const char *stage_order[] = {"load", "extract", "lio", "loc", "frame"};
+  StageStats allocs, allocs_total; // heap allocations per frame, replay thread and all threads
+  CloudPool<LabelledPoint> frame_pool;
+  // reserved so that recording the samples does not show up as allocations of the frame
+  for (const char *name : stage_order)
+    if ((lio || std::string(name) != "lio") && (loc || std::string(name) != "loc"))
+      stats[name].samples.reserve(scans.size());
+  allocs.samples.reserve(scans.size());
+  allocs_total.samples.reserve(scans.size());
+  CLOUD_PTR scan(new CLOUD);
+  CLOUD_PTR corner(new CLOUD);
+  CLOUD_PTR surf(new CLOUD);
+  std::vector<sensor_msgs::ImuConstPtr> vimuMsg;
+  int processed = 0;
+  double process_ms = 0;
+  TicToc wall;
+  for (const auto &entry : scans)
+  {
+    TicToc tc;
+    if (pcl::io::loadPCDFile(seq_dir + "/" + entry.file, *scan) == -1)
+    {
+      std::cout << ANSI_COLOR_RED << "couldn't load " << entry.file << ", skipped" << ANSI_COLOR_RESET << std::endl;
+      continue;
+    }
+    stats["load"].add(tc.toc());
+
+    TicToc frame_tc;
+    alloc_counter::FrameAllocations frame_allocs;
+    TRACE_SCOPE("replay frame");
+    tc.tic();
+    // the frame is extracted into a pooled cloud and handed to the pipeline as it is
+    LabelledCloud::Ptr extracted = frame_pool.Acquire();
+    extractor.Extract(scan, extracted, corner, surf);
+    stats["extract"].add(tc.toc());
+    // both pipelines undistort their cloud in place, with both running loc gets a copy taken before lio
+    LabelledCloud::Ptr loc_cloud = extracted;
+    if (lio && loc)
+    {
+      loc_cloud = frame_pool.Acquire();
+      *loc_cloud = *extracted;
+    }
+
+    if (lio)
+    {
+      tc.tic();
+      vimuMsg.clear();
+      if (lio->NeedImu())
+        lio->fetchImuMsgs(lio->LastLidarTime(), entry.time, vimuMsg);
+      if (lio->ProcessFrame(extracted, entry.time, vimuMsg))
+        saveTrajectoryTUMformat(lio_fout, entry.time, lio->GetLidarPose());
+      stats["lio"].add(tc.toc());
+    }
+
+    if (loc)
+    {
+      tc.tic();
+      vimuMsg.clear();
+      if (loc->NeedImu())
+        loc->fetchImuMsgs(loc->LastLidarTime(), entry.time, vimuMsg);
+      if (loc->ProcessFrame(loc_cloud, entry.time, vimuMsg) && loc->GetInitializedFlag() == Initialized)
+        saveTrajectoryTUMformat(loc_fout, entry.time, loc->GetPose());
+      stats["loc"].add(tc.toc());
+    }
+
+    allocs.add(frame_allocs.Thread());
+    allocs_total.add(frame_allocs.Total());
+    double frame_ms = frame_tc.toc();
+    stats["frame"].add(frame_ms);
+    process_ms += frame_ms;
+    processed++;
+  }
+  double wall_ms = wall.toc();
+
+  std::cout << ANSI_COLOR_GREEN << "---- offline replay: " << processed << " frames ----" << ANSI_COLOR_RESET << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "throughput: " << (process_ms > 0 ? processed * 1000.0 / process_ms : 0) << " frames/s (processing), "
+            << (wall_ms > 0 ? processed * 1000.0 / wall_ms : 0) << " frames/s (including load)" << std::endl;
+  std::cout << std::setw(10) << "stage" << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90"
+            << std::setw(10) << "p99" << std::setw(10) << "max" << "  [ms]" << std::endl;
+  for (const char *name : stage_order)
+  {
+    auto it = stats.find(name);
+    if (it == stats.end())
+      continue;
+    const StageStats &s = it->second;
+    std::cout << std::setw(10) << name << std::setw(10) << s.mean() << std::setw(10) << s.percentile(0.5)
+              << std::setw(10) << s.percentile(0.9) << std::setw(10) << s.percentile(0.99) << std::setw(10) << s.percentile(1.0) << std::endl;
+  }
+
+  if (alloc_counter::Enabled())
+  {
+    // the first frames fill the pools and grow the buffers, steady state is the second half
+    size_t zero = 0;
+    for (size_t i = allocs.samples.size() / 2; i < allocs.samples.size(); ++i)
+      zero += allocs.samples[i] == 0;
+    std::cout << std::setw(10) << "allocs" << std::setw(10) << allocs.mean() << std::setw(10) << allocs.percentile(0.5)
+              << std::setw(10) << allocs.percentile(0.9) << std::setw(10) << allocs.percentile(0.99) << std::setw(10) << allocs.percentile(1.0)
+              << "  [per frame, replay thread]" << std::endl;
+    std::cout << std::setw(10) << "all" << std::setw(10) << allocs_total.mean() << std::setw(10) << allocs_total.percentile(0.5)
+              << std::setw(10) << allocs_total.percentile(0.9) << std::setw(10) << allocs_total.percentile(0.99) << std::setw(10) << allocs_total.percentile(1.0)
+              << "  [per frame, all threads]" << std::endl;
+    std::cout << "allocation free frames in the second half: " << zero << "/" << allocs.samples.size() - allocs.samples.size() / 2 << std::endl;
+  }
+
+#ifndef LIO_DISABLE_PROFILING
+  profiler::Reporter reporter;
+  std::vector<profiler::StageSummary> spans = reporter.Collect();
+  std::cout << std::setw(16) << "span" << std::setw(10) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+            << std::setw(10) << "p95" << std::setw(10) << "p99" << "  [ms]" << std::endl;
+  for (const auto &s : spans)
+    std::cout << std::setw(16) << s.name << std::setw(10) << s.count << std::setw(10) << s.mean_ms << std::setw(10) << s.p50_ms
+              << std::setw(10) << s.p95_ms << std::setw(10) << s.p99_ms << std::endl;
+  std::remove((out_prefix + "_latency.csv").c_str());
+  profiler::AppendCsv(out_prefix + "_latency.csv", 0, spans);
+  if (trace && tracer::GetTracer().Dump(out_prefix + "_trace.json"))
+    std::cout << "trace: " << out_prefix << "_trace.json" << std::endl;
+#endif
+
+  if (lio)
+    std::cout << "lio trajectory: " << out_prefix << "_lio.txt" << std::endl;
+  if (loc)
+    std::cout << "loc trajectory: " << out_prefix << "_loc.txt" << std::endl;
+
+  // the lio estimator keeps its map thread running, the pipeline is left to the process exit like in the nodes
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Counting malloc for -DCOUNT_ALLOCATIONS=ON builds, see include/utils/AllocCounter.h.
+ * The symbols interpose the glibc allocator for the whole process and forward to its
+ * __libc_* entry points, frees are not counted.
+ */
+#include "utils/AllocCounter.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+extern "C"
+{
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t n, size_t size);
+  void *__libc_realloc(void *ptr, size_t size);
+  void *__libc_memalign(size_t alignment, size_t size);
+}
+
+namespace
+{
+std::atomic<uint64_t> total_allocations(0);
+// plain static tls of the executable, usable inside malloc
+thread_local uint64_t thread_allocations = 0;
+
+inline void Count()
+{
+  ++thread_allocations;
+  total_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace
+
+namespace alloc_counter
+{
+uint64_t ThreadAllocations()
+{
+  return thread_allocations;
+}
+
+uint64_t TotalAllocations()
+{
+  return total_allocations.load(std::memory_order_relaxed);
+}
+} // namespace alloc_counter
+
+extern "C"
+{
+  void *malloc(size_t size)
+  {
+    Count();
+    return __libc_malloc(size);
+  }
+
+  void *calloc(size_t n, size_t size)
+  {
+    Count();
+    return __libc_calloc(n, size);
+  }
+
+  void *realloc(void *ptr, size_t size)
+  {
+    Count();
+    return __libc_realloc(ptr, size);
+  }
+
+  void *memalign(size_t alignment, size_t size)
+  {
+    Count();
+    return __libc_memalign(alignment, size);
+  }
+
+  void *aligned_alloc(size_t alignment, size_t size)
+  {
+    Count();
+    return __libc_memalign(alignment, size);
+  }
+
+  int posix_memalign(void **ptr, size_t alignment, size_t size)
+  {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+      return EINVAL;
+    Count();
+    void *p = __libc_memalign(alignment, size);
+    if (!p && size)
+      return ENOMEM;
+    *ptr = p;
+    return 0;
+  }
+}
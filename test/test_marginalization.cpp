@@ -0,0 +1,135 @@
+/*
+ * MarginalizationInfo::marginalizeFixed against MarginalizationInfo::marginalize: both must leave
+ * the same prior, J^T J and J^T r of the kept blocks, on the factors of a sliding window.
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+
+#include "Estimator/Estimator.h"
+#include "Estimator/IMUIntegrator.h"
+#include "Estimator/ceresfunc.h"
+
+namespace
+{
+std::vector<sensor_msgs::ImuConstPtr> SyntheticImu(int n, double t0, double rate)
+{
+  std::vector<sensor_msgs::ImuConstPtr> vimu;
+  for (int i = 0; i < n; ++i)
+  {
+    sensor_msgs::ImuPtr imu(new sensor_msgs::Imu);
+    imu->header.stamp.fromSec(t0 + (i + 1) / rate);
+    imu->linear_acceleration.x = 0.1 * std::sin(0.1 * i);
+    imu->linear_acceleration.y = 0.05;
+    imu->linear_acceleration.z = 9.805;
+    imu->angular_velocity.x = 0.01;
+    imu->angular_velocity.y = 0.0;
+    imu->angular_velocity.z = 0.2;
+    vimu.push_back(imu);
+  }
+  return vimu;
+}
+
+/** \brief one IMU factor between two frames and num_planes point to plane factors on the first
+ *  frame, the first frame is marginalized
+ */
+MarginalizationInfo *BuildMarginalization(int num_planes, unsigned seed, double para_PR[2][6], double para_VBias[2][9],
+                                          IMUIntegrator &integrator, Eigen::Vector3d &gravity)
+{
+  auto *info = new MarginalizationInfo();
+  Eigen::Matrix<double, 15, 15> sqrt_info = Eigen::LLT<Eigen::Matrix<double, 15, 15>>(integrator.GetCovariance().inverse())
+                                                .matrixL()
+                                                .transpose();
+  info->addResidualBlockInfo(new ResidualBlockInfo(Cost_NavState_PRV_Bias::Create(integrator, gravity, sqrt_info), nullptr,
+                                                   std::vector<double *>{para_PR[0], para_VBias[0], para_PR[1], para_VBias[1]},
+                                                   std::vector<int>{0, 1}));
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uni(-20, 20);
+  std::uniform_real_distribution<double> offset(-0.05, 0.05);
+  Eigen::Matrix4d Tbl = Eigen::Matrix4d::Identity();
+  Eigen::Matrix3d sqrt_plane = (1.0 / IMUIntegrator::lidar_m) * Eigen::Matrix3d::Identity();
+  for (int i = 0; i < num_planes; ++i)
+  {
+    Eigen::Vector3d p(uni(rng), uni(rng), uni(rng));
+    Eigen::Vector3d proj = p + Eigen::Vector3d(offset(rng), offset(rng), offset(rng));
+    info->addResidualBlockInfo(new ResidualBlockInfo(Cost_NavState_IMU_Plan_Vec::Create(p, proj, Tbl, sqrt_plane), nullptr,
+                                                     std::vector<double *>{para_PR[0]}, std::vector<int>{0}));
+  }
+  return info;
+}
+
+/** \brief J^T J and J^T r of the prior left by a marginalization, the kept blocks ordered by address */
+void MarginalizationPrior(const MarginalizationInfo &info, Eigen::MatrixXd &H, Eigen::VectorXd &g)
+{
+  std::map<long, int> kept; // address to index in the prior
+  for (const auto &it : info.parameter_block_idx)
+    if (it.second >= info.m)
+      kept[it.first] = it.second - info.m;
+  std::vector<int> order;
+  for (const auto &it : kept)
+    for (int k = 0; k < info.parameter_block_size.at(it.first); ++k)
+      order.push_back(it.second + k);
+  const Eigen::MatrixXd JtJ = info.linearized_jacobians.transpose() * info.linearized_jacobians;
+  const Eigen::VectorXd Jtr = info.linearized_jacobians.transpose() * info.linearized_residuals;
+  const int n = static_cast<int>(order.size());
+  H.resize(n, n);
+  g.resize(n);
+  for (int i = 0; i < n; ++i)
+  {
+    g(i) = Jtr(order[i]);
+    for (int j = 0; j < n; ++j)
+      H(i, j) = JtJ(order[i], order[j]);
+  }
+}
+} // namespace
+
+TEST(Marginalization, FixedMatchesDynamic)
+{
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> uni(-0.5, 0.5);
+  // without planes the IMU factor alone is square in the first frame and the prior vanishes,
+  // both sides are then rounding noise of the cancellation
+  for (int num_planes : {10, 50, 500, 3000})
+  {
+    SCOPED_TRACE(num_planes);
+    double para_PR[2][6];
+    double para_VBias[2][9];
+    for (int i = 0; i < 2; ++i)
+    {
+      for (int k = 0; k < 6; ++k)
+        para_PR[i][k] = uni(rng);
+      for (int k = 0; k < 9; ++k)
+        para_VBias[i][k] = k < 3 ? 2 * uni(rng) : 0.01 * uni(rng);
+    }
+    IMUIntegrator integrator;
+    integrator.PushIMUMsg(SyntheticImu(20, 0.0, 200.0));
+    integrator.PreIntegration(0.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+    Eigen::Vector3d gravity(0, 0, -9.805);
+
+    MarginalizationInfo *dynamic = BuildMarginalization(num_planes, num_planes + 1, para_PR, para_VBias, integrator, gravity);
+    MarginalizationInfo *fixed = BuildMarginalization(num_planes, num_planes + 1, para_PR, para_VBias, integrator, gravity);
+    dynamic->preMarginalize();
+    fixed->preMarginalize();
+    dynamic->marginalize();
+    fixed->marginalizeFixed<Estimator::SLIDEWINDOWSIZE>();
+
+    Eigen::MatrixXd H, HFixed;
+    Eigen::VectorXd g, gFixed;
+    MarginalizationPrior(*dynamic, H, g);
+    MarginalizationPrior(*fixed, HFixed, gFixed);
+    delete dynamic;
+    delete fixed;
+
+    ASSERT_EQ(H.rows(), HFixed.rows());
+    EXPECT_LE((HFixed - H).cwiseAbs().maxCoeff(), 1e-8 * std::max(H.cwiseAbs().maxCoeff(), 1.0));
+    EXPECT_LE((gFixed - g).cwiseAbs().maxCoeff(), 1e-8 * std::max(g.cwiseAbs().maxCoeff(), 1.0));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
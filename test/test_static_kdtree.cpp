@@ -0,0 +1,167 @@
+/*
+ * StaticKdTree k nearest neighbours against a brute force search, with float and with int16
+ * quantized storage.
+ */
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <pcl/point_types.h>
+
+#include "Estimator/StaticKdTree.h"
+
+typedef pcl::PointXYZINormal PointType;
+typedef pcl::PointCloud<PointType> CLOUD;
+
+namespace
+{
+/** \brief points of a map far from the world origin, uniform in a box plus two planes */
+CLOUD::Ptr RandomMap(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uni(-30.0f, 30.0f);
+  CLOUD::Ptr cloud(new CLOUD);
+  for (size_t i = 0; i < n; ++i)
+  {
+    PointType p;
+    p.x = 5000.0f + uni(rng);
+    p.y = -2000.0f + uni(rng);
+    p.z = i % 3 == 0 ? 0.0f : (i % 3 == 1 ? uni(rng) / 10 : uni(rng));
+    cloud->push_back(p);
+  }
+  return cloud;
+}
+
+struct Neighbour
+{
+  int index;
+  float sqDist;
+  bool operator<(const Neighbour &o) const { return sqDist < o.sqDist || (sqDist == o.sqDist && index < o.index); }
+};
+
+/** \brief squared distances in double to the exact input points, sorted */
+std::vector<Neighbour> BruteForce(const CLOUD &cloud, const PointType &q)
+{
+  std::vector<Neighbour> all(cloud.size());
+  for (size_t i = 0; i < cloud.size(); ++i)
+  {
+    const double dx = double(cloud.points[i].x) - q.x;
+    const double dy = double(cloud.points[i].y) - q.y;
+    const double dz = double(cloud.points[i].z) - q.z;
+    all[i].index = int(i);
+    all[i].sqDist = float(dx * dx + dy * dy + dz * dz);
+  }
+  std::sort(all.begin(), all.end());
+  return all;
+}
+
+std::vector<PointType> Queries(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> uni(-35.0f, 35.0f);
+  std::vector<PointType> queries(n);
+  for (auto &q : queries)
+  {
+    q.x = 5000.0f + uni(rng);
+    q.y = -2000.0f + uni(rng);
+    q.z = uni(rng) / 2;
+  }
+  return queries;
+}
+} // namespace
+
+TEST(StaticKdTree, FloatMatchesBruteForce)
+{
+  for (size_t n : {5, 100, 20000, 70000})
+  {
+    SCOPED_TRACE(n);
+    CLOUD::Ptr cloud = RandomMap(n, unsigned(n));
+    StaticKdTree<PointType> tree;
+    tree.setInputCloud(cloud);
+    ASSERT_EQ(int(n), tree.size());
+    for (const PointType &q : Queries(200, unsigned(n) + 1))
+    {
+      const std::vector<Neighbour> expected = BruteForce(*cloud, q);
+      KnnResult<5> result;
+      const int found = tree.nearestKSearch(q, result);
+      ASSERT_EQ(int(std::min<size_t>(5, n)), found);
+      for (int k = 0; k < found; ++k)
+      {
+        // the tree computes relative to the cloud centre in float, ties may swap
+        EXPECT_NEAR(expected[k].sqDist, result.sqDists[k], 1e-4f * std::max(1.0f, expected[k].sqDist));
+        // the stored coordinates are floats relative to the cloud centre
+        const PointType &p = cloud->points[result.indices[k]];
+        EXPECT_NEAR(p.x, result.xyz[k][0], 1e-5f);
+        EXPECT_NEAR(p.y, result.xyz[k][1], 1e-5f);
+        EXPECT_NEAR(p.z, result.xyz[k][2], 1e-5f);
+        if (k + 1 < found && expected[k + 1].sqDist - expected[k].sqDist > 1e-3f)
+          EXPECT_EQ(expected[k].index, result.indices[k]);
+      }
+
+      // the vector interface returns the same neighbours
+      std::vector<int> indices;
+      std::vector<float> sqDists;
+      ASSERT_EQ(found, tree.nearestKSearch(q, 5, indices, sqDists));
+      for (int k = 0; k < found; ++k)
+        EXPECT_EQ(result.indices[k], indices[k]);
+
+      // a distance bound keeps exactly the neighbours inside it
+      const float bound = expected[std::min<size_t>(2, n - 1)].sqDist + 1e-3f;
+      KnnResult<5> bounded;
+      tree.nearestKSearch(q, bounded, bound);
+      for (int k = 0; k < bounded.size; ++k)
+        EXPECT_LT(bounded.sqDists[k], bound);
+      EXPECT_GE(bounded.size, int(std::min<size_t>(3, n)) - 1);
+    }
+  }
+}
+
+TEST(StaticKdTree, QuantizedMatchesBruteForce)
+{
+  const float step = 0.005f;
+  // largest distance of a dequantized point to its input point
+  const float err = 0.5f * step * std::sqrt(3.0f) * 1.01f;
+  for (size_t n : {100, 20000, 70000})
+  {
+    SCOPED_TRACE(n);
+    CLOUD::Ptr cloud = RandomMap(n, unsigned(n) + 7);
+    StaticKdTree<PointType> tree;
+    tree.setQuantizationStep(step);
+    tree.setInputCloud(cloud);
+    for (const PointType &q : Queries(200, unsigned(n) + 8))
+    {
+      const std::vector<Neighbour> expected = BruteForce(*cloud, q);
+      KnnResult<5> result;
+      ASSERT_EQ(5, tree.nearestKSearch(q, result));
+      for (int k = 0; k < 5; ++k)
+      {
+        const PointType &p = cloud->points[result.indices[k]];
+        // the stored point is within half a step per axis of the input point
+        const float dx = result.xyz[k][0] - p.x, dy = result.xyz[k][1] - p.y, dz = result.xyz[k][2] - p.z;
+        EXPECT_LE(std::sqrt(dx * dx + dy * dy + dz * dz), err);
+        // the distance is the one to the stored point
+        const float sx = result.xyz[k][0] - q.x, sy = result.xyz[k][1] - q.y, sz = result.xyz[k][2] - q.z;
+        EXPECT_NEAR(sx * sx + sy * sy + sz * sz, result.sqDists[k], 1e-3f * std::max(1.0f, result.sqDists[k]));
+        if (k > 0)
+          EXPECT_LE(result.sqDists[k - 1], result.sqDists[k]);
+        // and the k-th neighbour is no farther than the exact k-th neighbour plus the quantization
+        EXPECT_LE(std::sqrt(result.sqDists[k]), std::sqrt(expected[k].sqDist) + err);
+      }
+      // every exact neighbour clearly inside the k-th distance is found
+      const float kth = std::sqrt(result.sqDists[4]);
+      for (const Neighbour &e : expected)
+      {
+        if (std::sqrt(e.sqDist) >= kth - 2 * err)
+          break;
+        EXPECT_NE(result.indices + 5, std::find(result.indices, result.indices + 5, e.index));
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
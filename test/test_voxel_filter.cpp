@@ -0,0 +1,134 @@
+/*
+ * VoxelFilter in compatible mode against pcl::VoxelGrid<pcl::PointXYZINormal>: same points in
+ * the same order, bit for bit, through filter() and FilterByLabel().
+ */
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <pcl/filters/voxel_grid.h>
+
+#include "Estimator/VoxelFilter.h"
+
+typedef pcl::PointXYZINormal PointType;
+typedef pcl::PointCloud<PointType> CLOUD;
+
+namespace
+{
+/** \brief n points in a 40 m cube off the origin, a tenth of them in a dense cluster so that
+ *  voxels hold many points, every field random
+ */
+CLOUD::Ptr RandomCloud(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> pos(-20.0f, 20.0f);
+  std::uniform_real_distribution<float> cluster(-0.5f, 0.5f);
+  std::uniform_real_distribution<float> field(0.0f, 1.0f);
+  CLOUD::Ptr cloud(new CLOUD);
+  for (size_t i = 0; i < n; ++i)
+  {
+    PointType p;
+    const bool dense = i % 10 == 0;
+    p.x = 100.0f + (dense ? cluster(rng) : pos(rng));
+    p.y = -50.0f + (dense ? cluster(rng) : pos(rng));
+    p.z = dense ? cluster(rng) : pos(rng) / 4;
+    p.intensity = 100 * field(rng);
+    p.normal_x = field(rng);
+    p.normal_y = field(rng);
+    p.normal_z = field(rng);
+    p.curvature = field(rng);
+    cloud->push_back(p);
+  }
+  return cloud;
+}
+
+LabelledCloud::Ptr RandomLabelledCloud(size_t n, unsigned seed)
+{
+  CLOUD::Ptr raw = RandomCloud(n, seed);
+  std::mt19937 rng(seed + 1);
+  std::uniform_int_distribution<int> label(LabelledPoint::None, LabelledPoint::NonFeature);
+  LabelledCloud::Ptr cloud(new LabelledCloud);
+  for (const auto &p : raw->points)
+  {
+    LabelledPoint lp;
+    lp.Set(p);
+    lp.ring = static_cast<uint8_t>(label(rng) * 10);
+    lp.label = static_cast<uint8_t>(label(rng));
+    cloud->push_back(lp);
+  }
+  return cloud;
+}
+
+CLOUD VoxelGrid(const CLOUD::Ptr &cloud, float leaf)
+{
+  pcl::VoxelGrid<PointType> grid;
+  grid.setLeafSize(leaf, leaf, leaf);
+  grid.setInputCloud(cloud);
+  CLOUD out;
+  grid.filter(out);
+  return out;
+}
+
+void ExpectBitIdentical(const CLOUD &expected, const CLOUD &actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i)
+  {
+    const PointType &e = expected.points[i];
+    const PointType &a = actual.points[i];
+    const float fe[8] = {e.x, e.y, e.z, e.intensity, e.normal_x, e.normal_y, e.normal_z, e.curvature};
+    const float fa[8] = {a.x, a.y, a.z, a.intensity, a.normal_x, a.normal_y, a.normal_z, a.curvature};
+    ASSERT_EQ(0, std::memcmp(fe, fa, sizeof(fe))) << "point " << i;
+  }
+}
+} // namespace
+
+TEST(VoxelFilter, CompatibleFilterMatchesVoxelGrid)
+{
+  unsigned seed = 1;
+  for (float leaf : {0.1f, 0.2f, 0.3f, 0.5f, 1.0f, 1.7f})
+  {
+    SCOPED_TRACE(leaf);
+    CLOUD::Ptr cloud = RandomCloud(20000, seed++);
+    VoxelFilter filter;
+    filter.setCompatible(true);
+    filter.setLeafSize(leaf, leaf, leaf);
+    filter.setInputCloud(cloud);
+    CLOUD out;
+    filter.filter(out);
+    ExpectBitIdentical(VoxelGrid(cloud, leaf), out);
+  }
+}
+
+TEST(VoxelFilter, CompatibleFilterByLabelMatchesVoxelGrid)
+{
+  const float leafs[][3] = {{0.2f, 0.4f, 0.8f}, {0.3f, 0.7f, 0.11f}, {1.0f / 3, 0.15f, 2.5f}};
+  unsigned seed = 100;
+  for (const auto &leaf : leafs)
+  {
+    SCOPED_TRACE(leaf[0]);
+    LabelledCloud::Ptr cloud = RandomLabelledCloud(30000, seed++);
+    VoxelFilter filter;
+    filter.setCompatible(true);
+    filter.setLeafSize(0.9f, 0.9f, 0.9f);
+    for (int l = 0; l < 3; ++l)
+      filter.setLabelLeafSize(l + 1, leaf[l]);
+    CLOUD corner, surf, nonFeature;
+    filter.FilterByLabel(*cloud, corner, surf, &nonFeature);
+
+    CLOUD::Ptr split[3] = {CLOUD::Ptr(new CLOUD), CLOUD::Ptr(new CLOUD), CLOUD::Ptr(new CLOUD)};
+    SplitByLabel(*cloud, *split[0], *split[1], split[2].get());
+    ExpectBitIdentical(VoxelGrid(split[0], leaf[0]), corner);
+    ExpectBitIdentical(VoxelGrid(split[1], leaf[1]), surf);
+    ExpectBitIdentical(VoxelGrid(split[2], leaf[2]), nonFeature);
+    // the leaf of filter() is left as it was
+    EXPECT_EQ(0.9f, filter.getLeafSize()[0]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}